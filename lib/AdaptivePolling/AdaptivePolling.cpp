@@ -0,0 +1,97 @@
+/**
+ * @file AdaptivePolling.cpp
+ * @brief Implementation of per-channel poll period selection.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include "AdaptivePolling.h"
+
+/**
+ * @brief Reset a channel to the given period.
+ */
+void AdaptivePoll_init(PollChannel *ch, uint32_t periodMs)
+{
+    ch->pollClass = POLL_CLASS_RUNNING;
+    ch->activity = 0;
+    ch->periodMs = periodMs;
+}
+
+/**
+ * @brief Choose the period of a PZEM016T socket.
+ *
+ * @details A change re-arms fast polling for POLL_ACTIVITY_HOLD evaluations, whatever the class,
+ *          so power-up, power-loss and load steps are followed closely; afterwards the period
+ *          settles to the one of the socket's steady class.
+ */
+uint32_t AdaptivePoll_updateSocket(PollChannel *ch, bool powered, bool machineOn, bool changed)
+{
+    if (changed)
+    {
+        ch->activity = POLL_ACTIVITY_HOLD;
+    }
+    else if (ch->activity > 0)
+    {
+        ch->activity--;
+    }
+
+    if (ch->activity > 0)
+    {
+        ch->pollClass = POLL_CLASS_ACTIVE;
+        ch->periodMs = POLL_PERIOD_ACTIVE_MS;
+    }
+    else if (!powered)
+    {
+        ch->pollClass = POLL_CLASS_LOST;
+        ch->periodMs = POLL_PERIOD_LOST_MS;
+    }
+    else if (!machineOn)
+    {
+        ch->pollClass = POLL_CLASS_OFF;
+        ch->periodMs = POLL_PERIOD_OFF_MS;
+    }
+    else
+    {
+        ch->pollClass = POLL_CLASS_RUNNING;
+        ch->periodMs = POLL_PERIOD_RUNNING_MS;
+    }
+    return ch->periodMs;
+}
+
+/**
+ * @brief Choose the period of the environment sensor.
+ */
+uint32_t AdaptivePoll_updateEnvironment(PollChannel *ch, bool changed)
+{
+    if (changed)
+    {
+        ch->activity = POLL_ACTIVITY_HOLD;
+    }
+    else if (ch->activity > 0)
+    {
+        ch->activity--;
+    }
+
+    ch->pollClass = ch->activity > 0 ? POLL_CLASS_ACTIVE : POLL_CLASS_RUNNING;
+    ch->periodMs = ch->activity > 0 ? POLL_PERIOD_ENV_ACTIVE_MS : POLL_PERIOD_ENV_MS;
+    return ch->periodMs;
+}
+
+/**
+ * @brief Printable name of a class.
+ */
+const char *AdaptivePoll_className(PollClass pollClass)
+{
+    switch (pollClass)
+    {
+    case POLL_CLASS_LOST:
+        return "lost";
+    case POLL_CLASS_OFF:
+        return "off";
+    case POLL_CLASS_RUNNING:
+        return "running";
+    case POLL_CLASS_ACTIVE:
+        return "active";
+    }
+    return "?";
+}
@@ -0,0 +1,84 @@
+/**
+ * @file AdaptivePolling.h
+ * @brief Per-channel poll period selection from device state and recent change activity.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef ADAPTIVE_POLLING_H
+#define ADAPTIVE_POLLING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Poll periods (ms) of a PZEM016T socket in each class
+#define POLL_PERIOD_ACTIVE_MS 1000   // Machine running and its readings are changing
+#define POLL_PERIOD_RUNNING_MS 5000  // Machine running with steady readings (the fixed-schedule rate)
+#define POLL_PERIOD_OFF_MS 10000     // Socket powered, machine off
+#define POLL_PERIOD_LOST_MS 30000    // Socket lost power / meter not answering
+
+// Poll periods (ms) of the environment sensor (room temperature changes over minutes)
+#define POLL_PERIOD_ENV_ACTIVE_MS 10000 // Temperature or humidity changed recently
+#define POLL_PERIOD_ENV_MS 30000        // Steady environment
+
+#define POLL_ACTIVITY_HOLD 3 // Evaluations a channel stays fast after its last change
+
+    /**
+     * @brief Activity class of a polled channel.
+     */
+    typedef enum
+    {
+        POLL_CLASS_LOST = 0, ///< No power / no valid data
+        POLL_CLASS_OFF,      ///< Powered, machine off
+        POLL_CLASS_RUNNING,  ///< Machine on, steady
+        POLL_CLASS_ACTIVE    ///< Machine on or state changing, recent change detected
+    } PollClass;
+
+    /**
+     * @brief Rate state of one channel.
+     */
+    typedef struct
+    {
+        PollClass pollClass; ///< Class chosen by the last evaluation
+        uint8_t activity;    ///< Evaluations left in fast mode after the last change
+        uint32_t periodMs;   ///< Poll period chosen by the last evaluation
+    } PollChannel;
+
+    /**
+     * @brief Reset a channel to the given period (the fixed-schedule period before the first evaluation).
+     */
+    extern void AdaptivePoll_init(PollChannel *ch, uint32_t periodMs);
+
+    /**
+     * @brief Choose the period of a PZEM016T socket.
+     * @param ch Channel state.
+     * @param powered socketState[] of the socket (power present and valid data).
+     * @param machineOn sensorData[].machineState of the socket.
+     * @param changed true if any reading or state of the socket changed beyond its calculateDelta() threshold.
+     * @return New poll period in ms.
+     */
+    extern uint32_t AdaptivePoll_updateSocket(PollChannel *ch, bool powered, bool machineOn, bool changed);
+
+    /**
+     * @brief Choose the period of the environment sensor.
+     * @param ch Channel state.
+     * @param changed true if temperature or humidity changed beyond its delta threshold.
+     * @return New poll period in ms.
+     */
+    extern uint32_t AdaptivePoll_updateEnvironment(PollChannel *ch, bool changed);
+
+    /**
+     * @brief Printable name of a class.
+     */
+    extern const char *AdaptivePoll_className(PollClass pollClass);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADAPTIVE_POLLING_H
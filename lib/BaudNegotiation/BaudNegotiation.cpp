@@ -0,0 +1,172 @@
+/**
+ * @file BaudNegotiation.cpp
+ * @brief Implementation of the sensor bus baud rate negotiation.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include "BaudNegotiation.h"
+#include <Preferences.h>
+
+static Preferences baudPrefs; // NVS namespace "busbaud", one key per bus name
+
+static uint32_t loadBaud(void)
+{
+    baudPrefs.begin("busbaud", true);
+    const uint32_t baud = baudPrefs.getUInt(sensorBus.name, SENSOR_BUS_BAUD);
+    baudPrefs.end();
+    return baud;
+}
+
+static void saveBaud(uint32_t baud)
+{
+    baudPrefs.begin("busbaud", false);
+    baudPrefs.putUInt(sensorBus.name, baud);
+    baudPrefs.end();
+}
+
+/**
+ * @brief Slave type that keeps the sensor bus at its default rate.
+ */
+const char *BaudNegotiation_fixedBy(const ModbusBusMap *map)
+{
+    for (int i = 0; i < NUM_DEVICES; i++)
+    {
+        if (map->pzem[i] != 0)
+        {
+            return "PZEM016T"; // Fixed 9600 baud, no rate register
+        }
+    }
+    return NULL;
+}
+
+// The ES35-SW answers BAUD_VERIFY_READS read-backs of its rate register at the current bus rate
+static bool verify(uint32_t baud)
+{
+    for (uint8_t n = 0; n < BAUD_VERIFY_READS; n++)
+    {
+        if (!ES35SW_checkBaudRate(baud))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Move the ES35-SW and the sensor bus from @p current to @p baud.
+ *
+ * @details The sensor echoes the write at the old rate and switches afterwards; the bus follows right
+ *          after the echo. If the read-backs at the new rate fail, the sensor either never switched
+ *          (it still answers at @p current) or switched but does not work reliably at @p baud: then the
+ *          old rate is written back at @p baud. Either way sensor and bus end up at @p current.
+ * @return true if sensor and bus now run at @p baud.
+ */
+static bool moveSensor(uint32_t current, uint32_t baud)
+{
+    if (ES35SW_writeBaudRate(baud) == RS485_OK && verify(baud))
+    {
+        return true;
+    }
+    RS485Bus_setBaud(&sensorBus, current);
+    if (ES35SW_checkBaudRate(current))
+    {
+        return false;
+    }
+    RS485Bus_setBaud(&sensorBus, baud);
+    if (ES35SW_writeBaudRate(current) != RS485_OK)
+    {
+        RS485Bus_setBaud(&sensorBus, current); // Lost at both rates: BaudNegotiation_check() keeps looking
+    }
+    return false;
+}
+
+// Try the candidate rates above the current one, fastest first, and keep the first that verifies
+static void upgrade(void)
+{
+    const uint32_t candidates[] = BAUD_CANDIDATES;
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++)
+    {
+        const uint32_t current = sensorBus.baud;
+        if (candidates[i] <= current || ES35SW_baudCode(candidates[i]) < 0)
+        {
+            continue;
+        }
+        if (moveSensor(current, candidates[i]))
+        {
+            saveBaud(candidates[i]);
+            Serial.printf("[BAUD] %s: upgraded to %lu baud\n", sensorBus.name, (unsigned long)candidates[i]);
+            return;
+        }
+        Serial.printf("[BAUD] %s: %lu baud failed verification, staying at %lu\n", sensorBus.name,
+                      (unsigned long)candidates[i], (unsigned long)current);
+    }
+}
+
+/**
+ * @brief Restore, verify or negotiate the sensor bus rate at boot.
+ *
+ * @details A saved rate is only kept if the ES35-SW answers at it; a bus that gained a fixed-rate slave
+ *          since (or BAUD_NEGOTIATION_ENABLE 0) moves the ES35-SW back to the default rate first.
+ */
+void BaudNegotiation_init(void)
+{
+    const uint32_t saved = loadBaud();
+    const char *fixedBy = BAUD_NEGOTIATION_ENABLE ? BaudNegotiation_fixedBy(&modbusBusMap) : "configuration";
+
+    if (saved != SENSOR_BUS_BAUD)
+    {
+        RS485Bus_setBaud(&sensorBus, saved);
+        if (!verify(saved))
+        {
+            Serial.printf("[BAUD] %s: no answer at saved %lu baud, falling back\n", sensorBus.name, (unsigned long)saved);
+            RS485Bus_setBaud(&sensorBus, SENSOR_BUS_BAUD);
+            saveBaud(SENSOR_BUS_BAUD);
+        }
+        else if (fixedBy != NULL)
+        {
+            if (!moveSensor(saved, SENSOR_BUS_BAUD))
+            {
+                RS485Bus_setBaud(&sensorBus, SENSOR_BUS_BAUD); // The fixed-rate slaves take precedence
+            }
+            saveBaud(SENSOR_BUS_BAUD);
+        }
+    }
+
+    if (fixedBy != NULL)
+    {
+        Serial.printf("[BAUD] %s: %lu baud, fixed by %s\n", sensorBus.name, (unsigned long)sensorBus.baud, fixedBy);
+        return;
+    }
+    if (sensorBus.baud == SENSOR_BUS_BAUD)
+    {
+        upgrade();
+    }
+    Serial.printf("[BAUD] %s: %lu baud\n", sensorBus.name, (unsigned long)sensorBus.baud);
+}
+
+/**
+ * @brief Fall back to the default rate when the ES35-SW answers there instead of at the negotiated rate.
+ */
+void BaudNegotiation_check(void)
+{
+    static uint32_t lastCheckMs = 0;
+    if (sensorBus.baud == SENSOR_BUS_BAUD || es35swBreaker.state != BREAKER_OPEN ||
+        millis() - lastCheckMs < BAUD_FALLBACK_CHECK_MS)
+    {
+        return;
+    }
+    lastCheckMs = millis();
+
+    const uint32_t fast = sensorBus.baud;
+    RS485Bus_setBaud(&sensorBus, SENSOR_BUS_BAUD);
+    if (ES35SW_checkBaudRate(SENSOR_BUS_BAUD))
+    {
+        saveBaud(SENSOR_BUS_BAUD);
+        Breaker_init(&es35swBreaker);
+        Serial.printf("[BAUD] %s: ES35-SW answers at %lu baud again, bus falls back\n", sensorBus.name,
+                      (unsigned long)SENSOR_BUS_BAUD);
+        return;
+    }
+    RS485Bus_setBaud(&sensorBus, fast);
+}
@@ -0,0 +1,59 @@
+/**
+ * @file BaudNegotiation.h
+ * @brief Moves an RS485 bus to a faster baud rate when every slave on it supports one, with read-back
+ *        verification, automatic fallback and the negotiated rate persisted in NVS.
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * All slaves of a bus share its rate, so a bus can only be upgraded when every mapped slave has a
+ * programmable rate. On this cart that is never the case today: the PZEM016T is fixed at 9600 baud
+ * and shares the sensor bus with the ES35-SW, and the MD0630T01A has no documented rate register.
+ * The procedure runs when the bus map has no PZEM016T on the sensor bus (ES35-SW alone).
+ */
+
+#ifndef BAUD_NEGOTIATION_H
+#define BAUD_NEGOTIATION_H
+
+#include <Arduino.h>
+#include "RS485_Bus.h"
+#include "ES35-SW.h"
+#include "ModbusDiscovery.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifndef BAUD_NEGOTIATION_ENABLE
+#define BAUD_NEGOTIATION_ENABLE 1 // 0: keep every bus at its default rate and ignore a saved rate
+#endif
+
+#define BAUD_CANDIDATES {38400, 19200} // Rates tried on the sensor bus, fastest first
+#define BAUD_VERIFY_READS 3            // Read-backs at the new rate that must all succeed
+#define BAUD_FALLBACK_CHECK_MS 60000   // Interval of the default-rate check while the ES35-SW is silent
+
+    /**
+     * @brief Restore the saved rate of the sensor bus, verifying that the slaves answer at it
+     *        (falling back to SENSOR_BUS_BAUD otherwise), then try to upgrade a bus still at the default
+     *        rate. Call after ModbusDiscovery_init().
+     */
+    extern void BaudNegotiation_init(void);
+
+    /**
+     * @brief Runtime fallback for the acquisition task: if the sensor bus runs above its default rate
+     *        and the ES35-SW stopped answering, check whether it came back at the default rate
+     *        (replaced or factory-reset module) and move the bus there if so.
+     */
+    extern void BaudNegotiation_check(void);
+
+    /**
+     * @brief Name of the slave type that pins the sensor bus to its default rate, or NULL if every
+     *        mapped slave supports a rate change.
+     */
+    extern const char *BaudNegotiation_fixedBy(const ModbusBusMap *map);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BAUD_NEGOTIATION_H
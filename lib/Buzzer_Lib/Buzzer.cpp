@@ -7,24 +7,259 @@
  */
 
 #include "Buzzer.h"
+#include "esp_timer.h"
 
-// Declare array for the melody and duration of the startup tone
-uint16_t melody[] = {1047, 1319, 1568, 1319, 1047, 1568, 2093}; 
-                //    C6,   E6,   G6,   E6,   C6,   G6,   C7
-uint16_t duration[] = {120, 120, 120, 120, 120, 180, 350}; // milliseconds for each note
+#define NOTE_COUNT(table) ((uint8_t)(sizeof(table) / sizeof((table)[0])))
+
+// Startup melody: C6, E6, G6, E6, C6, G6, C7 with a 40 ms gap after each note
+static const BuzzerNote startupNotes[] = {
+    {1047, 120}, {TONE_MIN_FREQ, 40},
+    {1319, 120}, {TONE_MIN_FREQ, 40},
+    {1568, 120}, {TONE_MIN_FREQ, 40},
+    {1319, 120}, {TONE_MIN_FREQ, 40},
+    {1047, 120}, {TONE_MIN_FREQ, 40},
+    {1568, 180}, {TONE_MIN_FREQ, 40},
+    {2093, 350}, {TONE_MIN_FREQ, 40}};
+
+// Warning: 3 high and clear beeps followed by a pause
+static const BuzzerNote warningNotes[] = {
+    {TONE_MAX_FREQ, 120}, {TONE_MIN_FREQ, 80},
+    {TONE_MAX_FREQ, 120}, {TONE_MIN_FREQ, 80},
+    {TONE_MAX_FREQ, 120}, {TONE_MIN_FREQ, 80},
+    {TONE_MIN_FREQ, 250}};
+
+// Soft leakage warning: 2 long beeps followed by a long pause
+static const BuzzerNote leakSoftNotes[] = {
+    {TONE_MAX_FREQ, 300}, {TONE_MIN_FREQ, 150},
+    {TONE_MAX_FREQ, 300}, {TONE_MIN_FREQ, 600}};
+
+// Strong leakage alarm: two-tone siren without pause
+static const BuzzerNote leakStrongNotes[] = {
+    {TONE_MAX_FREQ, 200}, {1500, 200}};
+
+// "Happy Birthday" with a 50 ms gap after each note
+static const BuzzerNote happyBirthdayNotes[] = {
+    {262, 250}, {0, 50}, {262, 250}, {0, 50}, {294, 500}, {0, 50}, {262, 500}, {0, 50}, {349, 500}, {0, 50}, {330, 1000}, {0, 50},          // Happy Birthday to You
+    {262, 250}, {0, 50}, {262, 250}, {0, 50}, {294, 500}, {0, 50}, {262, 500}, {0, 50}, {392, 500}, {0, 50}, {349, 1000}, {0, 50},          // Happy Birthday to You
+    {262, 250}, {0, 50}, {262, 250}, {0, 50}, {523, 500}, {0, 50}, {440, 500}, {0, 50}, {349, 500}, {0, 50}, {330, 500}, {0, 50}, {294, 500}, {0, 50}, // Happy Birthday Dear [Name]
+    {466, 250}, {0, 50}, {466, 250}, {0, 50}, {440, 500}, {0, 50}, {349, 500}, {0, 50}, {392, 500}, {0, 50}, {349, 1000}, {0, 50}};        // Happy Birthday to You
+
+const BuzzerPattern BUZZER_PATTERN_STARTUP = {startupNotes, NOTE_COUNT(startupNotes), 1, BUZZER_PRIORITY_MELODY};
+const BuzzerPattern BUZZER_PATTERN_WARNING = {warningNotes, NOTE_COUNT(warningNotes), ALARM_REPEAT, BUZZER_PRIORITY_WARNING};
+const BuzzerPattern BUZZER_PATTERN_LEAK_SOFT = {leakSoftNotes, NOTE_COUNT(leakSoftNotes), ALARM_REPEAT, BUZZER_PRIORITY_LEAK_SOFT};
+const BuzzerPattern BUZZER_PATTERN_LEAK_STRONG = {leakStrongNotes, NOTE_COUNT(leakStrongNotes), 15, BUZZER_PRIORITY_LEAK_STRONG};
+const BuzzerPattern BUZZER_PATTERN_HAPPY_BIRTHDAY = {happyBirthdayNotes, NOTE_COUNT(happyBirthdayNotes), 1, BUZZER_PRIORITY_MELODY};
+
+// Sequencer state, shared between callers of Buzzer_play() and the timer callback
+static portMUX_TYPE buzzerMux = portMUX_INITIALIZER_UNLOCKED;
+static const BuzzerPattern *currentPattern = NULL;           // Pattern being played
+static const BuzzerPattern *pendingPatterns[BUZZER_QUEUE_SIZE]; // Patterns waiting, unordered
+static uint8_t pendingCount = 0;
+static uint8_t noteIndex = 0;   // Note being played in currentPattern
+static uint8_t repeatIndex = 0; // Repetition of currentPattern
+static bool noteStarted = false; // false = the note at noteIndex still has to be output
+static uint32_t noteEndMs = 0;  // End time of the current note
+
+static esp_timer_handle_t buzzerTimer = NULL;
+
+/**
+ * @brief Default output: drive the LEDC channel.
+ */
+static void ledcOutput(uint16_t frequency)
+{
+    ledcWriteTone(PWM_CHANNEL, frequency);
+}
+
+static BuzzerOutput buzzerOutput = ledcOutput;
+
+/**
+ * @brief Remove and return the highest-priority pending pattern (FIFO among equals). Caller holds buzzerMux.
+ */
+static const BuzzerPattern *popPending(void)
+{
+    if (pendingCount == 0)
+    {
+        return NULL;
+    }
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < pendingCount; i++)
+    {
+        if (pendingPatterns[i]->priority > pendingPatterns[best]->priority)
+        {
+            best = i;
+        }
+    }
+    const BuzzerPattern *pattern = pendingPatterns[best];
+    for (uint8_t i = best; i + 1 < pendingCount; i++)
+    {
+        pendingPatterns[i] = pendingPatterns[i + 1];
+    }
+    pendingCount--;
+    return pattern;
+}
+
+/**
+ * @brief true if @p pattern is already queued. Caller holds buzzerMux.
+ */
+static bool isPending(const BuzzerPattern *pattern)
+{
+    for (uint8_t i = 0; i < pendingCount; i++)
+    {
+        if (pendingPatterns[i] == pattern)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Make @p pattern the current one, starting from its first note. Caller holds buzzerMux.
+ */
+static void startPattern(const BuzzerPattern *pattern)
+{
+    currentPattern = pattern;
+    noteIndex = 0;
+    repeatIndex = 0;
+    noteStarted = false;
+}
+
+/**
+ * @brief Timer callback: advance the sequencer every BUZZER_TICK_MS.
+ */
+static void buzzerTimerCallback(void *)
+{
+    Buzzer_tick(millis());
+}
 
 /**
  * @brief Initializes the buzzer.
- * This function sets up the PWM channel for the buzzer and plays the startup tone.
+ * This function sets up the PWM channel and the sequencer timer, then queues the startup tone.
  */
 void initBuzzer(void)
 {
     ledcSetup(PWM_CHANNEL, PWM_FREQUENCY, PWM_RESOLUTION);
     ledcAttachPin(BUZZER_PIN, PWM_CHANNEL);
-    
+
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = buzzerTimerCallback;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "buzzer";
+    esp_timer_create(&timerArgs, &buzzerTimer);
+    esp_timer_start_periodic(buzzerTimer, (uint64_t)BUZZER_TICK_MS * 1000);
+
     playStartupTone();
 }
 
+bool Buzzer_play(const BuzzerPattern *pattern)
+{
+    if (pattern == NULL || pattern->noteCount == 0 || pattern->repeat == 0)
+    {
+        return false;
+    }
+
+    bool queued = true;
+    portENTER_CRITICAL(&buzzerMux);
+    if (pattern == currentPattern || isPending(pattern))
+    {
+        // Đang phát hoặc đã trong hàng đợi, không phát chồng
+    }
+    else if (currentPattern == NULL)
+    {
+        startPattern(pattern);
+    }
+    else if (pattern->priority > currentPattern->priority)
+    {
+        // Ưu tiên cao hơn: ngắt mẫu đang phát, mẫu cũ phát lại từ đầu sau khi mẫu mới kết thúc
+        if (pendingCount < BUZZER_QUEUE_SIZE)
+        {
+            pendingPatterns[pendingCount++] = currentPattern;
+        }
+        startPattern(pattern);
+    }
+    else if (pendingCount < BUZZER_QUEUE_SIZE)
+    {
+        pendingPatterns[pendingCount++] = pattern;
+    }
+    else
+    {
+        queued = false;
+    }
+    portEXIT_CRITICAL(&buzzerMux);
+    return queued;
+}
+
+void Buzzer_tick(uint32_t nowMs)
+{
+    bool output = false;
+    uint16_t frequency = TONE_MIN_FREQ;
+
+    portENTER_CRITICAL(&buzzerMux);
+    if (currentPattern != NULL && noteStarted && (int32_t)(nowMs - noteEndMs) >= 0)
+    {
+        // Hết nốt hiện tại: chuyển nốt, lặp lại mẫu hoặc kết thúc mẫu
+        noteStarted = false;
+        if (++noteIndex >= currentPattern->noteCount)
+        {
+            noteIndex = 0;
+            if (++repeatIndex >= currentPattern->repeat)
+            {
+                currentPattern = NULL;
+                output = true; // Tắt âm nếu không còn mẫu nào chờ
+            }
+        }
+    }
+    if (currentPattern == NULL && pendingCount > 0)
+    {
+        startPattern(popPending());
+    }
+    if (currentPattern != NULL && !noteStarted)
+    {
+        const BuzzerNote *note = &currentPattern->notes[noteIndex];
+        frequency = note->frequency;
+        noteEndMs = nowMs + note->durationMs;
+        noteStarted = true;
+        output = true;
+    }
+    portEXIT_CRITICAL(&buzzerMux);
+
+    // Ghi ra LEDC ngoài vùng critical section
+    if (output)
+    {
+        buzzerOutput(frequency);
+    }
+}
+
+void Buzzer_stop(void)
+{
+    portENTER_CRITICAL(&buzzerMux);
+    currentPattern = NULL;
+    pendingCount = 0;
+    portEXIT_CRITICAL(&buzzerMux);
+    buzzerOutput(TONE_MIN_FREQ);
+}
+
+bool Buzzer_isBusy(void)
+{
+    portENTER_CRITICAL(&buzzerMux);
+    bool busy = (currentPattern != NULL) || (pendingCount > 0);
+    portEXIT_CRITICAL(&buzzerMux);
+    return busy;
+}
+
+int Buzzer_currentPriority(void)
+{
+    portENTER_CRITICAL(&buzzerMux);
+    int priority = (currentPattern != NULL) ? (int)currentPattern->priority : -1;
+    portEXIT_CRITICAL(&buzzerMux);
+    return priority;
+}
+
+void Buzzer_setOutput(BuzzerOutput output)
+{
+    buzzerOutput = (output != NULL) ? output : ledcOutput;
+}
+
 /**
  * @brief Turns off the buzzer sound.
  * This function disables the sound by setting the PWM channel frequency to 0.
@@ -36,70 +271,29 @@ void noTone(void)
 
 /**
  * @brief Plays the startup tone.
- * This function plays a short sequence of tones to indicate successful system startup.
- * The sequence consists of 3 short beeps and 1 long beep.
+ * Queues a short sequence of tones to indicate successful system startup.
  */
 void playStartupTone(void)
 {
-    for (int i = 0; i < 7; i++)
-    {
-        ledcWriteTone(PWM_CHANNEL, melody[i]);
-        delay(duration[i]);
-        ledcWriteTone(PWM_CHANNEL, TONE_MIN_FREQ);
-        delay(40);
-    }
+    Buzzer_play(&BUZZER_PATTERN_STARTUP);
 }
 
 /**
  * @brief Plays a warning tone.
- * This function plays a sequence of high-frequency tones as an alert.
+ * Queues a sequence of high-frequency tones as an alert.
  * The sequence consists of 3 high and clear beeps, repeated multiple times.
  */
 void playWarningTone(void)
 {
-    for (int repeat = 0; repeat < ALARM_REPEAT; repeat++)
-    {
-        for (int i = 0; i < 3; i++)
-        {
-            ledcWriteTone(PWM_CHANNEL, TONE_MAX_FREQ); 
-            delay(120);
-            ledcWriteTone(PWM_CHANNEL, TONE_MIN_FREQ);
-            delay(80);
-        }
-        delay(250); 
-    }
-    ledcWriteTone(PWM_CHANNEL, TONE_MIN_FREQ); 
+    Buzzer_play(&BUZZER_PATTERN_WARNING);
 }
 
 
 /**
  * @brief Plays the "Happy Birthday" melody.
- * This function plays the "Happy Birthday" song using the buzzer.
+ * Queues the "Happy Birthday" song on the buzzer.
  */
 void playHappyBirthdayTone(void)
 {
-    // Nốt nhạc của bài "Happy Birthday"
-    uint16_t happyBirthdayMelody[] = {
-        262, 262, 294, 262, 349, 330, // Happy Birthday to You
-        262, 262, 294, 262, 392, 349, // Happy Birthday to You
-        262, 262, 523, 440, 349, 330, 294, // Happy Birthday Dear [Name]
-        466, 466, 440, 349, 392, 349       // Happy Birthday to You
-    };
-
-    // Độ dài của từng nốt nhạc (ms)
-    uint16_t happyBirthdayDuration[] = {
-        250, 250, 500, 500, 500, 1000, // Happy Birthday to You
-        250, 250, 500, 500, 500, 1000, // Happy Birthday to You
-        250, 250, 500, 500, 500, 500, 500, // Happy Birthday Dear [Name]
-        250, 250, 500, 500, 500, 1000       // Happy Birthday to You
-    };
-
-    // Phát bài hát
-    for (int i = 0; i < sizeof(happyBirthdayMelody) / sizeof(happyBirthdayMelody[0]); i++)
-    {
-        ledcWriteTone(PWM_CHANNEL, happyBirthdayMelody[i]); // Phát nốt nhạc
-        delay(happyBirthdayDuration[i]);                   // Đợi thời gian của nốt nhạc
-        ledcWriteTone(PWM_CHANNEL, TONE_MIN_FREQ);         // Tắt âm giữa các nốt
-        delay(50);                                         // Đợi một chút giữa các nốt
-    }
+    Buzzer_play(&BUZZER_PATTERN_HAPPY_BIRTHDAY);
 }
\ No newline at end of file
@@ -27,15 +27,91 @@ extern "C" {
 #define PWM_FREQUENCY 2000 // PWM frequency
 #define PWM_RESOLUTION 8 // PWM resolution (bits)
 
-extern uint16_t melody[]; // Array containing the frequencies of the notes
-extern uint16_t duration[]; // Array containing the duration of each note
+#define BUZZER_TICK_MS 10 // Sequencer timer period (ms), resolution of note durations
+#define BUZZER_QUEUE_SIZE 4 // Maximum number of patterns waiting behind the one being played
+
+/**
+ * @brief Pattern priority. A higher priority pattern preempts a lower one immediately;
+ * the preempted pattern is queued again and restarts once the higher one finishes.
+ */
+typedef enum
+{
+    BUZZER_PRIORITY_MELODY = 0,  ///< Startup tone, melodies
+    BUZZER_PRIORITY_WARNING,     ///< Generic threshold warning (temperature, voltage...)
+    BUZZER_PRIORITY_LEAK_SOFT,   ///< AC leakage over the soft threshold
+    BUZZER_PRIORITY_LEAK_STRONG  ///< AC leakage over the strong threshold
+} BuzzerPriority;
+
+/**
+ * @brief One note of a pattern. A frequency of TONE_MIN_FREQ is a silence.
+ */
+typedef struct
+{
+    uint16_t frequency;  ///< Tone frequency (Hz)
+    uint16_t durationMs; ///< Note duration (ms)
+} BuzzerNote;
+
+/**
+ * @brief Constant pattern definition: a note table played @c repeat times.
+ */
+typedef struct
+{
+    const BuzzerNote *notes; ///< Note table
+    uint8_t noteCount;       ///< Number of notes in the table
+    uint8_t repeat;          ///< Number of times the table is played
+    BuzzerPriority priority; ///< Preemption priority
+} BuzzerPattern;
+
+extern const BuzzerPattern BUZZER_PATTERN_STARTUP;        ///< Startup melody
+extern const BuzzerPattern BUZZER_PATTERN_WARNING;        ///< Generic warning (3 beeps x ALARM_REPEAT)
+extern const BuzzerPattern BUZZER_PATTERN_LEAK_SOFT;      ///< Soft leakage warning
+extern const BuzzerPattern BUZZER_PATTERN_LEAK_STRONG;    ///< Strong leakage alarm
+extern const BuzzerPattern BUZZER_PATTERN_HAPPY_BIRTHDAY; ///< "Happy Birthday" melody
+
+/**
+ * @brief Output hook receiving the frequency to play (TONE_MIN_FREQ = off).
+ */
+typedef void (*BuzzerOutput)(uint16_t frequency);
 
 /**
  * @brief Initializes the buzzer.
- * This function sets up the PWM channel for the buzzer and plays a startup sound.
+ * This function sets up the PWM channel and the sequencer timer, then queues the startup tone.
  */
 extern void initBuzzer(void);
 
+/**
+ * @brief Queue a pattern without blocking.
+ * Preempts the current pattern if @p pattern has a higher priority, ignored if already playing or queued.
+ * @return false if the queue is full.
+ */
+extern bool Buzzer_play(const BuzzerPattern *pattern);
+
+/**
+ * @brief Advance the sequencer. Called from the buzzer timer; a host build can call it with a fake time.
+ * @param nowMs Current time in ms.
+ */
+extern void Buzzer_tick(uint32_t nowMs);
+
+/**
+ * @brief Stop the current pattern and clear the queue.
+ */
+extern void Buzzer_stop(void);
+
+/**
+ * @brief true while a pattern is playing or queued.
+ */
+extern bool Buzzer_isBusy(void);
+
+/**
+ * @brief Priority of the pattern being played, or -1 if idle.
+ */
+extern int Buzzer_currentPriority(void);
+
+/**
+ * @brief Replace the tone output (default drives the LEDC channel). Used to record timelines on a host.
+ */
+extern void Buzzer_setOutput(BuzzerOutput output);
+
 /**
  * @brief Turns off the buzzer sound.
  */
@@ -43,20 +119,20 @@ extern void noTone(void);
 
 /**
  * @brief Plays the startup sound.
- * This function plays a short tone to indicate that the system has started successfully.
+ * Queues a short melody to indicate that the system has started successfully. Does not block.
  */
 extern void playStartupTone(void);
 
 /**
  * @brief Plays the warning sound.
- * This function plays a sequence of tones with increasing frequency from TONE_MIN_FREQ to TONE_MAX_FREQ.
+ * Queues 3 high and clear beeps, repeated ALARM_REPEAT times. Does not block.
  */
 extern void playWarningTone(void);
 
 
 /**
  * @brief Plays the "Happy Birthday" melody.
- * This function plays the "Happy Birthday" song using the buzzer.
+ * Queues the "Happy Birthday" song on the buzzer. Does not block.
  */
 extern void playHappyBirthdayTone(void);
 
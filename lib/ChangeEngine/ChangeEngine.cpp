@@ -0,0 +1,76 @@
+/**
+ * @file ChangeEngine.cpp
+ * @brief Evaluation loops of the change-detection channel registry.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include "ChangeEngine.h"
+
+/**
+ * @brief true if every gate the channel waits for is open.
+ */
+static inline bool gatesOpen(const ChangeChannel &channel, uint8_t open)
+{
+    return (channel.gates & ~open) == 0;
+}
+
+ChangeMask ChangeEngine_pending(const ChangeChannel *channels, size_t count, const int32_t *values,
+                                const int32_t *published, uint8_t open)
+{
+    ChangeMask mask = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (gatesOpen(channels[i], open) && channels[i].gate->exceeded(values[i], published[i]))
+        {
+            mask |= CHANGE_BIT(channels[i].bit);
+        }
+    }
+    return mask;
+}
+
+ChangeMask ChangeEngine_evaluate(const ChangeChannel *channels, size_t count, const int32_t *values,
+                                 int32_t *published, uint8_t open, ChangeMask force)
+{
+    ChangeMask mask = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!gatesOpen(channels[i], open))
+        {
+            continue;
+        }
+        const ChangeMask bit = CHANGE_BIT(channels[i].bit);
+        if ((force & bit) != 0 || channels[i].gate->exceeded(values[i], published[i]))
+        {
+            published[i] = values[i];
+            mask |= bit;
+        }
+    }
+    return mask;
+}
+
+ChangeMask ChangeEngine_publishAll(const ChangeChannel *channels, size_t count, const int32_t *values,
+                                   int32_t *published)
+{
+    ChangeMask mask = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        published[i] = values[i];
+        mask |= CHANGE_BIT(channels[i].bit);
+    }
+    return mask;
+}
+
+ChangeMask ChangeEngine_clear(const ChangeChannel *channels, size_t count, int32_t *published)
+{
+    ChangeMask mask = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (published[i] != 0)
+        {
+            published[i] = 0;
+            mask |= CHANGE_BIT(channels[i].bit);
+        }
+    }
+    return mask;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file ChangeEngine.h
+ * @brief Table-driven change detection: a registry of measurement channels evaluated in one loop
+ *        into a bitmask of the fields to publish.
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * A driver declares its channels once, as a const table
+ *
+ *     static const ChangeChannel channels[] = {
+ *         {CHANGE_VOLTAGE, GATE_LINE, &voltageGate},
+ *         {CHANGE_CURRENT, GATE_LINE | GATE_LOAD, &currentGate},
+ *     };
+ *
+ * with, for each channel, the bit it sets in the change mask, the warm-up gates that must be open
+ * before it is evaluated, and its delta gate. The current raw values and the last published ones are
+ * two int32_t arrays in the same order as the table. ChangeEngine_evaluate() walks the table once,
+ * updates the published values of the channels that moved and returns their bits; boolean states
+ * are packed into the same bit positions and compared with an XOR (ChangeEngine_transitions).
+ *
+ * The resulting mask replaces one bool per field: merging two cycles is an OR, "anything changed"
+ * is a compare with zero, and the serializer only visits the set bits (ChangeEngine_forEachBit).
+ */
+
+#ifndef CHANGE_ENGINE_H
+#define CHANGE_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FixedPoint.h" // RawDeltaGate
+
+typedef uint32_t ChangeMask; // One bit per published field of a device or of the cart
+
+#define CHANGE_BIT(bit) ((ChangeMask)1u << (bit))          // Mask of one field
+#define CHANGE_BITS(count) ((ChangeMask)((1ull << (count)) - 1u)) // Mask of the fields 0..count-1
+
+/**
+ * @brief One registered measurement channel.
+ */
+typedef struct
+{
+    uint8_t bit;              ///< Bit set in the change mask when the channel changes
+    uint8_t gates;            ///< Warm-up gates (caller-defined flags) that must all be open
+    const RawDeltaGate *gate; ///< Smallest change that is published
+} ChangeChannel;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Changes of every channel whose gates are all open in @p open, without publishing them.
+     * @param values Current raw values, in the order of @p channels.
+     * @param published Last published raw values, in the order of @p channels.
+     */
+    extern ChangeMask ChangeEngine_pending(const ChangeChannel *channels, size_t count, const int32_t *values,
+                                           const int32_t *published, uint8_t open);
+
+    /**
+     * @brief Evaluate every channel whose gates are all open in @p open and publish those that changed.
+     *
+     * A channel is published when its delta gate is exceeded, or unconditionally when its bit is in
+     * @p force (e.g. a value broadcast to every socket). Published channels copy their value into
+     * @p published.
+     * @return Bits of the published channels.
+     */
+    extern ChangeMask ChangeEngine_evaluate(const ChangeChannel *channels, size_t count, const int32_t *values,
+                                            int32_t *published, uint8_t open, ChangeMask force);
+
+    /**
+     * @brief Publish every channel as is (boot snapshot).
+     * @return Bits of all channels.
+     */
+    extern ChangeMask ChangeEngine_publishAll(const ChangeChannel *channels, size_t count, const int32_t *values,
+                                              int32_t *published);
+
+    /**
+     * @brief Publish zero on every channel whose published value is not zero yet (sensor offline).
+     * @return Bits of the channels that were cleared.
+     */
+    extern ChangeMask ChangeEngine_clear(const ChangeChannel *channels, size_t count, int32_t *published);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @brief Bits of the boolean states that differ between two packed state words.
+ */
+static inline ChangeMask ChangeEngine_transitions(ChangeMask before, ChangeMask after)
+{
+    return before ^ after;
+}
+
+/**
+ * @brief @p bit if @p state is true, 0 otherwise; builds a packed state word.
+ */
+static inline ChangeMask ChangeEngine_state(bool state, unsigned bit)
+{
+    return (ChangeMask)state << bit;
+}
+
+/**
+ * @brief Call @p fn(bit) for every set bit of @p mask, lowest first. The loop runs once per set bit.
+ */
+template <typename F>
+static inline void ChangeEngine_forEachBit(ChangeMask mask, F fn)
+{
+    while (mask != 0)
+    {
+        fn((unsigned)__builtin_ctz(mask));
+        mask &= mask - 1; // Clear the lowest set bit
+    }
+}
+
+#endif // CHANGE_ENGINE_H
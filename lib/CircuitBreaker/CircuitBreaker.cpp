@@ -0,0 +1,98 @@
+/**
+ * @file CircuitBreaker.cpp
+ * @brief Implementation of the per-slave circuit breaker.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include "CircuitBreaker.h"
+
+/**
+ * @brief Reset a breaker to closed.
+ */
+void Breaker_init(CircuitBreaker *breaker)
+{
+    breaker->state = BREAKER_CLOSED;
+    breaker->failures = 0;
+    breaker->openedAtMs = 0;
+    breaker->probeDelayMs = BREAKER_PROBE_MIN_MS;
+    breaker->tripCount = 0;
+    breaker->skipped = 0;
+}
+
+/**
+ * @brief Decide whether a request may go on the bus.
+ */
+BreakerDecision Breaker_allow(CircuitBreaker *breaker, uint32_t nowMs)
+{
+    switch (breaker->state)
+    {
+    case BREAKER_CLOSED:
+        return BREAKER_ALLOW;
+    case BREAKER_OPEN:
+        if ((uint32_t)(nowMs - breaker->openedAtMs) >= breaker->probeDelayMs)
+        {
+            breaker->state = BREAKER_HALF_OPEN;
+            return BREAKER_PROBE;
+        }
+        breaker->skipped++;
+        return BREAKER_SKIP;
+    case BREAKER_HALF_OPEN:
+        return BREAKER_PROBE; // Previous probe never reported: try again
+    }
+    return BREAKER_ALLOW;
+}
+
+/**
+ * @brief Record a successful request or probe.
+ */
+void Breaker_recordSuccess(CircuitBreaker *breaker)
+{
+    breaker->state = BREAKER_CLOSED;
+    breaker->failures = 0;
+    breaker->probeDelayMs = BREAKER_PROBE_MIN_MS;
+}
+
+/**
+ * @brief Record a failed request or probe.
+ */
+void Breaker_recordFailure(CircuitBreaker *breaker, uint32_t nowMs)
+{
+    if (breaker->state == BREAKER_HALF_OPEN)
+    {
+        breaker->state = BREAKER_OPEN;
+        breaker->openedAtMs = nowMs;
+        breaker->probeDelayMs = (breaker->probeDelayMs >= BREAKER_PROBE_MAX_MS / 2) ? BREAKER_PROBE_MAX_MS
+                                                                                      : breaker->probeDelayMs * 2;
+        return;
+    }
+
+    if (breaker->failures < 0xFF)
+    {
+        breaker->failures++;
+    }
+    if (breaker->state == BREAKER_CLOSED && breaker->failures >= BREAKER_FAILURE_THRESHOLD)
+    {
+        breaker->state = BREAKER_OPEN;
+        breaker->openedAtMs = nowMs;
+        breaker->probeDelayMs = BREAKER_PROBE_MIN_MS;
+        breaker->tripCount++;
+    }
+}
+
+/**
+ * @brief Printable name of a state.
+ */
+const char *Breaker_stateName(BreakerState state)
+{
+    switch (state)
+    {
+    case BREAKER_CLOSED:
+        return "closed";
+    case BREAKER_OPEN:
+        return "open";
+    case BREAKER_HALF_OPEN:
+        return "half-open";
+    }
+    return "?";
+}
@@ -0,0 +1,87 @@
+/**
+ * @file CircuitBreaker.h
+ * @brief Per-slave circuit breaker (closed / open / half-open) for Modbus polling.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef CIRCUIT_BREAKER_H
+#define CIRCUIT_BREAKER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define BREAKER_FAILURE_THRESHOLD 3   // Consecutive failures that open the breaker
+#define BREAKER_PROBE_MIN_MS 10000    // First probe interval after the breaker opens
+#define BREAKER_PROBE_MAX_MS 300000   // Probe interval cap (doubles after each failed probe)
+
+    /**
+     * @brief Breaker state.
+     */
+    typedef enum
+    {
+        BREAKER_CLOSED = 0, ///< Slave healthy, normal polling
+        BREAKER_OPEN,       ///< Slave dead, requests are skipped until the next probe time
+        BREAKER_HALF_OPEN   ///< One probe in flight; its result closes or re-opens the breaker
+    } BreakerState;
+
+    /**
+     * @brief What the caller should do with its next request.
+     */
+    typedef enum
+    {
+        BREAKER_ALLOW = 0, ///< Send the normal request
+        BREAKER_PROBE,     ///< Send one cheap probe request first
+        BREAKER_SKIP       ///< Do not touch the bus
+    } BreakerDecision;
+
+    /**
+     * @brief Breaker of one slave.
+     */
+    typedef struct
+    {
+        BreakerState state;    ///< Current state
+        uint8_t failures;      ///< Consecutive failures while closed
+        uint32_t openedAtMs;   ///< When the breaker last opened (or a probe failed)
+        uint32_t probeDelayMs; ///< Wait before the next probe
+        uint32_t tripCount;    ///< Times the breaker opened
+        uint32_t skipped;      ///< Requests skipped while open
+    } CircuitBreaker;
+
+    /**
+     * @brief Reset a breaker to closed.
+     */
+    extern void Breaker_init(CircuitBreaker *breaker);
+
+    /**
+     * @brief Decide whether a request may go on the bus. Moves an open breaker to half-open once
+     *        its probe delay has passed.
+     */
+    extern BreakerDecision Breaker_allow(CircuitBreaker *breaker, uint32_t nowMs);
+
+    /**
+     * @brief Record a successful request or probe: closes the breaker and resets the backoff.
+     */
+    extern void Breaker_recordSuccess(CircuitBreaker *breaker);
+
+    /**
+     * @brief Record a failed request or probe: opens the breaker after BREAKER_FAILURE_THRESHOLD
+     *        failures, or re-opens it with a doubled probe delay if the probe failed.
+     */
+    extern void Breaker_recordFailure(CircuitBreaker *breaker, uint32_t nowMs);
+
+    /**
+     * @brief Printable name of a state.
+     */
+    extern const char *Breaker_stateName(BreakerState state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CIRCUIT_BREAKER_H
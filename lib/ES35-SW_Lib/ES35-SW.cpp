@@ -9,17 +9,23 @@
 #include "ES35-SW.h"
 
 // Define global variables
-ModbusMaster es35swNode;        // Modbus master object for ES35-SW sensor
-HardwareSerial es35swSerial(2); // Serial port for ES35-SW sensors
 ES35SWData_Cart es35swCart;          // Data structure to hold ES35-SW sensor data
 ES35SWData_Device es35swDevice[NUM_DEVICES]; // Array to hold ES35-SW device data
+CircuitBreaker es35swBreaker;        // Circuit breaker of the ES35-SW slave
+uint8_t es35swAddress = ES35SW_SLAVE_ID; // Modbus address of the ES35-SW (bus map from ModbusDiscovery)
 
-float lastESTemp = 0; // Last recorded temperature for delta checking
-float lastESHumi = 0; // Last recorded humidity for delta checking
+int32_t lastES35[ES35_CH_COUNT] = {}; // Last published raw value of each channel (ES35_CHANNEL)
 
-static float tempHistory[5] = {0};
-static float humiHistory[5] = {0};
-static bool isHistoryInitialized = false;
+// Baud rate selected by each value of REG_BAUD_RATE
+static const uint32_t ES35_BAUD_RATES[] = {2400, 4800, 9600, 19200, 38400};
+
+// Filter pipeline of temperature and humidity: measuring range of the sensor, then median
+FILTER_LIMITS(Es35TempLimits, Temperature, ES35_TEMP_MIN, ES35_TEMP_MAX);
+FILTER_LIMITS(Es35HumiLimits, Humidity, ES35_HUMI_MIN, ES35_HUMI_MAX);
+typedef Pipeline<RangeCheck<Es35TempLimits>, Median<Temperature, ES35_MEDIAN_WINDOW>> Es35TempPipeline;
+typedef Pipeline<RangeCheck<Es35HumiLimits>, Median<Humidity, ES35_MEDIAN_WINDOW>> Es35HumiPipeline;
+static Es35TempPipeline tempFilter;
+static Es35HumiPipeline humiFilter;
 
 /**
  *  @brief Initialize  the ES35-SW sensor.
@@ -27,17 +33,8 @@ static bool isHistoryInitialized = false;
  */
 void ES35SW_init()
 {
-    es35swSerial.begin(9600, SERIAL_8N1, ES35_SW_RX_PIN, ES35_SW_TX_PIN); // Initialize serial communication
-    es35swNode.begin(ES35SW_SLAVE_ID, es35swSerial);                      // Set slave ID for Modbus communication
-}
-
-// Hàm lọc median (có thể dùng lại từ PZEM hoặc viết lại)
-float applyMedianFilterES35(float *data, int size)
-{
-    float sortedData[size];
-    memcpy(sortedData, data, size * sizeof(float));
-    std::sort(sortedData, sortedData + size);
-    return sortedData[size / 2];
+    RS485Bus_init(&sensorBus, "sensor", &ES35_SW_SERIAL, ES35_SW_BAUD_RATE, ES35_SW_RX_PIN, ES35_SW_TX_PIN); // Shared with PZEM016T
+    Breaker_init(&es35swBreaker);
 }
 
 /**
@@ -48,59 +45,99 @@ float applyMedianFilterES35(float *data, int size)
  */
 bool ES35SW_update(ES35SWData_Cart *sensor)
 {
-    uint8_t result = es35swNode.readHoldingRegisters(REG_TEMPERATURE, 2); // FC 0x03
-    if (result == es35swNode.ku8MBSuccess)
+    // Circuit breaker: while the sensor is dead only a single-register probe goes on the bus
+    const BreakerDecision decision = Breaker_allow(&es35swBreaker, millis());
+    if (decision == BREAKER_SKIP)
     {
-        float temp = es35swNode.getResponseBuffer(0) / 10.0f; // Temperature in degrees Celsius
-        float humi = es35swNode.getResponseBuffer(1) / 10.0f; // Humidity in percentage
-
-        // Kiểm tra giá trị hợp lệ trong dải đo cảm biến
-        if (isnan(temp) || temp < ES35_TEMP_MIN || temp > ES35_TEMP_MAX ||
-            isnan(humi) || humi < ES35_HUMI_MIN || humi > ES35_HUMI_MAX)
+        sensor->valid = false;
+        return false;
+    }
+    if (decision == BREAKER_PROBE)
+    {
+        uint8_t probe[2];
+        if (RS485Bus_readRegisters(&sensorBus, es35swAddress, ES35_CMD_READ_HOLDING, REG_TEMPERATURE, 1, "es35.probe", probe) != RS485_OK)
         {
+            Breaker_recordFailure(&es35swBreaker, millis());
             sensor->valid = false;
             return false;
         }
+        Breaker_recordSuccess(&es35swBreaker);
+    }
 
-        // Khởi tạo lịch sử nếu lần đầu
-        if (!isHistoryInitialized)
-        {
-            for (int j = 0; j < 5; j++)
-            {
-                tempHistory[j] = temp;
-                humiHistory[j] = humi;
-            }
-            isHistoryInitialized = true;
-        }
+    uint8_t regs[4];
+    if (RS485Bus_readRegisters(&sensorBus, es35swAddress, ES35_CMD_READ_HOLDING, REG_TEMPERATURE, 2, "es35.th", regs) == RS485_OK)
+    {
+        Breaker_recordSuccess(&es35swBreaker);
+
+        const Temperature temp = Temperature::fromRaw((int16_t)((regs[0] << 8) | regs[1])); // 0.1 °C, signed
+        const Humidity humi = Humidity::fromRaw((regs[2] << 8) | regs[3]);                 // 0.1 %
 
-        // Cập nhật lịch sử
-        for (int j = 4; j > 0; j--)
+        // Kiểm tra giá trị hợp lệ trong dải đo cảm biến
+        if (!Es35TempPipeline::accepts(temp) || !Es35HumiPipeline::accepts(humi))
         {
-            tempHistory[j] = tempHistory[j - 1];
-            humiHistory[j] = humiHistory[j - 1];
+            RS485Bus_recordRejected(&sensorBus, es35swAddress);
+            sensor->valid = false;
+            return false;
         }
-        tempHistory[0] = temp;
-        humiHistory[0] = humi;
 
-        // Lọc median
-        sensor->temperature = applyMedianFilterES35(tempHistory, 5);
-        sensor->humidity    = applyMedianFilterES35(humiHistory, 5);
+        // Lọc median (mẫu hợp lệ đầu tiên điền đầy cửa sổ)
+        sensor->temperature = tempFilter.update(temp).value;
+        sensor->humidity    = humiFilter.update(humi).value;
         sensor->valid = true; // Mark data as valid
         return true;          // Successful read
     }
     else
     {
+        Breaker_recordFailure(&es35swBreaker, millis());
         sensor->valid = false; // Mark data as invalid
         return false;          // Read failed
     }
 }
 
+/**
+ * @brief Value of REG_BAUD_RATE for a baud rate, -1 if the sensor does not support it.
+ */
+int ES35SW_baudCode(uint32_t baud)
+{
+    for (size_t code = 0; code < sizeof(ES35_BAUD_RATES) / sizeof(ES35_BAUD_RATES[0]); code++)
+    {
+        if (ES35_BAUD_RATES[code] == baud)
+        {
+            return (int)code;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Write a new baud rate; the bus follows once the sensor has echoed the write.
+ */
+Rs485Status ES35SW_writeBaudRate(uint32_t baud)
+{
+    const int code = ES35SW_baudCode(baud);
+    if (code < 0)
+    {
+        return RS485_FRAME_ERROR;
+    }
+    return RS485Bus_writeRegister(&sensorBus, es35swAddress, REG_BAUD_RATE, (uint16_t)code, baud, "es35.baud");
+}
+
+/**
+ * @brief Read REG_BAUD_RATE back and compare it with the code of @p baud.
+ */
+bool ES35SW_checkBaudRate(uint32_t baud)
+{
+    uint8_t reg[2];
+    return RS485Bus_readRegisters(&sensorBus, es35swAddress, ES35_CMD_READ_HOLDING, REG_BAUD_RATE, 1, "es35.baud", reg) == RS485_OK &&
+           ((reg[0] << 8) | reg[1]) == ES35SW_baudCode(baud);
+}
+
 /**
  *  @brief Read temperature from the ES35-SW sensor.
  *  @param sensor Pointer to the ES35SWData struct to store the temperature data.
  *  @return Temperature in degrees Celsius, or -1.0 if there is an error.
  */
-float ES35SW_getTemperature(const ES35SWData_Cart *sensor)
+Temperature ES35SW_getTemperature(const ES35SWData_Cart *sensor)
 {
     if (sensor && sensor->valid)
     {
@@ -108,7 +145,7 @@ float ES35SW_getTemperature(const ES35SWData_Cart *sensor)
     }
     else
     {
-        return -1.0f; // Lỗi hoặc ngoài dải đo
+        return Temperature(-1.0); // Lỗi hoặc ngoài dải đo
     }
 }
 
@@ -117,7 +154,7 @@ float ES35SW_getTemperature(const ES35SWData_Cart *sensor)
  *  @param sensor Pointer to the ES35SWData struct to store the humidity data.
  *  @return Humidity in percentage, or -1.0 if there is an error.
  */
-float ES35SW_getHumidity(const ES35SWData_Cart *sensor)
+Humidity ES35SW_getHumidity(const ES35SWData_Cart *sensor)
 {
     if (sensor && sensor->valid)
     {
@@ -125,16 +162,6 @@ float ES35SW_getHumidity(const ES35SWData_Cart *sensor)
     }
     else
     {
-        return -1.0f; // Lỗi hoặc ngoài dải đo
+        return Humidity(-1.0); // Lỗi hoặc ngoài dải đo
     }
 }
-
-
-/**
- * @brief Calculate the delta value for ES35-SW sensor readings.
- */
-float calculateDeltaES35(float value, float accuracy_pct, float resolution, float sigma, float F_u, int N_lsb, float delta_min)
-{
-    float delta = F_u * (fabs(value) * accuracy_pct + sigma + N_lsb * resolution);
-    return (delta > delta_min) ? delta : delta_min;
-}
@@ -9,8 +9,17 @@
 #ifndef ES35_SW_H
 #define ES35_SW_H
 
-#include <ModbusMaster.h>
+#include "RS485_Bus.h"
+#include "CircuitBreaker.h"
 #include "PZEM016_Lib.h"
+#include "FilterPipeline.h"
+#include "FixedPoint.h"
+
+// Measurements in the units of the ES35-SW registers (raw = register value)
+struct TemperatureUnit;
+struct HumidityUnit;
+typedef Fixed<10, TemperatureUnit> Temperature; // 0.1 °C
+typedef Fixed<10, HumidityUnit> Humidity;       // 0.1 %RH
 
 #ifdef __cplusplus
 extern "C"
@@ -22,13 +31,16 @@ extern "C"
 #define REG_SLAVE_ID        0x64    // Slave ID register address for ES35-SW sensor
 #define REG_BAUD_RATE       0x65    // Baud rate register address for ES35-SW sensor
 
-#define ES35SW_SLAVE_ID     0x09     // Slave ID for ES35-SW sensor
-#define ES35_SW_BAUD_RATE   9600    // Baud rate for ES35-SW sensor
+#define ES35SW_SLAVE_ID     0x09     // Default slave ID for ES35-SW sensor
+#define ES35_SW_BAUD_RATE   9600    // Factory baud rate for ES35-SW sensor (REG_BAUD_RATE can change it)
+
+#define ES35_CMD_READ_HOLDING 0x03 // Read holding registers
+#define ES35_CMD_WRITE_SINGLE 0x06 // Write single register
 
-#define ES35_SW_RX_PIN 17 // RX pin for ES35-SW sensor
-#define ES35_SW_TX_PIN 16 // TX pin for ES35-SW sensor
+#define ES35_SW_RX_PIN SENSOR_BUS_RX_PIN // RX pin for ES35-SW sensor (shared sensor bus)
+#define ES35_SW_TX_PIN SENSOR_BUS_TX_PIN // TX pin for ES35-SW sensor (shared sensor bus)
 
-#define ES35_SW_SERIAL Serial2 // Serial port for ES35-SW sensors
+#define ES35_SW_SERIAL SENSOR_BUS_SERIAL // Serial port for ES35-SW sensors
 
 #define TEMPERATURE_THHRESHOLD_warning  40.0f       // °C, Temperature threshold for warning
 #define HUMIDITY_THRESHOLD_warning      80.0f       // %, Humidity threshold for warning
@@ -41,6 +53,8 @@ extern "C"
 #define TEMP_DELTA_MIN 0.2f // °C, Define minimum delta for temperature updates
 #define HUMI_DELTA_MIN 1.0f // %, Define minimum delta for humidity updates
 
+#define ES35_MEDIAN_WINDOW 5 // Samples in the median filter of temperature and humidity
+
 // Tham số delta cho nhiệt độ và độ ẩm (có thể chỉnh sửa)
 #define ES35_DELTA_FU 1.7f
 #define ES35_DELTA_N_LSB 3
@@ -64,31 +78,42 @@ extern "C"
 #define COMMON_DEVICE_HUMI_MIN 25.0f // %, Minimum valid humidity for all devices
 #define COMMON_DEVICE_HUMI_MAX 75.0f // %, Maximum valid humidity for all devices
 
-    extern float lastESTemp; // Last recorded temperature for delta checking
-    extern float lastESHumi; // Last recorded humidity for delta checking
+    // Measurement channels checked for changes, in the order of the change-detection table
+    typedef enum
+    {
+        ES35_CH_TEMPERATURE = 0, // Temperature
+        ES35_CH_HUMIDITY,        // Humidity
+        ES35_CH_COUNT
+    } ES35_CHANNEL;
+
+    extern int32_t lastES35[ES35_CH_COUNT]; // Last published raw value of each channel, for delta checking
 
     typedef struct
     {
-        float temperature_min; // Minimum valid temperature
-        float temperature_max; // Maximum valid temperature
-        float humidity_min;    // Minimum valid humidity
-        float humidity_max;    // Maximum valid humidity
+        Temperature temperature_min; // Minimum valid temperature
+        Temperature temperature_max; // Maximum valid temperature
+        Humidity humidity_min;       // Minimum valid humidity
+        Humidity humidity_max;       // Maximum valid humidity
 
     } ES35SW_Thresholds;
 
     static const ES35SW_Thresholds es35swThresholds[NUM_DEVICES] = {
-        [AUO_DISPLAY]       = {0.0f, 40.0f, 20.0f, 80.0f},
-        [CCU_IMAGE1_S]      = {0.0f, 40.0f, 20.0f, 85.0f},
-        [CCU_IMAGE_1_HUB]   = {10.0f, 40.0f, 10.0f, 100.0f},
-        [CCU_TRICAM_PAL]    = {10.0f, 40.0f, 10.0f, 100.0f},
-        [XENON_300]         = {10.0f, 40.0f, 5.0f, 95.0f},
-        [ENDOFLATOR_UI400]  = {10.0f, 35.0f, 15.0f, 85.0f}};
+        [AUO_DISPLAY]       = {Temperature(0.0), Temperature(40.0), Humidity(20.0), Humidity(80.0)},
+        [CCU_IMAGE1_S]      = {Temperature(0.0), Temperature(40.0), Humidity(20.0), Humidity(85.0)},
+        [CCU_IMAGE_1_HUB]   = {Temperature(10.0), Temperature(40.0), Humidity(10.0), Humidity(100.0)},
+        [CCU_TRICAM_PAL]    = {Temperature(10.0), Temperature(40.0), Humidity(10.0), Humidity(100.0)},
+        [XENON_300]         = {Temperature(10.0), Temperature(40.0), Humidity(5.0), Humidity(95.0)},
+        [ENDOFLATOR_UI400]  = {Temperature(10.0), Temperature(35.0), Humidity(15.0), Humidity(85.0)}};
+
+    // Ngưỡng delta cho nhiệt độ và độ ẩm, tính bằng số nguyên theo đơn vị thanh ghi (xem DeltaGate)
+    static constexpr DeltaGate<Temperature> es35TempGate(ES35_ACCURACY_TEMP, ES35_RESOLUTION_TEMP, ES35_SIGMA_TEMP, ES35_DELTA_FU, ES35_DELTA_N_LSB, ES35_DELTA_TEMP_MIN);
+    static constexpr DeltaGate<Humidity> es35HumiGate(ES35_ACCURACY_HUMI, ES35_RESOLUTION_HUMI, ES35_SIGMA_HUMI, ES35_DELTA_FU, ES35_DELTA_N_LSB, ES35_DELTA_HUMI_MIN);
 
     
     typedef struct
     {
-        float temperature;                  // Temperature in degrees Celsius
-        float humidity;                     // Humidity in percentage
+        Temperature temperature;            // Temperature (0.1 °C)
+        Humidity humidity;                  // Humidity (0.1 %)
         bool over_room_temp_max;            // Flag: temperature exceeds safe room max
         bool under_room_temp_min;            // Flag: temperature below safe room min
         bool over_room_humi_max;            // Flag: humidity exceeds safe room max
@@ -113,15 +138,15 @@ extern "C"
 
 
 
-    extern ModbusMaster es35swNode;     // ModbusMaster object for ES35-SW sensor communication
-    extern HardwareSerial es35swSerial; // HardwareSerial object for ES35-SW sensor communication
     extern ES35SWData_Cart es35swCart;       // Struct to hold ES35-SW sensor data
+    extern CircuitBreaker es35swBreaker;     // Circuit breaker of the ES35-SW slave
+    extern uint8_t es35swAddress;            // Modbus address of the ES35-SW (bus map from ModbusDiscovery)
     extern ES35SWData_Device es35swDevice[NUM_DEVICES]; // Array to hold Temp-Humi threshold device data
     
     /**
      * @brief Initialize the ES35-SW sensor.
      * This function sets up the Modbus communication for the ES35-SW sensor.
-     * It initializes the serial port and prepares the ModbusMaster object.
+     * The sensor shares the PZEM016T bus; the bus is initialized once by whichever driver starts first.
      */
 
     extern void ES35SW_init();
@@ -136,37 +161,41 @@ extern "C"
     extern bool ES35SW_update(ES35SWData_Cart *sensor); // Function to update the sensor data
 
     /**
-     * @brief Read temperature from the ES35-SW sensor.
-     *  @param sensor Pointer to the ES35SWData struct to store the temperature data.
-     *  @return Temperature in degrees Celsius, or -1.0 if there is an error.
+     * @brief Value of REG_BAUD_RATE that selects a baud rate.
+     * @return Register value, or -1 if the sensor does not support @p baud.
      */
-    extern float ES35SW_getTemperature(const ES35SWData_Cart *sensor);
+    extern int ES35SW_baudCode(uint32_t baud);
 
     /**
-     *  @brief Read humidity from the ES35-SW sensor.
-     *  @param sensor Pointer to the ES35SWData struct to store the humidity data.
-     *  @return Humidity in percentage, or -1.0 if there is an error.
+     * @brief Write a new baud rate to the sensor; after the echo (sent at the old rate) the sensor
+     *        and the sensor bus both continue at @p baud.
      */
-    extern float ES35SW_getHumidity(const ES35SWData_Cart *sensor);
+    extern Rs485Status ES35SW_writeBaudRate(uint32_t baud);
 
     /**
-     * @brief Calculate the delta for temperature/humidity.
-     * This function calculates the delta value for temperature or humidity
-     * based on the given parameters.
-     * @param value The current value (temperature or humidity).
-     * @param accuracy_pct The accuracy percentage.
-     * @param resolution The resolution value.
-     * @param sigma The sigma value.
-     * @param F_u The F_u value.
-     * @param N_lsb The N_lsb value.
-     * @param delta_min The minimum delta value.
-     * @return The calculated delta value.
+     * @brief Read REG_BAUD_RATE back at the current bus rate.
+     * @return true if the sensor answers and reports the code of @p baud.
      */
-    extern float calculateDeltaES35(float value, float accuracy_pct, float resolution, float sigma, float F_u, int N_lsb, float delta_min);
-
+    extern bool ES35SW_checkBaudRate(uint32_t baud);
 
 #ifdef __cplusplus
 }
 #endif
 
+// C++ linkage: these return Fixed<> values
+
+/**
+ * @brief Read temperature from the ES35-SW sensor.
+ *  @param sensor Pointer to the ES35SWData struct to store the temperature data.
+ *  @return Temperature in degrees Celsius, or -1.0 if there is an error.
+ */
+extern Temperature ES35SW_getTemperature(const ES35SWData_Cart *sensor);
+
+/**
+ *  @brief Read humidity from the ES35-SW sensor.
+ *  @param sensor Pointer to the ES35SWData struct to store the humidity data.
+ *  @return Humidity in percentage, or -1.0 if there is an error.
+ */
+extern Humidity ES35SW_getHumidity(const ES35SWData_Cart *sensor);
+
 #endif // ES35_SW_H
\ No newline at end of file
@@ -0,0 +1,221 @@
+/**
+ * @file FilterPipeline.h
+ * @brief Compile-time composition of per-channel measurement filters (range check, median, EMA,
+ *        deadband) into one inlined update.
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * A channel type is declared once as a typedef, for example
+ *
+ *     typedef Pipeline<RangeCheck<VoltageLimits>, Median<Voltage, 5>, Ema<Voltage, 1, 4>> VoltagePipeline;
+ *
+ * and every sample goes through the stages left to right. Stage parameters are template arguments,
+ * so the compiler sees the whole chain as straight-line code: no virtual call, no stage loop, no
+ * runtime configuration. The value type is float or a Fixed quantity (FixedPoint.h); every stage of
+ * a pipeline works on the same type. Limits are passed through small structs (FILTER_LIMITS)
+ * because C++17 has no float or class template parameters. Requires C++17 (fold expressions).
+ */
+
+#ifndef FILTER_PIPELINE_H
+#define FILTER_PIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "FixedPoint.h"
+#include "SlidingMedian.h"
+
+/**
+ * @brief Declare a limits struct for RangeCheck: accepted values of type Type are [lo, hi].
+ */
+#define FILTER_LIMITS(Name, Type, lo, hi)         \
+    struct Name                                   \
+    {                                             \
+        typedef Type value_type;                  \
+        static constexpr Type min = Type(lo);     \
+        static constexpr Type max = Type(hi);     \
+    }
+
+/**
+ * @brief A sample on its way through a pipeline.
+ */
+template <typename T>
+struct FilterSample
+{
+    T value;      ///< Current value, rewritten by each stage
+    bool valid;   ///< false once a stage rejected the sample; later stages do not run
+    bool changed; ///< false if a Deadband stage held the value back
+};
+
+/**
+ * @brief Reject values outside [Limits::min, Limits::max] (NaN included).
+ *
+ * Stateless: Pipeline::accepts() runs it on its own, so a driver can validate every channel of a
+ * reading before any stateful stage sees one of them.
+ */
+template <typename Limits>
+struct RangeCheck
+{
+    typedef typename Limits::value_type value_type;
+
+    static bool accepts(value_type value) { return value >= Limits::min && value <= Limits::max; }
+
+    bool apply(FilterSample<value_type> &sample)
+    {
+        sample.valid = accepts(sample.value);
+        return sample.valid;
+    }
+};
+
+/**
+ * @brief Median of the last N samples (see SlidingMedian).
+ */
+template <typename T, size_t N>
+struct Median
+{
+    typedef T value_type;
+
+    static bool accepts(T) { return true; }
+
+    bool apply(FilterSample<T> &sample)
+    {
+        sample.value = window.push(sample.value);
+        return true;
+    }
+
+    SlidingMedian<T, N> window;
+};
+
+/**
+ * @brief Smallest move of an Ema towards its input when the rounded update is zero: one raw step of
+ *        a Fixed quantity, in the direction of @p diff.
+ */
+template <int32_t Scale, typename Unit>
+constexpr Fixed<Scale, Unit> filterSmallestStep(Fixed<Scale, Unit> diff)
+{
+    return Fixed<Scale, Unit>::fromRaw(diff.raw < 0 ? -1 : 1);
+}
+
+/**
+ * @brief float has no step: an update that underflowed to zero moves all the way to the input.
+ */
+template <typename T>
+constexpr T filterSmallestStep(T diff)
+{
+    return diff;
+}
+
+/**
+ * @brief Exponential moving average with alpha = Num / Den; the first sample initialises it.
+ *
+ * On a Fixed quantity the update is integer arithmetic rounded to the nearest step. Rounding alone
+ * would stall short of a constant input once (input - state) * Num / Den rounds to 0 (Ema<Voltage, 1, 4>
+ * fed 230.0 V after 0 would settle at 229.9 V), so a non-zero residual always moves the state by at
+ * least one step towards the input.
+ */
+template <typename T, int32_t Num, int32_t Den>
+struct Ema
+{
+    static_assert(Den > 0 && Num > 0 && Num <= Den, "Ema alpha must be in (0, 1]");
+
+    typedef T value_type;
+
+    static bool accepts(T) { return true; }
+
+    bool apply(FilterSample<T> &sample)
+    {
+        if (primed)
+        {
+            const T diff = sample.value - state;
+            const T step = diff * Num / Den;
+            state = state + (step == T() && diff != T() ? filterSmallestStep(diff) : step);
+        }
+        else
+        {
+            state = sample.value;
+            primed = true;
+        }
+        sample.value = state;
+        return true;
+    }
+
+    T state = T();
+    bool primed = false;
+};
+
+/**
+ * @brief Report a change only when Spec::exceeded(value, reported) says the value moved far enough
+ *        from the last reported one (e.g. a DeltaGate); the first sample is always reported.
+ *
+ * The value itself passes through: the stage only clears FilterSample::changed.
+ */
+template <typename Spec>
+struct Deadband
+{
+    typedef typename Spec::value_type value_type;
+
+    static bool accepts(value_type) { return true; }
+
+    bool apply(FilterSample<value_type> &sample)
+    {
+        sample.changed = !primed || Spec::exceeded(sample.value, reported);
+        if (sample.changed)
+        {
+            reported = sample.value;
+            primed = true;
+        }
+        return true;
+    }
+
+    value_type reported = value_type();
+    bool primed = false;
+};
+
+/**
+ * @brief Chain of stages applied left to right; a stage returning false stops the chain.
+ */
+template <typename... Stages>
+class Pipeline
+{
+public:
+    /// Value type of the first stage; all stages must agree on it
+    typedef typename std::tuple_element<0, std::tuple<Stages...>>::type::value_type value_type;
+    static_assert((std::is_same<value_type, typename Stages::value_type>::value && ...),
+                  "all stages of a Pipeline must use the same value type");
+
+    /**
+     * @brief true if no stateless stage (RangeCheck) would reject @p value. Touches no state.
+     */
+    static bool accepts(value_type value) { return (Stages::accepts(value) && ...); }
+
+    /**
+     * @brief Run one sample through every stage.
+     */
+    FilterSample<value_type> update(value_type value)
+    {
+        FilterSample<value_type> sample = {value, true, true};
+        run(sample, std::index_sequence_for<Stages...>{});
+        return sample;
+    }
+
+    /**
+     * @brief Access a stage, e.g. to read an EMA state or clear a median window.
+     */
+    template <size_t I>
+    auto &stage() { return std::get<I>(stages_); }
+
+    static constexpr size_t stageCount() { return sizeof...(Stages); }
+
+private:
+    template <size_t... I>
+    void run(FilterSample<value_type> &sample, std::index_sequence<I...>)
+    {
+        (void)(std::get<I>(stages_).apply(sample) && ...);
+    }
+
+    std::tuple<Stages...> stages_;
+};
+
+#endif // FILTER_PIPELINE_H
@@ -0,0 +1,66 @@
+/**
+ * @file FixedPoint.cpp
+ * @brief Decimal formatting of fixed-point measurements.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include "FixedPoint.h"
+
+/**
+ * @brief Integer part, then the fraction digits of @p scale with trailing zeros removed.
+ *
+ * @details Works on the magnitude as uint32_t so INT32_MIN formats correctly. No snprintf: this runs
+ *          for every field of every published message.
+ */
+size_t FixedPoint_format(char *buf, size_t size, int32_t raw, int32_t scale)
+{
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    char text[16]; // Sign, 10 digits, point: fits any int32_t
+    size_t len = 0;
+    const uint32_t magnitude = raw < 0 ? 0u - (uint32_t)raw : (uint32_t)raw;
+    uint32_t integer = magnitude / (uint32_t)scale;
+    uint32_t fraction = magnitude % (uint32_t)scale;
+
+    if (raw < 0)
+    {
+        text[len++] = '-';
+    }
+
+    char digits[10];
+    size_t count = 0;
+    do
+    {
+        digits[count++] = (char)('0' + integer % 10);
+        integer /= 10;
+    } while (integer != 0);
+    while (count > 0)
+    {
+        text[len++] = digits[--count];
+    }
+
+    if (fraction != 0)
+    {
+        text[len++] = '.';
+        for (uint32_t place = (uint32_t)scale / 10; place > 0 && fraction != 0; place /= 10)
+        {
+            text[len++] = (char)('0' + fraction / place);
+            fraction %= place;
+        }
+    }
+
+    if (len >= size)
+    {
+        len = size - 1;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        buf[i] = text[i];
+    }
+    buf[len] = '\0';
+    return len;
+}
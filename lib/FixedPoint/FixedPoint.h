@@ -0,0 +1,193 @@
+/**
+ * @file FixedPoint.h
+ * @brief Measurements kept as integers in the native register units of the sensors (0.1 V, 0.001 A,
+ *        0.1 °C...), with an integer delta gate and exact decimal formatting.
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * A quantity is a typedef of Fixed, for example
+ *
+ *     typedef Fixed<10, VoltageUnit> Voltage; // raw = volts x 10, the PZEM016T register value
+ *
+ * The register value is stored as read, filtered, compared with thresholds and gated in integer
+ * arithmetic, and only turned into decimal text when it is serialized, so a reading never picks up
+ * float rounding on its way (229.9 stays 2299, never 229.899994). Two quantities with different
+ * units or scales are different types and there is no implicit conversion from or to float: a
+ * forgotten float in the measurement path is a compile error instead of a silent conversion.
+ */
+
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Write @p raw / @p scale as decimal text without trailing zeros ("229.9", "0.237", "50").
+ * @param scale 1, 10, 100 or 1000.
+ * @return Length of the text (the buffer is always terminated when @p size > 0).
+ */
+size_t FixedPoint_format(char *buf, size_t size, int32_t raw, int32_t scale);
+
+/**
+ * @brief Value of a quantity in steps of 1 / Scale of its unit.
+ *
+ * Trivially copyable with a trivial default constructor, so structs holding it keep being plain
+ * data (memcpy into a snapshot, zero-initialised globals).
+ *
+ * @tparam Scale Steps per unit: 10 for a 0.1 V register, 1000 for a 0.001 A register.
+ * @tparam Unit Empty tag struct keeping quantities with the same scale apart.
+ */
+template <int32_t Scale, typename Unit>
+struct Fixed
+{
+    static_assert(Scale == 1 || Scale == 10 || Scale == 100 || Scale == 1000, "Fixed scale must be 1, 10, 100 or 1000");
+
+    static constexpr int32_t scale = Scale;
+
+    int32_t raw; ///< Value x Scale
+
+    Fixed() = default;
+
+    /**
+     * @brief Value in the unit of the quantity, rounded to the nearest step. Meant for thresholds and
+     *        limits, which the compiler folds into integer constants.
+     */
+    constexpr explicit Fixed(double value) : raw((int32_t)(value * Scale + (value < 0 ? -0.5 : 0.5))) {}
+
+    /**
+     * @brief Value from a register reading or another raw value.
+     */
+    static constexpr Fixed fromRaw(int32_t raw) { return Fixed(RawTag(), raw); }
+
+    /**
+     * @brief Value as float, for log messages only.
+     */
+    float toFloat() const { return (float)raw / Scale; }
+
+    /**
+     * @brief Decimal text of the value (see FixedPoint_format).
+     */
+    size_t format(char *buf, size_t size) const { return FixedPoint_format(buf, size, raw, Scale); }
+
+    constexpr Fixed abs() const { return fromRaw(raw < 0 ? -raw : raw); }
+
+    constexpr Fixed operator+(Fixed other) const { return fromRaw(raw + other.raw); }
+    constexpr Fixed operator-(Fixed other) const { return fromRaw(raw - other.raw); }
+    constexpr Fixed operator-() const { return fromRaw(-raw); }
+    constexpr Fixed operator*(int32_t factor) const { return fromRaw(raw * factor); }
+
+    /**
+     * @brief Division by an integer, rounded to the nearest step.
+     */
+    constexpr Fixed operator/(int32_t divisor) const
+    {
+        return fromRaw((raw + ((raw < 0) != (divisor < 0) ? -divisor / 2 : divisor / 2)) / divisor);
+    }
+
+    constexpr bool operator==(Fixed other) const { return raw == other.raw; }
+    constexpr bool operator!=(Fixed other) const { return raw != other.raw; }
+    constexpr bool operator<(Fixed other) const { return raw < other.raw; }
+    constexpr bool operator<=(Fixed other) const { return raw <= other.raw; }
+    constexpr bool operator>(Fixed other) const { return raw > other.raw; }
+    constexpr bool operator>=(Fixed other) const { return raw >= other.raw; }
+
+private:
+    struct RawTag
+    {
+    };
+    constexpr Fixed(RawTag, int32_t value) : raw(value) {}
+};
+
+/**
+ * @brief calculateDelta() change gate evaluated in integer arithmetic, on raw values.
+ *
+ * A change from @c last to @c value is reported when
+ *
+ *     |value - last| > max(F_u * (|value| * accuracy + sigma + N_lsb * resolution), delta_min)
+ *
+ * The float parameters are turned into integer constants once (milli, ppm and raw steps, see the
+ * constructor), then every check is two 64-bit integer compares: no float math and no rounding at
+ * the boundary, so a difference of exactly delta_min is never reported, whatever the value.
+ *
+ * Works on the raw int32_t of a quantity so gates of different quantities can sit in one table
+ * (see ChangeEngine); DeltaGate is the typed front end.
+ */
+struct RawDeltaGate
+{
+    int32_t safetyMilli; ///< F_u x 1000
+    int32_t accuracyPpm; ///< Relative accuracy x 1e6
+    int32_t baseMilli;   ///< (sigma + N_lsb x resolution) in raw steps, x 1000
+    int32_t minSteps;    ///< delta_min in raw steps
+
+    /**
+     * @brief Same parameters as calculateDelta(), in the unit of a quantity with @p scale steps per unit.
+     */
+    constexpr RawDeltaGate(int32_t scale, double accuracy, double resolution, double sigma, double F_u, int N_lsb,
+                           double delta_min)
+        : safetyMilli((int32_t)(F_u * 1000 + 0.5)),
+          accuracyPpm((int32_t)(accuracy * 1000000 + 0.5)),
+          baseMilli((int32_t)((sigma + N_lsb * resolution) * scale * 1000 + 0.5)),
+          minSteps((int32_t)(delta_min * scale + 0.5))
+    {
+    }
+
+    /**
+     * @brief true if @p value moved far enough from @p last to be reported.
+     */
+    bool exceeded(int32_t value, int32_t last) const
+    {
+        const int64_t diff = (int64_t)value - last;
+        const int64_t steps = diff < 0 ? -diff : diff;
+        if (steps <= minSteps)
+        {
+            return false;
+        }
+        return steps * 1000000000LL > bound(value);
+    }
+
+    /**
+     * @brief Smallest change of @p value that is reported, in raw steps.
+     */
+    int32_t step(int32_t value) const
+    {
+        const int64_t steps = bound(value) / 1000000000LL + 1;
+        return steps > minSteps ? (int32_t)steps : minSteps + 1;
+    }
+
+private:
+    /**
+     * @brief F_u * (|value| * accuracy + base) in raw steps, x 1e9.
+     */
+    int64_t bound(int32_t value) const
+    {
+        const int64_t magnitude = value < 0 ? -(int64_t)value : value;
+        return (int64_t)safetyMilli * (magnitude * accuracyPpm + (int64_t)baseMilli * 1000);
+    }
+};
+
+/**
+ * @brief RawDeltaGate of one Fixed quantity.
+ *
+ * @tparam T Fixed quantity the gate applies to.
+ */
+template <typename T>
+struct DeltaGate : RawDeltaGate
+{
+    /**
+     * @brief Same parameters as calculateDelta(), in the unit of T.
+     */
+    constexpr DeltaGate(double accuracy, double resolution, double sigma, double F_u, int N_lsb, double delta_min)
+        : RawDeltaGate(T::scale, accuracy, resolution, sigma, F_u, N_lsb, delta_min)
+    {
+    }
+
+    bool exceeded(T value, T last) const { return RawDeltaGate::exceeded(value.raw, last.raw); }
+
+    /**
+     * @brief Smallest change of @p value that is reported, for log messages.
+     */
+    T step(T value) const { return T::fromRaw(RawDeltaGate::step(value.raw)); }
+};
+
+#endif // FIXED_POINT_H
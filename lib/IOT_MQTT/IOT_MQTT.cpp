@@ -48,163 +48,263 @@ const char *topic_env_xenon300 = "hopt/floor2/rd/cart01/envi/xenon300";  // Topi
 const char *topic_elec_co2ui400 = "hopt/floor2/rd/cart01/elec/co2ui400"; // Topic dữ liệu điện thiết bị bơm CO2 UI400
 const char *topic_env_co2ui400 = "hopt/floor2/rd/cart01/envi/co2ui400";  // Topic dữ liệu môi trường thiết bị bơm CO2 UI400
 
-// Hàm kết nối WiFi, xử lý ngoại lệ khi không kết nối được
+const char *topic_diag_modbus = "hopt/floor2/rd/cart01/diag/modbus"; // Topic chẩn đoán bus Modbus
+const char *topic_leak_window = "hopt/floor2/rd/cart01/elec/cart/window"; // Topic thống kê dòng rò theo cửa sổ
+const char *topic_alarm_leak_peak = "hopt/floor2/rd/cart01/alarm/leak_peak"; // Topic dòng rò AC vượt ngưỡng
+const char *topic_alarm_leak = "hopt/floor2/rd/cart01/alarm/leak";   // Topic cảnh báo tức thời của cảm biến rò điện
+const char *topic_diag_alarm = "hopt/floor2/rd/cart01/diag/alarm";   // Topic chẩn đoán đường cảnh báo
+
+// Danh sách mạng WiFi theo thứ tự ưu tiên: chính, sau đó backup
+static WifiCredential wifiCredentials[2];
+
+static WifiStateMachine wifiSM;           // State machine kết nối WiFi (chỉ chạy trong task mạng)
+static QueueHandle_t wifiEventQueue = NULL; // Sự kiện WiFi từ event task của ESP32 sang task mạng
+static Preferences wifiPrefs;             // NVS lưu BSSID/kênh của AP kết nối thành công gần nhất
+
+// Driver cho state machine: gọi WiFi.begin với BSSID/kênh (bỏ qua scan) hoặc scan đầy đủ
+static void wifiDriverBegin(const char *ssid, const char *password, int32_t channel, const uint8_t *bssid)
+{
+    Serial.printf("Connecting to WiFi: %s%s\n", ssid, bssid ? " (cached BSSID/channel)" : "");
+    WiFi.begin(ssid, password, channel, bssid, true);
+}
+
+static void wifiDriverDisconnect(void)
+{
+    WiFi.disconnect();
+}
+
+static void wifiDriverSaveCache(const WifiApCache *cache)
+{
+    wifiPrefs.begin("wifi", false);
+    wifiPrefs.putBytes("ap", cache, sizeof(*cache));
+    wifiPrefs.end();
+}
+
+// Callback sự kiện WiFi (chạy trong event task của ESP32), chỉ chuyển sự kiện vào hàng đợi
+static void onWiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info)
+{
+    WifiSmEvent evt = {};
+    switch (event)
+    {
+    case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+        evt.type = WIFI_SM_EVT_ASSOCIATED;
+        memcpy(evt.bssid, info.wifi_sta_connected.bssid, sizeof(evt.bssid));
+        evt.channel = info.wifi_sta_connected.channel;
+        break;
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+        evt.type = WIFI_SM_EVT_GOT_IP;
+        break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+        evt.type = WIFI_SM_EVT_DISCONNECTED;
+        break;
+    default:
+        return;
+    }
+    xQueueSend(wifiEventQueue, &evt, 0);
+}
+
+// Hàm khởi tạo WiFi: không chặn, việc kết nối do state machine thực hiện trong IOT_MQTT_ensureWifiConnected()
 void IOT_MQTT_setupWifi()
 {
-    delay(10); // Đợi một chút trước khi bắt đầu kết nối
     Serial.println("Starting WiFi connection...");
 
-    // Thử kết nối WiFi chính
-    Serial.print("Connecting to primary WiFi: ");
-    Serial.println(WIFI_SSID);
-    WiFi.mode(WIFI_STA);                  // Đặt chế độ WiFi là Station (client)
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD); // Kết nối WiFi chính
+    wifiCredentials[0] = {WIFI_SSID, WIFI_PASSWORD};       // WiFi chính
+    wifiCredentials[1] = {BK_WIFI_SSID, BK_WIFI_PASSWORD}; // WiFi backup
 
-    int retry = 0; // Biến đếm số lần thử kết nối
-    while (WiFi.status() != WL_CONNECTED)
+    // Đọc cache AP từ NVS để lần kết nối đầu tiên bỏ qua bước scan
+    WifiApCache cache = {};
+    wifiPrefs.begin("wifi", true);
+    if (wifiPrefs.getBytesLength("ap") == sizeof(cache))
     {
-        delay(500);        // Đợi 0.5s giữa các lần kiểm tra
-        Serial.print("."); // In dấu chấm để báo tiến trình
-        if (++retry > 40)  // Nếu quá 40 lần (20s) mà chưa kết nối được
-        {
-            Serial.println("\nPrimary WiFi connect failed. Trying backup WiFi...");
-            break; // Thoát khỏi vòng lặp để thử WiFi phụ
-        }
+        wifiPrefs.getBytes("ap", &cache, sizeof(cache));
     }
+    wifiPrefs.end();
 
-    // Nếu không kết nối được WiFi chính, thử kết nối WiFi phụ
-    if (WiFi.status() != WL_CONNECTED)
-    {
-        Serial.print("Connecting to backup WiFi: ");
-        Serial.println(BK_WIFI_SSID);
-        WiFi.begin(BK_WIFI_SSID, BK_WIFI_PASSWORD); // Kết nối WiFi phụ
+    wifiEventQueue = xQueueCreate(8, sizeof(WifiSmEvent));
 
-        retry = 0; // Reset biến đếm số lần thử kết nối
-        while (WiFi.status() != WL_CONNECTED)
-        {
-            delay(500);        // Đợi 0.5s giữa các lần kiểm tra
-            Serial.print("."); // In dấu chấm để báo tiến trình
-            if (++retry > 40)  // Nếu quá 40 lần (20s) mà chưa kết nối được
-            {
-                Serial.println("\nBackup WiFi connect failed. Restarting...");
-                ESP.restart(); // Khởi động lại ESP để thử lại từ đầu
-            }
-        }
-    }
+    WiFi.mode(WIFI_STA);          // Đặt chế độ WiFi là Station (client)
+    WiFi.persistent(false);       // Không ghi cấu hình WiFi vào flash mỗi lần begin
+    WiFi.setAutoReconnect(false); // Reconnect do state machine quản lý
+    WiFi.onEvent(onWiFiEvent);
 
-    // Nếu kết nối thành công, in địa chỉ IP
-    Serial.println("\nWiFi connected!");
-    Serial.print("IP address: ");
-    Serial.println(WiFi.localIP());
+    const WifiSmDriver driver = {wifiDriverBegin, wifiDriverDisconnect, wifiDriverSaveCache};
+    WifiSM_init(&wifiSM, wifiCredentials, 2, &driver, &cache);
 }
 
-// Hàm đảm bảo WiFi luôn được kết nối, tự động reconnect nếu mất kết nối
-void IOT_MQTT_ensureWifiConnected()
+// Hàm duy trì WiFi: xử lý sự kiện và timeout của state machine, không bao giờ chặn hay restart ESP
+bool IOT_MQTT_ensureWifiConnected()
 {
-    if (WiFi.status() != WL_CONNECTED) // Nếu WiFi không kết nối
+    const WifiSmState prevState = wifiSM.state;
+
+    WifiSmEvent evt;
+    while (xQueueReceive(wifiEventQueue, &evt, 0) == pdTRUE)
     {
-        Serial.println("WiFi disconnected. Reconnecting...");
-        WiFi.disconnect();                    // Ngắt kết nối hiện tại (nếu có)
-        WiFi.begin(WIFI_SSID, WIFI_PASSWORD); // Thử kết nối lại WiFi chính
+        WifiSM_handleEvent(&wifiSM, &evt, millis());
+    }
+    WifiSM_tick(&wifiSM, millis());
 
-        int retry = 0;
-        while (WiFi.status() != WL_CONNECTED)
+    if (wifiSM.state != prevState)
+    {
+        Serial.printf("WiFi state: %s -> %s\n", WifiSM_stateName(prevState), WifiSM_stateName(wifiSM.state));
+        if (wifiSM.state == WIFI_SM_CONNECTED)
         {
-            delay(500); // Đợi 0.5s giữa các lần kiểm tra
-            Serial.print(".");
-            if (++retry > 40) // Nếu quá 20 giây mà không kết nối được
-            {
-                Serial.println("\nPrimary WiFi failed. Trying backup WiFi...");
-                WiFi.disconnect();                          // Ngắt kết nối hiện tại
-                WiFi.begin(BK_WIFI_SSID, BK_WIFI_PASSWORD); // Thử kết nối WiFi phụ
-
-                retry = 0;
-                while (WiFi.status() != WL_CONNECTED)
-                {
-                    delay(500);
-                    Serial.print(".");
-                    if (++retry > 40) // Nếu quá 20 giây mà không kết nối được
-                    {
-                        Serial.println("\nBackup WiFi failed. Restarting...");
-                        ESP.restart(); // Khởi động lại ESP
-                    }
-                }
-                break;
-            }
+            Serial.printf("WiFi connected! IP address: %s (reconnect took %lu ms)\n",
+                          WiFi.localIP().toString().c_str(), (unsigned long)wifiSM.lastReconnectMs);
         }
+    }
+    return WifiSM_isConnected(&wifiSM);
+}
+
+// Trả về state machine WiFi (chỉ đọc) để lấy các chỉ số thời gian reconnect
+const WifiStateMachine *IOT_MQTT_getWifiState()
+{
+    return &wifiSM;
+}
 
-        Serial.println("\nWiFi reconnected!");
-        Serial.print("IP address: ");
-        Serial.println(WiFi.localIP());
+static volatile bool timeSynced = false;     // true sau lần đồng bộ NTP đầu tiên
+static uint32_t timeSyncedAtMs = 0;          // millis() lúc đồng bộ NTP lần đầu
+static uint32_t bootToFirstPublishMs = 0;    // Thời gian từ khi khởi động đến lần publish thành công đầu tiên (0 = chưa có)
+
+// Callback của SNTP (chạy trong task LwIP) khi thời gian được đồng bộ
+static void onTimeSynced(struct timeval *tv)
+{
+    if (!timeSynced)
+    {
+        timeSyncedAtMs = millis();
+        timeSynced = true;
     }
 }
 
-// Hàm đồng bộ thời gian hệ thống với NTP server, xử lý ngoại lệ khi chưa lấy được thời gian
+// Hàm khởi động đồng bộ thời gian NTP chạy nền, không chờ kết quả
 void IOT_MQTT_setupTime()
 {
     // Thiết lập múi giờ GMT+7 và các NTP server
     // configTime(7 * 3600, 0, "pool.ntp.org", "time.nist.gov"); // GMT+7, đổi nếu cần
+    sntp_set_time_sync_notification_cb(onTimeSynced);
     configTime(7 * 3600, 0, "asia.pool.ntp.org", "time.google.com"); // GMT+7, đổi nếu cần
+    Serial.println("NTP time sync started in background");
+}
 
-    Serial.print("Waiting for NTP time sync...");
-    time_t now = time(nullptr);          // Lấy thời gian hiện tại (epoch)
-    unsigned long start = millis();      // Lấy thời gian bắt đầu chờ
-    const unsigned long timeout = 10000; // Thời gian chờ tối đa 10 giây
-    // Nếu thời gian chưa được đồng bộ (giá trị nhỏ), tiếp tục chờ
-    while (now < 8 * 3600 * 2)
-    {
-        delay(100);          // Đợi 0.1s giữa các lần kiểm tra
-        Serial.print(".");   // In dấu chấm để báo tiến trình
-        now = time(nullptr); // Lấy lại thời gian
+// Trả về true nếu đồng hồ thực đã được đồng bộ NTP
+bool IOT_MQTT_isTimeSynced()
+{
+    return timeSynced;
+}
 
-        if (millis() - start > timeout) // Nếu vượt quá thời gian chờ
-        {
-            Serial.println("\nNTP time sync timeout. Using default time.");
-            return;
-        }
+// Trả về true nếu các bản tin có timestamp được publish ngay. Gọi khi MQTT đã kết nối.
+// Trước khi đồng bộ NTP, snapshot và cảnh báo được giữ trong hàng đợi (snapshot gộp flag khi đầy)
+// để được đóng dấu giờ thực lúc publish thay vì "T+<giây>s". Thời gian giữ tối đa NTP_SYNC_HOLD_MS
+// kể từ lần kết nối đầu tiên; quá hạn (không có Internet, NTP bị chặn) thì publish với "T+<giây>s"
+bool IOT_MQTT_timestampsReady()
+{
+    static uint32_t holdStartMs = 0;   // millis() lúc bắt đầu giữ bản tin (0 = chưa bắt đầu)
+    static bool holdExpired = false;   // true khi đã hết thời gian giữ mà chưa đồng bộ NTP
+    if (timeSynced || holdExpired)
+    {
+        return true;
     }
-    Serial.println(" done!"); // Đã đồng bộ thời gian thành công
+    const uint32_t now = millis();
+    if (holdStartMs == 0)
+    {
+        holdStartMs = now | 1; // Tránh giá trị 0 (chưa bắt đầu)
+        Serial.printf("Holding publishes until NTP sync (max %d ms)\n", NTP_SYNC_HOLD_MS);
+    }
+    if (now - holdStartMs < NTP_SYNC_HOLD_MS)
+    {
+        return false;
+    }
+    holdExpired = true;
+    Serial.printf("NTP not synced after %d ms, publishing with boot-relative timestamps\n", NTP_SYNC_HOLD_MS);
+    return true;
 }
 
 // ========== Helper: Get timestamp ==========
-// Hàm lấy timestamp hiện tại dưới dạng chuỗi, dùng để ghi nhận thời điểm gửi dữ liệu
-String IOT_MQTT_getTimestamp()
+// Hàm lấy timestamp của một mẫu dưới dạng chuỗi từ thời điểm lấy mẫu (millis)
+// - Đã đồng bộ NTP: quy đổi ra giờ thực, kể cả mẫu lấy trước khi đồng bộ (được hiệu chỉnh lúc publish)
+// - Chưa đồng bộ: đóng dấu bằng thời gian kể từ khi khởi động "T+<giây>s"
+//   (chỉ xảy ra khi hết thời gian giữ bản tin, xem IOT_MQTT_timestampsReady)
+String IOT_MQTT_getTimestamp(uint32_t sampleMs)
 {
-    time_t now = time(nullptr);                                 // Lấy thời gian hiện tại (epoch)
+    char buf[32]; // Bộ đệm lưu chuỗi thời gian
+    if (!timeSynced)
+    {
+        snprintf(buf, sizeof(buf), "T+%lus", (unsigned long)(sampleMs / 1000));
+        return String(buf);
+    }
+
+    time_t now = time(nullptr) - (time_t)((millis() - sampleMs) / 1000); // Lùi về thời điểm lấy mẫu
     struct tm timeinfo;                                         // Khai báo cấu trúc lưu thông tin thời gian
     localtime_r(&now, &timeinfo);                               // Chuyển đổi epoch sang dạng cấu trúc thời gian cục bộ
-    char buf[32];                                               // Bộ đệm lưu chuỗi thời gian
     strftime(buf, sizeof(buf), "%H:%M:%S %d/%m/%Y", &timeinfo); // Định dạng chuỗi thời gian
     return String(buf);                                         // Trả về chuỗi thời gian đã định dạng
 }
 
+// Thời gian từ khi khởi động đến lần publish thành công đầu tiên (ms), 0 nếu chưa publish được
+uint32_t IOT_MQTT_getBootToFirstPublishMs()
+{
+    return bootToFirstPublishMs;
+}
+
+static MqttSession mqttSession;               // ClientId cố định theo MAC, backoff và thống kê kết nối MQTT
+static PubSubClient *sessionClient = &mqttClient; // Client mà mqttSession điều khiển
+
+// Các hàm nối MqttSession với PubSubClient và Arduino
+static bool sessionConnected() { return sessionClient->connected(); }
+static int sessionState() { return sessionClient->state(); }
+static void sessionLoop() { sessionClient->loop(); }
+static uint32_t sessionMillis() { return millis(); }
+static uint32_t sessionRandom(uint32_t bound) { return (uint32_t)random(bound); }
+static bool sessionConnect(const char *clientId)
+{
+    // cleanSession = false: dùng lại session cũ trên broker thay vì tạo session mới mỗi lần reconnect
+    return sessionClient->connect(clientId, NULL, NULL, NULL, 0, false, NULL, false);
+}
+
+static const MqttSessionDriver mqttSessionDriver = {
+    sessionConnected, sessionConnect, sessionState, sessionLoop, sessionMillis, sessionRandom};
+
 // Hàm thiết lập thông số kết nối MQTT cho client
 void IOT_MQTT_setupMQTT(PubSubClient &client)
 {
     client.setServer(MQTT_SERVER, MQTT_PORT); // Thiết lập địa chỉ và cổng MQTT broker
     client.setBufferSize(1024);               // Thiết lập kích thước bộ đệm cho gói tin MQTT
+    client.setSocketTimeout(MQTT_SOCKET_TIMEOUT_S); // Giới hạn thời gian chờ CONNACK của một lần thử
+
+    // Tạo clientId từ địa chỉ MAC: cố định qua mọi lần reconnect và khởi động lại
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    sessionClient = &client;
+    MqttSession_init(&mqttSession, mac, &mqttSessionDriver);
+    Serial.printf("MQTT clientId: %s\n", mqttSession.clientId);
 }
 
-// Hàm đảm bảo kết nối MQTT luôn được duy trì, tự động reconnect nếu mất kết nối
-void IOT_MQTT_ensureConnected(PubSubClient &client)
+// Hàm duy trì kết nối MQTT: tối đa một lần thử kết nối mỗi lần gọi, backoff tăng dần có jitter
+bool IOT_MQTT_ensureConnected(PubSubClient &client)
 {
-    while (!client.connected()) // Nếu chưa kết nối tới broker
+    sessionClient = &client;
+    const uint32_t attempts = mqttSession.stats.attempts;
+    const bool connected = MqttSession_tick(&mqttSession);
+
+    if (mqttSession.stats.attempts != attempts) // Vừa thử kết nối trong lần gọi này
     {
-        Serial.print("Connecting to MQTT...");                          // In thông báo đang kết nối
-        String clientId = "ESP32Client-" + String(random(0xffff), HEX); // Tạo clientId ngẫu nhiên
-        if (client.connect(clientId.c_str()))                           // Thử kết nối với clientId vừa tạo
+        if (connected)
         {
-            Serial.println("connected"); // Kết nối thành công
+            Serial.printf("MQTT connected (%lu ms)\n", (unsigned long)mqttSession.stats.lastConnectLatencyMs);
         }
         else
         {
-            Serial.print("failed, rc="); // Kết nối thất bại, in mã lỗi
-            Serial.print(client.state());
-            Serial.println(" try again in 5s"); // Thông báo sẽ thử lại sau 5 giây
-            delay(5000);                        // Đợi 5 giây trước khi thử lại
+            Serial.printf("MQTT connect failed, rc=%d, retry in %lu ms\n", mqttSession.stats.lastState,
+                          (unsigned long)(mqttSession.nextAttemptMs - millis()));
         }
     }
-    client.loop(); // Gọi vòng lặp MQTT để xử lý các sự kiện
+    return connected;
+}
+
+// Trả về thống kê kết nối MQTT (số lần thử, lỗi, độ trễ kết nối)
+const MqttSessionStats *IOT_MQTT_getSessionStats()
+{
+    return &mqttSession.stats;
 }
 
 // ========== Publish only changed fields ==========
@@ -216,232 +316,166 @@ static void publishIfChanged(PubSubClient &client, const char *topic, JsonDocume
     char jsonBuffer[512];                                       // Bộ đệm lưu chuỗi JSON
     serializeJson(doc, jsonBuffer);                             // Chuyển đổi doc sang chuỗi JSON
     Serial.printf("Publishing to %s: %s\n", topic, jsonBuffer); // In ra dữ liệu sẽ gửi để debug
-    client.publish(topic, jsonBuffer);                          // Gửi dữ liệu lên topic MQTT
+    if (client.publish(topic, jsonBuffer) && bootToFirstPublishMs == 0) // Gửi dữ liệu lên topic MQTT
+    {
+        bootToFirstPublishMs = millis(); // Ghi nhận thời gian từ khi khởi động đến lần publish đầu tiên
+        Serial.printf("Boot to first publish: %lu ms (NTP %s)\n", (unsigned long)bootToFirstPublishMs,
+                      timeSynced ? "synced" : "not synced");
+    }
+}
+
+// Ghi số đo fixed-point vào doc dưới dạng số JSON: chuỗi thập phân đúng giá trị thanh ghi, không qua float
+template <int32_t Scale, typename Unit>
+static void setMeasurement(JsonDocument &doc, const char *key, Fixed<Scale, Unit> value)
+{
+    char text[16];
+    value.format(text, sizeof(text));
+    doc[key] = serialized(text); // Chuỗi không const: ArduinoJson sao chép vào doc
 }
 
 // Biến lưu thời gian lần đầu phát hiện socketPowerLost[id] = true
 static unsigned long socketPowerLostFirstDetected[NUM_DEVICES] = {0};
 static bool Pzems_firstPublish[NUM_DEVICES] = {true, true, true, true, true, true}; // Biến đánh dấu lần đầu publish dữ liệu PZEMs
+static uint8_t lastPzemLink[NUM_DEVICES] = {0}; // Trạng thái circuit breaker Modbus đã gửi gần nhất của từng PZEM
 
-// Hàm publish dữ liệu thiết bị lên MQTT, chỉ gửi khi có trường thay đổi
-static void publishDeviceData(PubSubClient &client, const char *elecTopic, const char *envTopic, int id, const PZEMChangedFlags &eleChanged, const teHuDecviceChangedFlags &envChanged)
+// Ghi trường ứng với bit thay đổi @p bit (DeviceChangeBit) của thiết bị @p id vào doc
+static void setDeviceField(JsonDocument &doc, unsigned bit, const SensorSnapshot &snap, int id)
+{
+    switch (bit)
+    {
+    case CHANGE_VOLTAGE:           setMeasurement(doc, "voltage", snap.voltageCalib[id]); break;
+    case CHANGE_CURRENT:           setMeasurement(doc, "current", snap.pzem[id].current); break;
+    case CHANGE_POWER:             setMeasurement(doc, "power", snap.pzem[id].power); break;
+    case CHANGE_FREQUENCY:         setMeasurement(doc, "frequency", snap.pzem[id].frequency); break;
+    case CHANGE_PF:                setMeasurement(doc, "power_factor", snap.pzem[id].pf); break;
+    case CHANGE_MACHINE_STATE:     doc["machine_state"] = snap.pzem[id].machineState; break;
+    case CHANGE_OVER_VOLTAGE:      doc["over_voltage"] = snap.overVoltage[id]; break;
+    case CHANGE_OVER_CURRENT:      doc["over_current"] = snap.overCurrent[id]; break;
+    case CHANGE_OVER_POWER:        doc["over_power"] = snap.overPower[id]; break;
+    case CHANGE_UNDER_VOLTAGE:     doc["under_voltage"] = snap.underVoltage[id]; break;
+    case CHANGE_SOCKET_STATE:      doc["socket_state"] = snap.socketState[id]; break;
+    case CHANGE_OPERATING_TIME:    doc["operating_time"] = snap.operatingTime[id]; break;
+    case CHANGE_OVER_DEVICE_TEMP:  doc["over_temp_max"] = snap.envDevice[id].over_temp_max; break;
+    case CHANGE_UNDER_DEVICE_TEMP: doc["under_temp_min"] = snap.envDevice[id].under_temp_min; break;
+    case CHANGE_OVER_DEVICE_HUMI:  doc["over_humi_max"] = snap.envDevice[id].over_humi_max; break;
+    case CHANGE_UNDER_DEVICE_HUMI: doc["under_humi_min"] = snap.envDevice[id].under_humi_min; break;
+    default: break;
+    }
+}
+
+// Ghi trường ứng với bit thay đổi @p bit (CartChangeBit) của xe đẩy vào doc
+static void setCartField(JsonDocument &doc, unsigned bit, const SensorSnapshot &snap)
+{
+    switch (bit)
+    {
+    case CHANGE_TEMPERATURE:           setMeasurement(doc, "temp", snap.envCart.temperature); break;
+    case CHANGE_HUMIDITY:              setMeasurement(doc, "humi", snap.envCart.humidity); break;
+    case CHANGE_OVER_ROOM_TEMP:        doc["over_room_temp_max"] = snap.envCart.over_room_temp_max; break;
+    case CHANGE_UNDER_ROOM_TEMP:       doc["under_room_temp_min"] = snap.envCart.under_room_temp_min; break;
+    case CHANGE_OVER_ROOM_HUMI:        doc["over_room_humi_max"] = snap.envCart.over_room_humi_max; break;
+    case CHANGE_UNDER_ROOM_HUMI:       doc["under_room_humi_min"] = snap.envCart.under_room_humi_min; break;
+    case CHANGE_OVER_COM_DEVICE_TEMP:  doc["over_com_device_temp_max"] = snap.envCart.over_com_device_temp_max; break;
+    case CHANGE_UNDER_COM_DEVICE_TEMP: doc["under_com_device_temp_min"] = snap.envCart.under_com_device_temp_min; break;
+    case CHANGE_OVER_COM_DEVICE_HUMI:  doc["over_com_device_humi_max"] = snap.envCart.over_com_device_humi_max; break;
+    case CHANGE_UNDER_COM_DEVICE_HUMI: doc["under_com_device_humi_min"] = snap.envCart.under_com_device_humi_min; break;
+    case CHANGE_LEAK_AC_CURRENT:       doc["leak_current"] = snap.leak.acCurrent; break;
+    case CHANGE_LEAK_SOFT_WARNING:     doc["over_safe_threshold"] = snap.leak.acSoftWarning; break;
+    case CHANGE_LEAK_STRONG_WARNING:   doc["over_warning_threshold"] = snap.leak.acStrongWarning; break;
+    default: break;
+    }
+}
+
+// Hàm publish dữ liệu thiết bị lên MQTT, chỉ gửi các trường có bit thay đổi
+static void publishDeviceData(PubSubClient &client, const char *elecTopic, const char *envTopic, int id, const SensorSnapshot &snap)
 {
     // Tăng kích thước doc để tránh thiếu bộ nhớ khi gửi nhiều trường
     ArduinoJson::StaticJsonDocument<512> elecDoc;
     ArduinoJson::StaticJsonDocument<256> envDoc;
 
-    // Lần đầu publish: gửi toàn bộ trường
-    if (Pzems_firstPublish[id])
-    {
-        elecDoc["voltage"] = sensorData[id].valid ? sensorData[id].voltage : pzemVoltageCalib[id];
-        elecDoc["current"] = sensorData[id].current;
-        elecDoc["power"] = sensorData[id].power;
-        elecDoc["frequency"] = sensorData[id].frequency;
-        elecDoc["power_factor"] = sensorData[id].pf;
-        elecDoc["machine_state"] = sensorData[id].machineState;
-        elecDoc["over_voltage"] = overVoltage[id];
-        elecDoc["over_current"] = overCurrent[id];
-        elecDoc["over_power"] = overPower[id];
-        elecDoc["under_voltage"] = underVoltage[id];
-        elecDoc["socket_state"] = socketState[id];
-
-        // Thời gian hoạt động
-        char buf[16];
-        switch (id)
-        {
-        case AUO_DISPLAY:
-            op_time_counter_get_formatted(&op_time_auo_display, buf, sizeof(buf));
-            break;
-        case CCU_IMAGE1_S:
-            op_time_counter_get_formatted(&op_time_ccu_img1s, buf, sizeof(buf));
-            break;
-        case CCU_IMAGE_1_HUB:
-            op_time_counter_get_formatted(&op_time_ccu_img1hub, buf, sizeof(buf));
-            break;
-        case CCU_TRICAM_PAL:
-            op_time_counter_get_formatted(&op_time_ccu_imgtricpal, buf, sizeof(buf));
-            break;
-        case XENON_300:
-            op_time_counter_get_formatted(&op_time_xenon_300, buf, sizeof(buf));
-            break;
-        case ENDOFLATOR_UI400:
-            op_time_counter_get_formatted(&op_time_UI400, buf, sizeof(buf));
-            break;
-        default:
-            buf[0] = 0;
-            break;
-        }
-        elecDoc["operating_time"] = buf;
-        elecDoc["timestamp"] = IOT_MQTT_getTimestamp();
-        publishIfChanged(client, elecTopic, elecDoc);
-
-        // Môi trường thiết bị
-        envDoc["over_temp_max"] = es35swDevice[id].over_temp_max;
-        envDoc["under_temp_min"] = es35swDevice[id].under_temp_min;
-        envDoc["over_humi_max"] = es35swDevice[id].over_humi_max;
-        envDoc["under_humi_min"] = es35swDevice[id].under_humi_min;
-        envDoc["timestamp"] = IOT_MQTT_getTimestamp();
-        publishIfChanged(client, envTopic, envDoc);
+    // Lần đầu publish: gửi toàn bộ trường, các lần sau chỉ các trường có bit thay đổi
+    const bool firstPublish = Pzems_firstPublish[id];
+    const ChangeMask changed = firstPublish ? CHANGE_BITS(DEVICE_CHANGE_BITS) : snap.changed.device[id];
 
-        Pzems_firstPublish[id] = false;
-        return;
+    ChangeEngine_forEachBit(changed & DEVICE_ELEC_CHANGES,
+                            [&](unsigned bit) { setDeviceField(elecDoc, bit, snap, id); });
+    if (firstPublish && snap.pzem[id].valid)
+    {
+        setMeasurement(elecDoc, "voltage", snap.pzem[id].voltage); // Lần đầu gửi điện áp đo thực tế
     }
 
-    // Các lần sau: chỉ gửi trường changed
-    if (eleChanged.voltage[id])
-        elecDoc["voltage"] = pzemVoltageCalib[id];
-    if (eleChanged.current[id])
-        elecDoc["current"] = sensorData[id].current;
-    if (eleChanged.power[id])
-        elecDoc["power"] = sensorData[id].power;
-    if (eleChanged.frequency[id])
-        elecDoc["frequency"] = sensorData[id].frequency;
-    if (eleChanged.pf[id])
-        elecDoc["power_factor"] = sensorData[id].pf;
-    if (eleChanged.machineState[id])
-        elecDoc["machine_state"] = sensorData[id].machineState;
-    if (eleChanged.overVoltage[id])
-        elecDoc["over_voltage"] = overVoltage[id];
-    if (eleChanged.overCurrent[id])
-        elecDoc["over_current"] = overCurrent[id];
-    if (eleChanged.overPower[id])
-        elecDoc["over_power"] = overPower[id];
-    if (eleChanged.underVoltage[id])
-        elecDoc["under_voltage"] = underVoltage[id];
-    if (eleChanged.socketState[id])
-        elecDoc["socket_state"] = socketState[id];
-
-    // Thời gian hoạt động
-    if (eleChanged.operating_time[id])
+    // Trạng thái liên kết Modbus: lần đầu và mỗi khi circuit breaker đổi trạng thái
+    if (firstPublish || snap.pzemLink[id] != lastPzemLink[id])
     {
-        char buf[16];
-        switch (id)
-        {
-        case AUO_DISPLAY:
-            op_time_counter_get_formatted(&op_time_auo_display, buf, sizeof(buf));
-            break;
-        case CCU_IMAGE1_S:
-            op_time_counter_get_formatted(&op_time_ccu_img1s, buf, sizeof(buf));
-            break;
-        case CCU_IMAGE_1_HUB:
-            op_time_counter_get_formatted(&op_time_ccu_img1hub, buf, sizeof(buf));
-            break;
-        case CCU_TRICAM_PAL:
-            op_time_counter_get_formatted(&op_time_ccu_imgtricpal, buf, sizeof(buf));
-            break;
-        case XENON_300:
-            op_time_counter_get_formatted(&op_time_xenon_300, buf, sizeof(buf));
-            break;
-        case ENDOFLATOR_UI400:
-            op_time_counter_get_formatted(&op_time_UI400, buf, sizeof(buf));
-            break;
-        default:
-            buf[0] = 0;
-            break;
-        }
-        elecDoc["operating_time"] = buf;
+        elecDoc["modbus_link"] = Breaker_stateName((BreakerState)snap.pzemLink[id]);
+        lastPzemLink[id] = snap.pzemLink[id];
     }
 
     if (elecDoc.size() > 0)
     {
-        elecDoc["timestamp"] = IOT_MQTT_getTimestamp();
+        elecDoc["timestamp"] = IOT_MQTT_getTimestamp(snap.sampleMs);
         publishIfChanged(client, elecTopic, elecDoc);
     }
 
     // Môi trường thiết bị
-    if (envChanged.overDeviceTemp[id])
-        envDoc["over_temp_max"] = es35swDevice[id].over_temp_max;
-    if (envChanged.underDeviceTemp[id])
-        envDoc["under_temp_min"] = es35swDevice[id].under_temp_min;
-    if (envChanged.overDeviceHumi[id])
-        envDoc["over_humi_max"] = es35swDevice[id].over_humi_max;
-    if (envChanged.underDeviceHumi[id])
-        envDoc["under_humi_min"] = es35swDevice[id].under_humi_min;
+    ChangeEngine_forEachBit(changed & DEVICE_ENV_CHANGES,
+                            [&](unsigned bit) { setDeviceField(envDoc, bit, snap, id); });
 
     if (envDoc.size() > 0)
     {
-        envDoc["timestamp"] = IOT_MQTT_getTimestamp();
+        envDoc["timestamp"] = IOT_MQTT_getTimestamp(snap.sampleMs);
         publishIfChanged(client, envTopic, envDoc);
     }
+
+    Pzems_firstPublish[id] = false;
 }
 
 static bool firstEnvPublish = true; // Biến đánh dấu lần đầu publish dữ liệu môi trường
+static uint8_t lastLeakLink = 0;    // Trạng thái circuit breaker đã gửi gần nhất của cảm biến rò điện
+static uint8_t lastEnvLink = 0;     // Trạng thái circuit breaker đã gửi gần nhất của ES35-SW
 
-// Hàm publish dữ liệu môi trường lên MQTT, chỉ gửi khi có trường thay đổi
-static void publishOprCondition(PubSubClient &client, const acLeakChangedFlags &acLeakChanged,const teHuCartChangedFlags &envChanged)
+// Hàm publish dữ liệu môi trường lên MQTT, chỉ gửi các trường có bit thay đổi
+static void publishOprCondition(PubSubClient &client, const SensorSnapshot &snap)
 {
     ArduinoJson::StaticJsonDocument<256> acLeakDoc; 
     ArduinoJson::StaticJsonDocument<256> envDoc;
 
-    if (firstEnvPublish)
-    {
-        acLeakDoc["leak_current"] = leakSensorData.acCurrent;
-        acLeakDoc["over_safe_threshold"] = leakSensorData.acSoftWarning;
-        acLeakDoc["over_warning_threshold"] = leakSensorData.acStrongWarning;
-        acLeakDoc["timestamp"] = IOT_MQTT_getTimestamp();
-        publishIfChanged(client, topic_elec_cart, acLeakDoc);
-
-        envDoc["temp"] = es35swCart.temperature;
-        envDoc["humi"] = es35swCart.humidity;
-        envDoc["over_room_temp_max"] = es35swCart.over_room_temp_max;
-        envDoc["under_room_temp_min"] = es35swCart.under_room_temp_min;
-        envDoc["over_room_humi_max"] = es35swCart.over_room_humi_max;
-        envDoc["under_room_humi_min"] = es35swCart.under_room_humi_min;
-        envDoc["over_com_device_temp_max"] = es35swCart.over_com_device_temp_max;
-        envDoc["under_com_device_temp_min"] = es35swCart.under_com_device_temp_min;
-        envDoc["over_com_device_humi_max"] = es35swCart.over_com_device_humi_max;
-        envDoc["under_com_device_humi_min"] = es35swCart.under_com_device_humi_min;
-        envDoc["timestamp"] = IOT_MQTT_getTimestamp();
-        publishIfChanged(client, topic_env_cart, envDoc);
+    // Lần đầu publish: gửi toàn bộ trường, các lần sau chỉ các trường có bit thay đổi
+    const bool firstPublish = firstEnvPublish;
+    const ChangeMask changed = firstPublish ? CHANGE_BITS(CART_CHANGE_BITS) : snap.changed.cart;
 
-        // Đánh dấu đã gửi toàn bộ dữ liệu lần đầu
-        firstEnvPublish = false;
-        return;
+    ChangeEngine_forEachBit(changed & CART_LEAK_CHANGES, [&](unsigned bit) { setCartField(acLeakDoc, bit, snap); });
+    if (firstPublish || snap.leakLink != lastLeakLink)
+    {
+        acLeakDoc["modbus_link"] = Breaker_stateName((BreakerState)snap.leakLink);
+        lastLeakLink = snap.leakLink;
     }
-
-    if (acLeakChanged.changeLeakACCurrent)
-        acLeakDoc["leak_current"] = leakSensorData.acCurrent;
-    if (acLeakChanged.softWarning)
-        acLeakDoc["over_safe_threshold"] = leakSensorData.acSoftWarning;
-    if (acLeakChanged.strongWarning)
-        acLeakDoc["over_warning_threshold"] = leakSensorData.acStrongWarning;
     if (acLeakDoc.size() > 0) 
     {
-        acLeakDoc["timestamp"] = IOT_MQTT_getTimestamp();
+        acLeakDoc["timestamp"] = IOT_MQTT_getTimestamp(snap.sampleMs);
         publishIfChanged(client, topic_elec_cart, acLeakDoc);
     }
 
-    if (envChanged.temperature) 
-        envDoc["temp"] = es35swCart.temperature;
-    if (envChanged.humidity) 
-        envDoc["humi"] = es35swCart.humidity;
-    if (envChanged.overRoomTemp)
-        envDoc["over_room_temp_max"] = es35swCart.over_room_temp_max;
-    if (envChanged.underRoomTemp)
-        envDoc["under_room_temp_min"] = es35swCart.under_room_temp_min;
-    if (envChanged.overRoomHumi)
-        envDoc["over_room_humi_max"] = es35swCart.over_room_humi_max;
-    if (envChanged.underRoomHumi)
-        envDoc["under_room_humi_min"] = es35swCart.under_room_humi_min;
-    if (envChanged.overComDeviceTemp)    
-        envDoc["over_com_device_temp_max"] = es35swCart.over_com_device_temp_max;   
-    if (envChanged.underComDeviceTemp)
-        envDoc["under_com_device_temp_min"] = es35swCart.under_com_device_temp_min;
-    if (envChanged.overComDeviceHumi)
-        envDoc["over_com_device_humi_max"] = es35swCart.over_com_device_humi_max;
-    if (envChanged.underComDeviceHumi)
-        envDoc["under_com_device_humi_min"] = es35swCart.under_com_device_humi_min;
+    ChangeEngine_forEachBit(changed & CART_ENV_CHANGES, [&](unsigned bit) { setCartField(envDoc, bit, snap); });
+    if (firstPublish || snap.envLink != lastEnvLink)
+    {
+        envDoc["modbus_link"] = Breaker_stateName((BreakerState)snap.envLink);
+        lastEnvLink = snap.envLink;
+    }
     if (envDoc.size() > 0) 
     {
-        envDoc["timestamp"] = IOT_MQTT_getTimestamp();
+        envDoc["timestamp"] = IOT_MQTT_getTimestamp(snap.sampleMs);
         publishIfChanged(client, topic_env_cart, envDoc);
     }
+
+    // Đánh dấu đã gửi toàn bộ dữ liệu lần đầu
+    firstEnvPublish = false;
 }
 
 // Hàm publish toàn bộ dữ liệu lên MQTT, gọi lần lượt các hàm publish cho từng loại dữ liệu
-void IOT_MQTT_publishAll(PubSubClient &client, const acLeakChangedFlags &acLeakChanged, const teHuCartChangedFlags &teHuCartChanged, const teHuDecviceChangedFlags &teHuDecviceChanged, const PZEMChangedFlags &pzemChanged)
+// Chỉ đọc dữ liệu từ snapshot, không đọc trực tiếp biến toàn cục của task thu thập dữ liệu
+void IOT_MQTT_publishAll(PubSubClient &client, const SensorSnapshot &snap)
 {
-    publishOprCondition(client, acLeakChanged, teHuCartChanged);
+    publishOprCondition(client, snap);
 
     // Bảng ánh xạ topic điện và môi trường cho từng thiết bị
     const struct
@@ -460,6 +494,157 @@ void IOT_MQTT_publishAll(PubSubClient &client, const acLeakChangedFlags &acLeakC
 
     for (const auto &device : deviceTopics)
     {
-        publishDeviceData(client, device.elecTopic, device.envTopic, device.id, pzemChanged, teHuDecviceChanged);
+        publishDeviceData(client, device.elecTopic, device.envTopic, device.id, snap);
     }
 }
+
+// Hàm publish chẩn đoán của một bus: mỗi slave đã có giao dịch là một bản tin.
+// Bộ đếm là tích luỹ từ khi khởi động, phía nhận tự tính tốc độ giữa hai bản tin
+static void publishBusDiagnostics(PubSubClient &client, const Rs485Bus *bus)
+{
+    for (uint8_t slave = 0; slave < RS485_TRACKED_SLAVES; slave++)
+    {
+        const SlaveTelemetry *t = &bus->telemetry[slave];
+        if (Telemetry_total(t) == 0)
+            continue;
+
+        ArduinoJson::StaticJsonDocument<768> doc;
+        doc["bus"] = bus->name;
+        doc["slave"] = slave;
+        doc["ok"] = t->ok;
+        doc["timeout"] = t->timeouts;
+        doc["crc_error"] = t->crcErrors;
+        doc["frame_error"] = t->frameErrors;
+        doc["exception"] = t->exceptions;
+        doc["rejected"] = t->rejected;
+        JsonArray codes = doc["exception_codes"].to<JsonArray>(); // [khác, 0x01, 0x02, 0x03, 0x04]
+        for (uint8_t i = 0; i < TELEMETRY_EXCEPTION_CODES; i++)
+            codes.add(t->exceptionCodes[i]);
+        JsonArray bounds = doc["latency_bucket_ms"].to<JsonArray>(); // Cận trên của từng bucket, bucket cuối không giới hạn
+        for (uint8_t i = 0; i < TELEMETRY_LATENCY_BUCKETS - 1; i++)
+            bounds.add(TELEMETRY_BUCKET_UPPER_MS[i]);
+        JsonArray hist = doc["latency_hist"].to<JsonArray>();
+        for (uint8_t i = 0; i < TELEMETRY_LATENCY_BUCKETS; i++)
+            hist.add(t->latency[i]);
+        doc["latency_max_us"] = t->maxLatencyUs;
+        doc["rto_ms"] = Rto_timeoutMs(&bus->rto[slave]);
+        doc["timestamp"] = IOT_MQTT_getTimestamp(millis());
+
+        char jsonBuffer[768];
+        serializeJson(doc, jsonBuffer);
+        client.publish(topic_diag_modbus, jsonBuffer);
+    }
+}
+
+// Hàm publish các sự kiện cảnh báo rò điện từ đường ngắt GPIO, gọi trước và xen giữa các snapshot.
+// Thời điểm trong bản tin là lúc phát hiện cạnh (ISR), không phải lúc gửi
+void IOT_MQTT_publishLeakAlarms(PubSubClient &client)
+{
+    LeakAlarmEvent event;
+    while (LeakAlarm_takeEvent(&event))
+    {
+        ArduinoJson::StaticJsonDocument<256> doc;
+        doc["over_dc"] = (event.active & LEAK_ALARM_PIN_DO) != 0;
+        doc["over_ac"] = (event.active & LEAK_ALARM_PIN_AO) != 0;
+        doc["over_da"] = (event.active & LEAK_ALARM_PIN_DA) != 0;
+        doc["detect_to_buzzer_us"] = event.dispatchUs - event.detectUs;
+        doc["timestamp"] = IOT_MQTT_getTimestamp(millis() - (micros() - event.detectUs) / 1000);
+
+        char jsonBuffer[256];
+        serializeJson(doc, jsonBuffer);
+        if (client.publish(topic_alarm_leak, jsonBuffer))
+        {
+            LeakAlarm_recordPublished(&event, micros());
+        }
+        Serial.printf("Publishing to %s: %s\n", topic_alarm_leak, jsonBuffer);
+    }
+}
+
+// Ghi min/max/mean/RMS của một kênh dòng rò vào object JSON
+static void addLeakChannel(JsonObject obj, const LeakChannelStats &stats)
+{
+    obj["min"] = stats.min;
+    obj["max"] = stats.max;
+    obj["mean"] = stats.mean;
+    obj["rms"] = stats.rms;
+}
+
+// Hàm publish dòng rò lấy mẫu nhanh: sự kiện vượt ngưỡng gửi ngay, sau đó thống kê của các cửa sổ đã đóng
+// (mỗi cửa sổ LEAK_WINDOW_MS một bản tin, không phụ thuộc LEAK_AC_DELTA_MIN)
+void IOT_MQTT_publishLeakWindows(PubSubClient &client)
+{
+    LeakPeakEvent peak;
+    while (LeakWindow_takePeak(&peak))
+    {
+        ArduinoJson::StaticJsonDocument<192> doc;
+        doc["level"] = LeakWindow_levelName(peak.level);
+        doc["leak_current"] = peak.acCurrent;
+        doc["timestamp"] = IOT_MQTT_getTimestamp(peak.sampleMs);
+
+        char jsonBuffer[192];
+        serializeJson(doc, jsonBuffer);
+        client.publish(topic_alarm_leak_peak, jsonBuffer);
+        Serial.printf("Publishing to %s: %s\n", topic_alarm_leak_peak, jsonBuffer);
+    }
+
+    LeakWindowStats window;
+    while (LeakWindow_takeWindow(&window))
+    {
+        ArduinoJson::StaticJsonDocument<512> doc;
+        doc["window"] = window.sequence;
+        doc["duration_ms"] = window.endMs - window.startMs;
+        doc["samples"] = window.samples;
+        doc["missed"] = window.missed;
+        if (window.samples > 0)
+        {
+            addLeakChannel(doc["ac"].to<JsonObject>(), window.ac);
+            addLeakChannel(doc["dc"].to<JsonObject>(), window.dc);
+            doc["ac_peak_time"] = IOT_MQTT_getTimestamp(window.acPeakMs);
+        }
+        doc["peak_level"] = LeakWindow_levelName(window.peakLevel);
+        doc["timestamp"] = IOT_MQTT_getTimestamp(window.endMs);
+
+        char jsonBuffer[512];
+        serializeJson(doc, jsonBuffer);
+        client.publish(topic_leak_window, jsonBuffer);
+    }
+}
+
+// Hàm publish chẩn đoán đường cảnh báo rò điện: số cạnh/sự kiện và độ trễ phát hiện -> còi, phát hiện -> publish
+static void publishAlarmDiagnostics(PubSubClient &client)
+{
+    const LeakAlarmStats *stats = LeakAlarm_getStats();
+    if (stats->edges == 0)
+        return;
+
+    ArduinoJson::StaticJsonDocument<384> doc;
+    doc["edges"] = stats->edges;
+    doc["events"] = stats->events;
+    doc["glitches"] = stats->glitches;
+    doc["dropped"] = stats->dropped;
+    doc["published"] = stats->published;
+    doc["detect_to_buzzer_last_us"] = stats->lastDetectToBuzzerUs;
+    doc["detect_to_buzzer_max_us"] = stats->maxDetectToBuzzerUs;
+    doc["detect_to_publish_last_us"] = stats->lastDetectToPublishUs;
+    doc["detect_to_publish_max_us"] = stats->maxDetectToPublishUs;
+    doc["detect_to_publish_mean_us"] = stats->published ? (uint32_t)(stats->sumDetectToPublishUs / stats->published) : 0;
+    doc["timestamp"] = IOT_MQTT_getTimestamp(millis());
+
+    char jsonBuffer[384];
+    serializeJson(doc, jsonBuffer);
+    client.publish(topic_diag_alarm, jsonBuffer);
+}
+
+// Hàm publish chẩn đoán Modbus theo chu kỳ chậm, đọc trực tiếp bộ đếm của các bus (chỉ worker của bus ghi)
+void IOT_MQTT_publishDiagnostics(PubSubClient &client)
+{
+    static uint32_t lastDiagMs = 0;
+    const uint32_t now = millis();
+    if (lastDiagMs != 0 && now - lastDiagMs < DIAG_PUBLISH_INTERVAL_MS)
+        return;
+    lastDiagMs = now;
+
+    publishBusDiagnostics(client, &sensorBus);
+    publishBusDiagnostics(client, &leakBus);
+    publishAlarmDiagnostics(client);
+}
@@ -2,18 +2,29 @@
 
 #include <WiFi.h>                // Thư viện WiFi cho ESP32, phục vụ kết nối mạng không dây
 #include <time.h>                // Thư viện thời gian thực, dùng cho đồng bộ NTP và timestamp
+#include "esp_sntp.h"             // Callback báo đồng bộ NTP xong
 #include <PubSubClient.h>        // Thư viện MQTT client, giao tiếp với MQTT broker
+#include <Preferences.h>         // Thư viện NVS, lưu cache AP WiFi
+#include "WifiStateMachine.h"    // State machine kết nối WiFi không chặn
+#include "MqttSession.h"         // Quản lý kết nối MQTT không chặn (backoff + jitter, clientId theo MAC)
 #include "SensorHandlers.h"      // Khai báo các struct, biến, hàm xử lý cảm biến và trạng thái thiết bị
+#include "SensorSnapshot.h"      // Snapshot dữ liệu do task thu thập gửi sang task mạng
 #include <ArduinoJson.h>         // Thư viện ArduinoJson, dùng để đóng gói dữ liệu gửi lên MQTT
 #include "MD0630T01A_LeakSensor.h" // Khai báo cảm biến rò điện
 #include "ES35-SW.h"               // Khai báo cảm biến môi trường (nhiệt độ, độ ẩm)
 #include "PZEM016_Lib.h"           // Khai báo cảm biến điện năng (điện áp, dòng, công suất...)
 
+#define MQTT_SOCKET_TIMEOUT_S 3    // Thời gian chờ tối đa cho một lần kết nối MQTT (s)
+#define DIAG_PUBLISH_INTERVAL_MS 60000 // Chu kỳ publish chẩn đoán bus Modbus (ms)
+#define NTP_SYNC_HOLD_MS 10000     // Thời gian giữ bản tin trong hàng đợi chờ đồng bộ NTP, tính từ lần kết nối MQTT đầu tiên (ms)
+
 extern WiFiClient espClient;       // Đối tượng quản lý kết nối TCP/IP cho ESP32
 extern PubSubClient mqttClient;    // Đối tượng MQTT client, dùng để publish/subscribe dữ liệu
 
 extern const char* WIFI_SSID;      // Tên mạng WiFi cần kết nối
 extern const char* WIFI_PASSWORD;  // Mật khẩu WiFi
+extern const char* BK_WIFI_SSID;   // Tên mạng WiFi backup
+extern const char* BK_WIFI_PASSWORD; // Mật khẩu WiFi backup
 extern const char* MQTT_SERVER;    // Địa chỉ MQTT broker/server
 extern const int   MQTT_PORT;      // Cổng kết nối MQTT broker
 
@@ -39,12 +50,26 @@ extern const char* topic_env_xenon300;      // Topic dữ liệu môi trường
 extern const char* topic_elec_co2ui400;     // Topic dữ liệu điện thiết bị bơm CO2 UI400
 extern const char* topic_env_co2ui400;      // Topic dữ liệu môi trường thiết bị bơm CO2 UI400
 
+extern const char* topic_diag_modbus;       // Topic chẩn đoán bus Modbus (bộ đếm, histogram độ trễ từng slave)
+extern const char* topic_leak_window;       // Topic thống kê dòng rò theo cửa sổ (min/max/mean/RMS)
+extern const char* topic_alarm_leak_peak;   // Topic sự kiện dòng rò AC vượt ngưỡng (mẫu đọc nhanh)
+extern const char* topic_alarm_leak;        // Topic cảnh báo tức thời từ các chân DO/AO/DA của cảm biến rò điện
+extern const char* topic_diag_alarm;        // Topic chẩn đoán đường cảnh báo (độ trễ phát hiện -> còi/publish)
+
 // Khai báo các hàm xử lý chính cho module IoT MQTT
-extern void IOT_MQTT_setupWifi(); // Hàm kết nối WiFi, tự động retry nếu thất bại, log trạng thái lên Serial
-extern void IOT_MQTT_setupTime(); // Hàm đồng bộ thời gian thực (NTP), phục vụ timestamp cho dữ liệu
+extern void IOT_MQTT_setupWifi(); // Hàm khởi tạo WiFi và state machine kết nối (không chặn)
+extern void IOT_MQTT_setupTime(); // Khởi động đồng bộ thời gian thực (NTP) chạy nền, không chờ
+extern bool IOT_MQTT_isTimeSynced(); // true nếu đã đồng bộ NTP
+extern bool IOT_MQTT_timestampsReady(); // true nếu được publish: đã đồng bộ NTP, hoặc đã chờ quá NTP_SYNC_HOLD_MS (timestamp "T+<giây>s")
 extern void IOT_MQTT_setupMQTT(PubSubClient& client); // Hàm kết nối MQTT server, thiết lập client, topic, callback
-extern void IOT_MQTT_publishAll(PubSubClient& client, const acLeakChangedFlags&, const teHuCartChangedFlags&, const teHuDecviceChangedFlags&, const PZEMChangedFlags&); // Publish toàn bộ dữ liệu cảm biến nếu có thay đổi
-extern void IOT_MQTT_ensureWifiConnected(); // Đảm bảo kết nối WiFi luôn duy trì, tự động reconnect nếu mất kết nối
-extern void IOT_MQTT_ensureConnected(PubSubClient& client); // Đảm bảo kết nối MQTT luôn duy trì, tự động reconnect nếu mất kết nối
-extern String IOT_MQTT_getTimestamp(); // Lấy timestamp hiện tại dạng chuỗi ISO8601 để gắn vào dữ liệu publish
+extern void IOT_MQTT_publishAll(PubSubClient& client, const SensorSnapshot& snap); // Publish dữ liệu của một snapshot nếu có thay đổi
+extern void IOT_MQTT_publishLeakAlarms(PubSubClient& client); // Publish ngay các sự kiện cảnh báo rò điện đang chờ, trước snapshot
+extern void IOT_MQTT_publishLeakWindows(PubSubClient& client); // Publish sự kiện vượt ngưỡng và thống kê các cửa sổ dòng rò đã đóng
+extern void IOT_MQTT_publishDiagnostics(PubSubClient& client); // Publish chẩn đoán Modbus, tối đa một lần mỗi DIAG_PUBLISH_INTERVAL_MS
+extern bool IOT_MQTT_ensureWifiConnected(); // Chạy state machine WiFi (không chặn), trả về true nếu đã có IP
+extern const WifiStateMachine *IOT_MQTT_getWifiState(); // State machine WiFi, chứa thời gian reconnect gần nhất/lớn nhất
+extern bool IOT_MQTT_ensureConnected(PubSubClient& client); // Duy trì kết nối MQTT (không chặn, tối đa 1 lần thử mỗi lần gọi), trả về true nếu đã kết nối
+extern const MqttSessionStats *IOT_MQTT_getSessionStats(); // Thống kê số lần thử, lỗi và độ trễ kết nối MQTT
+extern String IOT_MQTT_getTimestamp(uint32_t sampleMs); // Timestamp của mẫu lấy lúc sampleMs (millis), hiệu chỉnh theo NTP nếu đã đồng bộ
+extern uint32_t IOT_MQTT_getBootToFirstPublishMs(); // Thời gian từ khi khởi động đến lần publish đầu tiên (ms), 0 nếu chưa có
 // extern void IOT_MQTT_loadOperatingTime(); // (Đã loại bỏ) Hàm cũ dùng để load thời gian hoạt động từ EEPROM, không dùng nữa
\ No newline at end of file
@@ -0,0 +1,183 @@
+/**
+ * @file LeakAlarm.cpp
+ * @brief Implementation of the interrupt-driven leakage alarm path.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include "LeakAlarm.h"
+
+// Edge state shared between the ISR and the alarm task
+static portMUX_TYPE alarmMux = portMUX_INITIALIZER_UNLOCKED;
+static bool edgePending = false;    // An edge arrived since the last LeakAlarm_process()
+static uint32_t pendingEdgeUs = 0;  // Timestamp of the first of those edges
+
+static LeakAlarmPinSource pinSource = NULL;
+static TaskHandle_t alarmTask = NULL;
+static TaskHandle_t consumerTask = NULL;
+static QueueHandle_t eventQueue = NULL;
+static volatile uint8_t activePins = 0; // Written by the alarm task only
+static LeakAlarmStats stats = {};
+
+/**
+ * @brief Default source: the three sensor outputs, active high.
+ */
+static uint8_t gpioPinSource(void)
+{
+    return (digitalRead(PIN_DO) == HIGH ? LEAK_ALARM_PIN_DO : 0) |
+           (digitalRead(PIN_AO) == HIGH ? LEAK_ALARM_PIN_AO : 0) |
+           (digitalRead(PIN_DA) == HIGH ? LEAK_ALARM_PIN_DA : 0);
+}
+
+static void IRAM_ATTR alarmIsr(void)
+{
+    LeakAlarm_onEdge(micros());
+}
+
+/**
+ * @brief Alarm task: sleeps until an edge, lets the level settle, then processes it.
+ */
+static void alarmTaskMain(void *)
+{
+    LeakAlarmEvent event;
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(LEAK_ALARM_CONFIRM_MS));
+        LeakAlarm_process(&event);
+    }
+}
+
+/**
+ * @brief Start the alarm task and, for the GPIO source, the pin interrupts on both edges.
+ *
+ * @details The level at start-up becomes the initial state, so an alarm already active at boot is
+ *          raised once through the normal path.
+ */
+void LeakAlarm_init(LeakAlarmPinSource source)
+{
+    pinSource = (source != NULL) ? source : gpioPinSource;
+    eventQueue = xQueueCreate(LEAK_ALARM_QUEUE_DEPTH, sizeof(LeakAlarmEvent));
+    xTaskCreatePinnedToCore(alarmTaskMain, "leakAlarm", LEAK_ALARM_TASK_STACK, NULL, LEAK_ALARM_TASK_PRIORITY,
+                            &alarmTask, LEAK_ALARM_TASK_CORE);
+    if (source == NULL)
+    {
+        attachInterrupt(digitalPinToInterrupt(PIN_DO), alarmIsr, CHANGE);
+        attachInterrupt(digitalPinToInterrupt(PIN_AO), alarmIsr, CHANGE);
+        attachInterrupt(digitalPinToInterrupt(PIN_DA), alarmIsr, CHANGE);
+    }
+    LeakAlarm_onEdge(micros()); // Evaluate the level present at boot
+}
+
+void LeakAlarm_setConsumerTask(TaskHandle_t task)
+{
+    consumerTask = task;
+}
+
+/**
+ * @brief Keep the timestamp of the first edge of a burst; later edges only wake the task again.
+ */
+void IRAM_ATTR LeakAlarm_onEdge(uint32_t nowUs)
+{
+    portENTER_CRITICAL_ISR(&alarmMux);
+    if (!edgePending)
+    {
+        pendingEdgeUs = nowUs;
+        edgePending = true;
+    }
+    stats.edges++;
+    portEXIT_CRITICAL_ISR(&alarmMux);
+
+    if (alarmTask != NULL)
+    {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(alarmTask, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+/**
+ * @brief Compare the settled level with the last confirmed one; on a change start the buzzer (raised
+ *        alarm) and queue the event for the network task.
+ *
+ * @details The buzzer is ticked once right away so the first note sounds now instead of at the next
+ *          sequencer tick. A full queue (network down) drops its oldest event: the newest state matters.
+ *          Nothing is logged here: a blocking Serial write would delay the event, the latency goes to
+ *          the stats instead.
+ */
+bool LeakAlarm_process(LeakAlarmEvent *event)
+{
+    portENTER_CRITICAL(&alarmMux);
+    const bool pending = edgePending;
+    const uint32_t detectUs = pendingEdgeUs;
+    edgePending = false;
+    portEXIT_CRITICAL(&alarmMux);
+    if (!pending)
+    {
+        return false;
+    }
+
+    const uint8_t level = pinSource();
+    if (level == activePins)
+    {
+        stats.glitches++;
+        return false;
+    }
+
+    event->active = level;
+    event->changed = level ^ activePins;
+    event->detectUs = detectUs;
+    activePins = level;
+    if ((level & event->changed) != 0) // An output went active
+    {
+        Buzzer_play(&BUZZER_PATTERN_LEAK_STRONG);
+        Buzzer_tick(millis());
+        stats.lastDetectToBuzzerUs = micros() - detectUs;
+        if (stats.lastDetectToBuzzerUs > stats.maxDetectToBuzzerUs)
+        {
+            stats.maxDetectToBuzzerUs = stats.lastDetectToBuzzerUs;
+        }
+    }
+    event->dispatchUs = micros();
+    stats.events++;
+
+    if (xQueueSend(eventQueue, event, 0) != pdTRUE)
+    {
+        LeakAlarmEvent oldest;
+        xQueueReceive(eventQueue, &oldest, 0);
+        xQueueSend(eventQueue, event, 0);
+        stats.dropped++;
+    }
+    if (consumerTask != NULL)
+    {
+        xTaskNotifyGive(consumerTask);
+    }
+    return true;
+}
+
+bool LeakAlarm_takeEvent(LeakAlarmEvent *event)
+{
+    return eventQueue != NULL && xQueueReceive(eventQueue, event, 0) == pdTRUE;
+}
+
+void LeakAlarm_recordPublished(const LeakAlarmEvent *event, uint32_t nowUs)
+{
+    const uint32_t latencyUs = nowUs - event->detectUs;
+    stats.published++;
+    stats.lastDetectToPublishUs = latencyUs;
+    stats.sumDetectToPublishUs += latencyUs;
+    if (latencyUs > stats.maxDetectToPublishUs)
+    {
+        stats.maxDetectToPublishUs = latencyUs;
+    }
+}
+
+uint8_t LeakAlarm_activePins(void)
+{
+    return activePins;
+}
+
+const LeakAlarmStats *LeakAlarm_getStats(void)
+{
+    return &stats;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file LeakAlarm.h
+ * @brief Interrupt-driven fast path for the DO/AO/DA alarm outputs of the MD0630T01A leakage sensor.
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * An edge on any output is timestamped in the ISR, which wakes a high-priority alarm task. The task
+ * confirms the new level, starts the buzzer and queues an event that the network task publishes
+ * ahead of the regular snapshots, so an alarm does not wait for the next poll or publish cycle.
+ * The pin levels come from a replaceable source, so the ISR-to-alarm logic also runs on a host.
+ */
+
+#ifndef LEAK_ALARM_H
+#define LEAK_ALARM_H
+
+#include <Arduino.h>
+#include "MD0630T01A_LeakSensor.h"
+#include "Buzzer.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define LEAK_ALARM_PIN_DO 0x01 // DC overcurrent output (PIN_DO)
+#define LEAK_ALARM_PIN_AO 0x02 // AC overcurrent output (PIN_AO)
+#define LEAK_ALARM_PIN_DA 0x04 // AC or DC overcurrent output (PIN_DA)
+
+#define LEAK_ALARM_TASK_STACK 3072   // Stack (byte) of the alarm task
+#define LEAK_ALARM_TASK_PRIORITY 5   // Above the RS485 bus workers (4)
+#define LEAK_ALARM_TASK_CORE 1       // Same core as the acquisition tasks, away from WiFi
+#define LEAK_ALARM_CONFIRM_MS 1      // Delay before the level is read, filters contact bounce and EMI spikes
+#define LEAK_ALARM_QUEUE_DEPTH 8     // Events waiting for the network task; the oldest is dropped when full
+
+    /**
+     * @brief Source of the current output levels as a LEAK_ALARM_PIN_* mask (set bit = alarm active).
+     */
+    typedef uint8_t (*LeakAlarmPinSource)(void);
+
+    /**
+     * @brief One confirmed change of the alarm outputs.
+     */
+    typedef struct
+    {
+        uint8_t active;      ///< LEAK_ALARM_PIN_* outputs active after the change
+        uint8_t changed;     ///< Outputs whose level changed
+        uint32_t detectUs;   ///< micros() of the first edge, taken in the ISR
+        uint32_t dispatchUs; ///< micros() when the buzzer was started and the event queued
+    } LeakAlarmEvent;
+
+    /**
+     * @brief Counters and latencies of the alarm path.
+     */
+    typedef struct
+    {
+        uint32_t edges;                 ///< Interrupts taken
+        uint32_t events;                ///< Confirmed level changes
+        uint32_t glitches;              ///< Wake-ups whose confirmed level had not changed
+        uint32_t dropped;               ///< Events dropped because the network queue was full
+        uint32_t published;             ///< Events published
+        uint32_t lastDetectToBuzzerUs;  ///< Edge to buzzer start of the last raised alarm
+        uint32_t maxDetectToBuzzerUs;   ///< Worst edge to buzzer start
+        uint32_t lastDetectToPublishUs; ///< Edge to MQTT publish of the last published event
+        uint32_t maxDetectToPublishUs;  ///< Worst edge to MQTT publish
+        uint64_t sumDetectToPublishUs;  ///< For the mean over @c published events
+    } LeakAlarmStats;
+
+    /**
+     * @brief Start the alarm task. With @p source NULL the GPIO pins are read and their interrupts
+     *        attached; otherwise @p source is used and the caller calls LeakAlarm_onEdge() itself.
+     */
+    extern void LeakAlarm_init(LeakAlarmPinSource source);
+
+    /**
+     * @brief Task notified when an event has been queued (the network task).
+     */
+    extern void LeakAlarm_setConsumerTask(TaskHandle_t task);
+
+    /**
+     * @brief ISR body: timestamp the edge and wake the alarm task.
+     */
+    extern void LeakAlarm_onEdge(uint32_t nowUs);
+
+    /**
+     * @brief Alarm task body: read the level after a pending edge and act on a change.
+     * @return true and @p event filled if the outputs changed.
+     */
+    extern bool LeakAlarm_process(LeakAlarmEvent *event);
+
+    /**
+     * @brief Take the oldest event waiting to be published (network task).
+     */
+    extern bool LeakAlarm_takeEvent(LeakAlarmEvent *event);
+
+    /**
+     * @brief Record that @p event has been published at @p nowUs.
+     */
+    extern void LeakAlarm_recordPublished(const LeakAlarmEvent *event, uint32_t nowUs);
+
+    /**
+     * @brief Outputs active as of the last confirmed change.
+     */
+    extern uint8_t LeakAlarm_activePins(void);
+
+    /**
+     * @brief Counters and latencies of the alarm path.
+     */
+    extern const LeakAlarmStats *LeakAlarm_getStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LEAK_ALARM_H
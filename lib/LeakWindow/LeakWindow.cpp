@@ -0,0 +1,241 @@
+/**
+ * @file LeakWindow.cpp
+ * @brief Implementation of the windowed leakage current statistics.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include "LeakWindow.h"
+#include <math.h>
+
+/**
+ * @brief Running sums of one channel in the open window.
+ */
+typedef struct
+{
+    float min;
+    float max;
+    float sum;
+    float sumSquares;
+} ChannelAccumulator;
+
+// Open window, touched by the leak task only
+static bool windowOpen = false;
+static uint32_t windowStartMs = 0;
+static uint16_t windowSamples = 0;
+static uint16_t windowMissed = 0;
+static ChannelAccumulator acAcc;
+static ChannelAccumulator dcAcc;
+static uint32_t acPeakMs = 0;
+static uint8_t windowPeakLevel = LEAK_LEVEL_NORMAL;
+static uint8_t reportedLevel = LEAK_LEVEL_NORMAL; // Level of the last peak event, lowered with hysteresis
+
+static QueueHandle_t windowQueue = NULL;
+static QueueHandle_t peakQueue = NULL;
+static TaskHandle_t consumerTask = NULL;
+static LeakWindowCounters counters = {};
+
+static void accumulatorReset(ChannelAccumulator *acc)
+{
+    acc->min = INFINITY;
+    acc->max = -INFINITY;
+    acc->sum = 0.0f;
+    acc->sumSquares = 0.0f;
+}
+
+static void accumulatorAdd(ChannelAccumulator *acc, float value)
+{
+    if (value < acc->min)
+    {
+        acc->min = value;
+    }
+    if (value > acc->max)
+    {
+        acc->max = value;
+    }
+    acc->sum += value;
+    acc->sumSquares += value * value;
+}
+
+static void accumulatorResult(const ChannelAccumulator *acc, uint16_t samples, LeakChannelStats *out)
+{
+    if (samples == 0)
+    {
+        *out = {};
+        return;
+    }
+    out->min = acc->min;
+    out->max = acc->max;
+    out->mean = acc->sum / samples;
+    out->rms = sqrtf(acc->sumSquares / samples);
+}
+
+static void openWindow(uint32_t nowMs)
+{
+    windowOpen = true;
+    windowStartMs = nowMs;
+    windowSamples = 0;
+    windowMissed = 0;
+    accumulatorReset(&acAcc);
+    accumulatorReset(&dcAcc);
+    acPeakMs = nowMs;
+    windowPeakLevel = LEAK_LEVEL_NORMAL;
+}
+
+/**
+ * @brief Queue @p item, dropping the oldest entry when the queue is full.
+ * @return false if an entry was dropped.
+ */
+static bool queueDropOldest(QueueHandle_t queue, const void *item, void *scratch)
+{
+    if (xQueueSend(queue, item, 0) == pdTRUE)
+    {
+        return true;
+    }
+    xQueueReceive(queue, scratch, 0);
+    xQueueSend(queue, item, 0);
+    return false;
+}
+
+static void closeWindow(uint32_t nowMs)
+{
+    LeakWindowStats window;
+    window.sequence = counters.windows++;
+    window.startMs = windowStartMs;
+    window.endMs = nowMs;
+    window.samples = windowSamples;
+    window.missed = windowMissed;
+    accumulatorResult(&acAcc, windowSamples, &window.ac);
+    accumulatorResult(&dcAcc, windowSamples, &window.dc);
+    window.acPeakMs = acPeakMs;
+    window.peakLevel = windowPeakLevel;
+
+    LeakWindowStats dropped;
+    if (!queueDropOldest(windowQueue, &window, &dropped))
+    {
+        counters.windowsLost++;
+    }
+    if (consumerTask != NULL)
+    {
+        xTaskNotifyGive(consumerTask);
+    }
+}
+
+/**
+ * @brief Raise a peak event when the level goes above the last reported one; lower the reported level
+ *        only once the current is LEAK_PEAK_HYSTERESIS below the threshold it crossed. Nothing is
+ *        printed here, on the sampling path: the event and LeakWindowCounters carry the peak, and the
+ *        network task logs it when it publishes.
+ */
+static void checkPeak(uint32_t nowMs, float acCurrent, uint8_t level)
+{
+    if (level > reportedLevel)
+    {
+        reportedLevel = level;
+        LeakPeakEvent event = {level, acCurrent, nowMs};
+        LeakPeakEvent dropped;
+        counters.peaks++;
+        if (!queueDropOldest(peakQueue, &event, &dropped))
+        {
+            counters.peaksLost++;
+        }
+        if (consumerTask != NULL)
+        {
+            xTaskNotifyGive(consumerTask);
+        }
+    }
+    else if (level < reportedLevel)
+    {
+        reportedLevel = LeakWindow_levelOf(acCurrent + LEAK_PEAK_HYSTERESIS);
+    }
+}
+
+void LeakWindow_init(void)
+{
+    windowQueue = xQueueCreate(LEAK_WINDOW_RING, sizeof(LeakWindowStats));
+    peakQueue = xQueueCreate(LEAK_PEAK_QUEUE_DEPTH, sizeof(LeakPeakEvent));
+}
+
+void LeakWindow_setConsumerTask(TaskHandle_t task)
+{
+    consumerTask = task;
+}
+
+/**
+ * @brief Close the open window once LEAK_WINDOW_MS has elapsed, then aggregate the reading into the
+ *        next one. A failed read only counts as missed.
+ */
+void LeakWindow_addSample(uint32_t nowMs, const LeakSensorData *data)
+{
+    if (!windowOpen)
+    {
+        openWindow(nowMs);
+    }
+    else if (nowMs - windowStartMs >= LEAK_WINDOW_MS)
+    {
+        closeWindow(nowMs);
+        openWindow(nowMs);
+    }
+
+    if (data == NULL)
+    {
+        windowMissed++;
+        return;
+    }
+
+    windowSamples++;
+    accumulatorAdd(&dcAcc, data->dcCurrent);
+    if (data->acCurrent > acAcc.max)
+    {
+        acPeakMs = nowMs;
+    }
+    accumulatorAdd(&acAcc, data->acCurrent);
+
+    const uint8_t level = LeakWindow_levelOf(data->acCurrent);
+    if (level > windowPeakLevel)
+    {
+        windowPeakLevel = level;
+    }
+    checkPeak(nowMs, data->acCurrent, level);
+}
+
+bool LeakWindow_takeWindow(LeakWindowStats *window)
+{
+    return windowQueue != NULL && xQueueReceive(windowQueue, window, 0) == pdTRUE;
+}
+
+bool LeakWindow_takePeak(LeakPeakEvent *event)
+{
+    return peakQueue != NULL && xQueueReceive(peakQueue, event, 0) == pdTRUE;
+}
+
+LeakLevel LeakWindow_levelOf(float acCurrent)
+{
+    if (acCurrent >= AC_LEAK_THRESHOLD_STRONG)
+    {
+        return LEAK_LEVEL_STRONG;
+    }
+    if (acCurrent >= AC_LEAK_THRESHOLD_SOFT)
+    {
+        return LEAK_LEVEL_SOFT;
+    }
+    return LEAK_LEVEL_NORMAL;
+}
+
+const char *LeakWindow_levelName(uint8_t level)
+{
+    switch (level)
+    {
+    case LEAK_LEVEL_SOFT:
+        return "soft";
+    case LEAK_LEVEL_STRONG:
+        return "strong";
+    default:
+        return "normal";
+    }
+}
+
+const LeakWindowCounters *LeakWindow_getCounters(void)
+{
+    return &counters;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file LeakWindow.h
+ * @brief High-rate sampling statistics of the MD0630T01A leakage current: per-window min, max, mean
+ *        and RMS, and immediate events when a sample crosses a warning threshold.
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * The leak task reads the sensor every LEAK_SAMPLE_PERIOD_MS on its own bus and adds each reading
+ * here. Every LEAK_WINDOW_MS the window is closed into one aggregate for the network task, so a short
+ * transient shows up in the window maximum instead of falling between two slow polls or under
+ * LEAK_AC_DELTA_MIN. A sample crossing AC_LEAK_THRESHOLD_SOFT or AC_LEAK_THRESHOLD_STRONG is queued
+ * as a peak event right away; it is reported again only after the current fell back below the
+ * threshold by LEAK_PEAK_HYSTERESIS, so a current hovering around a threshold does not flood MQTT.
+ */
+
+#ifndef LEAK_WINDOW_H
+#define LEAK_WINDOW_H
+
+#include <Arduino.h>
+#include "MD0630T01A_LeakSensor.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define LEAK_SAMPLE_PERIOD_MS 200  // 5 Hz; one 4-register read takes ~24 ms at 9600 baud (~12% of the leak bus)
+#define LEAK_WINDOW_MS 10000       // Aggregation window, one MQTT message per window
+#define LEAK_WINDOW_RING 8         // Closed windows waiting for the network task; the oldest is dropped when full
+#define LEAK_PEAK_QUEUE_DEPTH 8    // Peak events waiting for the network task; the oldest is dropped when full
+#define LEAK_PEAK_HYSTERESIS 0.2f  // mA below a threshold before the same crossing is reported again
+
+    /**
+     * @brief Warning level of an AC leakage current.
+     */
+    typedef enum
+    {
+        LEAK_LEVEL_NORMAL = 0, ///< Below AC_LEAK_THRESHOLD_SOFT
+        LEAK_LEVEL_SOFT,       ///< From AC_LEAK_THRESHOLD_SOFT
+        LEAK_LEVEL_STRONG      ///< From AC_LEAK_THRESHOLD_STRONG
+    } LeakLevel;
+
+    /**
+     * @brief Aggregates of one current channel over a window (mA).
+     */
+    typedef struct
+    {
+        float min;
+        float max;
+        float mean;
+        float rms;
+    } LeakChannelStats;
+
+    /**
+     * @brief One closed window.
+     */
+    typedef struct
+    {
+        uint32_t sequence;   ///< Window counter since boot
+        uint32_t startMs;    ///< millis() of the first sample slot of the window
+        uint32_t endMs;      ///< millis() when the window was closed
+        uint16_t samples;    ///< Valid readings aggregated
+        uint16_t missed;     ///< Reads that failed (timeout, CRC, breaker open)
+        LeakChannelStats ac; ///< AC leakage current, valid if @c samples > 0
+        LeakChannelStats dc; ///< DC leakage current, valid if @c samples > 0
+        uint32_t acPeakMs;   ///< millis() of the AC maximum
+        uint8_t peakLevel;   ///< Highest @c LeakLevel reached in the window
+    } LeakWindowStats;
+
+    /**
+     * @brief A sample that raised the warning level.
+     */
+    typedef struct
+    {
+        uint8_t level;     ///< @c LeakLevel reached
+        float acCurrent;   ///< AC leakage current of the sample (mA)
+        uint32_t sampleMs; ///< millis() of the sample
+    } LeakPeakEvent;
+
+    /**
+     * @brief Counters of the sampling path.
+     */
+    typedef struct
+    {
+        uint32_t windows;      ///< Windows closed
+        uint32_t windowsLost;  ///< Windows dropped because the ring was full
+        uint32_t peaks;        ///< Peak events raised
+        uint32_t peaksLost;    ///< Peak events dropped because the queue was full
+    } LeakWindowCounters;
+
+    /**
+     * @brief Create the window ring and the peak queue. Call before the leak task starts.
+     */
+    extern void LeakWindow_init(void);
+
+    /**
+     * @brief Task notified when a window closed or a peak event was queued (the network task).
+     */
+    extern void LeakWindow_setConsumerTask(TaskHandle_t task);
+
+    /**
+     * @brief Add one reading (leak task only).
+     * @param nowMs millis() of the read.
+     * @param data Decoded reading, or NULL if the read failed.
+     */
+    extern void LeakWindow_addSample(uint32_t nowMs, const LeakSensorData *data);
+
+    /**
+     * @brief Take the oldest closed window (network task).
+     */
+    extern bool LeakWindow_takeWindow(LeakWindowStats *window);
+
+    /**
+     * @brief Take the oldest peak event (network task).
+     */
+    extern bool LeakWindow_takePeak(LeakPeakEvent *event);
+
+    /**
+     * @brief Warning level of an AC leakage current, without hysteresis.
+     */
+    extern LeakLevel LeakWindow_levelOf(float acCurrent);
+
+    /**
+     * @brief Printable name of a level.
+     */
+    extern const char *LeakWindow_levelName(uint8_t level);
+
+    /**
+     * @brief Counters of the sampling path.
+     */
+    extern const LeakWindowCounters *LeakWindow_getCounters(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LEAK_WINDOW_H
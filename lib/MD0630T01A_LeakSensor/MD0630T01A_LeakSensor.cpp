@@ -10,34 +10,35 @@
 
 // Define global variables
 HardwareSerial leakSerial(1); // Define Serial1 for MD0630T01A sensor - RX: GPIO 9, TX: GPIO 10
-ModbusMaster leakSensorNode;  // ModbusMaster object for MD0630T01A sensor communication
+Rs485Bus leakBus = {};        // RS485 bus of the MD0630T01A sensor (UART1)
 LeakSensorData leakSensorData; // Global variable holding leakage sensor data
-LeakSensor leakSensor = {&leakSensorNode}; // Struct managing the leakage sensor, contains pointer to leakSensorNode for sensor handling functions
-
-float lastLeakACCurrent = 0;
-
-// /**
-//  * @brief Initializes the GPIO pins used for threshold detection on the MD0630T01A leakage current sensor.
-//  *
-//  * Sets the pin modes for the DC overcurrent output (DO), AC overcurrent output (AO),
-//  * and combined AC/DC overcurrent output (DA) pins to INPUT for monitoring overcurrent events.
-//  */
-// void initLeakSensorThresholdPins(void)
-// {
-//     pinMode(PIN_DO, INPUT);
-//     pinMode(PIN_AO, INPUT);
-//     pinMode(PIN_DA, INPUT);
-// }
+LeakSensor leakSensor = {&leakBus, LEAK_SENSOR_SLAVE_ID, {}}; // Struct managing the leakage sensor, contains its bus and slave ID for sensor handling functions
+
+int32_t lastLeakACCurrent = 0;
+
+/**
+ * @brief Initializes the GPIO pins used for threshold detection on the MD0630T01A leakage current sensor.
+ *
+ * Sets the pin modes for the DC overcurrent output (DO), AC overcurrent output (AO),
+ * and combined AC/DC overcurrent output (DA) pins to INPUT for monitoring overcurrent events.
+ * Their edges are handled by the LeakAlarm interrupt path.
+ */
+void initLeakSensorThresholdPins(void)
+{
+    pinMode(PIN_DO, INPUT);
+    pinMode(PIN_AO, INPUT);
+    pinMode(PIN_DA, INPUT);
+}
 
 /**
  * @brief Initializes UART communication for the MD0630T01A leakage current sensor.
  *
- * Configures the HardwareSerial port with 9600 baud rate, 8 data bits, no parity, 1 stop bit,
- * and assigns the RX and TX pins for the sensor.
+ * Starts the sensor's own RS485 bus on the HardwareSerial port with 9600 baud rate, 8 data bits,
+ * no parity, 1 stop bit and the RX and TX pins of the sensor, together with its bus worker task.
  */
 void initLeakSensorUart(void)
 {
-    leakSerial.begin(9600, SERIAL_8N1, RX_LEAK_SENSOR, TX_LEAK_SENSOR);
+    RS485Bus_init(&leakBus, "leak", &leakSerial, LEAK_SENSOR_BAUD, RX_LEAK_SENSOR, TX_LEAK_SENSOR);
 }
 
 /**
@@ -46,7 +47,9 @@ void initLeakSensorUart(void)
  */
 void initLeakSensorModbus(void)
 {
-    leakSensorNode.begin(1, leakSerial); // Slave ID = 0x01 (default)
+    leakSensor.bus = &leakBus;
+    leakSensor.slave = LEAK_SENSOR_SLAVE_ID; // Slave ID = 0x01 (default)
+    Breaker_init(&leakSensor.breaker);
 }
 
 /**
@@ -60,30 +63,83 @@ void MD0630T01A_init(void)
 {
     initLeakSensorUart();
     initLeakSensorModbus();
-    // initLeakSensorThresholdPins();
+    initLeakSensorThresholdPins();
 }
 
 /**
  * @brief Reads a single input register from the leak sensor via Modbus and returns its value as a float.
  *
- * This function communicates with the leak sensor using the Modbus protocol to read the value of a specific input register.
+ * The request is queued on the sensor's bus; the calling task sleeps while the frame is on the wire and is
+ * woken by the bus worker when the UART reports the end of the reply, so the CPU is not busy-waiting.
  * The raw register value is divided by 10.0 to convert it to a floating-point representation, as per sensor specification.
  * If the read operation fails, the function returns -1.0f to indicate an error.
  *
- * @param sensor Pointer to a LeakSensor object containing the Modbus interface.
+ * @param sensor Pointer to a LeakSensor object containing the bus and slave ID.
  * @param reg    The address of the input register to read from the sensor.
  * @return float The value read from the register, converted to float. Returns -1.0f on failure.
  */
 static float readRegister(LeakSensor *sensor, uint16_t reg)
 {
-    uint8_t result = sensor->modbus->readInputRegisters(reg, 1);
-    if (result == sensor->modbus->ku8MBSuccess)
+    // A single-register read is already the cheapest request, so a probe is just the normal read
+    if (Breaker_allow(&sensor->breaker, millis()) == BREAKER_SKIP)
     {
-        return sensor->modbus->getResponseBuffer(0) / 10.0f;
+        return -1.0f;
     }
+
+    uint8_t data[2];
+    if (RS485Bus_readRegisters(sensor->bus, sensor->slave, LEAK_CMD_READ_INPUT, reg, 1, "leak.reg", data) == RS485_OK)
+    {
+        Breaker_recordSuccess(&sensor->breaker);
+        return ((data[0] << 8) | data[1]) / (float)LEAK_CURRENT_SCALE;
+    }
+    Breaker_recordFailure(&sensor->breaker, millis());
     return -1.0f;
 }
 
+/**
+ * @brief Reads the whole measurement block (registers 0x00..0x03) of the leak sensor in one transaction.
+ *
+ * One 13-byte response replaces four single-register round trips, so the AC leakage current is sampled
+ * together with the DC current and both thresholds at about a quarter of the bus time. The values are
+ * decoded into a local copy first and stored only when the whole frame is valid, so a reader never sees
+ * a mix of old and new channels.
+ *
+ * @param sensor Pointer to a LeakSensor object containing the bus and slave ID.
+ * @param data   Pointer to the LeakSensorData struct to fill.
+ * @return true if the read was successful, false otherwise.
+ */
+bool MD0630T01A_readAll(LeakSensor *sensor, LeakSensorData *data)
+{
+    if (Breaker_allow(&sensor->breaker, millis()) == BREAKER_SKIP)
+    {
+        data->valid = false;
+        return false;
+    }
+
+    uint8_t regs[2 * LEAK_REG_COUNT];
+    if (RS485Bus_readRegisters(sensor->bus, sensor->slave, LEAK_CMD_READ_INPUT, REG_DC_CURRENT, LEAK_REG_COUNT,
+                               "leak.block", regs) != RS485_OK)
+    {
+        Breaker_recordFailure(&sensor->breaker, millis());
+        data->valid = false;
+        return false;
+    }
+    Breaker_recordSuccess(&sensor->breaker);
+
+    float values[LEAK_REG_COUNT];
+    for (int i = 0; i < LEAK_REG_COUNT; i++)
+    {
+        values[i] = ((regs[2 * i] << 8) | regs[2 * i + 1]) / (float)LEAK_CURRENT_SCALE;
+    }
+    data->dcCurrent = values[REG_DC_CURRENT];
+    data->acCurrent = values[REG_AC_CURRENT];
+    data->acCurrentRaw = (uint16_t)((regs[2 * REG_AC_CURRENT] << 8) | regs[2 * REG_AC_CURRENT + 1]);
+    data->dcThreshold = values[REG_DC_THRESHOLD];
+    data->acThreshold = values[REG_AC_THRESHOLD];
+    data->valid = true;
+    return true;
+}
+
 /**
  * @brief Function to read the DC current from the MD0630T01A leakage current sensor.
  * @param sensor Pointer to the LeakSensor object.
@@ -126,20 +182,20 @@ float MD0630T01A_getACThreshold(LeakSensor *sensor)
 
 /**
  * @brief Function to check if the DC leakage current exceeds the threshold.
- * @param sensor Pointer to the LeakSensor object.
+ * @param sensor Unused: the level is read from the sensor's DO output pin.
  * @return true if the DC leakage current exceeds the threshold, false otherwise.
  */
-bool MD0630T01A_isOverDC(LeakSensor *sensor)
+bool MD0630T01A_isOverDC(LeakSensor *)
 {
     return digitalRead(PIN_DO) == HIGH;
 }
 
 /**
  * @brief Function to check if the AC leakage current exceeds the threshold.
- * @param sensor Pointer to the LeakSensor object.
+ * @param sensor Unused: the level is read from the sensor's AO output pin.
  * @return true if the AC leakage current exceeds the threshold, false otherwise.
  */
-bool MD0630T01A_isOverAC(LeakSensor *sensor)
+bool MD0630T01A_isOverAC(LeakSensor *)
 {
     return digitalRead(PIN_AO) == HIGH;
 }
@@ -147,10 +203,10 @@ bool MD0630T01A_isOverAC(LeakSensor *sensor)
 
 /**
  * @brief Function to check if either AC or DC leakage current exceeds the threshold.
- * @param sensor Pointer to the LeakSensor object.
+ * @param sensor Unused: the level is read from the sensor's DA output pin.
  * @return true if either AC or DC leakage current exceeds the threshold, false otherwise.
  */
-bool MD0630T01A_isOverDA(LeakSensor *sensor)
+bool MD0630T01A_isOverDA(LeakSensor *)
 {
     return digitalRead(PIN_DA) == HIGH;
 }
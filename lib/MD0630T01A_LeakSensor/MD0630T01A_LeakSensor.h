@@ -9,7 +9,9 @@
 #ifndef MD0630T01A_LEAKSENSOR_H
 #define MD0630T01A_LEAKSENSOR_H
 
-#include <ModbusMaster.h>
+#include "RS485_Bus.h"
+#include "CircuitBreaker.h"
+#include "FixedPoint.h" // RawDeltaGate
 
 #ifdef __cplusplus
 extern "C"
@@ -22,6 +24,11 @@ extern "C"
 #define REG_AC_CURRENT 0x01     // AC leakage current register address
 #define REG_DC_THRESHOLD 0x02   // DC leakage threshold register address
 #define REG_AC_THRESHOLD 0x03   // AC leakage threshold register address
+#define LEAK_REG_COUNT 4        // Registers 0x00..0x03: DC current, AC current, DC threshold, AC threshold
+
+#define LEAK_SENSOR_SLAVE_ID 0x01  // Modbus slave ID of MD0630T01A sensor (default)
+#define LEAK_SENSOR_BAUD 9600      // Baud rate of MD0630T01A sensor
+#define LEAK_CMD_READ_INPUT 0x04   // Read input registers
 
 // RX/TX pin for MD0630T01A sensor UART 1 of ESP32
 #define RX_LEAK_SENSOR 9    // RX pin for MD0630T01A sensor
@@ -37,18 +44,24 @@ extern "C"
 #define AC_LEAK_THRESHOLD_STRONG 5.0f        // mA, strong warning (start)
 
 #define LEAK_AC_DELTA_MIN 0.02f // mA, define minimum delta for AC leakage current updates
+#define LEAK_CURRENT_SCALE 10   // Register steps per mA (0.1 mA registers)
+
+extern int32_t lastLeakACCurrent; // Last published AC leakage current in register steps, for delta checking
 
-extern float lastLeakACCurrent; // Last recorded AC leakage current for delta checking
+// Delta gate of the AC leakage current in register steps: only LEAK_AC_DELTA_MIN, no relative part
+static constexpr RawDeltaGate leakACGate(LEAK_CURRENT_SCALE, 0.0, 0.0, 0.0, 1.0, 0, LEAK_AC_DELTA_MIN);
 
     /**
      * @brief Struct representing the MD0630T01A leakage current sensor.
      *
-     * This struct uses the ModbusMaster library to communicate with the sensor
-     * via the Modbus RTU protocol.
+     * The sensor is a Modbus RTU slave on its own RS485 bus (UART1), served by the
+     * asynchronous bus worker so its reads overlap with traffic on the shared sensor bus.
      */
     typedef struct
     {
-        ModbusMaster *modbus; ///< Pointer to ModbusMaster object for sensor communication
+        Rs485Bus *bus;          ///< Bus the sensor is attached to
+        uint8_t slave;          ///< Modbus slave ID of the sensor
+        CircuitBreaker breaker; ///< Circuit breaker of the sensor slave
     } LeakSensor;
 
     /**
@@ -58,6 +71,7 @@ extern float lastLeakACCurrent; // Last recorded AC leakage current for delta ch
     {
         float dcCurrent;            ///< Current DC leakage (mA)
         float acCurrent;            ///< Current AC leakage (mA)
+        uint16_t acCurrentRaw;      ///< AC leakage register as read (0.1 mA steps), for the integer delta gate
         float dcThreshold;          ///< DC leakage threshold (mA)
         float acThreshold;          ///< AC leakage threshold (mA)
         
@@ -74,8 +88,8 @@ extern float lastLeakACCurrent; // Last recorded AC leakage current for delta ch
     // Global variable definitions
     extern LeakSensorData leakSensorData; // Global variable holding leakage sensor data
     extern HardwareSerial leakSerial;     // Serial port for sensor communication
-    extern ModbusMaster leakSensorNode;   // ModbusMaster object for Modbus RTU communication with MD0630T01A sensor
-    extern LeakSensor leakSensor;         // Struct managing the leakage sensor, contains pointer to leakSensorNode for sensor handling functions
+    extern Rs485Bus leakBus;              // RS485 bus of the MD0630T01A sensor on UART1
+    extern LeakSensor leakSensor;         // Struct managing the leakage sensor, contains its bus and slave ID for sensor handling functions
 
     /**
      * @brief Initialize UART pins for MD0630T01A leakage current sensor.
@@ -89,13 +103,13 @@ extern float lastLeakACCurrent; // Last recorded AC leakage current for delta ch
      */
     extern void initLeakSensorModbus(void);
 
-    // /**
-    //  * @brief Initialize GPIO pins for the MD0630T01A leakage current sensor.
-    //  *
-    //  * Configures the pin modes for the DC overcurrent output (DO), AC overcurrent output (AO),
-    //  * and combined AC/DC overcurrent output (DA) pins used for overcurrent detection.
-    //  */
-    // extern void initLeakSensorThresholdPins(void);
+    /**
+     * @brief Initialize GPIO pins for the MD0630T01A leakage current sensor.
+     *
+     * Configures the pin modes for the DC overcurrent output (DO), AC overcurrent output (AO),
+     * and combined AC/DC overcurrent output (DA) pins used for overcurrent detection.
+     */
+    extern void initLeakSensorThresholdPins(void);
 
     /**
      * @brief Initialize the MD0630T01A leakage current sensor.
@@ -105,6 +119,15 @@ extern float lastLeakACCurrent; // Last recorded AC leakage current for delta ch
      */
     extern void MD0630T01A_init(void);
 
+    /**
+     * @brief Read DC current, AC current and both thresholds in one FC 0x04 transaction.
+     * @param sensor Pointer to the LeakSensor object.
+     * @param data   Receives the four values and valid = true, all together, only if the read succeeded;
+     *               on failure only valid is cleared.
+     * @return true if the read was successful.
+     */
+    extern bool MD0630T01A_readAll(LeakSensor *sensor, LeakSensorData *data);
+
     /**
      * @brief Read current DC leakage from MD0630T01A sensor.
      * @param sensor Pointer to the LeakSensor object.
@@ -0,0 +1,376 @@
+/**
+ * @file ModbusDiscovery.cpp
+ * @brief Implementation of Modbus slave discovery and the persisted bus map.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include "ModbusDiscovery.h"
+#include "ModbusRtu.h"
+#include <Preferences.h>
+
+// Factory layout, also the starting point of the first scan
+ModbusBusMap modbusBusMap = {DISCOVERY_MAP_VERSION, {0x01, 0x02, 0x03, 0x04, 0x05, 0x06}, ES35SW_SLAVE_ID, LEAK_SENSOR_SLAVE_ID};
+
+static Preferences busPrefs; // NVS namespace "busmap"
+
+// Type found at each scanned address of one bus (NONE outside the scanned range)
+typedef struct
+{
+    ModbusDeviceType type[DISCOVERY_LAST_ADDRESS + 1];
+} ScanResult;
+
+static ModbusDeviceType typeAt(const ScanResult *result, uint8_t address)
+{
+    return (address >= DISCOVERY_FIRST_ADDRESS && address <= DISCOVERY_LAST_ADDRESS) ? result->type[address]
+                                                                                        : MODBUS_DEVICE_NONE;
+}
+
+static bool loadMap(ModbusBusMap *map)
+{
+    ModbusBusMap stored = {};
+    busPrefs.begin("busmap", true);
+    const bool ok = busPrefs.getBytesLength("map") == sizeof(stored);
+    if (ok)
+    {
+        busPrefs.getBytes("map", &stored, sizeof(stored));
+    }
+    busPrefs.end();
+    if (!ok || stored.version != DISCOVERY_MAP_VERSION)
+    {
+        return false;
+    }
+    *map = stored;
+    return true;
+}
+
+static void saveMap(const ModbusBusMap *map)
+{
+    busPrefs.begin("busmap", false);
+    busPrefs.putBytes("map", map, sizeof(*map));
+    busPrefs.end();
+}
+
+static void printMap(const ModbusBusMap *map)
+{
+    Serial.print("[DISCOVERY] map:");
+    for (int i = 0; i < NUM_DEVICES; i++)
+    {
+        Serial.printf(" %s=0x%02X", SOCKET_NAMES[i], map->pzem[i]);
+    }
+    Serial.printf(" ES35SW=0x%02X LEAK=0x%02X\n", map->es35sw, map->leak);
+}
+
+// Hand the map to the drivers; a socket whose address changed starts with a fresh breaker
+static void applyMap(const ModbusBusMap *map)
+{
+    for (int i = 0; i < NUM_DEVICES; i++)
+    {
+        if (pzemAddresses[i] != map->pzem[i])
+        {
+            pzemAddresses[i] = map->pzem[i];
+            Breaker_init(&pzemBreakers[i]);
+            readFailCount[i] = 0;
+        }
+    }
+    if (es35swAddress != map->es35sw)
+    {
+        es35swAddress = map->es35sw;
+        Breaker_init(&es35swBreaker);
+    }
+    leakSensor.slave = map->leak;
+}
+
+static bool isMappedPzem(const ModbusBusMap *map, uint8_t address)
+{
+    for (int i = 0; i < NUM_DEVICES; i++)
+    {
+        if (map->pzem[i] == address)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Put a PZEM016T found at an unmapped address into a socket.
+ *
+ * @details A socket keeps its address while that slave is silent, because a PZEM016T is powered from
+ *          the socket it measures and an unpowered socket looks exactly like a missing meter. The new
+ *          meter is adopted only when exactly one socket is silent or without address (@p answering
+ *          false): that is where a replaced module with a different address ends up. With several
+ *          silent sockets the meter could belong to any of them, and a wrong guess would publish one
+ *          device's readings under another's name, so the address is only logged and the map is left
+ *          unchanged until the other sockets answer again (or the map is fixed by hand).
+ * @return Socket index, or -1 if no socket or more than one socket is silent.
+ */
+static int adoptPzem(ModbusBusMap *map, uint8_t address, const bool *answering)
+{
+    int socket = -1;
+    int silent = 0;
+    for (int i = 0; i < NUM_DEVICES; i++)
+    {
+        if (!answering[i] || map->pzem[i] == 0)
+        {
+            socket = i;
+            silent++;
+        }
+    }
+    if (silent != 1)
+    {
+        Serial.printf("[DISCOVERY] PZEM016T at 0x%02X left unmapped: %d silent sockets\n", address, silent);
+        return -1;
+    }
+    map->pzem[socket] = address;
+    return socket;
+}
+
+/**
+ * @brief Identify the device at an address from the registers it answers.
+ *
+ * @details PZEM016T and ES35-SW both report their own address in a holding register (0x0002 and 0x64),
+ *          which tells them apart from a device that merely answers any read; the measurement block is
+ *          then read to confirm the layout. The leakage sensor is alone on its bus and only needs its
+ *          4-register input block to answer.
+ */
+ModbusDeviceType ModbusDiscovery_identify(Rs485Bus *bus, uint8_t address)
+{
+    uint8_t regs[2 * PZEM_REG_COUNT];
+
+    if (bus == &leakBus)
+    {
+        return RS485Bus_readRegisters(bus, address, LEAK_CMD_READ_INPUT, REG_DC_CURRENT, LEAK_REG_COUNT,
+                                      "disc.id", regs) == RS485_OK
+                   ? MODBUS_DEVICE_LEAK
+                   : MODBUS_DEVICE_UNKNOWN;
+    }
+
+    if (RS485Bus_readRegisters(bus, address, PZEM_CMD_READ_HOLDING, PZEM_HOLD_REG_ADDRESS, 1, "disc.id", regs) == RS485_OK &&
+        regs[0] == 0 && regs[1] == address &&
+        RS485Bus_readRegisters(bus, address, PZEM_CMD_READ_INPUT, PZEM_REG_START, PZEM_REG_COUNT, "disc.id", regs) == RS485_OK)
+    {
+        return MODBUS_DEVICE_PZEM016;
+    }
+
+    if (RS485Bus_readRegisters(bus, address, ES35_CMD_READ_HOLDING, REG_SLAVE_ID, 1, "disc.id", regs) == RS485_OK &&
+        regs[0] == 0 && regs[1] == address &&
+        RS485Bus_readRegisters(bus, address, ES35_CMD_READ_HOLDING, REG_TEMPERATURE, 2, "disc.id", regs) == RS485_OK)
+    {
+        return MODBUS_DEVICE_ES35SW;
+    }
+    return MODBUS_DEVICE_UNKNOWN;
+}
+
+/**
+ * @brief Probe one address with a single-register read and identify it if anything answers.
+ *
+ * @details Any reply, even an exception or a garbled frame, means a slave is there. Only an empty
+ *          address costs the short probe timeout; its timeout estimate and telemetry are cleared again
+ *          so the scan leaves no trace in the diagnostics.
+ */
+static ModbusDeviceType probeAddress(Rs485Bus *bus, uint8_t address)
+{
+    uint8_t reg[2];
+    const Rs485Status status = RS485Bus_probeRegisters(bus, address, MODBUS_FC_READ_INPUT, 0, 1,
+                                                       DISCOVERY_PROBE_TIMEOUT_MS, "disc.probe", reg);
+    if (status == RS485_TIMEOUT)
+    {
+        RS485Bus_resetSlave(bus, address);
+        return MODBUS_DEVICE_NONE;
+    }
+    return ModbusDiscovery_identify(bus, address);
+}
+
+// Scan one bus in address order; stop once @p expected known devices have been identified
+static void scanBus(Rs485Bus *bus, uint8_t expected, ScanResult *result, ModbusScanStats *stats)
+{
+    uint8_t identified = 0;
+    for (uint16_t address = DISCOVERY_FIRST_ADDRESS; address <= DISCOVERY_LAST_ADDRESS; address++)
+    {
+        const ModbusDeviceType type = probeAddress(bus, (uint8_t)address);
+        result->type[address] = type;
+        stats->probes++;
+        if (type == MODBUS_DEVICE_NONE)
+        {
+            continue;
+        }
+        Serial.printf("[DISCOVERY] %s: 0x%02X is %s\n", bus->name, address, ModbusDiscovery_typeName(type));
+        if (type != MODBUS_DEVICE_UNKNOWN)
+        {
+            stats->found++;
+            if (++identified >= expected)
+            {
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Scan both buses and merge the result into @p map.
+ *
+ * @details Addresses already in the map keep their place even if they did not answer (see adoptPzem());
+ *          a new PZEM016T fills the only silent socket, if there is exactly one. The scan stops early once every expected device
+ *          has been found, so a cart with the factory addresses is done after address 0x09.
+ */
+bool ModbusDiscovery_scan(ModbusBusMap *map, ModbusScanStats *stats)
+{
+    static ScanResult sensorResult; // Static: too large for the caller's stack
+    static ScanResult leakResult;
+    memset(&sensorResult, 0, sizeof(sensorResult));
+    memset(&leakResult, 0, sizeof(leakResult));
+    memset(stats, 0, sizeof(*stats));
+    const uint32_t startMs = millis();
+
+    scanBus(&leakBus, 1, &leakResult, stats);
+    scanBus(&sensorBus, NUM_DEVICES + 1, &sensorResult, stats);
+
+    const ModbusBusMap before = *map;
+    bool answering[NUM_DEVICES];
+    for (int i = 0; i < NUM_DEVICES; i++)
+    {
+        answering[i] = typeAt(&sensorResult, map->pzem[i]) == MODBUS_DEVICE_PZEM016;
+    }
+    for (uint16_t address = DISCOVERY_FIRST_ADDRESS; address <= DISCOVERY_LAST_ADDRESS; address++)
+    {
+        const ModbusDeviceType type = sensorResult.type[address];
+        if (type == MODBUS_DEVICE_PZEM016 && !isMappedPzem(map, (uint8_t)address))
+        {
+            const int socket = adoptPzem(map, (uint8_t)address, answering);
+            if (socket >= 0)
+            {
+                answering[socket] = true;
+            }
+        }
+        else if (type == MODBUS_DEVICE_ES35SW && typeAt(&sensorResult, map->es35sw) != MODBUS_DEVICE_ES35SW)
+        {
+            map->es35sw = (uint8_t)address;
+        }
+        if (leakResult.type[address] == MODBUS_DEVICE_LEAK && typeAt(&leakResult, map->leak) != MODBUS_DEVICE_LEAK)
+        {
+            map->leak = (uint8_t)address;
+        }
+    }
+
+    stats->durationMs = millis() - startMs;
+    return memcmp(&before, map, sizeof(before)) != 0;
+}
+
+/**
+ * @brief Load or discover the bus map and apply it.
+ */
+void ModbusDiscovery_init(void)
+{
+    const bool loaded = loadMap(&modbusBusMap);
+    if (loaded && !MODBUS_DISCOVERY_FORCE)
+    {
+        Serial.println("[DISCOVERY] using saved bus map");
+    }
+    else
+    {
+        ModbusScanStats stats;
+        const bool changed = ModbusDiscovery_scan(&modbusBusMap, &stats);
+        Serial.printf("[DISCOVERY] scan: %u probes, %u devices in %lu ms\n", stats.probes, stats.found,
+                      (unsigned long)stats.durationMs);
+        if (changed || !loaded)
+        {
+            saveMap(&modbusBusMap);
+        }
+    }
+    printMap(&modbusBusMap);
+    applyMap(&modbusBusMap);
+}
+
+/**
+ * @brief Background discovery step, run by the acquisition task.
+ *
+ * @details Runs only while a socket or the ES35-SW has no answering slave (breaker not closed), one
+ *          unmapped address per call, so it costs at most one short probe per call. A pass over the
+ *          whole range that adopts nothing is followed by DISCOVERY_IDLE_PASS_MS of rest: an unpowered
+ *          socket keeps the search alive but only as a slow trickle.
+ */
+void ModbusDiscovery_step(void)
+{
+    static uint8_t nextAddress = DISCOVERY_FIRST_ADDRESS;
+    static bool adoptedThisPass = false;
+    static bool resting = false;
+    static uint32_t restStartMs = 0;
+
+    bool answering[NUM_DEVICES];
+    bool unresolved = es35swBreaker.state != BREAKER_CLOSED;
+    for (int i = 0; i < NUM_DEVICES; i++)
+    {
+        answering[i] = pzemBreakers[i].state == BREAKER_CLOSED;
+        unresolved = unresolved || !answering[i];
+    }
+    if (!unresolved)
+    {
+        return;
+    }
+    if (resting && millis() - restStartMs < DISCOVERY_IDLE_PASS_MS)
+    {
+        return;
+    }
+    resting = false;
+
+    // Next address not already in the map
+    uint8_t address = nextAddress;
+    for (int n = 0; n <= DISCOVERY_LAST_ADDRESS && (isMappedPzem(&modbusBusMap, address) || address == modbusBusMap.es35sw); n++)
+    {
+        address = (address >= DISCOVERY_LAST_ADDRESS) ? DISCOVERY_FIRST_ADDRESS : address + 1;
+    }
+
+    ModbusBusMap map = modbusBusMap;
+    const ModbusDeviceType type = probeAddress(&sensorBus, address);
+    if (type == MODBUS_DEVICE_PZEM016)
+    {
+        adoptPzem(&map, address, answering);
+    }
+    else if (type == MODBUS_DEVICE_ES35SW && es35swBreaker.state != BREAKER_CLOSED)
+    {
+        map.es35sw = address;
+    }
+    if (memcmp(&map, &modbusBusMap, sizeof(map)) != 0)
+    {
+        Serial.printf("[DISCOVERY] adopted %s at 0x%02X\n", ModbusDiscovery_typeName(type), address);
+        modbusBusMap = map;
+        saveMap(&modbusBusMap);
+        printMap(&modbusBusMap);
+        applyMap(&modbusBusMap);
+        adoptedThisPass = true;
+    }
+
+    if (address >= DISCOVERY_LAST_ADDRESS)
+    {
+        nextAddress = DISCOVERY_FIRST_ADDRESS;
+        resting = !adoptedThisPass;
+        restStartMs = millis();
+        adoptedThisPass = false;
+    }
+    else
+    {
+        nextAddress = address + 1;
+    }
+}
+
+/**
+ * @brief Printable name of a device type.
+ */
+const char *ModbusDiscovery_typeName(ModbusDeviceType type)
+{
+    switch (type)
+    {
+    case MODBUS_DEVICE_NONE:
+        return "none";
+    case MODBUS_DEVICE_PZEM016:
+        return "PZEM016T";
+    case MODBUS_DEVICE_ES35SW:
+        return "ES35-SW";
+    case MODBUS_DEVICE_LEAK:
+        return "MD0630T01A";
+    case MODBUS_DEVICE_UNKNOWN:
+        return "unknown";
+    }
+    return "?";
+}
@@ -0,0 +1,101 @@
+/**
+ * @file ModbusDiscovery.h
+ * @brief Modbus slave discovery: address scan, device identification and a bus map persisted in NVS.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef MODBUS_DISCOVERY_H
+#define MODBUS_DISCOVERY_H
+
+#include <Arduino.h>
+#include "RS485_Bus.h"
+#include "PZEM016_Lib.h"
+#include "ES35-SW.h"
+#include "MD0630T01A_LeakSensor.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifndef MODBUS_DISCOVERY_FORCE
+#define MODBUS_DISCOVERY_FORCE 0 // 1: full scan at every boot, ignoring the saved bus map
+#endif
+
+#define DISCOVERY_FIRST_ADDRESS 1      // First address scanned
+#define DISCOVERY_LAST_ADDRESS 32      // Last address scanned (Modbus allows 247; the cart uses the low range)
+#define DISCOVERY_PROBE_TIMEOUT_MS 30  // Presence probe timeout: 7-byte answer (8 ms) + slave latency
+#define DISCOVERY_IDLE_PASS_MS 600000  // Pause between background passes that found nothing new
+#define DISCOVERY_MAP_VERSION 1        // Layout version of the map stored in NVS
+
+    /**
+     * @brief Device type recognized from its register layout.
+     */
+    typedef enum
+    {
+        MODBUS_DEVICE_NONE = 0, ///< No answer
+        MODBUS_DEVICE_PZEM016,  ///< FC 0x04 measurement block 0..9, holding register 0x0002 = own address
+        MODBUS_DEVICE_ES35SW,   ///< FC 0x03 temperature/humidity 0..1, holding register 0x64 = own address
+        MODBUS_DEVICE_LEAK,     ///< FC 0x04 current/threshold block 0..3 (leakage sensor bus)
+        MODBUS_DEVICE_UNKNOWN   ///< Answers, but matches no known layout
+    } ModbusDeviceType;
+
+    /**
+     * @brief Socket-to-address map of both buses, as stored in NVS.
+     */
+    typedef struct
+    {
+        uint8_t version;           ///< DISCOVERY_MAP_VERSION
+        uint8_t pzem[NUM_DEVICES]; ///< Address of the PZEM016T of each socket
+        uint8_t es35sw;            ///< Address of the ES35-SW
+        uint8_t leak;              ///< Address of the leakage sensor
+    } ModbusBusMap;
+
+    /**
+     * @brief Statistics of the last full scan.
+     */
+    typedef struct
+    {
+        uint32_t durationMs; ///< Wall time of the scan
+        uint16_t probes;     ///< Addresses probed
+        uint8_t found;       ///< Devices identified
+    } ModbusScanStats;
+
+    extern ModbusBusMap modbusBusMap; // Map in use by the drivers
+
+    /**
+     * @brief Load the bus map from NVS and apply it; if there is none (or MODBUS_DISCOVERY_FORCE),
+     *        scan both buses first and save the result. Call after the drivers' init functions
+     *        and before the acquisition tasks start.
+     */
+    extern void ModbusDiscovery_init(void);
+
+    /**
+     * @brief Scan both buses and merge what was found into @p map (see ModbusDiscovery.cpp for the rules).
+     * @return true if @p map changed.
+     */
+    extern bool ModbusDiscovery_scan(ModbusBusMap *map, ModbusScanStats *stats);
+
+    /**
+     * @brief Background step for the acquisition task: while a socket or the ES35-SW has no answering
+     *        slave, probe one unmapped address of the sensor bus per call and adopt a matching device
+     *        (a PZEM016T only when exactly one socket is silent).
+     */
+    extern void ModbusDiscovery_step(void);
+
+    /**
+     * @brief Identify the device at @p address.
+     */
+    extern ModbusDeviceType ModbusDiscovery_identify(Rs485Bus *bus, uint8_t address);
+
+    /**
+     * @brief Printable name of a device type.
+     */
+    extern const char *ModbusDiscovery_typeName(ModbusDeviceType type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MODBUS_DISCOVERY_H
@@ -0,0 +1,256 @@
+/**
+ * @file ModbusRtu.h
+ * @brief Header-only Modbus-RTU codec: request builders, response checks and exception decoding
+ *        into caller-provided buffers, with a CRC16 lookup table generated at compile time.
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * No allocation and no Arduino dependency, so the same code runs in the firmware and on the host.
+ * Every parser takes the received length and the capacity of its output, and never reads or
+ * writes past either, whatever bytes a noisy line delivers. Requires C++17 (inline variables,
+ * constexpr loops).
+ */
+
+#ifndef MODBUS_RTU_H
+#define MODBUS_RTU_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MODBUS_RTU_MAX_FRAME 256        // Maximum Modbus-RTU frame length
+#define MODBUS_RTU_READ_REQUEST_LEN 8   // addr + fc + start(2) + count(2) + crc(2)
+#define MODBUS_RTU_WRITE_SINGLE_LEN 8   // addr + fc + register(2) + value(2) + crc(2), request and echo
+#define MODBUS_RTU_EXCEPTION_LEN 5      // addr + fc|0x80 + code + crc(2)
+#define MODBUS_RTU_MAX_READ_COUNT 125   // Register limit of one FC 0x03/0x04 read
+#define MODBUS_FC_READ_HOLDING 0x03     // Read holding registers
+#define MODBUS_FC_READ_INPUT 0x04       // Read input registers
+#define MODBUS_FC_WRITE_SINGLE 0x06     // Write single register
+#define MODBUS_EXCEPTION_FLAG 0x80      // Set in the function code of an exception response
+
+/**
+ * @brief Result of checking a received frame.
+ */
+typedef enum
+{
+    MODBUS_RTU_OK = 0,         ///< Well-formed normal response
+    MODBUS_RTU_TRUNCATED,      ///< Too short to be a frame, or shorter than its byte count says
+    MODBUS_RTU_CRC_ERROR,      ///< CRC mismatch
+    MODBUS_RTU_FRAME_ERROR,    ///< Wrong address, function, byte count or length
+    MODBUS_RTU_EXCEPTION       ///< Valid exception response, code in *exceptionCode
+} ModbusRtuResult;
+
+/**
+ * @brief 256-entry table of the reflected CRC16 polynomial 0xA001.
+ */
+struct ModbusRtuCrcTable
+{
+    uint16_t entry[256];
+};
+
+/**
+ * @brief Generate the CRC table (evaluated by the compiler).
+ */
+constexpr ModbusRtuCrcTable ModbusRtu_makeCrcTable()
+{
+    ModbusRtuCrcTable table = {};
+    for (uint16_t i = 0; i < 256; i++)
+    {
+        uint16_t crc = i;
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x0001) ? (uint16_t)((crc >> 1) ^ 0xA001) : (uint16_t)(crc >> 1);
+        }
+        table.entry[i] = crc;
+    }
+    return table;
+}
+
+inline constexpr ModbusRtuCrcTable MODBUS_RTU_CRC_TABLE = ModbusRtu_makeCrcTable(); // In flash, one copy per image
+
+static_assert(MODBUS_RTU_CRC_TABLE.entry[0x01] == 0xC0C1 && MODBUS_RTU_CRC_TABLE.entry[0xFF] == 0x4040,
+              "Modbus CRC16 table mismatch");
+
+/**
+ * @brief Modbus-RTU CRC16 (poly 0xA001, init 0xFFFF), one table lookup per byte.
+ */
+constexpr uint16_t ModbusRtu_crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = (uint16_t)((crc >> 8) ^ MODBUS_RTU_CRC_TABLE.entry[(crc ^ data[i]) & 0xFF]);
+    }
+    return crc;
+}
+
+/**
+ * @brief Append the CRC of the first @p len bytes of @p frame (low byte first).
+ * @return Frame length including the CRC.
+ */
+inline size_t ModbusRtu_appendCrc(uint8_t *frame, size_t len)
+{
+    const uint16_t crc = ModbusRtu_crc16(frame, len);
+    frame[len] = (uint8_t)(crc & 0xFF);
+    frame[len + 1] = (uint8_t)(crc >> 8);
+    return len + 2;
+}
+
+/**
+ * @brief Length of a normal response to a read of @p count registers.
+ */
+constexpr uint16_t ModbusRtu_readResponseLen(uint16_t count)
+{
+    return (uint16_t)(5 + 2 * count); // addr + fc + byte count + data + crc(2)
+}
+
+/**
+ * @brief Build an FC 0x03/0x04 read request.
+ * @return Frame length, or 0 if @p cap is too small or @p count is outside 1..125.
+ */
+inline size_t ModbusRtu_buildReadRequest(uint8_t *frame, size_t cap, uint8_t slave, uint8_t function,
+                                         uint16_t start, uint16_t count)
+{
+    if (cap < MODBUS_RTU_READ_REQUEST_LEN || count == 0 || count > MODBUS_RTU_MAX_READ_COUNT)
+    {
+        return 0;
+    }
+    frame[0] = slave;
+    frame[1] = function;
+    frame[2] = (uint8_t)(start >> 8);
+    frame[3] = (uint8_t)(start & 0xFF);
+    frame[4] = (uint8_t)(count >> 8);
+    frame[5] = (uint8_t)(count & 0xFF);
+    return ModbusRtu_appendCrc(frame, 6);
+}
+
+/**
+ * @brief Build an FC 0x06 write-single-register request.
+ * @return Frame length, or 0 if @p cap is too small.
+ */
+inline size_t ModbusRtu_buildWriteSingleRequest(uint8_t *frame, size_t cap, uint8_t slave, uint16_t reg, uint16_t value)
+{
+    if (cap < MODBUS_RTU_WRITE_SINGLE_LEN)
+    {
+        return 0;
+    }
+    frame[0] = slave;
+    frame[1] = MODBUS_FC_WRITE_SINGLE;
+    frame[2] = (uint8_t)(reg >> 8);
+    frame[3] = (uint8_t)(reg & 0xFF);
+    frame[4] = (uint8_t)(value >> 8);
+    frame[5] = (uint8_t)(value & 0xFF);
+    return ModbusRtu_appendCrc(frame, 6);
+}
+
+/**
+ * @brief Check CRC, address and function of a response, and decode an exception response.
+ * @param exceptionCode Receives the exception code for MODBUS_RTU_EXCEPTION (may be NULL).
+ */
+inline ModbusRtuResult ModbusRtu_checkResponse(const uint8_t *frame, size_t len, uint8_t slave, uint8_t function,
+                                               uint8_t *exceptionCode)
+{
+    if (len < MODBUS_RTU_EXCEPTION_LEN)
+    {
+        return MODBUS_RTU_TRUNCATED;
+    }
+    if (len > MODBUS_RTU_MAX_FRAME)
+    {
+        return MODBUS_RTU_FRAME_ERROR;
+    }
+    if (ModbusRtu_crc16(frame, len - 2) != (uint16_t)(frame[len - 2] | (frame[len - 1] << 8)))
+    {
+        return MODBUS_RTU_CRC_ERROR;
+    }
+    if (frame[0] != slave || (uint8_t)(frame[1] & ~MODBUS_EXCEPTION_FLAG) != function)
+    {
+        return MODBUS_RTU_FRAME_ERROR;
+    }
+    if (frame[1] & MODBUS_EXCEPTION_FLAG)
+    {
+        if (len != MODBUS_RTU_EXCEPTION_LEN)
+        {
+            return MODBUS_RTU_FRAME_ERROR;
+        }
+        if (exceptionCode != NULL)
+        {
+            *exceptionCode = frame[2];
+        }
+        return MODBUS_RTU_EXCEPTION;
+    }
+    return MODBUS_RTU_OK;
+}
+
+/**
+ * @brief Check a read response and copy its 2 * @p count raw big-endian data bytes.
+ * @param data        Destination, written only if the whole frame is valid.
+ * @param dataCap     Size of @p data; a response that does not fit is a frame error.
+ * @param exceptionCode Receives the exception code for MODBUS_RTU_EXCEPTION (may be NULL).
+ */
+inline ModbusRtuResult ModbusRtu_parseReadResponse(const uint8_t *frame, size_t len, uint8_t slave, uint8_t function,
+                                                   uint16_t count, uint8_t *data, size_t dataCap,
+                                                   uint8_t *exceptionCode)
+{
+    const ModbusRtuResult result = ModbusRtu_checkResponse(frame, len, slave, function, exceptionCode);
+    if (result != MODBUS_RTU_OK)
+    {
+        return result;
+    }
+    const size_t byteCount = frame[2];
+    if (byteCount + 5 > len)
+    {
+        return MODBUS_RTU_TRUNCATED;
+    }
+    if (byteCount != 2u * count || len != ModbusRtu_readResponseLen(count) || byteCount > dataCap)
+    {
+        return MODBUS_RTU_FRAME_ERROR;
+    }
+    memcpy(data, &frame[3], byteCount);
+    return MODBUS_RTU_OK;
+}
+
+/**
+ * @brief Check the response to an FC 0x06 request: a normal response echoes the request exactly.
+ * @param exceptionCode Receives the exception code for MODBUS_RTU_EXCEPTION (may be NULL).
+ */
+inline ModbusRtuResult ModbusRtu_checkWriteSingleResponse(const uint8_t *frame, size_t len, const uint8_t *request,
+                                                          uint8_t *exceptionCode)
+{
+    const ModbusRtuResult result = ModbusRtu_checkResponse(frame, len, request[0], MODBUS_FC_WRITE_SINGLE, exceptionCode);
+    if (result != MODBUS_RTU_OK)
+    {
+        return result;
+    }
+    if (len != MODBUS_RTU_WRITE_SINGLE_LEN || memcmp(frame, request, MODBUS_RTU_WRITE_SINGLE_LEN) != 0)
+    {
+        return MODBUS_RTU_FRAME_ERROR;
+    }
+    return MODBUS_RTU_OK;
+}
+
+/**
+ * @brief Printable name of a Modbus exception code.
+ */
+inline const char *ModbusRtu_exceptionName(uint8_t code)
+{
+    switch (code)
+    {
+    case 0x01:
+        return "illegal function";
+    case 0x02:
+        return "illegal data address";
+    case 0x03:
+        return "illegal data value";
+    case 0x04:
+        return "slave device failure";
+    case 0x05:
+        return "acknowledge";
+    case 0x06:
+        return "slave device busy";
+    case 0x0B:
+        return "gateway target failed to respond";
+    }
+    return "unknown exception";
+}
+
+#endif // MODBUS_RTU_H
@@ -0,0 +1,80 @@
+/**
+ * @file ModbusTelemetry.h
+ * @brief Per-slave Modbus transaction counters and fixed-bucket latency histogram.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef MODBUS_TELEMETRY_H
+#define MODBUS_TELEMETRY_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TELEMETRY_LATENCY_BUCKETS 10 // Histogram buckets, the last one is open-ended
+#define TELEMETRY_EXCEPTION_CODES 5  // Exception counters: [0] = other code, [1..4] = codes 0x01..0x04
+
+    /**
+     * @brief Upper bound (ms, inclusive) of every latency bucket except the last.
+     */
+    extern const uint16_t TELEMETRY_BUCKET_UPPER_MS[TELEMETRY_LATENCY_BUCKETS - 1];
+
+    /**
+     * @brief How a transaction ended, as seen by the bus.
+     */
+    typedef enum
+    {
+        TELEMETRY_OK = 0,      ///< Valid response
+        TELEMETRY_TIMEOUT,     ///< No response
+        TELEMETRY_CRC_ERROR,   ///< Response CRC mismatch
+        TELEMETRY_FRAME_ERROR, ///< Wrong address, function, length or a truncated frame
+        TELEMETRY_EXCEPTION    ///< Modbus exception response
+    } TelemetryOutcome;
+
+    /**
+     * @brief Counters of one slave. Only the bus worker writes them; readers may see a
+     *        transaction half-recorded, which is harmless for diagnostics.
+     */
+    typedef struct
+    {
+        uint32_t ok;          ///< Valid responses
+        uint32_t timeouts;    ///< No response
+        uint32_t crcErrors;   ///< CRC mismatches
+        uint32_t frameErrors; ///< Malformed responses
+        uint32_t exceptions;  ///< Exception responses
+        uint32_t rejected;    ///< Valid responses whose values the driver rejected as out of range
+        uint32_t exceptionCodes[TELEMETRY_EXCEPTION_CODES]; ///< Exception responses by code
+        uint32_t latency[TELEMETRY_LATENCY_BUCKETS];        ///< Bus time of answered transactions
+        uint32_t maxLatencyUs; ///< Longest answered transaction (us)
+    } SlaveTelemetry;
+
+    /**
+     * @brief Histogram bucket of a bus time.
+     */
+    extern uint8_t Telemetry_bucketOf(uint32_t busTimeUs);
+
+    /**
+     * @brief Count one transaction. Timeouts are not put in the histogram: their bus time is the timeout.
+     * @param exceptionCode Modbus exception code, used only for TELEMETRY_EXCEPTION.
+     */
+    extern void Telemetry_record(SlaveTelemetry *t, TelemetryOutcome outcome, uint32_t busTimeUs, uint8_t exceptionCode);
+
+    /**
+     * @brief Count a response whose decoded values failed the driver's range check.
+     */
+    extern void Telemetry_recordRejected(SlaveTelemetry *t);
+
+    /**
+     * @brief Transactions counted so far.
+     */
+    extern uint32_t Telemetry_total(const SlaveTelemetry *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MODBUS_TELEMETRY_H
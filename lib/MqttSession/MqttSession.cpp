@@ -0,0 +1,63 @@
+/**
+ * @file MqttSession.cpp
+ * @brief Implementation of the non-blocking MQTT connection manager.
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * @details The manager has no dependency on PubSubClient: the client is reached through
+ *          MqttSessionDriver, so the backoff can be tested on a host, against a fake client or a
+ *          real broker.
+ */
+
+#include "MqttSession.h"
+#include <stdio.h>
+#include <string.h>
+
+void MqttSession_init(MqttSession *session, const uint8_t mac[6], const MqttSessionDriver *driver)
+{
+    memset(session, 0, sizeof(*session));
+    snprintf(session->clientId, sizeof(session->clientId), MQTT_CLIENT_ID_PREFIX "%02X%02X%02X%02X%02X%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    session->driver = *driver;
+    session->backoffMs = MQTT_BACKOFF_MIN_MS;
+    session->nextAttemptMs = driver->millis();
+}
+
+bool MqttSession_tick(MqttSession *session)
+{
+    if (session->driver.connected())
+    {
+        session->driver.loop();
+        return true;
+    }
+
+    const uint32_t start = session->driver.millis();
+    if ((int32_t)(start - session->nextAttemptMs) < 0)
+    {
+        return false; // Backoff not expired
+    }
+
+    session->stats.attempts++;
+    const bool ok = session->driver.connect(session->clientId);
+    const uint32_t end = session->driver.millis();
+    session->stats.lastState = session->driver.state();
+
+    if (ok)
+    {
+        const uint32_t latency = end - start;
+        session->stats.connects++;
+        session->stats.lastConnectLatencyMs = latency;
+        if (latency > session->stats.maxConnectLatencyMs)
+        {
+            session->stats.maxConnectLatencyMs = latency;
+        }
+        session->backoffMs = MQTT_BACKOFF_MIN_MS;
+        return true;
+    }
+
+    // Wait backoff/2 plus a random jitter in [0, backoff/2] so that devices do not reconnect in step
+    session->stats.failures++;
+    session->nextAttemptMs = end + session->backoffMs / 2 + session->driver.random(session->backoffMs / 2 + 1);
+    session->backoffMs = (session->backoffMs * 2 > MQTT_BACKOFF_MAX_MS) ? MQTT_BACKOFF_MAX_MS : session->backoffMs * 2;
+    return false;
+}
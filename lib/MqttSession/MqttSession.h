@@ -0,0 +1,75 @@
+/**
+ * @file MqttSession.h
+ * @brief Non-blocking MQTT connection manager: one connect attempt per tick, exponential backoff
+ *        with jitter, clientId derived from the MAC address.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef MQTT_SESSION_H
+#define MQTT_SESSION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define MQTT_BACKOFF_MIN_MS 1000      // Backoff after the first failed attempt
+#define MQTT_BACKOFF_MAX_MS 60000     // Backoff upper bound
+#define MQTT_CLIENT_ID_PREFIX "ESP32Client-" // Followed by the 12 hex digits of the MAC
+
+    /**
+     * @brief Connection statistics.
+     */
+    typedef struct
+    {
+        uint32_t attempts;             ///< Connect attempts
+        uint32_t failures;             ///< Failed attempts
+        uint32_t connects;             ///< Successful attempts
+        uint32_t lastConnectLatencyMs; ///< Duration of the last successful attempt
+        uint32_t maxConnectLatencyMs;  ///< Longest successful attempt
+        int lastState;                 ///< Client state code after the last attempt (PubSubClient codes)
+    } MqttSessionStats;
+
+    /**
+     * @brief Client hooks. On the target they wrap PubSubClient, millis() and random().
+     */
+    typedef struct
+    {
+        bool (*connected)(void);
+        bool (*connect)(const char *clientId); ///< One attempt with cleanSession = false, bounded by the socket timeout
+        int (*state)(void);
+        void (*loop)(void);           ///< Service the connection while connected
+        uint32_t (*millis)(void);
+        uint32_t (*random)(uint32_t bound); ///< Uniform in [0, bound)
+    } MqttSessionDriver;
+
+    typedef struct
+    {
+        char clientId[32];       ///< Stable across reconnects and reboots, so the broker keeps the session
+        MqttSessionDriver driver;
+        uint32_t backoffMs;      ///< Backoff applied after the next failure
+        uint32_t nextAttemptMs;  ///< No attempt before this time
+        MqttSessionStats stats;
+    } MqttSession;
+
+    /**
+     * @brief Initialize the manager and build the clientId from @p mac. Nothing is attempted until
+     *        the first MqttSession_tick().
+     */
+    extern void MqttSession_init(MqttSession *session, const uint8_t mac[6], const MqttSessionDriver *driver);
+
+    /**
+     * @brief Service the connection, or make at most one connect attempt if the backoff has expired.
+     * @return true if connected.
+     */
+    extern bool MqttSession_tick(MqttSession *session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MQTT_SESSION_H
@@ -8,13 +8,9 @@
 
 #include <PZEM016_Lib.h>
 
-float lastPZEMVoltage[NUM_DEVICES] = {0}; // Store last voltage readings for each PZEM016T sensor
-float lastPZEMCurrent[NUM_DEVICES] = {0}; // Store last current readings for each PZEM016T sensor
-float lastPZEMPower[NUM_DEVICES] = {0};   // Store last power readings for each PZEM016T sensor
-float lastPZEMFreq[NUM_DEVICES] = {0};    // Store last frequency readings for each PZEM016T sensor
-float lastPZEMPF[NUM_DEVICES] = {0};      // Store last power factor readings for each PZEM016T sensor
+int32_t lastPZEM[NUM_DEVICES][PZEM_CH_COUNT] = {}; // Last published raw value of each channel (PZEM_CHANNEL)
 
-float pzemVoltageCalib[NUM_DEVICES] = {0}; // Calibration offsets for each PZEM016T sensor
+Voltage pzemVoltageCalib[NUM_DEVICES] = {}; // Calibration offsets for each PZEM016T sensor
 
 bool overVoltage[NUM_DEVICES] = {false};     // Array to hold over-voltage state for each PZEM016T sensor
 bool overCurrent[NUM_DEVICES] = {false};     // Array to hold over-current state for each PZEM016T sensor
@@ -22,14 +18,9 @@ bool overPower[NUM_DEVICES] = {false};       // Array to hold over-power state f
 bool underVoltage[NUM_DEVICES] = {false};    // Array to hold under-voltage state for each PZEM016T sensor
 bool socketState[NUM_DEVICES] = {false}; // Array to hold power lost state for each PZEM016T sensor
 
-// Initialize PZEM016T sensors with different addresses
-PZEM004Tv30 pzems[NUM_DEVICES] = {
-    PZEM004Tv30(PZEM_SERIAL, PZEM_RX_PIN, PZEM_TX_PIN, 0x01),
-    PZEM004Tv30(PZEM_SERIAL, PZEM_RX_PIN, PZEM_TX_PIN, 0x02),
-    PZEM004Tv30(PZEM_SERIAL, PZEM_RX_PIN, PZEM_TX_PIN, 0x03),
-    PZEM004Tv30(PZEM_SERIAL, PZEM_RX_PIN, PZEM_TX_PIN, 0x04),
-    PZEM004Tv30(PZEM_SERIAL, PZEM_RX_PIN, PZEM_TX_PIN, 0x05),
-    PZEM004Tv30(PZEM_SERIAL, PZEM_RX_PIN, PZEM_TX_PIN, 0x06)};
+// Modbus address of each PZEM016T sensor on the shared RS485 bus.
+// Factory layout; replaced at boot by the saved or discovered bus map (ModbusDiscovery)
+uint8_t pzemAddresses[NUM_DEVICES] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06};
 
 // Array to store PZEM016T sensor data
 PZEMData sensorData[NUM_DEVICES];
@@ -37,6 +28,10 @@ PZEMData sensorData[NUM_DEVICES];
 // Array to count read failures for each PZEM016T sensor
 uint8_t readFailCount[NUM_DEVICES] = {0};
 
+// Circuit breaker of each PZEM016T slave: a socket without power stops answering,
+// so after a few timeouts it is only probed at a growing interval
+CircuitBreaker pzemBreakers[NUM_DEVICES];
+
 // Define name of devices for each PZEM016T sensor
 // These names are used for identification and debugging purposes.
 const char *SOCKET_NAMES[NUM_DEVICES] = {
@@ -54,7 +49,56 @@ const char *SOCKET_NAMES[NUM_DEVICES] = {
  */
 void PZEM016_init(void)
 {
-    PZEM_SERIAL.begin(9600, SERIAL_8N1, PZEM_RX_PIN, PZEM_TX_PIN);
+    RS485Bus_init(&sensorBus, "sensor", &PZEM_SERIAL, PZEM_BAUD_RATE, PZEM_RX_PIN, PZEM_TX_PIN);
+    for (int i = 0; i < NUM_DEVICES; i++)
+    {
+        Breaker_init(&pzemBreakers[i]);
+    }
+}
+
+/**
+ * @brief Decode the 20-byte register block of a PZEM016T response into PZEMData.
+ *
+ * @details Registers are big-endian; 32-bit values are sent low word first.
+ *          Scaling: voltage 0.1 V, current 0.001 A, power 0.1 W, energy 1 Wh, frequency 0.1 Hz, PF 0.01.
+ *          The register values are kept as they are: the types of PZEMData carry the scale.
+ */
+void PZEM016_decodeMeasurements(const uint8_t *regs, PZEMData *out)
+{
+    uint16_t r[PZEM_REG_COUNT];
+    for (int k = 0; k < PZEM_REG_COUNT; k++)
+    {
+        r[k] = ((uint16_t)regs[2 * k] << 8) | regs[2 * k + 1];
+    }
+
+    out->voltage = Voltage::fromRaw(r[0]);
+    out->current = Current::fromRaw((int32_t)((uint32_t)r[1] | ((uint32_t)r[2] << 16)));
+    out->power = Power::fromRaw((int32_t)((uint32_t)r[3] | ((uint32_t)r[4] << 16)));
+    out->energy = Energy::fromRaw((int32_t)((uint32_t)r[5] | ((uint32_t)r[6] << 16)));
+    out->frequency = Frequency::fromRaw(r[7]);
+    out->pf = PowerFactor::fromRaw(r[8]);
+    out->alarm = (r[9] == PZEM_ALARM_ON);
+}
+
+/**
+ * @brief Read all measurement registers of one PZEM016T in a single FC 0x04 transaction.
+ *
+ * @details Registers 0x0000..0x0009 are fetched in one frame through the shared sensor bus,
+ *          which serializes this with ES35-SW traffic and enforces the inter-frame gap.
+ */
+bool PZEM016_readMeasurements(uint8_t address, PZEMData *out)
+{
+    uint8_t regs[2 * PZEM_REG_COUNT];
+    if (RS485Bus_readRegisters(&sensorBus, address, PZEM_CMD_READ_INPUT, PZEM_REG_START, PZEM_REG_COUNT,
+                               "pzem.measure", regs) != RS485_OK)
+    {
+        out->valid = false;
+        return false;
+    }
+
+    PZEM016_decodeMeasurements(regs, out);
+    out->valid = true;
+    return true;
 }
 
 /**
@@ -73,17 +117,47 @@ bool areAllSocketsPowerLost()
     return true; // Tất cả thiết bị đều mất nguồn - true
 }
 
+// Valid range of each measurement
+FILTER_LIMITS(PzemVoltageLimits, Voltage, PZEM_VOLTAGE_MIN, PZEM_VOLTAGE_MAX);
+FILTER_LIMITS(PzemCurrentLimits, Current, PZEM_CURRENT_MIN, PZEM_CURRENT_MAX);
+FILTER_LIMITS(PzemPowerLimits, Power, PZEM_POWER_MIN, PZEM_POWER_MAX);
+FILTER_LIMITS(PzemFrequencyLimits, Frequency, PZEM_FREQUENCY_MIN, PZEM_FREQUENCY_MAX);
+FILTER_LIMITS(PzemPfLimits, PowerFactor, PZEM_PF_MIN, PZEM_PF_MAX);
+
+// Filter pipeline of each channel type. Stages run left to right; add a stage here (e.g.
+// Ema<PowerFactor, 1, 4> on a noisy PF) and the driver code does not change. The change gate stays
+// in handlePZEMSensors(), where it depends on warm-up and on the voltage reference socket.
+typedef Pipeline<RangeCheck<PzemVoltageLimits>, Median<Voltage, PZEM_MEDIAN_WINDOW>> PzemVoltagePipeline;
+typedef Pipeline<RangeCheck<PzemCurrentLimits>, Median<Current, PZEM_MEDIAN_WINDOW>> PzemCurrentPipeline;
+typedef Pipeline<RangeCheck<PzemPowerLimits>, Median<Power, PZEM_MEDIAN_WINDOW>> PzemPowerPipeline;
+typedef Pipeline<RangeCheck<PzemFrequencyLimits>, Median<Frequency, PZEM_MEDIAN_WINDOW>> PzemFrequencyPipeline;
+typedef Pipeline<RangeCheck<PzemPfLimits>, Median<PowerFactor, PZEM_MEDIAN_WINDOW>> PzemPfPipeline;
+
 /**
- * @brief Apply a median filter to an array of float data.
+ * @brief U x I in 0.1 W, rounded to the nearest step (0.1 V x 0.001 A = 0.0001 W).
+ *
+ * @details 64-bit product: the current register is 32 bits wide. An out-of-range result saturates,
+ *          so the power range check still rejects it.
  */
-float applyMedianFilter(float *data, int size)
+Power PZEM016_apparentPower(Voltage U, Current I)
 {
-    float sortedData[size];
-    memcpy(sortedData, data, size * sizeof(float)); // Copy data to avoid modifying the original array
-    std::sort(sortedData, sortedData + size);       // Sort the copied array
-    return sortedData[size / 2];                    // Return the median value
+    const int64_t steps = ((int64_t)U.raw * I.raw + 500) / 1000;
+    return Power::fromRaw(steps > INT32_MAX ? INT32_MAX : (int32_t)steps);
 }
 
+/**
+ * @brief Filter state of one socket. A read updates all five channels of one socket, so they are
+ *        kept next to each other rather than in one array per channel.
+ */
+struct PzemChannels
+{
+    PzemVoltagePipeline voltage;
+    PzemCurrentPipeline current;
+    PzemPowerPipeline power;
+    PzemFrequencyPipeline frequency;
+    PzemPfPipeline pf;
+};
+
 /**
  * @brief Read data from the i-th PZEM016T sensor.
  *
@@ -99,46 +173,65 @@ void readPZEM(uint8_t i)
         return;
     }
 
-    // Static variables for Median Filter
-    static float voltageHistory[NUM_DEVICES][5] = {0};
-    static float currentHistory[NUM_DEVICES][5] = {0};
-    static float powerHistory[NUM_DEVICES][5] = {0};
-    static float frequencyHistory[NUM_DEVICES][5] = {0};
-    static float pfHistory[NUM_DEVICES][5] = {0};
-
-    // Read data from the sensor
-    float U = pzems[i].voltage();
-    float I = pzems[i].current();
-    float P = (i == AUO_DISPLAY) ? pzems[i].power() : U * I;
-    float F = pzems[i].frequency();
-    float PF = pzems[i].pf();
-
-    // Check if the values are NaN (not a number)
-    if (isnan(U) || isnan(I) || isnan(P) || isnan(F) || isnan(PF))
+    // Filter pipelines, one PzemChannels per socket
+    static PzemChannels channels[NUM_DEVICES];
+
+    // Circuit breaker: skip a dead slave, or probe it with a single-register read before the full read
+    const BreakerDecision decision = Breaker_allow(&pzemBreakers[i], millis());
+    if (decision == BREAKER_SKIP)
     {
-        Serial.printf("Error: NaN detected for device %d. Skipping update.\n", i);
+        sensorData[i].valid = false; // Slave still considered dead, no bus traffic
+        return;
+    }
+    if (decision == BREAKER_PROBE)
+    {
+        uint8_t probe[2 * PZEM_PROBE_REG_COUNT];
+        if (RS485Bus_readRegisters(&sensorBus, pzemAddresses[i], PZEM_CMD_READ_INPUT, PZEM_REG_START,
+                                   PZEM_PROBE_REG_COUNT, "pzem.probe", probe) != RS485_OK)
+        {
+            Breaker_recordFailure(&pzemBreakers[i], millis());
+            sensorData[i].valid = false;
+            return;
+        }
+        Breaker_recordSuccess(&pzemBreakers[i]);
+        Serial.printf("Device %d answered the probe, resuming normal polling.\n", i);
+    }
+
+    // Read all measurement registers of the sensor in one transaction
+    PZEMData raw;
+    if (!PZEM016_readMeasurements(pzemAddresses[i], &raw))
+    {
+        Breaker_recordFailure(&pzemBreakers[i], millis());
+        Serial.printf("Error: No valid response from device %d. Skipping update.\n", i);
         sensorData[i].valid = false; // Mark data as invalid
         readFailCount[i]++;
         if (readFailCount[i] >= 5)
         {
-            Serial.printf("Warning: Device %d failed to read 5 times consecutively due to NaN sensor values.\n", i);
+            Serial.printf("Warning: Device %d failed to read 5 times consecutively due to no valid response.\n", i);
         }
         return;
     }
 
+    Breaker_recordSuccess(&pzemBreakers[i]);
+
+    const Voltage U = raw.voltage;
+    const Current I = raw.current;
+    const Power P = (i == AUO_DISPLAY) ? raw.power : PZEM016_apparentPower(U, I);
+    const Frequency F = raw.frequency;
+    const PowerFactor PF = raw.pf;
+
     // Check if the values are within the valid range
-    if (U < PZEM_VOLTAGE_MIN || U > PZEM_VOLTAGE_MAX ||
-        I < PZEM_CURRENT_MIN || I > PZEM_CURRENT_MAX ||
-        P < PZEM_POWER_MIN || P > PZEM_POWER_MAX ||
-        F < PZEM_FREQUENCY_MIN || F > PZEM_FREQUENCY_MAX ||
-        PF < PZEM_PF_MIN || PF > PZEM_PF_MAX)
+    // (checked for all channels before any filter state changes: one bad channel rejects the reading)
+    if (!PzemVoltagePipeline::accepts(U) || !PzemCurrentPipeline::accepts(I) || !PzemPowerPipeline::accepts(P) ||
+        !PzemFrequencyPipeline::accepts(F) || !PzemPfPipeline::accepts(PF))
     {
         Serial.printf("Out-of-range data from sensor (device %d): Voltage: %.2f (%.2f~%.2f), Current: %.2f (%.2f~%.2f), Power: %.2f (%.2f~%.2f), Frequency: %.2f (%.2f~%.2f), PF: %.2f (%.2f~%.2f)\n",
-                      i, U, PZEM_VOLTAGE_MIN, PZEM_VOLTAGE_MAX,
-                      I, PZEM_CURRENT_MIN, PZEM_CURRENT_MAX,
-                      P, PZEM_POWER_MIN, PZEM_POWER_MAX,
-                      F, PZEM_FREQUENCY_MIN, PZEM_FREQUENCY_MAX,
-                      PF, PZEM_PF_MIN, PZEM_PF_MAX);
+                      i, U.toFloat(), PZEM_VOLTAGE_MIN, PZEM_VOLTAGE_MAX,
+                      I.toFloat(), PZEM_CURRENT_MIN, PZEM_CURRENT_MAX,
+                      P.toFloat(), PZEM_POWER_MIN, PZEM_POWER_MAX,
+                      F.toFloat(), PZEM_FREQUENCY_MIN, PZEM_FREQUENCY_MAX,
+                      PF.toFloat(), PZEM_PF_MIN, PZEM_PF_MAX);
+        RS485Bus_recordRejected(&sensorBus, pzemAddresses[i]);
         sensorData[i].valid = false; // Mark data as invalid
         readFailCount[i]++;
         if (readFailCount[i] >= 5)
@@ -156,6 +249,8 @@ void readPZEM(uint8_t i)
         sensorData[i].power = P;
         sensorData[i].frequency = F;
         sensorData[i].pf = PF;
+        sensorData[i].energy = raw.energy;
+        sensorData[i].alarm = raw.alarm;
         sensorData[i].valid = true;
 
         // Reset failure count if data is valid
@@ -164,42 +259,13 @@ void readPZEM(uint8_t i)
         return;
     }
 
-    // Initialize history arrays with the first valid reading
-    static bool isHistoryInitialized[NUM_DEVICES] = {false};
-    if (!isHistoryInitialized[i])
-    {
-        for (int j = 0; j < 5; j++)
-        {
-            voltageHistory[i][j] = U;
-            currentHistory[i][j] = I;
-            powerHistory[i][j] = P;
-            frequencyHistory[i][j] = F;
-            pfHistory[i][j] = PF;
-        }
-        isHistoryInitialized[i] = true;
-    }
-
-    // Update history for Median Filter
-    for (int j = 4; j > 0; j--)
-    {
-        voltageHistory[i][j] = voltageHistory[i][j - 1];
-        currentHistory[i][j] = currentHistory[i][j - 1];
-        powerHistory[i][j] = powerHistory[i][j - 1];
-        frequencyHistory[i][j] = frequencyHistory[i][j - 1];
-        pfHistory[i][j] = pfHistory[i][j - 1];
-    }
-    voltageHistory[i][0] = U;
-    currentHistory[i][0] = I;
-    powerHistory[i][0] = P;
-    frequencyHistory[i][0] = F;
-    pfHistory[i][0] = PF;
-
-    // Apply Median Filter
-    float voltageMedian = applyMedianFilter(voltageHistory[i], 5);
-    float currentMedian = applyMedianFilter(currentHistory[i], 5);
-    float powerMedian = applyMedianFilter(powerHistory[i], 5);
-    float frequencyMedian = applyMedianFilter(frequencyHistory[i], 5);
-    float pfMedian = applyMedianFilter(pfHistory[i], 5);
+    // Apply the filter pipelines (the first valid reading fills the median windows)
+    PzemChannels &ch = channels[i];
+    const Voltage voltageMedian = ch.voltage.update(U).value;
+    const Current currentMedian = ch.current.update(I).value;
+    const Power powerMedian = ch.power.update(P).value;
+    const Frequency frequencyMedian = ch.frequency.update(F).value;
+    const PowerFactor pfMedian = ch.pf.update(PF).value;
 
     // Update sensor data after filtering
     sensorData[i].voltage = voltageMedian;
@@ -207,27 +273,11 @@ void readPZEM(uint8_t i)
     sensorData[i].power = powerMedian;
     sensorData[i].frequency = frequencyMedian;
     sensorData[i].pf = pfMedian;
+    sensorData[i].energy = raw.energy;
+    sensorData[i].alarm = raw.alarm;
     sensorData[i].valid = true;
 
     // Reset failure count if data is valid
     readFailCount[i] = 0;
 
-}
-
-/**
- * @brief Calculate the delta value for a given measurement.
- *
- * @param value The measured value.
- * @param accuracy_pct The desired accuracy as a percentage (e.g., 0.01 for 1%).
- * @param resolution The resolution of the measurement system.
- * @param sigma The process noise standard deviation.
- * @param F_u The sensitivity of the measurement system.
- * @param N_lsb The number of least significant bits.
- * @param delta_min The minimum delta value.
- * @return The calculated delta value.
- */
-float calculateDelta(float value, float accuracy_pct, float resolution, float sigma, float F_u, int N_lsb, float delta_min)
-{
-    float delta = F_u * (fabs(value) * accuracy_pct + sigma + N_lsb * resolution);
-    return (delta > delta_min) ? delta : delta_min;
 }
\ No newline at end of file
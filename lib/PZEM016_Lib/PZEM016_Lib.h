@@ -9,19 +9,46 @@
 #ifndef PZEM016_Lib_H
 #define PZEM016_Lib_H
 
-#include <PZEM004Tv30.h>
-#include <algorithm> // For std::sort
+#include <Arduino.h>
+#include "RS485_Bus.h"
+#include "CircuitBreaker.h"
+#include "FilterPipeline.h" // Per-channel filter pipelines of the measurements
+#include "FixedPoint.h"     // Measurements in register units
+
+// Measurements in the units of the PZEM016T registers (raw = register value)
+struct VoltageUnit;
+struct CurrentUnit;
+struct PowerUnit;
+struct EnergyUnit;
+struct FrequencyUnit;
+struct PowerFactorUnit;
+typedef Fixed<10, VoltageUnit> Voltage;          // 0.1 V
+typedef Fixed<1000, CurrentUnit> Current;        // 0.001 A
+typedef Fixed<10, PowerUnit> Power;              // 0.1 W
+typedef Fixed<1, EnergyUnit> Energy;             // 1 Wh
+typedef Fixed<10, FrequencyUnit> Frequency;      // 0.1 Hz
+typedef Fixed<100, PowerFactorUnit> PowerFactor; // 0.01
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
-// RX/TX pin for PZEM016T sensors
-#define PZEM_RX_PIN 17
-#define PZEM_TX_PIN 16
+// RX/TX pin for PZEM016T sensors (shared sensor bus, see RS485_Bus.h)
+#define PZEM_RX_PIN SENSOR_BUS_RX_PIN
+#define PZEM_TX_PIN SENSOR_BUS_TX_PIN
 
-#define PZEM_SERIAL Serial2 // Serial port for PZEM016T sensors
+#define PZEM_SERIAL SENSOR_BUS_SERIAL // Serial port for PZEM016T sensors
+#define PZEM_BAUD_RATE 9600 // Fixed baud rate of PZEM016T sensors
+
+// Modbus-RTU measurement block of PZEM016T (FC 0x04, input registers 0x0000..0x0009)
+#define PZEM_CMD_READ_INPUT 0x04    // Read input registers
+#define PZEM_REG_START 0x0000       // First measurement register (voltage)
+#define PZEM_REG_COUNT 10           // Voltage, current(2), power(2), energy(2), frequency, PF, alarm
+#define PZEM_ALARM_ON 0xFFFF        // Alarm register value when the power alarm is active
+#define PZEM_PROBE_REG_COUNT 1      // Registers read by a circuit-breaker probe (voltage only)
+#define PZEM_CMD_READ_HOLDING 0x03  // Read holding (parameter) registers
+#define PZEM_HOLD_REG_ADDRESS 0x0002 // Parameter register holding the slave's own Modbus address
 
 #define PZEM_VOLTAGE_MIN 80.0f  // V, define minimum valid voltage
 #define PZEM_VOLTAGE_MAX 260.0f // V, define maximum valid voltage
@@ -34,6 +61,8 @@ extern "C"
 #define PZEM_PF_MIN 0.0f        // Power Factor, define minimum valid power factor
 #define PZEM_PF_MAX 1.0f        // Power Factor, define maximum valid power factor
 
+#define PZEM_MEDIAN_WINDOW 5    // Samples in the median filter of each measurement
+
 // Delta calculation parameters (có thể chỉnh sửa cho từng loại cảm biến)
 #define PZEM_DELTA_FU         1.2f   // Hệ số an toàn
 #define PZEM_DELTA_N_LSB      1      // Số bậc LSB tối thiểu
@@ -67,7 +96,7 @@ extern "C"
 #define PZEM0_VOLTAGE_OFFSET 0.0f               // Giá trị hiệu chỉnh thủ công cho cảm biến gốc (PZEM1) 
 
 
-extern float pzemVoltageCalib[]; // Array to hold the calibration offsets for each PZEM016T sensor   
+extern Voltage pzemVoltageCalib[]; // Array to hold the calibration offsets for each PZEM016T sensor   
 
     // Define the PZEM016T sockets
     // These are the identifiers for each PZEM016T sensor socket.
@@ -86,13 +115,20 @@ extern float pzemVoltageCalib[]; // Array to hold the calibration offsets for ea
     // These names are used for identification and debugging purposes.
     extern const char *SOCKET_NAMES[NUM_DEVICES];
 
+    // Measurement channels checked for changes, in the order of the change-detection table
+    typedef enum
+    {
+        PZEM_CH_VOLTAGE = 0, // Voltage sent to the dashboard (Voltage)
+        PZEM_CH_CURRENT,     // Current
+        PZEM_CH_POWER,       // Power
+        PZEM_CH_FREQUENCY,   // Frequency
+        PZEM_CH_PF,          // PowerFactor
+        PZEM_CH_COUNT
+    } PZEM_CHANNEL;
+
     // Declear global variables for last readings
-    // These variables are used to store the last readings from each PZEM016T sensor for delta checking.
-    extern float lastPZEMVoltage[NUM_DEVICES];    // Store last voltage readings for each PZEM016T sensor
-    extern float lastPZEMCurrent[NUM_DEVICES];    // Store last current readings for each PZEM016T sensor
-    extern float lastPZEMPower[NUM_DEVICES];      // Store last power readings for each PZEM016T sensor
-    extern float lastPZEMFreq[NUM_DEVICES];       // Store last frequency readings for each PZEM016T sensor
-    extern float lastPZEMPF[NUM_DEVICES];         // Store last power factor readings for each PZEM016T sensor
+    // Last published raw register value of each channel of each PZEM016T sensor, for delta checking.
+    extern int32_t lastPZEM[NUM_DEVICES][PZEM_CH_COUNT];
 
     extern bool overVoltage[NUM_DEVICES]; // Array to hold over-voltage state for each PZEM016T sensor
     extern bool overCurrent[NUM_DEVICES]; // Array to hold over-current state for each PZEM016T sensor
@@ -104,26 +140,27 @@ extern float pzemVoltageCalib[]; // Array to hold the calibration offsets for ea
     // These thresholds are used to validate the readings from each PZEM016T sensor.
     typedef struct
     {
-        float voltage_min;   // Minimum voltage (V)
-        float voltage_max;   // Maximum voltage (V)
-        float current_min;   // Minimum current (A)
-        float current_max;   // Maximum current (A)
-        float power_min;     // Minimum power (W)
-        float power_max;     // Maximum power (W)
-        float frequency_min; // Minimum frequency (Hz)
-        float frequency_max; // Maximum frequency (Hz)
+        Voltage voltage_min;     // Minimum voltage (V)
+        Voltage voltage_max;     // Maximum voltage (V)
+        Current current_min;     // Minimum current (A)
+        Current current_max;     // Maximum current (A)
+        Power power_min;         // Minimum power (W)
+        Power power_max;         // Maximum power (W)
+        Frequency frequency_min; // Minimum frequency (Hz)
+        Frequency frequency_max; // Maximum frequency (Hz)
     } PZEM_Thresholds;
 
     // Set the thresholds for each PZEM016T sensor
     // These thresholds are used to validate the readings from each PZEM016T sensor.
     // [DEVICE_NAME] = {voltage_min, voltage_max, current_min, current_max, power_min, power_max, frequency_min, frequency_max}
+    // Values must lie on the register step (0.1 V, 0.001 A, 0.1 W, 0.1 Hz): power > 128.25 W is power > 128.2 W
     static const PZEM_Thresholds pzemThresholds[NUM_DEVICES] = {
-        [AUO_DISPLAY]       = {218.0f, 240.0f, 0.1f, 0.65f, 0.0f, 142.5f, 49.5f, 50.5f}, //P (W)
-        [CCU_IMAGE1_S]      = {218.0f, 240.0f, 0.01f, 0.534f, 0.0f, 128.25f, 49.5f, 50.5f},
-        [CCU_IMAGE_1_HUB]   = {218.0f, 240.0f, 0.01f, 0.38f, 0.0f, 91.2f, 49.5f, 50.5f}, 
-        [CCU_TRICAM_PAL]    = {218.0f, 240.0f, 0.01f, 0.237f, 0.0f, 57.0f, 49.5f, 50.5f},
-        [XENON_300]         = {218.0f, 240.0f, 0.01f, 1.78f, 0.0f, 427.5f, 49.5f, 50.5f},
-        [ENDOFLATOR_UI400]  = {218.0f, 240.0f, 0.01f, 1.52f, 0.0f, 364.8f, 49.5f, 50.5f}};
+        [AUO_DISPLAY]       = {Voltage(218.0), Voltage(240.0), Current(0.1), Current(0.65), Power(0.0), Power(142.5), Frequency(49.5), Frequency(50.5)}, //P (W)
+        [CCU_IMAGE1_S]      = {Voltage(218.0), Voltage(240.0), Current(0.01), Current(0.534), Power(0.0), Power(128.2), Frequency(49.5), Frequency(50.5)},
+        [CCU_IMAGE_1_HUB]   = {Voltage(218.0), Voltage(240.0), Current(0.01), Current(0.38), Power(0.0), Power(91.2), Frequency(49.5), Frequency(50.5)}, 
+        [CCU_TRICAM_PAL]    = {Voltage(218.0), Voltage(240.0), Current(0.01), Current(0.237), Power(0.0), Power(57.0), Frequency(49.5), Frequency(50.5)},
+        [XENON_300]         = {Voltage(218.0), Voltage(240.0), Current(0.01), Current(1.78), Power(0.0), Power(427.5), Frequency(49.5), Frequency(50.5)},
+        [ENDOFLATOR_UI400]  = {Voltage(218.0), Voltage(240.0), Current(0.01), Current(1.52), Power(0.0), Power(364.8), Frequency(49.5), Frequency(50.5)}};
 
     /**
      * @brief Struct to hold PZEM data.
@@ -132,19 +169,21 @@ extern float pzemVoltageCalib[]; // Array to hold the calibration offsets for ea
      */
     typedef struct
 {
-    float voltage;      ///< Voltage in V
-    float current;      ///< Current in A
-    float power;        ///< Power in W
-    float energy;       ///< Energy in Wh
-    float frequency;    ///< Frequency in Hz
-    float pf;           ///< Power factor
+    Voltage voltage;     ///< Voltage (0.1 V)
+    Current current;     ///< Current (0.001 A)
+    Power power;         ///< Power (0.1 W)
+    Energy energy;       ///< Energy (Wh)
+    Frequency frequency; ///< Frequency (0.1 Hz)
+    PowerFactor pf;      ///< Power factor (0.01)
+    bool alarm;         ///< true = power alarm active on the meter
     bool machineState;  ///< true = ON, false = OFF
     bool valid;         ///< true = data valid, false = invalid
 } PZEMData;
-    
-    extern PZEM004Tv30 pzems[NUM_DEVICES];     // Array of PZEM004Tv30 objects for each sensor
+
+    extern uint8_t pzemAddresses[NUM_DEVICES]; // Modbus address of each PZEM016T sensor (bus map from ModbusDiscovery)
     extern PZEMData sensorData[NUM_DEVICES];   // Array to hold data for each PZEM016T sensor
     extern uint8_t readFailCount[NUM_DEVICES]; // Array to count read failures for each sensor
+    extern CircuitBreaker pzemBreakers[NUM_DEVICES]; // Circuit breaker of each PZEM016T slave
 
     /**
      * @brief Initialize UART for PZEM016T sensors.
@@ -152,6 +191,21 @@ extern float pzemVoltageCalib[]; // Array to hold the calibration offsets for ea
      */
     extern void PZEM016_init(void);
 
+    /**
+     * @brief Read all measurement registers of one PZEM016T in a single FC 0x04 transaction.
+     * @param address Modbus address of the sensor.
+     * @param out Decoded voltage, current, power, energy, frequency, PF and alarm (valid is set on success).
+     * @return true if a complete response with valid CRC was received.
+     */
+    extern bool PZEM016_readMeasurements(uint8_t address, PZEMData *out);
+
+    /**
+     * @brief Decode the 20-byte register block of a PZEM016T response into PZEMData.
+     * @param regs Pointer to the data bytes (after the byte count field).
+     * @param out Destination for the decoded values.
+     */
+    extern void PZEM016_decodeMeasurements(const uint8_t *regs, PZEMData *out);
+
     /**
      * @brief Read data from the i-th PZEM016T sensor.
      * @param i Index of the sensor to read (0 to NUM_DEVICES-1).
@@ -164,30 +218,24 @@ extern float pzemVoltageCalib[]; // Array to hold the calibration offsets for ea
      */
     extern bool areAllSocketsPowerLost(); // Kiểm tra xem tất cả các thiết bị có đang mất nguồn không
 
-    /**
-     * @brief Apply a median filter to the data array.
-     * @param data Pointer to the array of float data to be filtered.
-     * @param size Size of the data array.
-     * @return The median value from the filtered data.
-     */
-    extern float applyMedianFilter(float *data, int size); // Hàm lọc trung vị
-
-    /**
-     * @brief Calculate the delta value for a given parameter.
-     * @param value Current value of the parameter.
-     * @param accuracy_pct Accuracy percentage of the sensor.
-     * @param resolution Resolution of the sensor.
-     * @param sigma Standard deviation of noise for the parameter.
-     * @param F_u Safety factor.
-     * @param N_lsb Minimum number of LSB steps.
-     * @param delta_min Minimum absolute delta threshold.
-     * @return Calculated delta value.
-     */
-    // Hàm tính delta cho từng thông số
-    float calculateDelta(float value, float accuracy_pct, float resolution, float sigma, float F_u, int N_lsb, float delta_min);
+    // Ngưỡng delta cho từng thông số, tính bằng số nguyên theo đơn vị thanh ghi (xem DeltaGate)
+    static constexpr DeltaGate<Voltage> pzemVoltageGate(PZEM_ACCURACY_VOLTAGE, PZEM_RESOLUTION_VOLTAGE, PZEM_SIGMA_VOLTAGE, PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_VOLTAGE_MIN);
+    static constexpr DeltaGate<Current> pzemCurrentGate(PZEM_ACCURACY_CURRENT, PZEM_RESOLUTION_CURRENT, PZEM_SIGMA_CURRENT, PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_CURRENT_MIN);
+    static constexpr DeltaGate<Power> pzemPowerGate(PZEM_ACCURACY_POWER, PZEM_RESOLUTION_POWER, PZEM_SIGMA_POWER, PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_POWER_MIN);
+    static constexpr DeltaGate<Frequency> pzemFreqGate(PZEM_ACCURACY_FREQ, PZEM_RESOLUTION_FREQ, PZEM_SIGMA_FREQ, PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_FREQ_MIN);
+    static constexpr DeltaGate<PowerFactor> pzemPfGate(PZEM_ACCURACY_PF, PZEM_RESOLUTION_PF, PZEM_SIGMA_PF, PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_PF_MIN);
 
 #ifdef __cplusplus
 }
 #endif
 
+// C++ linkage: returns a Fixed<> value
+
+/**
+ * @brief Power of a socket whose meter reports only U and I: U x I rounded to the 0.1 W register step.
+ * @details The rounding puts the result on the same grid as pzemThresholds, so an over-power
+ *          check only fires from threshold + 0.05 W (see test_fixed_point).
+ */
+extern Power PZEM016_apparentPower(Voltage U, Current I);
+
 #endif // PZEM016_Lib_H
@@ -0,0 +1,542 @@
+/**
+ * @file RS485_Bus.cpp
+ * @brief Implementation of the asynchronous RS485 Modbus-RTU master.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include "RS485_Bus.h"
+#include "ModbusRtu.h"
+
+Rs485Bus sensorBus = {}; // Shared PZEM016T / ES35-SW bus on UART2
+
+/**
+ * @brief Modbus t3.5 inter-frame gap for a baud rate (us).
+ *
+ * @details 3.5 character times up to 19200 baud; the spec fixes 1750 us above that.
+ */
+uint32_t RS485Bus_interFrameGapUs(uint32_t baud)
+{
+    if (baud > 19200)
+    {
+        return RS485_FIXED_GAP_US;
+    }
+    return (7UL * RS485_CHAR_BITS * 1000000UL + 2 * baud - 1) / (2 * baud); // ceil(3.5 * char time)
+}
+
+/**
+ * @brief Wait until the bus has been silent for t3.5 since the last frame.
+ *
+ * @details Whole milliseconds are slept so the other core and lower-priority tasks keep running;
+ *          only the sub-millisecond remainder is spun.
+ */
+static void waitInterFrameGap(Rs485Bus *bus)
+{
+    const uint32_t startUs = micros();
+    uint32_t elapsed = startUs - bus->lastFrameEndUs;
+    if (elapsed < bus->interFrameGapUs)
+    {
+        const uint32_t remainingMs = (bus->interFrameGapUs - elapsed) / 1000;
+        if (remainingMs > 0)
+        {
+            vTaskDelay(pdMS_TO_TICKS(remainingMs));
+        }
+        while ((uint32_t)(micros() - bus->lastFrameEndUs) < bus->interFrameGapUs)
+        {
+        }
+        bus->stats.gapWaitUs += micros() - startUs;
+    }
+}
+
+/**
+ * @brief Collect a response frame without polling.
+ *
+ * @details The worker sleeps on its task notification, which the UART event task gives when the
+ *          RX line has been idle for RS485_RX_IDLE_SYMBOLS characters (end of frame) or the RX FIFO
+ *          fills up. It stops at the expected length, at a complete exception frame, when the line
+ *          has been silent for t3.5 after at least one byte (short frame), or at the timeout.
+ */
+static void receiveFrame(Rs485Bus *bus, Rs485Transaction *txn)
+{
+    HardwareSerial *serial = bus->serial;
+    const uint32_t startMs = millis();
+    uint32_t lastByteUs = micros();
+    const uint32_t gapMs = (bus->interFrameGapUs + 999) / 1000;
+    txn->responseLen = 0;
+
+    for (;;)
+    {
+        while (serial->available() && txn->responseLen < txn->expectedLen)
+        {
+            const uint8_t b = (uint8_t)serial->read();
+            lastByteUs = micros();
+            if (txn->responseLen < txn->responseCap)
+            {
+                txn->response[txn->responseLen] = b;
+            }
+            txn->responseLen++;
+        }
+        if (txn->responseLen >= txn->expectedLen)
+        {
+            break;
+        }
+        if (txn->responseLen >= MODBUS_RTU_EXCEPTION_LEN && (txn->response[1] & MODBUS_EXCEPTION_FLAG))
+        {
+            break;
+        }
+        if (txn->responseLen > 0 && (uint32_t)(micros() - lastByteUs) >= bus->interFrameGapUs)
+        {
+            break; // Frame ended early
+        }
+        const uint32_t elapsedMs = millis() - startMs;
+        if (elapsedMs >= txn->timeoutMs)
+        {
+            break;
+        }
+        uint32_t waitMs = txn->timeoutMs - elapsedMs;
+        if (txn->responseLen > 0 && waitMs > gapMs)
+        {
+            waitMs = gapMs; // Part of a frame arrived: re-check for silence after t3.5
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs) > 0 ? pdMS_TO_TICKS(waitMs) : 1);
+    }
+    bus->lastFrameEndUs = txn->responseLen > 0 ? lastByteUs : micros();
+}
+
+/**
+ * @brief Check framing, address and CRC of a received response, and the echo of an FC 0x06 write.
+ */
+static Rs485Status checkResponse(const Rs485Transaction *txn)
+{
+    if (txn->responseLen == 0)
+    {
+        return RS485_TIMEOUT;
+    }
+    if (txn->responseLen > txn->responseCap)
+    {
+        return RS485_FRAME_ERROR; // Longer than the buffer: the tail was dropped
+    }
+    switch (ModbusRtu_checkResponse(txn->response, txn->responseLen, txn->slave, txn->request[1], NULL))
+    {
+    case MODBUS_RTU_OK:
+        if (txn->responseLen != txn->expectedLen)
+        {
+            return RS485_FRAME_ERROR;
+        }
+        if (txn->echoRequest && ModbusRtu_checkWriteSingleResponse(txn->response, txn->responseLen, txn->request, NULL) != MODBUS_RTU_OK)
+        {
+            return RS485_FRAME_ERROR; // Well-formed, but the slave did not take the value as sent
+        }
+        return RS485_OK;
+    case MODBUS_RTU_CRC_ERROR:
+        return RS485_CRC_ERROR;
+    case MODBUS_RTU_EXCEPTION:
+        return RS485_EXCEPTION;
+    default:
+        return RS485_FRAME_ERROR;
+    }
+}
+
+/**
+ * @brief Timeout an adaptive transaction gets: estimated slave latency plus the response frame time.
+ */
+uint16_t RS485Bus_responseTimeoutMs(const Rs485Bus *bus, uint8_t slave, uint16_t responseLen)
+{
+    if (slave >= RS485_TRACKED_SLAVES || bus->rto[slave].samples == 0)
+    {
+        return RS485_DEFAULT_TIMEOUT_MS; // Not measured yet
+    }
+    const uint32_t frameMs = (responseLen * bus->charTimeUs + 999) / 1000;
+    uint32_t timeoutMs = Rto_timeoutMs(&bus->rto[slave]) + frameMs;
+    // Never longer than the fixed timeout, unless the frame alone needs more time on the wire
+    uint32_t capMs = frameMs + RTO_MIN_MS;
+    if (capMs < RS485_DEFAULT_TIMEOUT_MS)
+    {
+        capMs = RS485_DEFAULT_TIMEOUT_MS;
+    }
+    return (uint16_t)(timeoutMs < capMs ? timeoutMs : capMs);
+}
+
+/**
+ * @brief Feed the result of a transaction into the latency estimate of its slave.
+ *
+ * @details The latency is the time from the end of the request to the end of the response, minus the
+ *          response's own wire time, so short probes and long reads of one slave share one estimate.
+ *          Bytes only become visible at UART RX idle, so the measurement includes that detection delay.
+ */
+static void updateResponseTimeout(Rs485Bus *bus, const Rs485Transaction *txn, uint32_t requestEndUs)
+{
+    if (txn->slave >= RS485_TRACKED_SLAVES)
+    {
+        return;
+    }
+    RtoEstimator *est = &bus->rto[txn->slave];
+    if (txn->status == RS485_TIMEOUT)
+    {
+        Rto_onTimeout(est);
+    }
+    else if (txn->status == RS485_OK || txn->status == RS485_EXCEPTION)
+    {
+        const uint32_t elapsedUs = bus->lastFrameEndUs - requestEndUs;
+        const uint32_t frameUs = txn->responseLen * bus->charTimeUs;
+        Rto_addSample(est, elapsedUs > frameUs ? elapsedUs - frameUs : 0);
+    }
+}
+
+/**
+ * @brief Count a finished transaction in the telemetry of its slave.
+ */
+static void recordTelemetry(Rs485Bus *bus, const Rs485Transaction *txn)
+{
+    if (txn->slave >= RS485_TRACKED_SLAVES)
+    {
+        return;
+    }
+    TelemetryOutcome outcome;
+    switch (txn->status)
+    {
+    case RS485_OK:
+        outcome = TELEMETRY_OK;
+        break;
+    case RS485_TIMEOUT:
+        outcome = TELEMETRY_TIMEOUT;
+        break;
+    case RS485_CRC_ERROR:
+        outcome = TELEMETRY_CRC_ERROR;
+        break;
+    case RS485_EXCEPTION:
+        outcome = TELEMETRY_EXCEPTION;
+        break;
+    default:
+        outcome = TELEMETRY_FRAME_ERROR;
+        break;
+    }
+    const uint8_t exceptionCode = txn->status == RS485_EXCEPTION ? txn->response[2] : 0;
+    Telemetry_record(&bus->telemetry[txn->slave], outcome, txn->busTimeUs, exceptionCode);
+}
+
+/**
+ * @brief Count a response rejected by a driver's range check.
+ */
+void RS485Bus_recordRejected(Rs485Bus *bus, uint8_t slave)
+{
+    if (slave < RS485_TRACKED_SLAVES)
+    {
+        Telemetry_recordRejected(&bus->telemetry[slave]);
+    }
+}
+
+/**
+ * @brief Execute one transaction on the wire and update the bus counters. Runs in the worker task.
+ */
+static void runTransaction(Rs485Bus *bus, Rs485Transaction *txn)
+{
+    waitInterFrameGap(bus);
+
+    while (bus->serial->available()) // Drop stale bytes from a previous timed-out transaction
+    {
+        bus->serial->read();
+    }
+    ulTaskNotifyTake(pdTRUE, 0); // Clear RX events left over from that frame
+
+    if (txn->timeoutMs == RS485_TIMEOUT_ADAPTIVE)
+    {
+        txn->timeoutMs = RS485Bus_responseTimeoutMs(bus, txn->slave, txn->expectedLen);
+    }
+
+    const uint32_t startUs = micros();
+    bus->serial->write(txn->request, txn->requestLen);
+    bus->serial->flush(); // Wait until the request has left the UART
+    const uint32_t requestEndUs = micros();
+    receiveFrame(bus, txn);
+    txn->busTimeUs = bus->lastFrameEndUs - startUs;
+    txn->status = checkResponse(txn);
+    updateResponseTimeout(bus, txn, requestEndUs);
+    recordTelemetry(bus, txn);
+
+    bus->stats.transactions++;
+    bus->stats.busTimeUs += txn->busTimeUs;
+    if (txn->busTimeUs > bus->stats.maxBusTimeUs)
+    {
+        bus->stats.maxBusTimeUs = txn->busTimeUs;
+    }
+    if (txn->status != RS485_OK)
+    {
+        bus->stats.failures++;
+        if (txn->status == RS485_TIMEOUT)
+        {
+            bus->stats.timeouts++;
+        }
+        if (txn->status != RS485_TIMEOUT || !txn->quietTimeout)
+        {
+            Serial.printf("[RS485] %s: slave 0x%02X %s failed: %s%s%s\n", bus->name, txn->slave, txn->purpose,
+                          RS485Bus_statusName(txn->status), txn->status == RS485_EXCEPTION ? " - " : "",
+                          txn->status == RS485_EXCEPTION ? ModbusRtu_exceptionName(txn->response[2]) : "");
+        }
+    }
+}
+
+// Character time and t3.5 gap of a rate
+static void setTiming(Rs485Bus *bus, uint32_t baud)
+{
+    bus->baud = baud;
+    bus->charTimeUs = (RS485_CHAR_BITS * 1000000UL + baud - 1) / baud;
+    bus->interFrameGapUs = RS485Bus_interFrameGapUs(baud);
+}
+
+/**
+ * @brief Move the UART to a new rate. Runs in the worker task, between two transactions.
+ *
+ * @details The latency estimates stay valid: they exclude the wire time, which
+ *          RS485Bus_responseTimeoutMs() recomputes from the new character time.
+ */
+static void switchBaud(Rs485Bus *bus, uint32_t baud)
+{
+    bus->serial->flush();
+    bus->serial->updateBaudRate(baud);
+    setTiming(bus, baud);
+    bus->lastFrameEndUs = micros(); // Start the t3.5 gap at the new rate
+    Serial.printf("[RS485] %s: %lu baud\n", bus->name, (unsigned long)baud);
+}
+
+/**
+ * @brief Bus worker: the only code that touches the UART of its bus.
+ */
+static void busWorkerTask(void *param)
+{
+    Rs485Bus *bus = (Rs485Bus *)param;
+    Rs485Transaction *txn;
+    for (;;)
+    {
+        if (xQueueReceive(bus->queue, &txn, portMAX_DELAY) == pdTRUE)
+        {
+            if (txn->requestLen > 0)
+            {
+                runTransaction(bus, txn);
+            }
+            else
+            {
+                txn->status = RS485_OK; // Control transaction: rate change only
+            }
+            if (txn->switchBaud != 0 && txn->status == RS485_OK)
+            {
+                switchBaud(bus, txn->switchBaud);
+            }
+            if (txn->onComplete != NULL)
+            {
+                txn->onComplete(txn, txn->ctx);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Initialize a bus once; later calls for the same bus are ignored.
+ *
+ * @details Starts the UART, arms the RX-idle event that wakes the worker at the end of each frame,
+ *          and creates the worker task and its transaction queue.
+ */
+void RS485Bus_init(Rs485Bus *bus, const char *name, HardwareSerial *serial, uint32_t baud, int8_t rxPin, int8_t txPin)
+{
+    if (bus->initialized)
+    {
+        return;
+    }
+    bus->name = name;
+    bus->serial = serial;
+    setTiming(bus, baud);
+    bus->lastFrameEndUs = micros();
+    memset(&bus->stats, 0, sizeof(bus->stats));
+    memset(bus->telemetry, 0, sizeof(bus->telemetry));
+    for (uint8_t slave = 0; slave < RS485_TRACKED_SLAVES; slave++)
+    {
+        Rto_init(&bus->rto[slave], RS485_DEFAULT_TIMEOUT_MS);
+    }
+    bus->queue = xQueueCreate(RS485_QUEUE_DEPTH, sizeof(Rs485Transaction *));
+
+    serial->begin(baud, SERIAL_8N1, rxPin, txPin);
+    serial->setRxTimeout(RS485_RX_IDLE_SYMBOLS);
+    xTaskCreatePinnedToCore(busWorkerTask, name, RS485_TASK_STACK, bus, RS485_TASK_PRIORITY, &bus->worker, RS485_TASK_CORE);
+    serial->onReceive([bus]()
+                      { xTaskNotifyGive(bus->worker); }, true); // Only on RX idle / FIFO full, not per byte
+    bus->initialized = true;
+}
+
+/**
+ * @brief Queue a transaction without waiting.
+ */
+bool RS485Bus_submit(Rs485Bus *bus, Rs485Transaction *txn)
+{
+    txn->status = RS485_PENDING;
+    txn->responseLen = 0;
+    if (xQueueSend(bus->queue, &txn, 0) != pdTRUE)
+    {
+        txn->status = RS485_BUSY;
+        Serial.printf("[RS485] %s: queue full, dropped slave 0x%02X %s\n", bus->name, txn->slave, txn->purpose);
+        return false;
+    }
+    const uint32_t depth = uxQueueMessagesWaiting(bus->queue);
+    if (depth > bus->stats.queueHighWater)
+    {
+        bus->stats.queueHighWater = depth;
+    }
+    return true;
+}
+
+/**
+ * @brief Number of transactions waiting in the queue of a bus.
+ */
+uint32_t RS485Bus_queueDepth(const Rs485Bus *bus)
+{
+    return bus->queue != NULL ? uxQueueMessagesWaiting(bus->queue) : 0;
+}
+
+// Completion callback of RS485Bus_transact(): wake the waiting task
+static void signalDone(Rs485Transaction *, void *ctx)
+{
+    xSemaphoreGive((SemaphoreHandle_t)ctx);
+}
+
+/**
+ * @brief Submit a transaction and block the calling task until it completes.
+ */
+Rs485Status RS485Bus_transact(Rs485Bus *bus, Rs485Transaction *txn)
+{
+    StaticSemaphore_t doneBuffer;
+    SemaphoreHandle_t done = xSemaphoreCreateBinaryStatic(&doneBuffer);
+    txn->onComplete = signalDone;
+    txn->ctx = done;
+    if (RS485Bus_submit(bus, txn))
+    {
+        xSemaphoreTake(done, portMAX_DELAY); // The worker always completes within the response timeout
+    }
+    vSemaphoreDelete(done);
+    return txn->status;
+}
+
+/**
+ * @brief Check the byte count of a completed read and copy its 2 * @p count data bytes.
+ */
+Rs485Status RS485Bus_parseReadResponse(const Rs485Transaction *txn, uint16_t count, uint8_t *data)
+{
+    if (txn->status != RS485_OK)
+    {
+        return txn->status;
+    }
+    const ModbusRtuResult result = ModbusRtu_parseReadResponse(txn->response, txn->responseLen, txn->slave,
+                                                               txn->request[1], count, data, 2u * count, NULL);
+    return (result == MODBUS_RTU_OK) ? RS485_OK : RS485_FRAME_ERROR;
+}
+
+// Build, run and parse one FC 0x03/0x04 read
+static Rs485Status readRegisters(Rs485Bus *bus, uint8_t slave, uint8_t function, uint16_t start, uint16_t count,
+                                 uint16_t timeoutMs, bool quietTimeout, const char *purpose, uint8_t *data)
+{
+    uint8_t request[MODBUS_RTU_READ_REQUEST_LEN];
+    uint8_t response[RS485_MAX_FRAME];
+    Rs485Transaction txn = {};
+    txn.slave = slave;
+    txn.purpose = purpose;
+    txn.request = request;
+    txn.requestLen = (uint16_t)ModbusRtu_buildReadRequest(request, sizeof(request), slave, function, start, count);
+    if (txn.requestLen == 0)
+    {
+        return RS485_FRAME_ERROR; // count outside 1..125
+    }
+    txn.response = response;
+    txn.responseCap = sizeof(response);
+    txn.expectedLen = ModbusRtu_readResponseLen(count);
+    txn.timeoutMs = timeoutMs;
+    txn.quietTimeout = quietTimeout;
+
+    RS485Bus_transact(bus, &txn);
+    return RS485Bus_parseReadResponse(&txn, count, data);
+}
+
+/**
+ * @brief Read @p count registers with FC 0x03 or 0x04 and copy the raw big-endian data bytes.
+ */
+Rs485Status RS485Bus_readRegisters(Rs485Bus *bus, uint8_t slave, uint8_t function, uint16_t start,
+                                   uint16_t count, const char *purpose, uint8_t *data)
+{
+    return readRegisters(bus, slave, function, start, count, RS485_TIMEOUT_ADAPTIVE, false, purpose, data);
+}
+
+/**
+ * @brief Read registers of a possibly empty address with a fixed timeout and no log line on timeout.
+ */
+Rs485Status RS485Bus_probeRegisters(Rs485Bus *bus, uint8_t slave, uint8_t function, uint16_t start,
+                                    uint16_t count, uint16_t timeoutMs, const char *purpose, uint8_t *data)
+{
+    return readRegisters(bus, slave, function, start, count, timeoutMs, true, purpose, data);
+}
+
+/**
+ * @brief Write one register with FC 0x06, optionally switching the bus rate after an exact echo.
+ */
+Rs485Status RS485Bus_writeRegister(Rs485Bus *bus, uint8_t slave, uint16_t reg, uint16_t value,
+                                   uint32_t switchBaud, const char *purpose)
+{
+    uint8_t request[MODBUS_RTU_WRITE_SINGLE_LEN];
+    uint8_t response[RS485_MAX_FRAME];
+    Rs485Transaction txn = {};
+    txn.slave = slave;
+    txn.purpose = purpose;
+    txn.request = request;
+    txn.requestLen = (uint16_t)ModbusRtu_buildWriteSingleRequest(request, sizeof(request), slave, reg, value);
+    txn.response = response;
+    txn.responseCap = sizeof(response);
+    txn.expectedLen = MODBUS_RTU_WRITE_SINGLE_LEN;
+    txn.timeoutMs = RS485_TIMEOUT_ADAPTIVE;
+    txn.echoRequest = true; // Checked by the worker, before it acts on switchBaud
+    txn.switchBaud = switchBaud;
+    return RS485Bus_transact(bus, &txn);
+}
+
+/**
+ * @brief Queue a rate change behind the pending transactions and wait for it.
+ */
+void RS485Bus_setBaud(Rs485Bus *bus, uint32_t baud)
+{
+    Rs485Transaction txn = {};
+    txn.purpose = "baud";
+    txn.switchBaud = baud;
+    RS485Bus_transact(bus, &txn);
+}
+
+/**
+ * @brief Forget the timeout estimate and telemetry of a slave.
+ */
+void RS485Bus_resetSlave(Rs485Bus *bus, uint8_t slave)
+{
+    if (slave < RS485_TRACKED_SLAVES)
+    {
+        Rto_init(&bus->rto[slave], RS485_DEFAULT_TIMEOUT_MS);
+        memset(&bus->telemetry[slave], 0, sizeof(bus->telemetry[slave]));
+    }
+}
+
+/**
+ * @brief Printable name of a status.
+ */
+const char *RS485Bus_statusName(Rs485Status status)
+{
+    switch (status)
+    {
+    case RS485_OK:
+        return "ok";
+    case RS485_TIMEOUT:
+        return "timeout";
+    case RS485_CRC_ERROR:
+        return "crc error";
+    case RS485_FRAME_ERROR:
+        return "frame error";
+    case RS485_EXCEPTION:
+        return "exception";
+    case RS485_BUSY:
+        return "busy";
+    case RS485_PENDING:
+        return "pending";
+    }
+    return "?";
+}
@@ -0,0 +1,205 @@
+/**
+ * @file RS485_Bus.h
+ * @brief Asynchronous Modbus-RTU master: one owner task per RS485 bus, tagged transactions with t3.5 spacing.
+ *        Framing and CRC come from the header-only ModbusRtu codec.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef RS485_BUS_H
+#define RS485_BUS_H
+
+#include <Arduino.h>
+#include "RtoEstimator.h"
+#include "ModbusTelemetry.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Shared sensor bus: PZEM016T array and ES35-SW on UART2
+#define SENSOR_BUS_SERIAL Serial2 // Serial port of the shared sensor bus
+#define SENSOR_BUS_RX_PIN 17      // RX pin of the shared sensor bus
+#define SENSOR_BUS_TX_PIN 16      // TX pin of the shared sensor bus
+#define SENSOR_BUS_BAUD 9600      // Baud rate of the shared sensor bus
+
+#define RS485_CHAR_BITS 11             // Bits per character on the wire (start + 8 data + parity/stop + stop)
+#define RS485_FIXED_GAP_US 1750        // Modbus t3.5 for baud rates above 19200
+#define RS485_MAX_FRAME 256            // Maximum Modbus-RTU frame length (MODBUS_RTU_MAX_FRAME)
+#define RS485_DEFAULT_TIMEOUT_MS 100   // Response timeout before a slave has been measured
+#define RS485_TIMEOUT_ADAPTIVE 0       // timeoutMs value: use the slave's estimated response timeout
+#define RS485_TRACKED_SLAVES 16        // Slave addresses below this get their own timeout estimate and telemetry
+#define RS485_RX_IDLE_SYMBOLS 4        // UART RX idle time (characters) that ends a frame, >= t3.5
+#define RS485_QUEUE_DEPTH 8            // Pending transactions per bus
+#define RS485_TASK_STACK 4096          // Stack (byte) of each bus worker task
+#define RS485_TASK_PRIORITY 4          // Above the acquisition task so replies are handled as soon as they end
+#define RS485_TASK_CORE 1              // Same core as the acquisition task
+
+    /**
+     * @brief Result of one bus transaction.
+     */
+    typedef enum
+    {
+        RS485_OK = 0,      ///< Complete response with valid CRC
+        RS485_TIMEOUT,     ///< No response within the timeout
+        RS485_CRC_ERROR,   ///< Response CRC mismatch
+        RS485_FRAME_ERROR, ///< Wrong address, function, length or a truncated frame
+        RS485_EXCEPTION,   ///< Slave answered with a Modbus exception
+        RS485_BUSY,        ///< Transaction queue of the bus is full
+        RS485_PENDING      ///< Submitted, not completed yet
+    } Rs485Status;
+
+    struct Rs485Transaction;
+
+    /**
+     * @brief Completion callback, called from the bus worker task once the transaction has finished.
+     */
+    typedef void (*Rs485Callback)(struct Rs485Transaction *txn, void *ctx);
+
+    /**
+     * @brief One request/response exchange, tagged with its slave and purpose for diagnostics.
+     */
+    typedef struct Rs485Transaction
+    {
+        uint8_t slave;           ///< Slave address (tag)
+        const char *purpose;     ///< What the transaction is for, e.g. "pzem.measure" (tag)
+        const uint8_t *request;  ///< Complete request frame including CRC
+        uint16_t requestLen;     ///< Request length in bytes
+        uint8_t *response;       ///< Buffer for the response frame
+        uint16_t responseCap;    ///< Size of the response buffer
+        uint16_t expectedLen;    ///< Length of a normal response frame
+        uint16_t timeoutMs;      ///< Response timeout, or RS485_TIMEOUT_ADAPTIVE (replaced by the value used)
+        uint16_t responseLen;    ///< Bytes received (output)
+        Rs485Status status;      ///< Result (output)
+        uint32_t busTimeUs;      ///< Time from first request byte to last response byte (output)
+        bool quietTimeout;       ///< A timeout is an expected answer (address probe): not logged
+        bool echoRequest;        ///< The response must repeat the request exactly (FC 0x06), else RS485_FRAME_ERROR
+        uint32_t switchBaud;     ///< Non-zero: switch the bus to this rate once the transaction ended in RS485_OK
+        Rs485Callback onComplete; ///< Called when done (may be NULL)
+        void *ctx;               ///< Passed to onComplete
+    } Rs485Transaction;
+
+    /**
+     * @brief Counters of one bus.
+     */
+    typedef struct
+    {
+        uint32_t transactions; ///< Transactions executed
+        uint32_t failures;     ///< Transactions not ending in RS485_OK
+        uint32_t timeouts;     ///< Transactions ending in RS485_TIMEOUT
+        uint32_t busTimeUs;    ///< Accumulated bus time (us)
+        uint32_t maxBusTimeUs; ///< Longest transaction (us)
+        uint32_t gapWaitUs;    ///< Accumulated time spent waiting for the inter-frame gap (us)
+        uint32_t queueHighWater; ///< Most transactions ever waiting in the queue
+    } Rs485BusStats;
+
+    /**
+     * @brief A physical RS485 bus and its owner state.
+     */
+    typedef struct
+    {
+        const char *name;           ///< Name used in logs
+        HardwareSerial *serial;     ///< UART driving the bus
+        uint32_t baud;              ///< Current baud rate
+        uint32_t charTimeUs;        ///< Time of one character on the wire
+        uint32_t interFrameGapUs;   ///< Modbus t3.5 silent interval
+        uint32_t lastFrameEndUs;    ///< micros() at the end of the last frame on the wire
+        QueueHandle_t queue;        ///< Pending transactions of all drivers on this bus
+        TaskHandle_t worker;        ///< Task that owns the UART and runs the transactions
+        Rs485BusStats stats;        ///< Bus counters
+        RtoEstimator rto[RS485_TRACKED_SLAVES]; ///< Response latency estimate per slave address
+        SlaveTelemetry telemetry[RS485_TRACKED_SLAVES]; ///< Transaction counters and latency histogram per slave address
+        bool initialized;           ///< true after RS485Bus_init()
+    } Rs485Bus;
+
+    extern Rs485Bus sensorBus; // Shared PZEM016T / ES35-SW bus on UART2
+
+    /**
+     * @brief Initialize a bus. Calling it again for an initialized bus does nothing,
+     *        so every driver on the bus may call it from its own init function.
+     */
+    extern void RS485Bus_init(Rs485Bus *bus, const char *name, HardwareSerial *serial, uint32_t baud, int8_t rxPin, int8_t txPin);
+
+    /**
+     * @brief Queue a transaction without waiting. The worker waits for the t3.5 gap, sends,
+     *        sleeps until the UART reports RX idle, then calls @p txn->onComplete.
+     *        @p txn and its buffers must stay valid until the callback runs.
+     * @return false if the queue is full (status RS485_BUSY, callback not called).
+     */
+    extern bool RS485Bus_submit(Rs485Bus *bus, Rs485Transaction *txn);
+
+    /**
+     * @brief Submit a transaction and block the calling task until it completes.
+     * @return Status, also stored in @p txn->status.
+     */
+    extern Rs485Status RS485Bus_transact(Rs485Bus *bus, Rs485Transaction *txn);
+
+    /**
+     * @brief Number of transactions waiting in the queue of a bus (not counting the one on the wire).
+     */
+    extern uint32_t RS485Bus_queueDepth(const Rs485Bus *bus);
+
+    /**
+     * @brief Timeout an adaptive transaction to @p slave would get for a response of @p responseLen bytes:
+     *        the slave's estimated latency plus the time the response needs on the wire.
+     */
+    extern uint16_t RS485Bus_responseTimeoutMs(const Rs485Bus *bus, uint8_t slave, uint16_t responseLen);
+
+    /**
+     * @brief Count a valid response of @p slave whose values the driver rejected as out of range.
+     */
+    extern void RS485Bus_recordRejected(Rs485Bus *bus, uint8_t slave);
+
+    /**
+     * @brief Check the byte count of a completed read and copy its 2 * @p count data bytes.
+     */
+    extern Rs485Status RS485Bus_parseReadResponse(const Rs485Transaction *txn, uint16_t count, uint8_t *data);
+
+    /**
+     * @brief Read @p count registers with FC 0x03 or 0x04 and copy the raw big-endian data bytes.
+     * @param data Destination for 2 * @p count bytes.
+     */
+    extern Rs485Status RS485Bus_readRegisters(Rs485Bus *bus, uint8_t slave, uint8_t function, uint16_t start,
+                                              uint16_t count, const char *purpose, uint8_t *data);
+
+    /**
+     * @brief Like RS485Bus_readRegisters() but with a caller-chosen response timeout and no log line
+     *        on timeout, for probing addresses that may be empty.
+     */
+    extern Rs485Status RS485Bus_probeRegisters(Rs485Bus *bus, uint8_t slave, uint8_t function, uint16_t start,
+                                               uint16_t count, uint16_t timeoutMs, const char *purpose, uint8_t *data);
+
+    /**
+     * @brief Write one register with FC 0x06 and check the echo. If @p switchBaud is non-zero and the
+     *        slave echoed the request exactly, the bus moves to that rate before the next queued
+     *        transaction runs; a different echo is RS485_FRAME_ERROR and the rate stays.
+     */
+    extern Rs485Status RS485Bus_writeRegister(Rs485Bus *bus, uint8_t slave, uint16_t reg, uint16_t value,
+                                              uint32_t switchBaud, const char *purpose);
+
+    /**
+     * @brief Change the rate of a bus between two queued transactions and wait until it is applied.
+     */
+    extern void RS485Bus_setBaud(Rs485Bus *bus, uint32_t baud);
+
+    /**
+     * @brief Forget the timeout estimate and telemetry of @p slave, e.g. after probing an empty address.
+     */
+    extern void RS485Bus_resetSlave(Rs485Bus *bus, uint8_t slave);
+
+    /**
+     * @brief Modbus t3.5 inter-frame gap for a baud rate (us).
+     */
+    extern uint32_t RS485Bus_interFrameGapUs(uint32_t baud);
+
+    /**
+     * @brief Printable name of a status.
+     */
+    extern const char *RS485Bus_statusName(Rs485Status status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RS485_BUS_H
@@ -0,0 +1,109 @@
+/**
+ * @file RingBuffer.h
+ * @brief Fixed-capacity circular history buffer with O(1) push.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stddef.h>
+
+/**
+ * @brief The last N values of one channel, oldest first.
+ *
+ * A push writes one slot and advances the write position, so its cost does not depend on N (a
+ * shift-register history moves every element on each sample). Once full, each push overwrites the
+ * oldest value. Storage slots stay where they were written, so a caller can keep slot indices
+ * (see SlidingMedian).
+ *
+ * Not thread-safe: one task owns each buffer, like the sensor globals it feeds.
+ *
+ * @tparam T Element type (must be copy-assignable).
+ * @tparam N Capacity, any size >= 1.
+ */
+template <typename T, size_t N>
+class RingBuffer
+{
+    static_assert(N >= 1, "RingBuffer capacity must be at least 1");
+
+public:
+    RingBuffer() : head_(0), count_(0) {}
+
+    /**
+     * @brief Append @p value, overwriting the oldest value when full.
+     * @return Storage slot written (0..N-1).
+     */
+    size_t push(const T &value)
+    {
+        const size_t slot = head_;
+        buffer_[slot] = value;
+        head_ = (head_ + 1 == N) ? 0 : head_ + 1;
+        if (count_ < N)
+        {
+            count_++;
+        }
+        return slot;
+    }
+
+    /**
+     * @brief @p i-th value from the oldest (0) to the newest (size() - 1).
+     */
+    const T &operator[](size_t i) const
+    {
+        size_t index = head_ + (N - count_) + i; // Always < 2N
+        if (index >= N)
+        {
+            index -= N;
+        }
+        return buffer_[index];
+    }
+
+    const T &oldest() const { return (*this)[0]; }
+
+    const T &newest() const { return buffer_[(head_ == 0) ? N - 1 : head_ - 1]; }
+
+    /**
+     * @brief Value stored in storage slot @p slot, as returned by push().
+     */
+    const T &slot(size_t slot) const { return buffer_[slot]; }
+
+    /**
+     * @brief Call @p fn(value) for every value, oldest first, without a modulo per element.
+     */
+    template <typename F>
+    void forEach(F fn) const
+    {
+        const size_t start = (count_ < N) ? 0 : head_;
+        for (size_t i = start; i < count_; i++)
+        {
+            fn(buffer_[i]);
+        }
+        for (size_t i = 0; i < start; i++)
+        {
+            fn(buffer_[i]);
+        }
+    }
+
+    void clear()
+    {
+        head_ = 0;
+        count_ = 0;
+    }
+
+    size_t size() const { return count_; }
+
+    bool empty() const { return count_ == 0; }
+
+    bool full() const { return count_ == N; }
+
+    static constexpr size_t capacity() { return N; }
+
+private:
+    T buffer_[N];
+    size_t head_;  ///< Slot the next push writes
+    size_t count_; ///< Values stored, up to N
+};
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,81 @@
+/**
+ * @file RtoEstimator.cpp
+ * @brief Implementation of the per-slave response timeout estimator.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include "RtoEstimator.h"
+
+// Clamp a timeout in microseconds to [RTO_MIN_MS, RTO_MAX_MS], rounding up to whole ms
+static uint16_t clampRtoMs(uint32_t rtoUs)
+{
+    uint32_t ms = (rtoUs + 999) / 1000;
+    if (ms < RTO_MIN_MS)
+    {
+        ms = RTO_MIN_MS;
+    }
+    if (ms > RTO_MAX_MS)
+    {
+        ms = RTO_MAX_MS;
+    }
+    return (uint16_t)ms;
+}
+
+/**
+ * @brief Reset an estimator.
+ */
+void Rto_init(RtoEstimator *est, uint16_t initialMs)
+{
+    est->srttUs = 0;
+    est->rttvarUs = 0;
+    est->rtoMs = initialMs;
+    est->samples = 0;
+    est->backoffs = 0;
+}
+
+/**
+ * @brief Feed the latency of a valid response.
+ *
+ * @details The first sample sets SRTT = R and RTTVAR = R / 2 (RFC 6298).
+ */
+void Rto_addSample(RtoEstimator *est, uint32_t latencyUs)
+{
+    if (est->samples == 0)
+    {
+        est->srttUs = latencyUs;
+        est->rttvarUs = latencyUs / 2;
+    }
+    else
+    {
+        const int32_t err = (int32_t)(latencyUs - est->srttUs);
+        const uint32_t absErr = err < 0 ? (uint32_t)-err : (uint32_t)err;
+        est->srttUs = (uint32_t)((int32_t)est->srttUs + err / 8);
+        est->rttvarUs = (uint32_t)((int32_t)est->rttvarUs + ((int32_t)absErr - (int32_t)est->rttvarUs) / 4);
+    }
+    est->samples++;
+
+    uint32_t devUs = RTO_DEV_FACTOR * est->rttvarUs;
+    if (devUs < RTO_GRANULARITY_US)
+    {
+        devUs = RTO_GRANULARITY_US;
+    }
+    est->rtoMs = clampRtoMs(est->srttUs + devUs);
+}
+
+/**
+ * @brief Record a timeout.
+ */
+void Rto_onTimeout(RtoEstimator *est)
+{
+    est->backoffs++;
+    est->rtoMs = clampRtoMs(2UL * est->rtoMs * 1000);
+}
+
+/**
+ * @brief Current response timeout (ms).
+ */
+uint16_t Rto_timeoutMs(const RtoEstimator *est)
+{
+    return est->rtoMs;
+}
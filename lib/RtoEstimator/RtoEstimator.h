@@ -0,0 +1,61 @@
+/**
+ * @file RtoEstimator.h
+ * @brief Per-slave response timeout from measured latencies (Jacobson/Karels, as TCP RTO).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef RTO_ESTIMATOR_H
+#define RTO_ESTIMATOR_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define RTO_MIN_MS 20           // Lower bound: two RTOS ticks plus UART RX-idle detection
+#define RTO_MAX_MS 100          // Upper bound: the old fixed response timeout
+#define RTO_DEV_FACTOR 4        // k in RTO = SRTT + k * RTTVAR
+#define RTO_GRANULARITY_US 1000 // Minimum deviation term: one RTOS tick
+
+    /**
+     * @brief Latency estimate of one slave.
+     */
+    typedef struct
+    {
+        uint32_t srttUs;   ///< Smoothed latency (us)
+        uint32_t rttvarUs; ///< Smoothed mean deviation (us)
+        uint16_t rtoMs;    ///< Current response timeout (ms)
+        uint32_t samples;  ///< Latencies measured so far
+        uint32_t backoffs; ///< Timeouts that doubled the RTO
+    } RtoEstimator;
+
+    /**
+     * @brief Reset an estimator. Until the first sample the timeout is @p initialMs.
+     */
+    extern void Rto_init(RtoEstimator *est, uint16_t initialMs);
+
+    /**
+     * @brief Feed the latency of a valid response: SRTT += err / 8, RTTVAR += (|err| - RTTVAR) / 4,
+     *        RTO = SRTT + max(G, k * RTTVAR), clamped to [RTO_MIN_MS, RTO_MAX_MS].
+     */
+    extern void Rto_addSample(RtoEstimator *est, uint32_t latencyUs);
+
+    /**
+     * @brief Record a timeout: double the RTO up to RTO_MAX_MS. The timed-out request gives no
+     *        latency sample (Karn), so one late reply only lengthens the next wait.
+     */
+    extern void Rto_onTimeout(RtoEstimator *est);
+
+    /**
+     * @brief Current response timeout (ms).
+     */
+    extern uint16_t Rto_timeoutMs(const RtoEstimator *est);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RTO_ESTIMATOR_H
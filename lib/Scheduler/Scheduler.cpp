@@ -0,0 +1,210 @@
+/**
+ * @file Scheduler.cpp
+ * @brief Implementation of the deadline-driven cooperative job scheduler.
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * @details This file only depends on the injected clock, so it builds unchanged on a host
+ *          with a fake clock for timing experiments.
+ */
+
+#include "Scheduler.h"
+#include <stddef.h>
+
+/**
+ * @brief Wrap-safe "a is at or after b" comparison for millisecond timestamps.
+ */
+static inline bool timeReached(uint32_t now, uint32_t t)
+{
+    return (int32_t)(now - t) >= 0;
+}
+
+void Scheduler_init(Scheduler *sched, SchedulerClock clock)
+{
+    sched->jobCount = 0;
+    sched->clock = clock;
+}
+
+int Scheduler_addJob(Scheduler *sched, const char *name, uint32_t periodMs, uint32_t offsetMs,
+                     uint32_t deadlineMs, SchedulerJobFunction fn, void *ctx)
+{
+    if (sched->jobCount >= SCHEDULER_MAX_JOBS || fn == NULL || periodMs == 0)
+    {
+        return -1;
+    }
+
+    SchedulerJob *job = &sched->jobs[sched->jobCount];
+    job->name = name;
+    job->fn = fn;
+    job->ctx = ctx;
+    job->periodMs = periodMs;
+    job->deadlineMs = (deadlineMs == 0) ? periodMs : deadlineMs;
+    job->nextRunMs = sched->clock() + offsetMs;
+    job->enabled = true;
+
+    job->runCount = 0;
+    job->missCount = 0;
+    job->lastJitterMs = 0;
+    job->maxJitterMs = 0;
+    job->sumJitterMs = 0;
+    job->lastDurationMs = 0;
+    job->maxDurationMs = 0;
+
+    return sched->jobCount++;
+}
+
+/**
+ * @brief Pick the due job with the earliest absolute deadline, or -1 if none is due.
+ */
+static int pickDueJob(Scheduler *sched, uint32_t now)
+{
+    int best = -1;
+    uint32_t bestDeadline = 0;
+    for (int i = 0; i < sched->jobCount; i++)
+    {
+        const SchedulerJob *job = &sched->jobs[i];
+        if (!job->enabled || !timeReached(now, job->nextRunMs))
+        {
+            continue;
+        }
+        const uint32_t deadline = job->nextRunMs + job->deadlineMs;
+        if (best < 0 || (int32_t)(deadline - bestDeadline) < 0)
+        {
+            best = i;
+            bestDeadline = deadline;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Execute one job and update its statistics and next release time.
+ */
+static void runJob(Scheduler *sched, SchedulerJob *job)
+{
+    const uint32_t release = job->nextRunMs;
+    const uint32_t start = sched->clock();
+
+    job->fn(job->ctx);
+
+    const uint32_t end = sched->clock();
+    const uint32_t jitter = start - release;
+
+    job->runCount++;
+    job->lastJitterMs = jitter;
+    job->sumJitterMs += jitter;
+    if (jitter > job->maxJitterMs)
+    {
+        job->maxJitterMs = jitter;
+    }
+    job->lastDurationMs = end - start;
+    if (job->lastDurationMs > job->maxDurationMs)
+    {
+        job->maxDurationMs = job->lastDurationMs;
+    }
+    if ((int32_t)(end - (release + job->deadlineMs)) > 0)
+    {
+        job->missCount++;
+    }
+
+    // Giữ nhịp theo mốc release, nếu đã trễ quá một chu kỳ thì bỏ qua các lần release đã lỡ
+    job->nextRunMs = release + job->periodMs;
+    while (timeReached(end, job->nextRunMs + job->periodMs))
+    {
+        job->nextRunMs += job->periodMs;
+        job->missCount++;
+    }
+}
+
+uint32_t Scheduler_runDue(Scheduler *sched)
+{
+    int idx;
+    while ((idx = pickDueJob(sched, sched->clock())) >= 0)
+    {
+        runJob(sched, &sched->jobs[idx]);
+    }
+
+    const uint32_t now = sched->clock();
+    uint32_t wait = SCHEDULER_IDLE_MAX_MS;
+    for (int i = 0; i < sched->jobCount; i++)
+    {
+        const SchedulerJob *job = &sched->jobs[i];
+        if (!job->enabled)
+        {
+            continue;
+        }
+        if (timeReached(now, job->nextRunMs))
+        {
+            return 0;
+        }
+        const uint32_t remaining = job->nextRunMs - now;
+        if (remaining < wait)
+        {
+            wait = remaining;
+        }
+    }
+    return wait;
+}
+
+void Scheduler_setPeriod(Scheduler *sched, int job, uint32_t periodMs)
+{
+    if (job < 0 || job >= sched->jobCount || periodMs == 0)
+    {
+        return;
+    }
+    SchedulerJob *j = &sched->jobs[job];
+    const uint32_t lastRelease = j->nextRunMs - j->periodMs;
+    if (j->deadlineMs == j->periodMs)
+    {
+        j->deadlineMs = periodMs; // Deadline mặc định đi theo chu kỳ
+    }
+    j->periodMs = periodMs;
+    uint32_t candidate = lastRelease + periodMs;
+    const uint32_t now = sched->clock();
+    if ((int32_t)(candidate - now) < 0)
+    {
+        candidate = now; // Mốc mới đã qua: release ngay, không tính là trễ deadline
+    }
+    if ((int32_t)(candidate - j->nextRunMs) < 0)
+    {
+        j->nextRunMs = candidate; // Chu kỳ ngắn hơn: kéo lần chạy kế tiếp về sớm hơn
+    }
+}
+
+void Scheduler_setEnabled(Scheduler *sched, int job, bool enabled)
+{
+    if (job < 0 || job >= sched->jobCount)
+    {
+        return;
+    }
+    SchedulerJob *j = &sched->jobs[job];
+    if (enabled && !j->enabled)
+    {
+        j->nextRunMs = sched->clock(); // Bật lại thì chạy ngay, không tính các lần lỡ
+    }
+    j->enabled = enabled;
+}
+
+void Scheduler_trigger(Scheduler *sched, int job)
+{
+    if (job < 0 || job >= sched->jobCount)
+    {
+        return;
+    }
+    sched->jobs[job].nextRunMs = sched->clock();
+}
+
+void Scheduler_resetStats(Scheduler *sched)
+{
+    for (int i = 0; i < sched->jobCount; i++)
+    {
+        SchedulerJob *job = &sched->jobs[i];
+        job->runCount = 0;
+        job->missCount = 0;
+        job->lastJitterMs = 0;
+        job->maxJitterMs = 0;
+        job->sumJitterMs = 0;
+        job->lastDurationMs = 0;
+        job->maxDurationMs = 0;
+    }
+}
@@ -0,0 +1,116 @@
+/**
+ * @file Scheduler.h
+ * @brief Deadline-driven cooperative job scheduler.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SCHEDULER_MAX_JOBS 16 // Maximum number of jobs per scheduler instance
+#define SCHEDULER_IDLE_MAX_MS 1000 // Upper bound returned by Scheduler_runDue() when no job is registered
+
+    /**
+     * @brief Millisecond clock used by the scheduler.
+     * On the target this wraps millis(); a host build can pass a fake clock.
+     */
+    typedef uint32_t (*SchedulerClock)(void);
+
+    /**
+     * @brief Job body. @p ctx is the pointer given to Scheduler_addJob().
+     */
+    typedef void (*SchedulerJobFunction)(void *ctx);
+
+    /**
+     * @brief One periodic job and its timing statistics.
+     */
+    typedef struct
+    {
+        const char *name;         ///< Name used in logs
+        SchedulerJobFunction fn;  ///< Job body
+        void *ctx;                ///< User context passed to fn
+        uint32_t periodMs;        ///< Release period
+        uint32_t deadlineMs;      ///< Relative deadline (from release time)
+        uint32_t nextRunMs;       ///< Next release time
+        bool enabled;             ///< false = job is skipped
+
+        uint32_t runCount;        ///< Number of executions
+        uint32_t missCount;       ///< Executions that finished after their deadline, plus skipped releases
+        uint32_t lastJitterMs;    ///< Start delay of the last execution relative to its release
+        uint32_t maxJitterMs;     ///< Largest start delay observed
+        uint32_t sumJitterMs;     ///< Sum of start delays (for the mean)
+        uint32_t lastDurationMs;  ///< Execution time of the last run
+        uint32_t maxDurationMs;   ///< Largest execution time observed
+    } SchedulerJob;
+
+    /**
+     * @brief Scheduler instance (one per task that dispatches jobs).
+     */
+    typedef struct
+    {
+        SchedulerJob jobs[SCHEDULER_MAX_JOBS]; ///< Registered jobs
+        uint8_t jobCount;                      ///< Number of registered jobs
+        SchedulerClock clock;                  ///< Time source
+    } Scheduler;
+
+    /**
+     * @brief Initialize a scheduler instance.
+     * @param sched Scheduler to initialize.
+     * @param clock Millisecond time source.
+     */
+    extern void Scheduler_init(Scheduler *sched, SchedulerClock clock);
+
+    /**
+     * @brief Register a periodic job.
+     * @param sched Scheduler instance.
+     * @param name Job name for logs.
+     * @param periodMs Release period in ms.
+     * @param offsetMs Delay of the first release from now, used to stagger jobs.
+     * @param deadlineMs Relative deadline in ms, 0 = same as the period.
+     * @param fn Job body.
+     * @param ctx Context passed to @p fn.
+     * @return Job index, or -1 if the table is full.
+     */
+    extern int Scheduler_addJob(Scheduler *sched, const char *name, uint32_t periodMs, uint32_t offsetMs,
+                                uint32_t deadlineMs, SchedulerJobFunction fn, void *ctx);
+
+    /**
+     * @brief Run every job whose release time has passed, earliest deadline first.
+     * @return Milliseconds until the next release (0 if a job is already due again).
+     */
+    extern uint32_t Scheduler_runDue(Scheduler *sched);
+
+    /**
+     * @brief Change the period of a job. The next release is pulled in if the new period is shorter.
+     */
+    extern void Scheduler_setPeriod(Scheduler *sched, int job, uint32_t periodMs);
+
+    /**
+     * @brief Enable or disable a job.
+     */
+    extern void Scheduler_setEnabled(Scheduler *sched, int job, bool enabled);
+
+    /**
+     * @brief Release a job immediately on the next Scheduler_runDue() call.
+     */
+    extern void Scheduler_trigger(Scheduler *sched, int job);
+
+    /**
+     * @brief Reset the timing statistics of all jobs.
+     */
+    extern void Scheduler_resetStats(Scheduler *sched);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCHEDULER_H
@@ -26,130 +26,163 @@ void SensorHandlers_init()
     op_time_counter_init(&op_time_UI400, 80);          // Địa chỉ 80 cho bơm CO2 UI400
 }
 
-// Xử lý cảm biến rò điện, cập nhật trạng thái cảnh báo và flag thay đổi
-void handleLeakSensor(bool &warning, acLeakChangedFlags &changed)
+// Mẫu đọc nhanh gần nhất của cảm biến rò điện (chỉ task rò điện đọc/ghi)
+static LeakSensorData leakSample = {};
+static bool leakSampleValid = false;
+
+// Đọc nhanh cảm biến rò điện: cả 4 thanh ghi (dòng DC, dòng AC, 2 ngưỡng) trong một giao dịch Modbus,
+// mỗi mẫu được cộng vào cửa sổ thống kê để không bỏ sót xung rò ngắn giữa 2 chu kỳ publish
+void sampleLeakSensor()
 {
-    // float newLeakACCurrent = MD0630T01A_getACCurrent(&leakSensor); // Đọc dòng rò điện mới
-    float newLeakACCurrent = 0.0; // Kiểm tra trạng thái rò điện mới
+    leakSampleValid = MD0630T01A_readAll(&leakSensor, &leakSample);
+    LeakWindow_addSample(millis(), leakSampleValid ? &leakSample : NULL);
+}
+
+// Bảng kênh đo của cảm biến rò điện: dòng rò AC, không chờ warm-up
+static const ChangeChannel leakChannels[] = {
+    {CHANGE_LEAK_AC_CURRENT, 0, &leakACGate},
+};
 
-    // Kiểm tra có thay đổi dòng rò điện so với lần trước không
-    changed.changeLeakACCurrent = fabs(newLeakACCurrent - lastLeakACCurrent) > LEAK_AC_DELTA_MIN;
+// Gói trạng thái cảnh báo dòng rò vào đúng vị trí bit thay đổi của chúng
+static ChangeMask leakStates(const LeakSensorData &data)
+{
+    return ChangeEngine_state(data.acSoftWarning, CHANGE_LEAK_SOFT_WARNING) |
+           ChangeEngine_state(data.acStrongWarning, CHANGE_LEAK_STRONG_WARNING);
+}
 
-    // Nếu có thay đổi dòng rò điện thì cập nhật giá trị mới
-    if (changed.changeLeakACCurrent)
+// Xử lý mẫu rò điện gần nhất, cập nhật trạng thái cảnh báo và bit thay đổi
+void handleLeakSensor(bool &warning, ChangeSet &changed)
+{
+    const LeakSensorData sample = leakSample;
+    if (!leakSampleValid)
+    {
+        leakSensorData.valid = false; // Giữ giá trị cũ, trạng thái cảnh báo tính lại từ giá trị đó
+    }
+    else
     {
-        leakSensorData.acCurrent = newLeakACCurrent;
-        lastLeakACCurrent = newLeakACCurrent;
+        leakSensorData.dcCurrent = sample.dcCurrent;
+        leakSensorData.dcThreshold = sample.dcThreshold;
+        leakSensorData.acThreshold = sample.acThreshold;
+        leakSensorData.valid = true;
+    }
+    // Dòng rò AC mới: giá trị thanh ghi (0.1 mA) như đọc được, không qua float; mẫu lỗi thì giữ giá trị đã publish
+    const int32_t newLeakACCurrent = leakSensorData.valid ? (int32_t)sample.acCurrentRaw : lastLeakACCurrent;
+
+    // Kiểm tra có thay đổi dòng rò điện so với lần trước không, nếu có thì cập nhật giá trị mới
+    const ChangeMask currentChanged = ChangeEngine_evaluate(leakChannels, sizeof(leakChannels) / sizeof(leakChannels[0]),
+                                                            &newLeakACCurrent, &lastLeakACCurrent, 0, 0);
+    if (currentChanged != 0)
+    {
+        leakSensorData.acCurrent = sample.acCurrent;
+        leakSensorData.acCurrentRaw = sample.acCurrentRaw;
     }
 
     // Cập nhật trạng thái dòng rò điện mới nếu có thay đổi
+    const ChangeMask prevStates = leakStates(leakSensorData);
     bool newSoftWarning = (leakSensorData.acCurrent >= AC_LEAK_THRESHOLD_SOFT && leakSensorData.acCurrent < AC_LEAK_THRESHOLD_STRONG);
     bool newStrongWarning = (leakSensorData.acCurrent >= AC_LEAK_THRESHOLD_STRONG);
 
-    // Kiểm tra có thay đổi trạng thái cảnh báo dòng rò điện không
-    changed.softWarning = (leakSensorData.acSoftWarning != newSoftWarning);
-    changed.strongWarning = (leakSensorData.acStrongWarning != newStrongWarning);
-
     // Cập nhật các trạng thái cảnh báo theo ngưỡng dòng rò điện
     leakSensorData.acSoftWarning = newSoftWarning;
     leakSensorData.acStrongWarning = newStrongWarning;
 
+    // Bit thay đổi: dòng rò và các trạng thái cảnh báo vừa đổi
+    changed.cart |= currentChanged | ChangeEngine_transitions(prevStates, leakStates(leakSensorData));
+
+    // Trạng thái các chân cảnh báo phần cứng, do đường ngắt LeakAlarm cập nhật ngay khi có cạnh
+    const uint8_t alarmPins = LeakAlarm_activePins();
+    leakSensorData.overDC = (alarmPins & LEAK_ALARM_PIN_DO) != 0;
+    leakSensorData.overAC = (alarmPins & LEAK_ALARM_PIN_AO) != 0;
+    leakSensorData.overDA = (alarmPins & LEAK_ALARM_PIN_DA) != 0;
+
     // Nếu có bất kỳ cảnh báo nào thì set warning = true để xử lý cảnh báo ngoài loop
-    if (newSoftWarning || newStrongWarning)
+    if (newSoftWarning || newStrongWarning || alarmPins != 0)
     {
         warning = true;
     }
 }
 
-// Xử lý cảm biến môi trường, cập nhật trạng thái cảnh báo và flag thay đổi
-void handleES35SW(bool &warning, teHuCartChangedFlags &cartChanged, teHuDecviceChangedFlags &deviceChanged)
+// Bảng kênh đo của cảm biến môi trường (theo thứ tự ES35_CHANNEL), không chờ warm-up
+static const ChangeChannel es35Channels[ES35_CH_COUNT] = {
+    [ES35_CH_TEMPERATURE] = {CHANGE_TEMPERATURE, 0, &es35TempGate},
+    [ES35_CH_HUMIDITY]    = {CHANGE_HUMIDITY, 0, &es35HumiGate},
+};
+
+// Gói trạng thái ngưỡng phòng/thiết bị chung vào đúng vị trí bit thay đổi của chúng
+static ChangeMask es35CartStates(const ES35SWData_Cart &cart)
+{
+    return ChangeEngine_state(cart.over_room_temp_max, CHANGE_OVER_ROOM_TEMP) |
+           ChangeEngine_state(cart.under_room_temp_min, CHANGE_UNDER_ROOM_TEMP) |
+           ChangeEngine_state(cart.over_room_humi_max, CHANGE_OVER_ROOM_HUMI) |
+           ChangeEngine_state(cart.under_room_humi_min, CHANGE_UNDER_ROOM_HUMI) |
+           ChangeEngine_state(cart.over_com_device_temp_max, CHANGE_OVER_COM_DEVICE_TEMP) |
+           ChangeEngine_state(cart.under_com_device_temp_min, CHANGE_UNDER_COM_DEVICE_TEMP) |
+           ChangeEngine_state(cart.over_com_device_humi_max, CHANGE_OVER_COM_DEVICE_HUMI) |
+           ChangeEngine_state(cart.under_com_device_humi_min, CHANGE_UNDER_COM_DEVICE_HUMI);
+}
+
+// Gói trạng thái ngưỡng hoạt động của một thiết bị vào đúng vị trí bit thay đổi của chúng
+static ChangeMask es35DeviceStates(const ES35SWData_Device &device)
+{
+    return ChangeEngine_state(device.over_temp_max, CHANGE_OVER_DEVICE_TEMP) |
+           ChangeEngine_state(device.under_temp_min, CHANGE_UNDER_DEVICE_TEMP) |
+           ChangeEngine_state(device.over_humi_max, CHANGE_OVER_DEVICE_HUMI) |
+           ChangeEngine_state(device.under_humi_min, CHANGE_UNDER_DEVICE_HUMI);
+}
+
+// Xử lý cảm biến môi trường, cập nhật trạng thái cảnh báo và bit thay đổi
+void handleES35SW(bool &warning, ChangeSet &changed)
 {
     if (ES35SW_update(&es35swCart)) // Đọc dữ liệu mới từ cảm biến môi trường
     {
         if (es35swCart.valid)
         {
-            float temp = ES35SW_getTemperature(&es35swCart); // Đọc nhiệt độ mới
-            float humi = ES35SW_getHumidity(&es35swCart);    // Đọc độ ẩm mới
-
-            // Tính delta động cho nhiệt độ và độ ẩm
-            float delta_temp = calculateDeltaES35(temp, ES35_ACCURACY_TEMP, ES35_RESOLUTION_TEMP, ES35_SIGMA_TEMP, ES35_DELTA_FU, ES35_DELTA_N_LSB, ES35_DELTA_TEMP_MIN);
-            float delta_humi = calculateDeltaES35(humi, ES35_ACCURACY_HUMI, ES35_RESOLUTION_HUMI, ES35_SIGMA_HUMI, ES35_DELTA_FU, ES35_DELTA_N_LSB, ES35_DELTA_HUMI_MIN);
-
-            // Kiểm tra có thay đổi nhiệt độ/độ ẩm so với lần trước không
-            cartChanged.temperature = fabs(temp - lastESTemp) > delta_temp;
-            cartChanged.humidity = fabs(humi - lastESHumi) > delta_humi;
-
-            cartChanged.overRoomTemp = false;
-            cartChanged.underRoomTemp = false;
-            cartChanged.overRoomHumi = false;
-            cartChanged.underRoomHumi = false;
-            cartChanged.overComDeviceTemp = false;
-            cartChanged.underComDeviceTemp = false;
-            cartChanged.overComDeviceHumi = false;
-
-            // Nếu có thay đổi nhiệt độ thì cập nhật giá trị mới
-            if (cartChanged.temperature)
+            const Temperature temp = ES35SW_getTemperature(&es35swCart); // Đọc nhiệt độ mới
+            const Humidity humi = ES35SW_getHumidity(&es35swCart);       // Đọc độ ẩm mới
+
+            // Kiểm tra có thay đổi nhiệt độ/độ ẩm so với lần trước không (delta động, số nguyên)
+            const int32_t values[ES35_CH_COUNT] = {[ES35_CH_TEMPERATURE] = temp.raw, [ES35_CH_HUMIDITY] = humi.raw};
+            const ChangeMask measured = ChangeEngine_evaluate(es35Channels, ES35_CH_COUNT, values, lastES35, 0, 0);
+
+            // Nếu có thay đổi nhiệt độ/độ ẩm thì cập nhật giá trị mới
+            if (measured & CHANGE_BIT(CHANGE_TEMPERATURE))
             {
                 es35swCart.temperature = temp;
-                lastESTemp = temp;
             }
-            // Nếu có thay đổi độ ẩm thì cập nhật giá trị mới
-            if (cartChanged.humidity)
+            if (measured & CHANGE_BIT(CHANGE_HUMIDITY))
             {
                 es35swCart.humidity = humi;
-                lastESHumi = humi;
             }
 
-            bool preOverRoomTemp = es35swCart.over_room_temp_max;
-            bool preUnderRoomTemp = es35swCart.under_room_temp_min;
-            bool preOverRoomHumi = es35swCart.over_room_humi_max;
-            bool preUnderRoomHumi = es35swCart.under_room_humi_min;
-            bool preOverComDeviceTemp = es35swCart.over_com_device_temp_max;
-            bool preUnderComDeviceTemp = es35swCart.under_com_device_temp_min;
-            bool preOverComDeviceHumi = es35swCart.over_com_device_humi_max;
-            bool preUnderComDeviceHumi = es35swCart.under_com_device_humi_min;
-
-            es35swCart.over_room_temp_max = (es35swCart.temperature > ROOM_TEMP_MAX);
-            es35swCart.under_room_temp_min = (es35swCart.temperature < ROOM_TEMP_MIN);
-            es35swCart.over_room_humi_max = (es35swCart.humidity > ROOM_HUMI_MAX);
-            es35swCart.under_room_humi_min = (es35swCart.humidity < ROOM_HUMI_MIN && es35swCart.humidity != 0);
-
-            es35swCart.over_com_device_temp_max = (es35swCart.temperature > COMMON_DEVICE_TEMP_MAX);
-            es35swCart.under_com_device_temp_min = (es35swCart.temperature < COMMON_DEVICE_TEMP_MIN);
-            es35swCart.over_com_device_humi_max = (es35swCart.humidity > COMMON_DEVICE_HUMI_MAX);
-            es35swCart.under_com_device_humi_min = (es35swCart.humidity < COMMON_DEVICE_HUMI_MIN && es35swCart.humidity != 0);
-
-            // Kiểm tra có thay đổi trạng thái quá nhiệt/quá ẩm không
-            cartChanged.overRoomTemp = (es35swCart.over_room_temp_max != preOverRoomTemp);
-            cartChanged.underRoomTemp = (es35swCart.under_room_temp_min != preUnderRoomTemp);
-            cartChanged.overRoomHumi = (es35swCart.over_room_humi_max != preOverRoomHumi);
-            cartChanged.underRoomHumi = (es35swCart.under_room_humi_min != preUnderRoomHumi);
-
-            cartChanged.overComDeviceTemp = (es35swCart.over_com_device_temp_max != preOverComDeviceTemp);
-            cartChanged.underComDeviceTemp = (es35swCart.under_com_device_temp_min != preUnderComDeviceTemp);
-            cartChanged.overComDeviceHumi = (es35swCart.over_com_device_humi_max != preOverComDeviceHumi);
-            cartChanged.underComDeviceHumi = (es35swCart.under_com_device_humi_min != preUnderComDeviceHumi);
+            const ChangeMask prevCartStates = es35CartStates(es35swCart);
+
+            es35swCart.over_room_temp_max = (es35swCart.temperature > Temperature(ROOM_TEMP_MAX));
+            es35swCart.under_room_temp_min = (es35swCart.temperature < Temperature(ROOM_TEMP_MIN));
+            es35swCart.over_room_humi_max = (es35swCart.humidity > Humidity(ROOM_HUMI_MAX));
+            es35swCart.under_room_humi_min = (es35swCart.humidity < Humidity(ROOM_HUMI_MIN) && es35swCart.humidity.raw != 0);
+
+            es35swCart.over_com_device_temp_max = (es35swCart.temperature > Temperature(COMMON_DEVICE_TEMP_MAX));
+            es35swCart.under_com_device_temp_min = (es35swCart.temperature < Temperature(COMMON_DEVICE_TEMP_MIN));
+            es35swCart.over_com_device_humi_max = (es35swCart.humidity > Humidity(COMMON_DEVICE_HUMI_MAX));
+            es35swCart.under_com_device_humi_min = (es35swCart.humidity < Humidity(COMMON_DEVICE_HUMI_MIN) && es35swCart.humidity.raw != 0);
+
+            // Bit thay đổi: nhiệt độ/độ ẩm và các trạng thái quá nhiệt/quá ẩm vừa đổi
+            changed.cart |= measured | ChangeEngine_transitions(prevCartStates, es35CartStates(es35swCart));
 
             for (SOCKET_ID id = AUO_DISPLAY; id < NUM_DEVICES; id = (SOCKET_ID)(id + 1))
             {
-                bool prevOverTemp = es35swDevice[id].over_temp_max;
-                bool prevUnderTemp = es35swDevice[id].under_temp_min;
-                bool prevOverHumi = es35swDevice[id].over_humi_max;
-                bool prevUnderHumi = es35swDevice[id].under_humi_min;
+                const ChangeMask prevStates = es35DeviceStates(es35swDevice[id]);
 
                 es35swDevice[id].over_temp_max = (es35swCart.temperature > es35swThresholds[id].temperature_max);
                 es35swDevice[id].under_temp_min = (es35swCart.temperature < es35swThresholds[id].temperature_min);
                 es35swDevice[id].over_humi_max = (es35swCart.humidity > es35swThresholds[id].humidity_max);
-                es35swDevice[id].under_humi_min = (es35swCart.humidity < es35swThresholds[id].humidity_min && es35swCart.humidity != 0);
+                es35swDevice[id].under_humi_min = (es35swCart.humidity < es35swThresholds[id].humidity_min && es35swCart.humidity.raw != 0);
 
                 // Kiểm tra có thay đổi trạng thái quá nhiệt/quá ẩm không
-                deviceChanged.overDeviceTemp[id] = (es35swDevice[id].over_temp_max != prevOverTemp);
-                deviceChanged.underDeviceTemp[id] = (es35swDevice[id].under_temp_min != prevUnderTemp);
-                deviceChanged.overDeviceHumi[id] = (es35swDevice[id].over_humi_max != prevOverHumi);
-                deviceChanged.underDeviceHumi[id] = (es35swDevice[id].under_humi_min != prevUnderHumi);
+                const ChangeMask states = es35DeviceStates(es35swDevice[id]);
+                changed.device[id] |= ChangeEngine_transitions(prevStates, states);
 
-                if (es35swDevice[id].over_temp_max || es35swDevice[id].under_temp_min ||
-                    es35swDevice[id].over_humi_max || es35swDevice[id].under_humi_min)
+                if (states != 0)
                 {
                     warning = true; // Nếu có thiết bị nào vượt ngưỡng thì cảnh báo
                 }
@@ -451,7 +484,32 @@ static constexpr uint32_t PZEM_MACHINE_WARMUP_TIME = 3000;
 // }
 
 /////////////////////////////
-void handlePZEMSensors(bool &warning, PZEMChangedFlags &changed)
+// Cổng warm-up của các kênh đo PZEM (ChangeChannel::gates)
+#define PZEM_GATE_REF 0x01  // Điện áp tham chiếu (AUO_DISPLAY) đã sẵn sàng
+#define PZEM_GATE_LINE 0x02 // Hết warm-up sau khi cảm biến valid trở lại
+#define PZEM_GATE_LOAD 0x04 // Hết warm-up sau khi máy bật
+
+// Bảng kênh đo PZEM (theo thứ tự PZEM_CHANNEL): điện áp/tần số chờ warm-up valid, dòng/công suất/PF chờ thêm warm-up máy
+static const ChangeChannel pzemChannels[PZEM_CH_COUNT] = {
+    [PZEM_CH_VOLTAGE]   = {CHANGE_VOLTAGE, PZEM_GATE_REF | PZEM_GATE_LINE, &pzemVoltageGate},
+    [PZEM_CH_CURRENT]   = {CHANGE_CURRENT, PZEM_GATE_LINE | PZEM_GATE_LOAD, &pzemCurrentGate},
+    [PZEM_CH_POWER]     = {CHANGE_POWER, PZEM_GATE_LINE | PZEM_GATE_LOAD, &pzemPowerGate},
+    [PZEM_CH_FREQUENCY] = {CHANGE_FREQUENCY, PZEM_GATE_LINE, &pzemFreqGate},
+    [PZEM_CH_PF]        = {CHANGE_PF, PZEM_GATE_LINE | PZEM_GATE_LOAD, &pzemPfGate},
+};
+
+// Giá trị thô các kênh đo của một ổ cắm, điện áp là giá trị gửi lên dashboard
+static void pzemChannelValues(int32_t values[PZEM_CH_COUNT], const PZEMData &data, Voltage v_send)
+{
+    values[PZEM_CH_VOLTAGE] = v_send.raw;
+    values[PZEM_CH_CURRENT] = data.current.raw;
+    values[PZEM_CH_POWER] = data.power.raw;
+    values[PZEM_CH_FREQUENCY] = data.frequency.raw;
+    values[PZEM_CH_PF] = data.pf.raw;
+}
+
+// Đánh giá dữ liệu PZEM mới nhất (không đọc bus), cập nhật cảnh báo và bit thay đổi
+void handlePZEMSensors(bool &warning, ChangeSet &changed)
 {
     static uint32_t validRiseTime[NUM_DEVICES]   = {0};
     static bool     validWarmup[NUM_DEVICES]     = {false};
@@ -461,114 +519,69 @@ void handlePZEMSensors(bool &warning, PZEMChangedFlags &changed)
 
     static bool bootSnapshotSent = false;
 
-    for (SOCKET_ID id = AUO_DISPLAY; id < NUM_DEVICES; id = (SOCKET_ID)(id + 1))
-    {
-        readPZEM(id);
-        delay(150);
-    }
-
+    // Dữ liệu sensorData[] đã được các job đọc PZEM riêng của từng ổ cắm cập nhật trước đó
     const uint32_t now = millis();
 
     // ========================= BOOT SNAPSHOT =========================
     if (!bootSnapshotSent)
     {
         const bool  ref_ok = sensorData[AUO_DISPLAY].valid;
-        const float v_ref  = sensorData[AUO_DISPLAY].voltage + PZEM0_VOLTAGE_OFFSET;
+        const Voltage v_ref = sensorData[AUO_DISPLAY].voltage + Voltage(PZEM0_VOLTAGE_OFFSET);
 
         for (SOCKET_ID id = AUO_DISPLAY; id < NUM_DEVICES; id = (SOCKET_ID)(id + 1))
         {
-            changed.voltage[id]        = false;
-            changed.current[id]        = false;
-            changed.power[id]          = false;
-            changed.frequency[id]      = false;
-            changed.pf[id]             = false;
-            changed.machineState[id]   = false;
-            changed.overVoltage[id]    = false;
-            changed.underVoltage[id]   = false;
-            changed.overCurrent[id]    = false;
-            changed.overPower[id]      = false;
-            changed.socketState[id]    = false;
-            changed.operating_time[id] = false;
-
             validWarmup[id]  = false;
             machineWarmup[id]= false;
 
+            // Boot snapshot: publish mọi trường điện của mọi ổ cắm
+            changed.device[id] |= DEVICE_ELEC_CHANGES;
+
             if (!sensorData[id].valid)
             {
                 socketState[id] = false;
-                changed.socketState[id] = true;
 
-                sensorData[id].voltage = 0.0f;
-                sensorData[id].current = 0.0f;
-                sensorData[id].power   = 0.0f;
-                sensorData[id].frequency = 0.0f;
-                sensorData[id].pf = 0.0f;
+                sensorData[id].voltage = Voltage();
+                sensorData[id].current = Current();
+                sensorData[id].power   = Power();
+                sensorData[id].frequency = Frequency();
+                sensorData[id].pf = PowerFactor();
                 sensorData[id].machineState = false;
 
                 overVoltage[id] = underVoltage[id] = overCurrent[id] = overPower[id] = false;
 
-                changed.voltage[id]   = true;
-                changed.current[id]   = true;
-                changed.power[id]     = true;
-                changed.frequency[id] = true;
-                changed.pf[id]        = true;
-                changed.machineState[id] = true;
-                changed.overVoltage[id]  = true;
-                changed.underVoltage[id] = true;
-                changed.overCurrent[id]  = true;
-                changed.overPower[id]    = true;
-                changed.operating_time[id] = true;
-
-                lastPZEMVoltage[id] = 0.0f;
-                lastPZEMCurrent[id] = 0.0f;
-                lastPZEMPower[id]   = 0.0f;
-                lastPZEMFreq[id]    = 0.0f;
-                lastPZEMPF[id]      = 0.0f;
-                pzemVoltageCalib[id]= 0.0f;
+                memset(lastPZEM[id], 0, sizeof(lastPZEM[id]));
+                pzemVoltageCalib[id]= Voltage();
 
                 strcpy(last_operating_time[id], "00:00:00");
                 continue;
             }
 
             socketState[id] = true;
-            changed.socketState[id] = true;
 
             const bool rawMachine = (sensorData[id].current > pzemThresholds[id].current_min);
             sensorData[id].machineState = rawMachine;
 
-            float v_send;
-            if (id == AUO_DISPLAY) v_send = sensorData[id].voltage + PZEM0_VOLTAGE_OFFSET;
+            Voltage v_send;
+            if (id == AUO_DISPLAY) v_send = sensorData[id].voltage + Voltage(PZEM0_VOLTAGE_OFFSET);
             else if (ref_ok)
             {
-                const float diff = fabs(sensorData[id].voltage - v_ref);
-                v_send = (diff < PZEM_VOLTAGE_SYNC_THRESHOLD) ? v_ref : sensorData[id].voltage;
-                if (diff >= PZEM_VOLTAGE_SYNC_THRESHOLD)
+                const Voltage diff = (sensorData[id].voltage - v_ref).abs();
+                v_send = (diff < Voltage(PZEM_VOLTAGE_SYNC_THRESHOLD)) ? v_ref : sensorData[id].voltage;
+                if (diff >= Voltage(PZEM_VOLTAGE_SYNC_THRESHOLD))
                 {
                     Serial.printf("[CẢNH BÁO] %s: Điện áp lệch ref quá lớn (%.2fV so với %.2fV)\n",
-                                  SOCKET_NAMES[id], sensorData[id].voltage, v_ref);
+                                  SOCKET_NAMES[id], sensorData[id].voltage.toFloat(), v_ref.toFloat());
                 }
             }
             else v_send = sensorData[id].voltage;
 
             pzemVoltageCalib[id] = v_send;
 
-            changed.voltage[id]   = true;
-            changed.current[id]   = true;
-            changed.power[id]     = true;
-            changed.frequency[id] = true;
-            changed.pf[id]        = true;
-            changed.machineState[id] = true;
-
             overVoltage[id]  = (sensorData[id].voltage > pzemThresholds[id].voltage_max);
             underVoltage[id] = (sensorData[id].voltage < pzemThresholds[id].voltage_min);
             overCurrent[id]  = (sensorData[id].current > pzemThresholds[id].current_max);
             overPower[id]    = (sensorData[id].power   > pzemThresholds[id].power_max);
 
-            changed.overVoltage[id]  = true;
-            changed.underVoltage[id] = true;
-            changed.overCurrent[id]  = true;
-            changed.overPower[id]    = true;
-
             if (overVoltage[id] || underVoltage[id] || overCurrent[id] || overPower[id])
                 warning = true;
 
@@ -603,14 +616,11 @@ void handlePZEMSensors(bool &warning, PZEMChangedFlags &changed)
                 buf[0] = 0;
                 break;
             }
-            changed.operating_time[id] = true;
             strcpy(last_operating_time[id], buf);
 
-            lastPZEMVoltage[id] = v_send;
-            lastPZEMCurrent[id] = sensorData[id].current;
-            lastPZEMPower[id]   = sensorData[id].power;
-            lastPZEMFreq[id]    = sensorData[id].frequency;
-            lastPZEMPF[id]      = sensorData[id].pf;
+            int32_t values[PZEM_CH_COUNT];
+            pzemChannelValues(values, sensorData[id], v_send);
+            ChangeEngine_publishAll(pzemChannels, PZEM_CH_COUNT, values, lastPZEM[id]);
         }
 
         bootSnapshotSent = true;
@@ -625,11 +635,10 @@ void handlePZEMSensors(bool &warning, PZEMChangedFlags &changed)
 
     // ========================= NORMAL OPERATION =========================
     const bool  refReady = sensorData[AUO_DISPLAY].valid && !validWarmup[AUO_DISPLAY];
-    const float v_ref    = sensorData[AUO_DISPLAY].voltage + PZEM0_VOLTAGE_OFFSET;
+    const Voltage v_ref  = sensorData[AUO_DISPLAY].voltage + Voltage(PZEM0_VOLTAGE_OFFSET);
 
-    float v_send[NUM_DEVICES] = {0};
-    bool  allowLine[NUM_DEVICES] = {false};
-    bool  allowLoad[NUM_DEVICES] = {false};
+    int32_t values[NUM_DEVICES][PZEM_CH_COUNT] = {}; // Giá trị thô các kênh đo (điện áp là v_send)
+    uint8_t open[NUM_DEVICES] = {0};                  // Cổng warm-up đang mở (PZEM_GATE_*) của từng ổ cắm
 
     // pass A
     for (SOCKET_ID id = AUO_DISPLAY; id < NUM_DEVICES; id = (SOCKET_ID)(id + 1))
@@ -637,52 +646,35 @@ void handlePZEMSensors(bool &warning, PZEMChangedFlags &changed)
         const bool prevSocketState  = socketState[id];
         const bool prevMachineState = sensorData[id].machineState;  // <-- QUAN TRỌNG cho change detect
 
-        changed.voltage[id]        = false;
-        changed.current[id]        = false;
-        changed.power[id]          = false;
-        changed.frequency[id]      = false;
-        changed.pf[id]             = false;
-        changed.machineState[id]   = false;
-        changed.overVoltage[id]    = false;
-        changed.underVoltage[id]   = false;
-        changed.overCurrent[id]    = false;
-        changed.overPower[id]      = false;
-        changed.socketState[id]    = false;
-        changed.operating_time[id] = false;
-
         if (!sensorData[id].valid)
         {
             socketState[id] = false;
-            changed.socketState[id] = (prevSocketState != false);
+            if (prevSocketState) changed.device[id] |= CHANGE_BIT(CHANGE_SOCKET_STATE);
 
             validWarmup[id]   = false;
             machineWarmup[id] = false;
 
-            sensorData[id].voltage = 0.0f;
-            sensorData[id].current = 0.0f;
-            sensorData[id].power   = 0.0f;
-            sensorData[id].frequency = 0.0f;
-            sensorData[id].pf = 0.0f;
+            sensorData[id].voltage = Voltage();
+            sensorData[id].current = Current();
+            sensorData[id].power   = Power();
+            sensorData[id].frequency = Frequency();
+            sensorData[id].pf = PowerFactor();
 
             // machine_state: OFFLINE thì bắt buộc về false và publish nếu trước đó true
             sensorData[id].machineState = false;
-            if (prevMachineState) changed.machineState[id] = true;   // <-- FIX
+            if (prevMachineState) changed.device[id] |= CHANGE_BIT(CHANGE_MACHINE_STATE);   // <-- FIX
 
-            if (lastPZEMVoltage[id] != 0.0f) { lastPZEMVoltage[id] = 0.0f; changed.voltage[id] = true; }
-            if (lastPZEMCurrent[id] != 0.0f) { lastPZEMCurrent[id] = 0.0f; changed.current[id] = true; }
-            if (lastPZEMPower[id]   != 0.0f) { lastPZEMPower[id]   = 0.0f; changed.power[id] = true; }
-            if (lastPZEMFreq[id]    != 0.0f) { lastPZEMFreq[id]    = 0.0f; changed.frequency[id] = true; }
-            if (lastPZEMPF[id]      != 0.0f) { lastPZEMPF[id]      = 0.0f; changed.pf[id] = true; }
+            // Publish 0 cho các kênh đo chưa về 0
+            changed.device[id] |= ChangeEngine_clear(pzemChannels, PZEM_CH_COUNT, lastPZEM[id]);
 
-            pzemVoltageCalib[id] = 0.0f;
+            pzemVoltageCalib[id] = Voltage();
             continue;
         }
 
         socketState[id] = true;
-        changed.socketState[id] = (prevSocketState != true);
-
         if (!prevSocketState)
         {
+            changed.device[id] |= CHANGE_BIT(CHANGE_SOCKET_STATE);
             validWarmup[id] = true;
             validRiseTime[id] = now;
         }
@@ -702,47 +694,40 @@ void handlePZEMSensors(bool &warning, PZEMChangedFlags &changed)
 
         sensorData[id].machineState = (rawMachine && !machineWarmup[id]);
 
-        allowLine[id] = (!validWarmup[id]);
-        allowLoad[id] = (!validWarmup[id] && !machineWarmup[id]);
+        open[id] = (refReady ? PZEM_GATE_REF : 0) | (!validWarmup[id] ? PZEM_GATE_LINE : 0) |
+                   (!machineWarmup[id] ? PZEM_GATE_LOAD : 0);
+        const bool allowLine = !validWarmup[id];
+        const bool allowLoad = !validWarmup[id] && !machineWarmup[id];
 
         // machine_state: chỉ publish khi allowLoad để tránh nhiễu lúc mới bật máy
-        if (allowLoad[id] && (sensorData[id].machineState != prevMachineState))
+        if (allowLoad && (sensorData[id].machineState != prevMachineState))
         {
-            changed.machineState[id] = true;   // <-- FIX
+            changed.device[id] |= CHANGE_BIT(CHANGE_MACHINE_STATE);   // <-- FIX
         }
 
-        if (!refReady || !allowLine[id]) v_send[id] = lastPZEMVoltage[id];
-        else if (id == AUO_DISPLAY)      v_send[id] = sensorData[id].voltage + PZEM0_VOLTAGE_OFFSET;
+        Voltage v_send;
+        if (!refReady || !allowLine)     v_send = Voltage::fromRaw(lastPZEM[id][PZEM_CH_VOLTAGE]);
+        else if (id == AUO_DISPLAY)      v_send = sensorData[id].voltage + Voltage(PZEM0_VOLTAGE_OFFSET);
         else
         {
-            const float diff = fabs(sensorData[id].voltage - v_ref);
-            v_send[id] = (diff < PZEM_VOLTAGE_SYNC_THRESHOLD) ? v_ref : sensorData[id].voltage;
-            if (diff >= PZEM_VOLTAGE_SYNC_THRESHOLD)
+            const Voltage diff = (sensorData[id].voltage - v_ref).abs();
+            v_send = (diff < Voltage(PZEM_VOLTAGE_SYNC_THRESHOLD)) ? v_ref : sensorData[id].voltage;
+            if (diff >= Voltage(PZEM_VOLTAGE_SYNC_THRESHOLD))
             {
                 Serial.printf("[CẢNH BÁO] %s: Điện áp lệch ref quá lớn (%.2fV so với %.2fV)\n",
-                              SOCKET_NAMES[id], sensorData[id].voltage, v_ref);
+                              SOCKET_NAMES[id], sensorData[id].voltage.toFloat(), v_ref.toFloat());
             }
         }
-        pzemVoltageCalib[id] = v_send[id];
+        pzemVoltageCalib[id] = v_send;
+        pzemChannelValues(values[id], sensorData[id], v_send);
     }
 
-    bool broadcastVoltage = false;
-    if (refReady)
+    // Một ổ cắm đổi điện áp thì gửi lại điện áp của mọi ổ cắm đang mở cổng (cùng nguồn lưới)
+    ChangeMask broadcastVoltage = 0;
+    for (SOCKET_ID id = AUO_DISPLAY; id < NUM_DEVICES && broadcastVoltage == 0; id = (SOCKET_ID)(id + 1))
     {
-        for (SOCKET_ID id = AUO_DISPLAY; id < NUM_DEVICES; id = (SOCKET_ID)(id + 1))
-        {
-            if (!sensorData[id].valid || !allowLine[id]) continue;
-
-            const float delta_v = calculateDelta(v_send[id],
-                                                PZEM_ACCURACY_VOLTAGE, PZEM_RESOLUTION_VOLTAGE, PZEM_SIGMA_VOLTAGE,
-                                                PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_VOLTAGE_MIN);
-
-            if (fabs(v_send[id] - lastPZEMVoltage[id]) > delta_v)
-            {
-                broadcastVoltage = true;
-                break;
-            }
-        }
+        broadcastVoltage = ChangeEngine_pending(&pzemChannels[PZEM_CH_VOLTAGE], 1, &values[id][PZEM_CH_VOLTAGE],
+                                                &lastPZEM[id][PZEM_CH_VOLTAGE], open[id]);
     }
 
     // pass B
@@ -750,63 +735,12 @@ void handlePZEMSensors(bool &warning, PZEMChangedFlags &changed)
     {
         if (!sensorData[id].valid) continue;
 
-        if (refReady && allowLine[id] && broadcastVoltage)
-        {
-            changed.voltage[id] = true;
-            lastPZEMVoltage[id] = v_send[id];
-        }
-        else if (refReady && allowLine[id])
-        {
-            const float delta_v = calculateDelta(v_send[id],
-                                                PZEM_ACCURACY_VOLTAGE, PZEM_RESOLUTION_VOLTAGE, PZEM_SIGMA_VOLTAGE,
-                                                PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_VOLTAGE_MIN);
-            if (fabs(v_send[id] - lastPZEMVoltage[id]) > delta_v)
-            {
-                changed.voltage[id] = true;
-                lastPZEMVoltage[id] = v_send[id];
-            }
-        }
-
-        if (allowLine[id])
-        {
-            const float delta_f = calculateDelta(sensorData[id].frequency,
-                                                PZEM_ACCURACY_FREQ, PZEM_RESOLUTION_FREQ, PZEM_SIGMA_FREQ,
-                                                PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_FREQ_MIN);
-            if (fabs(sensorData[id].frequency - lastPZEMFreq[id]) > delta_f)
-            {
-                changed.frequency[id] = true;
-                lastPZEMFreq[id] = sensorData[id].frequency;
-            }
-        }
+        // Mọi kênh đo trong một vòng: kênh có cổng warm-up đang mở và vượt delta thì publish
+        changed.device[id] |= ChangeEngine_evaluate(pzemChannels, PZEM_CH_COUNT, values[id], lastPZEM[id], open[id],
+                                                    broadcastVoltage);
 
-        if (allowLoad[id])
+        if ((open[id] & (PZEM_GATE_LINE | PZEM_GATE_LOAD)) == (PZEM_GATE_LINE | PZEM_GATE_LOAD))
         {
-            const float delta_i = calculateDelta(sensorData[id].current,
-                                                PZEM_ACCURACY_CURRENT, PZEM_RESOLUTION_CURRENT, PZEM_SIGMA_CURRENT,
-                                                PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_CURRENT_MIN);
-            const float delta_p = calculateDelta(sensorData[id].power,
-                                                PZEM_ACCURACY_POWER, PZEM_RESOLUTION_POWER, PZEM_SIGMA_POWER,
-                                                PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_POWER_MIN);
-            const float delta_pf = calculateDelta(sensorData[id].pf,
-                                                 PZEM_ACCURACY_PF, PZEM_RESOLUTION_PF, PZEM_SIGMA_PF,
-                                                 PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_PF_MIN);
-
-            if (fabs(sensorData[id].current - lastPZEMCurrent[id]) > delta_i)
-            {
-                changed.current[id] = true;
-                lastPZEMCurrent[id] = sensorData[id].current;
-            }
-            if (fabs(sensorData[id].power - lastPZEMPower[id]) > delta_p)
-            {
-                changed.power[id] = true;
-                lastPZEMPower[id] = sensorData[id].power;
-            }
-            if (fabs(sensorData[id].pf - lastPZEMPF[id]) > delta_pf)
-            {
-                changed.pf[id] = true;
-                lastPZEMPF[id] = sensorData[id].pf;
-            }
-
             char buf[16] = {0};
             switch (id)
             {
@@ -841,7 +775,7 @@ void handlePZEMSensors(bool &warning, PZEMChangedFlags &changed)
 
             if (strcmp(buf, last_operating_time[id]) != 0)
             {
-                changed.operating_time[id] = true;
+                changed.device[id] |= CHANGE_BIT(CHANGE_OPERATING_TIME);
                 strcpy(last_operating_time[id], buf);
             }
         }
@@ -860,22 +794,23 @@ void handlePZEMSensors(bool &warning, PZEMChangedFlags &changed)
 
 
 // In toàn bộ snapshot dữ liệu cảm biến lên Serial để debug, kiểm tra hệ thống
-void printSensorSnapshot()
+// Dữ liệu rò điện lấy từ bản sao trong snapshot vì task rò điện cập nhật leakSensorData song song
+void printSensorSnapshot(const LeakSensorData &leak)
 {
     Serial.println();
     Serial.println("=============== SENSOR SNAPSHOT ===============");
 
     // Leak sensor
     Serial.println("[LEAK SENSOR]");
-    Serial.printf("  AC Current: %.2f mA (Threshold: %.2f mA)\n", leakSensorData.acCurrent, leakSensorData.acThreshold);
+    Serial.printf("  AC Current: %.2f mA (Threshold: %.2f mA)\n", leak.acCurrent, leak.acThreshold);
     Serial.printf("  Soft Warning: %s | Strong Warning: %s\n",
-                  leakSensorData.acSoftWarning ? "YES" : "NO",
-                  leakSensorData.acStrongWarning ? "YES" : "NO");
+                  leak.acSoftWarning ? "YES" : "NO",
+                  leak.acStrongWarning ? "YES" : "NO");
 
     // ES35-SW environment sensor
     Serial.println("\n[ES35-SW ENVIRONMENT]");
     Serial.printf("  Temp: %.2f°C | Humi: %.2f%% | Valid: %s\n",
-                  es35swCart.temperature, es35swCart.humidity, es35swCart.valid ? "YES" : "NO");
+                  es35swCart.temperature.toFloat(), es35swCart.humidity.toFloat(), es35swCart.valid ? "YES" : "NO");
     Serial.printf("  Over Room Temp: %s | Under Room Temp: %s | Over Room Humi: %s | Under Room Humi: %s\n",
                   es35swCart.over_room_temp_max ? "YES" : "NO",
                   es35swCart.under_room_temp_min ? "YES" : "NO",
@@ -903,14 +838,17 @@ void printSensorSnapshot()
                           sensorData[id].valid ? "YES" : "NO",
                           socketState[id] ? "YES" : "NO");
             Serial.printf("    [MQTT] U=%.2fV I=%.3fA P=%.1fW F=%.2fHz PF=%.2f\n",
-                          pzemVoltageCalib[id], sensorData[id].current, sensorData[id].power,
-                          sensorData[id].frequency, sensorData[id].pf);
+                          pzemVoltageCalib[id].toFloat(), sensorData[id].current.toFloat(), sensorData[id].power.toFloat(),
+                          sensorData[id].frequency.toFloat(), sensorData[id].pf.toFloat());
             Serial.printf("    [RAW ] U=%.2fV I=%.3fA P=%.1fW F=%.2fHz PF=%.2f\n",
-                          sensorData[id].voltage, sensorData[id].current, sensorData[id].power,
-                          sensorData[id].frequency, sensorData[id].pf);
+                          sensorData[id].voltage.toFloat(), sensorData[id].current.toFloat(), sensorData[id].power.toFloat(),
+                          sensorData[id].frequency.toFloat(), sensorData[id].pf.toFloat());
             Serial.printf("    [LAST] U=%.2fV I=%.3fA P=%.1fW F=%.2fHz PF=%.2f\n",
-                          lastPZEMVoltage[id], lastPZEMCurrent[id], lastPZEMPower[id],
-                          lastPZEMFreq[id], lastPZEMPF[id]);
+                          Voltage::fromRaw(lastPZEM[id][PZEM_CH_VOLTAGE]).toFloat(),
+                          Current::fromRaw(lastPZEM[id][PZEM_CH_CURRENT]).toFloat(),
+                          Power::fromRaw(lastPZEM[id][PZEM_CH_POWER]).toFloat(),
+                          Frequency::fromRaw(lastPZEM[id][PZEM_CH_FREQUENCY]).toFloat(),
+                          PowerFactor::fromRaw(lastPZEM[id][PZEM_CH_PF]).toFloat());
             Serial.printf("    OverV: %s | UnderV: %s | OverI: %s | OverP: %s\n",
                           overVoltage[id] ? "YES" : "NO",
                           underVoltage[id] ? "YES" : "NO",
@@ -935,40 +873,52 @@ void printSensorSnapshot()
     op_time_counter_get_formatted(&op_time_UI400, buf, sizeof(buf));
     Serial.printf("  ENDOFLATOR_UI400: %s\n", buf);
 
-    // Delta snapshot
+    // Delta snapshot: thay đổi nhỏ nhất được publish tại giá trị hiện tại
     Serial.println("\n[DELTA SNAPSHOT]");
     for (SOCKET_ID id = AUO_DISPLAY; id < NUM_DEVICES; id = (SOCKET_ID)(id + 1))
     {
-        float delta_voltage = calculateDelta(sensorData[id].voltage, PZEM_ACCURACY_VOLTAGE, PZEM_RESOLUTION_VOLTAGE, PZEM_SIGMA_VOLTAGE, PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_VOLTAGE_MIN);
-        float delta_current = calculateDelta(sensorData[id].current, PZEM_ACCURACY_CURRENT, PZEM_RESOLUTION_CURRENT, PZEM_SIGMA_CURRENT, PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_CURRENT_MIN);
-        float delta_power = calculateDelta(sensorData[id].power, PZEM_ACCURACY_POWER, PZEM_RESOLUTION_POWER, PZEM_SIGMA_POWER, PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_POWER_MIN);
-        float delta_freq = calculateDelta(sensorData[id].frequency, PZEM_ACCURACY_FREQ, PZEM_RESOLUTION_FREQ, PZEM_SIGMA_FREQ, PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_FREQ_MIN);
-        float delta_pf = calculateDelta(sensorData[id].pf, PZEM_ACCURACY_PF, PZEM_RESOLUTION_PF, PZEM_SIGMA_PF, PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_PF_MIN);
+        const Voltage delta_voltage = pzemVoltageGate.step(sensorData[id].voltage);
+        const Current delta_current = pzemCurrentGate.step(sensorData[id].current);
+        const Power delta_power = pzemPowerGate.step(sensorData[id].power);
+        const Frequency delta_freq = pzemFreqGate.step(sensorData[id].frequency);
+        const PowerFactor delta_pf = pzemPfGate.step(sensorData[id].pf);
 
         Serial.printf("  [%s] ΔU=%.3fV ΔI=%.4fA ΔP=%.2fW ΔF=%.3fHz ΔPF=%.3f\n",
-                      SOCKET_NAMES[id], delta_voltage, delta_current, delta_power, delta_freq, delta_pf);
+                      SOCKET_NAMES[id], delta_voltage.toFloat(), delta_current.toFloat(), delta_power.toFloat(),
+                      delta_freq.toFloat(), delta_pf.toFloat());
     }
-    float delta_temp = calculateDeltaES35(es35swCart.temperature, ES35_ACCURACY_TEMP, ES35_RESOLUTION_TEMP, ES35_SIGMA_TEMP, ES35_DELTA_FU, ES35_DELTA_N_LSB, ES35_DELTA_TEMP_MIN);
-    float delta_humi = calculateDeltaES35(es35swCart.humidity, ES35_ACCURACY_HUMI, ES35_RESOLUTION_HUMI, ES35_SIGMA_HUMI, ES35_DELTA_FU, ES35_DELTA_N_LSB, ES35_DELTA_HUMI_MIN);
-    Serial.printf("  [ES35-SW] ΔTemp=%.3f°C ΔHumi=%.3f%%\n", delta_temp, delta_humi);
+    const Temperature delta_temp = es35TempGate.step(es35swCart.temperature);
+    const Humidity delta_humi = es35HumiGate.step(es35swCart.humidity);
+    Serial.printf("  [ES35-SW] ΔTemp=%.3f°C ΔHumi=%.3f%%\n", delta_temp.toFloat(), delta_humi.toFloat());
 
     Serial.println("=============== END SNAPSHOT ==================");
     Serial.println();
 }
 
+// Xử lý còi cảnh báo: chọn mẫu âm theo mức độ, chỉ xếp hàng phát (không chặn)
 void handleWarningBeep(bool warning)
 {
     static bool warningActive = false;
+    static BuzzerPriority activePriority = BUZZER_PRIORITY_WARNING;
 
     if (warning)
     {
+        // Rò điện mạnh > rò điện nhẹ > các cảnh báo ngưỡng khác
+        const BuzzerPattern *pattern = &BUZZER_PATTERN_WARNING;
+        if (leakSensorData.acStrongWarning || LeakAlarm_activePins() != 0) // Chân cảnh báo phần cứng = rò điện mạnh
+            pattern = &BUZZER_PATTERN_LEAK_STRONG;
+        else if (leakSensorData.acSoftWarning)
+            pattern = &BUZZER_PATTERN_LEAK_SOFT;
+
         unsigned long now = millis();
-        if (!warningActive || now - lastWarningBeepTime >= warningBeepInterval)
+        // Phát lại sau mỗi warningBeepInterval, hoặc ngay lập tức nếu mức cảnh báo tăng lên
+        if (!warningActive || now - lastWarningBeepTime >= warningBeepInterval || pattern->priority > activePriority)
         {
-            playWarningTone(); // Phát còi cảnh báo
+            Buzzer_play(pattern); // Phát còi cảnh báo
             lastWarningBeepTime = now;
             warningActive = true;
         }
+        activePriority = pattern->priority;
     }
     else
     {
@@ -8,55 +8,68 @@
 #include "PZEM016_Lib.h"             // Khai báo cảm biến điện năng (điện áp, dòng, công suất...)
 #include "ES35-SW.h"                 // Khai báo cảm biến môi trường (nhiệt độ, độ ẩm)
 #include "Buzzer.h"                  // Khai báo module cảnh báo âm thanh
+#include "LeakAlarm.h"               // Ngắt GPIO cho các chân cảnh báo DO/AO/DA của cảm biến rò điện
+#include "LeakWindow.h"              // Thống kê theo cửa sổ (min/max/mean/RMS) của dòng rò lấy mẫu nhanh
+#include "ChangeEngine.h"            // Bảng kênh đo và mặt nạ bit thay đổi (ChangeMask)
 
 
-// Struct lưu trạng thái thay đổi của cảm biến nhiệt độ, độ ẩm
-struct teHuCartChangedFlags {
-    bool temperature;                   // Có thay đổi nhiệt độ không
-    bool humidity;                      // Có thay đổi độ ẩm không
-
-    bool overRoomTemp;                  // Có thay đổi trạng thái quá nhiệt phòng không
-    bool underRoomTemp;                 // Có thay đổi trạng thái dưới nhiệt phòng không
-    bool overRoomHumi;                  // Có thay đổi trạng thái quá ẩm phòng không
-    bool underRoomHumi;                 // Có thay đổi trạng thái dưới ẩm phòng không
-
-    bool overComDeviceTemp;             // Có thay đổi trạng thái quá nhiệt thiết bị chung không
-    bool underComDeviceTemp;            // Có thay đổi trạng thái dưới nhiệt thiết bị chung không
-    bool overComDeviceHumi;             // Có thay đổi trạng thái quá ẩm thiết bị chung không
-    bool underComDeviceHumi;            // Có thay đổi trạng thái dưới ẩm thiết bị chung không
+// Bit thay đổi của từng thiết bị (ChangeSet::device[id]), mỗi bit là một trường được publish
+enum DeviceChangeBit
+{
+    // Điện năng (topic điện của thiết bị)
+    CHANGE_VOLTAGE = 0,        // Điện áp
+    CHANGE_CURRENT,            // Dòng điện
+    CHANGE_POWER,              // Công suất
+    CHANGE_FREQUENCY,          // Tần số
+    CHANGE_PF,                 // Hệ số công suất
+    CHANGE_MACHINE_STATE,      // Trạng thái hoạt động
+    CHANGE_OVER_VOLTAGE,       // Trạng thái quá áp
+    CHANGE_OVER_CURRENT,       // Trạng thái quá dòng
+    CHANGE_OVER_POWER,         // Trạng thái quá công suất
+    CHANGE_UNDER_VOLTAGE,      // Trạng thái dưới áp
+    CHANGE_SOCKET_STATE,       // Trạng thái mất nguồn
+    CHANGE_OPERATING_TIME,     // Thời gian hoạt động
+    // Môi trường hoạt động (topic môi trường của thiết bị)
+    CHANGE_OVER_DEVICE_TEMP,   // Trạng thái quá nhiệt hoạt động
+    CHANGE_UNDER_DEVICE_TEMP,  // Trạng thái dưới nhiệt hoạt động
+    CHANGE_OVER_DEVICE_HUMI,   // Trạng thái quá ẩm hoạt động
+    CHANGE_UNDER_DEVICE_HUMI,  // Trạng thái dưới ẩm hoạt động
+    DEVICE_CHANGE_BITS
 };
 
-// Struct lưu trạng thái thay đổi của cảm biến nhiệt độ, độ ẩm
-struct teHuDecviceChangedFlags { 
-    bool overDeviceTemp[NUM_DEVICES];   // Có thay đổi trạng thái quá nhiệt hoạt động từng thiết bị không
-    bool underDeviceTemp[NUM_DEVICES];  // Có thay đổi trạng thái dưới nhiệt hoạt động từng thiết bị không
-    bool overDeviceHumi[NUM_DEVICES];   // Có thay đổi trạng thái quá ẩm hoạt động từng thiết bị không
-    bool underDeviceHumi[NUM_DEVICES];  // Có thay đổi trạng thái dưới ẩm hoạt động từng thiết bị không
+// Bit thay đổi chung của xe đẩy (ChangeSet::cart)
+enum CartChangeBit
+{
+    // Cảm biến môi trường (topic môi trường xe đẩy)
+    CHANGE_TEMPERATURE = 0,       // Nhiệt độ
+    CHANGE_HUMIDITY,              // Độ ẩm
+    CHANGE_OVER_ROOM_TEMP,        // Trạng thái quá nhiệt phòng
+    CHANGE_UNDER_ROOM_TEMP,       // Trạng thái dưới nhiệt phòng
+    CHANGE_OVER_ROOM_HUMI,        // Trạng thái quá ẩm phòng
+    CHANGE_UNDER_ROOM_HUMI,       // Trạng thái dưới ẩm phòng
+    CHANGE_OVER_COM_DEVICE_TEMP,  // Trạng thái quá nhiệt thiết bị chung
+    CHANGE_UNDER_COM_DEVICE_TEMP, // Trạng thái dưới nhiệt thiết bị chung
+    CHANGE_OVER_COM_DEVICE_HUMI,  // Trạng thái quá ẩm thiết bị chung
+    CHANGE_UNDER_COM_DEVICE_HUMI, // Trạng thái dưới ẩm thiết bị chung
+    // Cảm biến dòng rò (topic điện xe đẩy)
+    CHANGE_LEAK_AC_CURRENT,       // Dòng rò AC
+    CHANGE_LEAK_SOFT_WARNING,     // Trạng thái cảnh báo dòng rò nhẹ
+    CHANGE_LEAK_STRONG_WARNING,   // Trạng thái cảnh báo dòng rò mạnh
+    CART_CHANGE_BITS
 };
 
-// Struct lưu trạng thái thay đổi của cảm biến dòng rò
-struct acLeakChangedFlags {
-    bool changeLeakACCurrent; // Có thay đổi dòng rò AC không
-    bool leakStatus;        // Có thay đổi trạng thái rò điện không
-    bool acLeakCurrent;    // Có thay đổi dòng rò điện không
-    bool softWarning;      // Có thay đổi trạng thái cảnh báo dòng rò nhẹ không
-    bool strongWarning;    // Có thay đổi trạng thái cảnh báo dòng rò mạnh không
-};
+static_assert(DEVICE_CHANGE_BITS <= 32 && CART_CHANGE_BITS <= 32, "change bits must fit in a ChangeMask");
+
+// Nhóm bit theo topic publish
+#define DEVICE_ELEC_CHANGES (CHANGE_BITS(CHANGE_OVER_DEVICE_TEMP))                         // Trường của topic điện thiết bị
+#define DEVICE_ENV_CHANGES (CHANGE_BITS(DEVICE_CHANGE_BITS) & ~DEVICE_ELEC_CHANGES)         // Trường của topic môi trường thiết bị
+#define CART_ENV_CHANGES (CHANGE_BITS(CHANGE_LEAK_AC_CURRENT))                             // Trường của topic môi trường xe đẩy
+#define CART_LEAK_CHANGES (CHANGE_BITS(CART_CHANGE_BITS) & ~CART_ENV_CHANGES)              // Trường của topic điện xe đẩy
 
-// Struct lưu trạng thái thay đổi của cảm biến điện năng cho từng thiết bị
-struct PZEMChangedFlags {
-    bool voltage[NUM_DEVICES];        // Có thay đổi điện áp không (mỗi thiết bị)
-    bool current[NUM_DEVICES];        // Có thay đổi dòng điện không
-    bool power[NUM_DEVICES];          // Có thay đổi công suất không
-    bool frequency[NUM_DEVICES];      // Có thay đổi tần số không
-    bool pf[NUM_DEVICES];             // Có thay đổi hệ số công suất không
-    bool machineState[NUM_DEVICES];          // Có thay đổi trạng thái hoạt động không
-    bool overVoltage[NUM_DEVICES];    // Có thay đổi trạng thái quá áp không
-    bool overCurrent[NUM_DEVICES];    // Có thay đổi trạng thái quá dòng không
-    bool overPower[NUM_DEVICES];      // Có thay đổi trạng thái quá công suất không
-    bool underVoltage[NUM_DEVICES];   // Có thay đổi trạng thái dưới áp không
-    bool socketState[NUM_DEVICES];      // Có thay đổi trạng thái mất nguồn không
-    bool operating_time[NUM_DEVICES]; // Có thay đổi thời gian hoạt động không
+// Tập thay đổi của một chu kỳ: mỗi bit là một trường cần publish, gộp nhiều chu kỳ bằng phép OR
+struct ChangeSet {
+    ChangeMask device[NUM_DEVICES]; // Bit DeviceChangeBit của từng thiết bị
+    ChangeMask cart;                // Bit CartChangeBit của xe đẩy
 };
 
 // Khai báo biến counter thời gian hoạt động cho từng thiết bị, dùng để lưu/đọc EEPROM
@@ -73,8 +86,9 @@ extern const unsigned long warningBeepInterval;
 
 // Khai báo các hàm xử lý cảm biến và trạng thái thiết bị
 extern void SensorHandlers_init(void); // Khởi tạo các biến, struct, trạng thái cảm biến
-extern void handleLeakSensor(bool &warning, acLeakChangedFlags &changed); // Xử lý cảm biến rò điện, cập nhật cảnh báo và flag thay đổi
-extern void handleES35SW(bool &warning, teHuCartChangedFlags &cartChanged, teHuDecviceChangedFlags &deviceChanged);     // Xử lý cảm biến môi trường, cập nhật cảnh báo và flag thay đổi
-extern void handlePZEMSensors(bool &warning, PZEMChangedFlags &changed); // Xử lý cảm biến điện năng, cập nhật cảnh báo và flag thay đổi
-extern void printSensorSnapshot(); // In toàn bộ snapshot dữ liệu cảm biến lên Serial để debug, kiểm tra hệ thống
+extern void sampleLeakSensor(); // Đọc nhanh cảm biến rò điện (LEAK_SAMPLE_PERIOD_MS), cộng mẫu vào cửa sổ thống kê
+extern void handleLeakSensor(bool &warning, ChangeSet &changed); // Xử lý mẫu rò điện mới nhất, cập nhật cảnh báo, gộp bit thay đổi vào changed
+extern void handleES35SW(bool &warning, ChangeSet &changed);     // Xử lý cảm biến môi trường, cập nhật cảnh báo, gộp bit thay đổi vào changed
+extern void handlePZEMSensors(bool &warning, ChangeSet &changed); // Đánh giá dữ liệu PZEM đã đọc (readPZEM), cập nhật cảnh báo, gộp bit thay đổi vào changed
+extern void printSensorSnapshot(const LeakSensorData &leak); // In toàn bộ snapshot dữ liệu cảm biến lên Serial để debug, kiểm tra hệ thống
 extern void handleWarningBeep(bool warning); // Xử lý cảnh báo còi khi có cảnh báo từ cảm biến
\ No newline at end of file
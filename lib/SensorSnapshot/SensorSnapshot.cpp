@@ -0,0 +1,108 @@
+/**
+ * @file SensorSnapshot.cpp
+ * @brief Snapshot capture and lock-free handoff between acquisition and network tasks.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include "SensorSnapshot.h"
+#include "SpscQueue.h"
+
+static SpscQueue<SensorSnapshot, SNAPSHOT_QUEUE_DEPTH> snapshotQueue; // Acquisition -> network
+static SensorSnapshot pendingSnapshot;        // Snapshot waiting for a free slot (producer side)
+static bool hasPendingSnapshot = false;       // true if pendingSnapshot holds unsent changes
+static uint32_t snapshotSequence = 0;         // Sequence number of the next snapshot
+static uint32_t coalescedCount = 0;           // Snapshots merged because the queue was full
+static TaskHandle_t consumerTask = NULL;      // Task notified when a snapshot is queued
+
+/**
+ * @brief OR every change bit of @p src into @p dst: one word per device and one for the cart.
+ */
+void SensorSnapshot_mergeChanges(ChangeSet *dst, const ChangeSet *src)
+{
+    for (int id = 0; id < NUM_DEVICES; id++)
+    {
+        dst->device[id] |= src->device[id];
+    }
+    dst->cart |= src->cart;
+}
+
+void SensorSnapshot_capture(SensorSnapshot *snap, bool warning, const ChangeSet &changed)
+{
+    snap->sequence = snapshotSequence++;
+    snap->sampleMs = millis();
+    snap->warning = warning;
+
+    snap->leak = leakSensorData;
+    snap->envCart = es35swCart;
+    memcpy(snap->envDevice, es35swDevice, sizeof(snap->envDevice));
+
+    memcpy(snap->pzem, sensorData, sizeof(snap->pzem));
+    memcpy(snap->voltageCalib, pzemVoltageCalib, sizeof(snap->voltageCalib));
+    memcpy(snap->overVoltage, overVoltage, sizeof(snap->overVoltage));
+    memcpy(snap->overCurrent, overCurrent, sizeof(snap->overCurrent));
+    memcpy(snap->overPower, overPower, sizeof(snap->overPower));
+    memcpy(snap->underVoltage, underVoltage, sizeof(snap->underVoltage));
+    memcpy(snap->socketState, socketState, sizeof(snap->socketState));
+
+    for (int id = 0; id < NUM_DEVICES; id++)
+    {
+        snap->pzemLink[id] = pzemBreakers[id].state;
+    }
+    snap->envLink = es35swBreaker.state;
+    snap->leakLink = leakSensor.breaker.state;
+
+    OperatingTimeCounter *counters[NUM_DEVICES] = {
+        &op_time_auo_display,
+        &op_time_ccu_img1s,
+        &op_time_ccu_img1hub,
+        &op_time_ccu_imgtricpal,
+        &op_time_xenon_300,
+        &op_time_UI400};
+    for (int id = 0; id < NUM_DEVICES; id++)
+    {
+        op_time_counter_get_formatted(counters[id], snap->operatingTime[id], sizeof(snap->operatingTime[id]));
+    }
+
+    snap->changed = changed;
+}
+
+bool SensorSnapshot_submit(SensorSnapshot *snap)
+{
+    // Gộp các bit thay đổi chưa gửi được của chu kỳ trước vào snapshot mới nhất
+    if (hasPendingSnapshot)
+    {
+        SensorSnapshot_mergeChanges(&snap->changed, &pendingSnapshot.changed);
+        snap->warning = snap->warning || pendingSnapshot.warning;
+    }
+
+    if (!snapshotQueue.push(*snap))
+    {
+        pendingSnapshot = *snap;
+        hasPendingSnapshot = true;
+        coalescedCount++;
+        return false;
+    }
+
+    hasPendingSnapshot = false;
+    if (consumerTask != NULL)
+    {
+        xTaskNotifyGive(consumerTask); // Đánh thức network task ngay khi có dữ liệu mới
+    }
+    return true;
+}
+
+bool SensorSnapshot_consume(SensorSnapshot *snap)
+{
+    return snapshotQueue.pop(*snap);
+}
+
+void SensorSnapshot_setConsumerTask(TaskHandle_t task)
+{
+    consumerTask = task;
+}
+
+uint32_t SensorSnapshot_getCoalescedCount(void)
+{
+    return coalescedCount;
+}
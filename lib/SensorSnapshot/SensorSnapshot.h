@@ -0,0 +1,83 @@
+/**
+ * @file SensorSnapshot.h
+ * @brief Immutable copy of one acquisition cycle, handed from the acquisition task to the network task.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef SENSOR_SNAPSHOT_H
+#define SENSOR_SNAPSHOT_H
+
+#include "SensorHandlers.h"
+
+#define SNAPSHOT_QUEUE_DEPTH 4 // Number of snapshots buffered between acquisition and network tasks
+
+/**
+ * @brief Everything the MQTT layer needs to publish one cycle.
+ *
+ * The network task only ever reads snapshots, never the live sensor globals, so the
+ * acquisition task can keep sampling while a publish or reconnect is in progress.
+ */
+typedef struct
+{
+    uint32_t sequence; ///< Monotonic snapshot counter
+    uint32_t sampleMs; ///< millis() at capture time
+    bool warning;      ///< Aggregated warning state of the cycle
+
+    LeakSensorData leak;                      ///< Leakage sensor data
+    ES35SWData_Cart envCart;                  ///< Cart environment data
+    ES35SWData_Device envDevice[NUM_DEVICES]; ///< Per-device environment threshold states
+
+    PZEMData pzem[NUM_DEVICES];       ///< Filtered PZEM data
+    Voltage voltageCalib[NUM_DEVICES];  ///< Voltage value sent to the dashboard
+    bool overVoltage[NUM_DEVICES];    ///< Over-voltage state
+    bool overCurrent[NUM_DEVICES];    ///< Over-current state
+    bool overPower[NUM_DEVICES];      ///< Over-power state
+    bool underVoltage[NUM_DEVICES];   ///< Under-voltage state
+    bool socketState[NUM_DEVICES];    ///< Socket powered / sensor reachable
+    char operatingTime[NUM_DEVICES][16]; ///< Operating time formatted as HH:MM:SS
+
+    uint8_t pzemLink[NUM_DEVICES]; ///< Circuit breaker state (@c BreakerState) of each PZEM slave
+    uint8_t envLink;               ///< Circuit breaker state of the ES35-SW slave
+    uint8_t leakLink;              ///< Circuit breaker state of the leakage sensor
+
+    ChangeSet changed; ///< Fields changed since the previous snapshot (one bit per published field)
+} SensorSnapshot;
+
+/**
+ * @brief Copy the current sensor globals and the cycle's change set into @p snap.
+ */
+extern void SensorSnapshot_capture(SensorSnapshot *snap, bool warning, const ChangeSet &changed);
+
+/**
+ * @brief OR-merge the change bits of @p src into @p dst.
+ * Used to accumulate changes from jobs that run several times between two publishes.
+ */
+extern void SensorSnapshot_mergeChanges(ChangeSet *dst, const ChangeSet *src);
+
+/**
+ * @brief Hand a snapshot to the network task (acquisition task only).
+ *
+ * If the queue is full the snapshot is kept aside and its change bits are OR-merged into
+ * the next one, so a slow network never loses a change, it only publishes it later.
+ * @return true if the snapshot (or the coalesced backlog) was queued.
+ */
+extern bool SensorSnapshot_submit(SensorSnapshot *snap);
+
+/**
+ * @brief Take the oldest queued snapshot (network task only).
+ * @return false if nothing is queued.
+ */
+extern bool SensorSnapshot_consume(SensorSnapshot *snap);
+
+/**
+ * @brief Register the task that is notified whenever a snapshot is queued.
+ */
+extern void SensorSnapshot_setConsumerTask(TaskHandle_t task);
+
+/**
+ * @brief Number of snapshots that had to be coalesced because the queue was full.
+ */
+extern uint32_t SensorSnapshot_getCoalescedCount(void);
+
+#endif // SENSOR_SNAPSHOT_H
@@ -0,0 +1,104 @@
+/**
+ * @file SlidingMedian.h
+ * @brief Sliding-window median filter updated in place, without copying or sorting the window.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef SLIDING_MEDIAN_H
+#define SLIDING_MEDIAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "RingBuffer.h"
+
+/**
+ * @brief Median of the last N samples of one channel.
+ *
+ * The samples are kept in a RingBuffer next to a list of its storage slots ordered by value. A new
+ * sample overwrites the oldest slot, and only that slot moves in the ordered list (one insertion
+ * step, at most N - 1 moves), so an update costs O(N) comparisons with no copy of the window and no
+ * sort. Slots are tracked by index rather than by value, so equal or unordered values (NaN) never
+ * break the bookkeeping.
+ *
+ * The first sample fills the whole window, so the filter outputs real readings from the start
+ * instead of a median pulled towards zero.
+ *
+ * @tparam T Sample type (must be copy-assignable and support operator<).
+ * @tparam N Window length, odd so the median is a sample (N / 2 is the upper median otherwise).
+ */
+template <typename T, size_t N>
+class SlidingMedian
+{
+    static_assert(N >= 1 && N <= 255, "SlidingMedian window must hold 1 to 255 samples");
+
+public:
+    SlidingMedian() : primed_(false) {}
+
+    /**
+     * @brief Add a sample and return the median of the window.
+     */
+    T push(const T &value)
+    {
+        if (!primed_)
+        {
+            reset(value);
+        }
+
+        const uint8_t slot = (uint8_t)window_.push(value); // Window is full: this was the oldest sample
+
+        size_t pos = 0;
+        while (order_[pos] != slot)
+        {
+            pos++;
+        }
+        // The rewritten slot only moves one way: towards the front if the new value is smaller than
+        // its left neighbour, towards the back if it is larger than its right neighbour
+        while (pos > 0 && value < window_.slot(order_[pos - 1]))
+        {
+            order_[pos] = order_[pos - 1];
+            pos--;
+        }
+        while (pos + 1 < N && window_.slot(order_[pos + 1]) < value)
+        {
+            order_[pos] = order_[pos + 1];
+            pos++;
+        }
+        order_[pos] = slot;
+        return median();
+    }
+
+    /**
+     * @brief Fill the whole window with @p value.
+     */
+    void reset(const T &value)
+    {
+        window_.clear();
+        for (size_t i = 0; i < N; i++)
+        {
+            order_[i] = (uint8_t)window_.push(value);
+        }
+        primed_ = true;
+    }
+
+    /**
+     * @brief Forget the window; the next sample fills it again.
+     */
+    void clear() { primed_ = false; }
+
+    /**
+     * @brief Median of the window (undefined before the first sample).
+     */
+    T median() const { return window_.slot(order_[N / 2]); }
+
+    bool primed() const { return primed_; }
+
+    static constexpr size_t size() { return N; }
+
+private:
+    RingBuffer<T, N> window_; ///< Samples in arrival order
+    uint8_t order_[N];        ///< Storage slots of window_ sorted by value
+    bool primed_;             ///< false until the first sample
+};
+
+#endif // SLIDING_MEDIAN_H
@@ -0,0 +1,81 @@
+/**
+ * @file SpscQueue.h
+ * @brief Lock-free single-producer/single-consumer ring queue.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <atomic>
+
+/**
+ * @brief Fixed-capacity lock-free queue for exactly one producer task and one consumer task.
+ *
+ * The producer only writes @c head_ and the consumer only writes @c tail_, so no lock or
+ * critical section is needed. Elements are copied in and out by value.
+ *
+ * @tparam T Element type (must be copy-assignable).
+ * @tparam N Capacity, must be a power of two.
+ */
+template <typename T, size_t N>
+class SpscQueue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() : head_(0), tail_(0) {}
+
+    /**
+     * @brief Push a copy of @p item (producer side only).
+     * @return false if the queue is full, the item is not stored.
+     */
+    bool push(const T &item)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= N)
+        {
+            return false;
+        }
+        buffer_[head & (N - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Pop the oldest item into @p item (consumer side only).
+     * @return false if the queue is empty.
+     */
+    bool pop(T &item)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail)
+        {
+            return false;
+        }
+        item = buffer_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Number of items currently queued (approximate when called concurrently).
+     */
+    size_t size() const
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    static constexpr size_t capacity() { return N; }
+
+private:
+    T buffer_[N];
+    std::atomic<size_t> head_; ///< Next slot to write, owned by the producer
+    std::atomic<size_t> tail_; ///< Next slot to read, owned by the consumer
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,196 @@
+/**
+ * @file WifiStateMachine.cpp
+ * @brief Implementation of the non-blocking WiFi connection state machine.
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * @details The state machine has no dependency on the Arduino WiFi API: actions go through
+ *          WifiSmDriver and events come in through WifiSM_handleEvent(), so transitions can be
+ *          driven by a fake event source on a host.
+ */
+
+#include "WifiStateMachine.h"
+#include <string.h>
+#include <stddef.h>
+
+/**
+ * @brief Start an attempt on the current credential, through the cache if it matches.
+ */
+static void startAttempt(WifiStateMachine *sm, uint32_t nowMs)
+{
+    const WifiCredential *cred = &sm->credentials[sm->credentialIndex];
+
+    sm->cachedAttempt = sm->cache.valid && sm->cache.credentialIndex == sm->credentialIndex;
+    sm->driver.disconnect();
+    if (sm->cachedAttempt)
+    {
+        sm->driver.begin(cred->ssid, cred->password, sm->cache.channel, sm->cache.bssid);
+    }
+    else
+    {
+        sm->driver.begin(cred->ssid, cred->password, 0, NULL);
+    }
+
+    sm->state = WIFI_SM_CONNECTING;
+    sm->attemptStartMs = nowMs;
+}
+
+/**
+ * @brief The current attempt failed: retry without cache, move to the next SSID or back off.
+ */
+static void attemptFailed(WifiStateMachine *sm, uint32_t nowMs)
+{
+    sm->failedAttempts++;
+
+    if (sm->cachedAttempt)
+    {
+        // AP trong cache không còn phản hồi: thử lại cùng SSID với scan đầy đủ
+        sm->cache.valid = false;
+        startAttempt(sm, nowMs);
+        return;
+    }
+
+    sm->failedInRound++;
+    sm->credentialIndex = (uint8_t)((sm->credentialIndex + 1) % sm->credentialCount);
+
+    if (sm->failedInRound >= sm->credentialCount)
+    {
+        // Tất cả SSID đều lỗi: chờ backoff tăng dần rồi thử lại từ đầu vòng
+        sm->failedInRound = 0;
+        sm->state = WIFI_SM_BACKOFF;
+        sm->nextAttemptMs = nowMs + sm->backoffMs;
+        sm->backoffMs = (sm->backoffMs * 2 > WIFI_SM_BACKOFF_MAX_MS) ? WIFI_SM_BACKOFF_MAX_MS : sm->backoffMs * 2;
+        sm->driver.disconnect();
+        return;
+    }
+
+    startAttempt(sm, nowMs);
+}
+
+void WifiSM_init(WifiStateMachine *sm, const WifiCredential *credentials, uint8_t count,
+                 const WifiSmDriver *driver, const WifiApCache *cache)
+{
+    memset(sm, 0, sizeof(*sm));
+    sm->state = WIFI_SM_IDLE;
+    sm->credentials = credentials;
+    sm->credentialCount = count;
+    sm->driver = *driver;
+    sm->backoffMs = WIFI_SM_BACKOFF_MIN_MS;
+
+    if (cache != NULL && cache->valid && cache->credentialIndex < count)
+    {
+        sm->cache = *cache;
+        sm->credentialIndex = cache->credentialIndex; // Bắt đầu bằng mạng đã kết nối thành công lần trước
+    }
+}
+
+void WifiSM_handleEvent(WifiStateMachine *sm, const WifiSmEvent *event, uint32_t nowMs)
+{
+    switch (event->type)
+    {
+    case WIFI_SM_EVT_ASSOCIATED:
+        memcpy(sm->pendingBssid, event->bssid, sizeof(sm->pendingBssid));
+        sm->pendingChannel = event->channel;
+        break;
+
+    case WIFI_SM_EVT_GOT_IP:
+        if (sm->state == WIFI_SM_CONNECTING)
+        {
+            sm->state = WIFI_SM_CONNECTED;
+            sm->connectCount++;
+            if (sm->cachedAttempt)
+            {
+                sm->cacheHits++;
+            }
+            sm->failedInRound = 0;
+            sm->backoffMs = WIFI_SM_BACKOFF_MIN_MS;
+            sm->lastReconnectMs = nowMs - sm->downSinceMs;
+            if (sm->lastReconnectMs > sm->maxReconnectMs)
+            {
+                sm->maxReconnectMs = sm->lastReconnectMs;
+            }
+
+            // Ghi nhớ AP vừa kết nối để lần sau bỏ qua bước scan
+            const bool changed = !sm->cache.valid || sm->cache.credentialIndex != sm->credentialIndex ||
+                                 sm->cache.channel != sm->pendingChannel ||
+                                 memcmp(sm->cache.bssid, sm->pendingBssid, sizeof(sm->cache.bssid)) != 0;
+            if (changed && sm->pendingChannel != 0)
+            {
+                memcpy(sm->cache.bssid, sm->pendingBssid, sizeof(sm->cache.bssid));
+                sm->cache.channel = sm->pendingChannel;
+                sm->cache.credentialIndex = sm->credentialIndex;
+                sm->cache.valid = true;
+                if (sm->driver.saveCache != NULL)
+                {
+                    sm->driver.saveCache(&sm->cache);
+                }
+            }
+        }
+        break;
+
+    case WIFI_SM_EVT_DISCONNECTED:
+        if (sm->state == WIFI_SM_CONNECTED)
+        {
+            // Mất kết nối: bắt đầu đo thời gian reconnect và thử lại ngay bằng cache
+            sm->downSinceMs = nowMs;
+            startAttempt(sm, nowMs);
+        }
+        else if (sm->state == WIFI_SM_CONNECTING && nowMs - sm->attemptStartMs >= WIFI_SM_EVENT_GRACE_MS)
+        {
+            attemptFailed(sm, nowMs);
+        }
+        break;
+    }
+}
+
+void WifiSM_tick(WifiStateMachine *sm, uint32_t nowMs)
+{
+    switch (sm->state)
+    {
+    case WIFI_SM_IDLE:
+        sm->downSinceMs = nowMs;
+        startAttempt(sm, nowMs);
+        break;
+
+    case WIFI_SM_CONNECTING:
+    {
+        const uint32_t timeout = sm->cachedAttempt ? WIFI_SM_CACHED_TIMEOUT_MS : WIFI_SM_SCAN_TIMEOUT_MS;
+        if (nowMs - sm->attemptStartMs >= timeout)
+        {
+            attemptFailed(sm, nowMs);
+        }
+        break;
+    }
+
+    case WIFI_SM_BACKOFF:
+        if ((int32_t)(nowMs - sm->nextAttemptMs) >= 0)
+        {
+            startAttempt(sm, nowMs);
+        }
+        break;
+
+    case WIFI_SM_CONNECTED:
+        break;
+    }
+}
+
+bool WifiSM_isConnected(const WifiStateMachine *sm)
+{
+    return sm->state == WIFI_SM_CONNECTED;
+}
+
+const char *WifiSM_stateName(WifiSmState state)
+{
+    switch (state)
+    {
+    case WIFI_SM_IDLE:
+        return "IDLE";
+    case WIFI_SM_CONNECTING:
+        return "CONNECTING";
+    case WIFI_SM_CONNECTED:
+        return "CONNECTED";
+    case WIFI_SM_BACKOFF:
+        return "BACKOFF";
+    }
+    return "?";
+}
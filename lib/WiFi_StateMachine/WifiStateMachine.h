@@ -0,0 +1,134 @@
+/**
+ * @file WifiStateMachine.h
+ * @brief Non-blocking WiFi station connection state machine with BSSID/channel fast-reconnect cache.
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef WIFI_STATE_MACHINE_H
+#define WIFI_STATE_MACHINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define WIFI_SM_CACHED_TIMEOUT_MS 5000   // Timeout of an attempt using the cached BSSID/channel (no scan)
+#define WIFI_SM_SCAN_TIMEOUT_MS 15000    // Timeout of an attempt with a full scan
+#define WIFI_SM_BACKOFF_MIN_MS 1000      // First backoff after every SSID failed once
+#define WIFI_SM_BACKOFF_MAX_MS 60000     // Backoff upper bound
+#define WIFI_SM_EVENT_GRACE_MS 300       // Disconnect events this soon after begin() are echoes of our own disconnect()
+
+    /**
+     * @brief Connection states.
+     */
+    typedef enum
+    {
+        WIFI_SM_IDLE = 0,   ///< Not started
+        WIFI_SM_CONNECTING, ///< Waiting for association + IP
+        WIFI_SM_CONNECTED,  ///< Got IP
+        WIFI_SM_BACKOFF     ///< Every SSID failed, waiting before the next round
+    } WifiSmState;
+
+    /**
+     * @brief Events fed by the WiFi driver (or a fake source on a host).
+     */
+    typedef enum
+    {
+        WIFI_SM_EVT_ASSOCIATED = 0, ///< Associated with an AP, bssid/channel are valid
+        WIFI_SM_EVT_GOT_IP,         ///< IP obtained, link usable
+        WIFI_SM_EVT_DISCONNECTED    ///< Association lost or attempt rejected
+    } WifiSmEventType;
+
+    typedef struct
+    {
+        WifiSmEventType type;
+        uint8_t bssid[6]; ///< AP BSSID (WIFI_SM_EVT_ASSOCIATED only)
+        uint8_t channel;  ///< AP channel (WIFI_SM_EVT_ASSOCIATED only)
+    } WifiSmEvent;
+
+    /**
+     * @brief SSID/password pair, tried in table order.
+     */
+    typedef struct
+    {
+        const char *ssid;
+        const char *password;
+    } WifiCredential;
+
+    /**
+     * @brief Last AP that gave an IP, reused to skip the scan on reconnect.
+     */
+    typedef struct
+    {
+        uint8_t bssid[6];
+        uint8_t channel;
+        uint8_t credentialIndex; ///< Index in the credential table
+        bool valid;
+    } WifiApCache;
+
+    /**
+     * @brief Hardware hooks. On the target they call WiFi.begin()/WiFi.disconnect() and NVS.
+     */
+    typedef struct
+    {
+        void (*begin)(const char *ssid, const char *password, int32_t channel, const uint8_t *bssid); ///< bssid NULL = full scan
+        void (*disconnect)(void);
+        void (*saveCache)(const WifiApCache *cache); ///< May be NULL
+    } WifiSmDriver;
+
+    typedef struct
+    {
+        WifiSmState state;
+        const WifiCredential *credentials;
+        uint8_t credentialCount;
+        uint8_t credentialIndex;  ///< Credential of the current attempt
+        WifiSmDriver driver;
+
+        WifiApCache cache;        ///< Fast-reconnect cache
+        bool cachedAttempt;       ///< true if the current attempt uses the cache
+        uint8_t pendingBssid[6];  ///< BSSID reported by the last association
+        uint8_t pendingChannel;   ///< Channel reported by the last association
+
+        uint32_t attemptStartMs;  ///< Start of the current attempt
+        uint32_t nextAttemptMs;   ///< End of the backoff
+        uint32_t backoffMs;       ///< Current backoff
+        uint32_t downSinceMs;     ///< Time the link was lost (or the first attempt started)
+        uint8_t failedInRound;    ///< SSIDs that failed since the last success or backoff
+
+        uint32_t connectCount;      ///< Successful connections
+        uint32_t failedAttempts;    ///< Attempts that timed out or were rejected
+        uint32_t lastReconnectMs;   ///< Duration of the last link-down period
+        uint32_t maxReconnectMs;    ///< Longest link-down period
+        uint32_t cacheHits;         ///< Connections obtained through the cache
+    } WifiStateMachine;
+
+    /**
+     * @brief Initialize the state machine. Nothing is started until the first WifiSM_tick().
+     * @param cache Previously saved cache, may be NULL.
+     */
+    extern void WifiSM_init(WifiStateMachine *sm, const WifiCredential *credentials, uint8_t count,
+                            const WifiSmDriver *driver, const WifiApCache *cache);
+
+    /**
+     * @brief Feed a driver event.
+     */
+    extern void WifiSM_handleEvent(WifiStateMachine *sm, const WifiSmEvent *event, uint32_t nowMs);
+
+    /**
+     * @brief Advance timeouts and backoff. Never blocks.
+     */
+    extern void WifiSM_tick(WifiStateMachine *sm, uint32_t nowMs);
+
+    extern bool WifiSM_isConnected(const WifiStateMachine *sm);
+
+    extern const char *WifiSM_stateName(WifiSmState state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WIFI_STATE_MACHINE_H
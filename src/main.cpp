@@ -1,71 +1,389 @@
 #include "SensorHandlers.h" // Khai báo các hàm, biến quản lý cảm biến và trạng thái thiết bị
 #include "IOT_MQTT.h"       // Khai báo các hàm xử lý MQTT (kết nối, publish dữ liệu)
-unsigned long lastReadTime = 0;          // Biến lưu thời điểm lần đọc dữ liệu gần nhất
+#include "SensorSnapshot.h" // Snapshot dữ liệu + hàng đợi lock-free giữa 2 task
+#include "Scheduler.h"      // Bộ lập lịch job theo deadline cho task thu thập dữ liệu
+#include "AdaptivePolling.h" // Chọn chu kỳ đọc từng kênh theo trạng thái thiết bị
+#include "ModbusDiscovery.h" // Bản đồ địa chỉ Modbus (NVS) và tìm slave mới
+#include "BaudNegotiation.h" // Nâng tốc độ baud của bus cảm biến khi mọi slave hỗ trợ
+#include "LeakAlarm.h"      // Đường cảnh báo rò điện theo ngắt (chân DO/AO/DA)
+
 const unsigned long readInterval = 5000; // Chu kỳ đọc dữ liệu (ms), tránh đọc quá nhanh gây quá tải
 
-void setup()
+// Cấu hình task FreeRTOS: thu thập dữ liệu và mạng chạy trên 2 core khác nhau
+#define ACQ_TASK_CORE 1        // APP_CPU: task thu thập dữ liệu cảm biến (Modbus, còi)
+#define NET_TASK_CORE 0        // PRO_CPU: task mạng, cùng core với WiFi/LwIP stack
+#define ACQ_TASK_STACK 8192    // Stack (byte) cho task thu thập dữ liệu
+#define NET_TASK_STACK 8192    // Stack (byte) cho task mạng
+#define ACQ_TASK_PRIORITY 3    // Ưu tiên cao hơn task mạng để chu kỳ lấy mẫu luôn đều
+#define NET_TASK_PRIORITY 2
+#define NET_TASK_IDLE_MS 100   // Thời gian chờ tối đa giữa 2 lần phục vụ MQTT khi không có snapshot mới
+#define LEAK_TASK_STACK 4096   // Stack (byte) cho task đọc cảm biến rò điện (bus UART1 riêng)
+#define LEAK_TASK_PRIORITY 3   // Cùng mức với task thu thập dữ liệu, 2 bus chạy song song
+
+// Fast boot: khởi tạo cảm biến và task thu thập dữ liệu trước, còi và mạng sau,
+// để lấy mẫu bắt đầu ngay khi cấp nguồn (đặt 0 để giữ thứ tự khởi động cũ)
+#ifndef FAST_BOOT
+#define FAST_BOOT 1
+#endif
+
+// Cấu hình job cho bộ lập lịch (ms): chu kỳ, độ lệch lần chạy đầu, deadline tương đối
+#define JOB_SENSOR_DEADLINE 500     // Deadline cho mỗi lần đọc cảm biến qua Modbus
+#define JOB_LEAK_PERIOD readInterval // Chu kỳ đánh giá cảnh báo/flag thay đổi của cảm biến rò điện
+#define JOB_LEAK_SAMPLE_PERIOD LEAK_SAMPLE_PERIOD_MS // Chu kỳ đọc nhanh cảm biến rò điện trên bus riêng
+#define JOB_PZEM_OFFSET 200         // Lần đọc PZEM, các ổ cắm đọc liên tiếp; khoảng cách giữa các frame do bus RS485 đảm bảo (t3.5)
+#define JOB_PUBLISH_OFFSET 2000     // Đánh giá + gửi snapshot sau khi các job đọc đã chạy
+#define JOB_PUBLISH_DEADLINE 1000
+#define JOB_BEEPER_PERIOD 1000      // Chu kỳ kiểm tra còi cảnh báo
+#define JOB_STATS_PERIOD 60000      // Chu kỳ in thống kê trễ/deadline của bộ lập lịch
+#define JOB_DISCOVERY_PERIOD 2000   // Chu kỳ dò một địa chỉ Modbus chưa có trong bản đồ (chỉ khi có slave không trả lời)
+
+static TaskHandle_t acquisitionTaskHandle = NULL; // Handle task thu thập dữ liệu
+static TaskHandle_t networkTaskHandle = NULL;     // Handle task mạng
+static TaskHandle_t leakTaskHandle = NULL;        // Handle task đọc cảm biến rò điện
+
+static Scheduler acqScheduler;         // Bộ lập lịch của task thu thập dữ liệu (bus cảm biến UART2)
+static Scheduler leakScheduler;        // Bộ lập lịch của task đọc cảm biến rò điện (bus UART1)
+static SemaphoreHandle_t leakLock;     // Bảo vệ dữ liệu/flag rò điện giữa task rò điện và job publish
+static int pzemJobs[NUM_DEVICES];      // Chỉ số job đọc PZEM của từng ổ cắm
+static int envJobIndex = -1;           // Chỉ số job đọc cảm biến môi trường
+static PollChannel pzemPoll[NUM_DEVICES]; // Chu kỳ đọc thích nghi của từng ổ cắm
+static PollChannel envPoll;            // Chu kỳ đọc thích nghi của cảm biến môi trường
+
+// Bit thay đổi và cảnh báo tích lũy giữa 2 lần gửi snapshot
+static ChangeSet leakChangedAcc = {}; // Bit rò điện, task rò điện ghi (giữ leakLock)
+static ChangeSet envChangedAcc = {};  // Bit môi trường, task thu thập dữ liệu ghi
+static bool leakWarning = false;  // Cảnh báo của lần đọc cảm biến rò điện gần nhất
+static bool envWarning = false;   // Cảnh báo của lần đọc cảm biến môi trường gần nhất
+static bool cycleWarning = false; // Cảnh báo tổng hợp của chu kỳ gần nhất, dùng cho còi
+
+// Đồng hồ cho bộ lập lịch (trên host có thể thay bằng đồng hồ giả lập)
+static uint32_t schedulerClock(void)
 {
-    Serial.begin(9600); // Khởi tạo giao tiếp Serial để debug, log trạng thái hệ thống
+    return millis();
+}
 
-    // 1. Khởi tạo các thư viện quản lý cảm biến, còi, nút nhấn, trạng thái
-    SensorHandlers_init(); // Khởi tạo các biến, struct, trạng thái cảm biến (counter, flag, threshold...)
-    initBuzzer();          // Khởi tạo module cảnh báo âm thanh (buzzer)
+// Job đọc nhanh cảm biến rò điện (chạy trong task rò điện, không chờ sau các giao dịch PZEM)
+static void leakSampleJob(void *ctx)
+{
+    sampleLeakSensor();
+}
 
-    // 2. Khởi tạo các module cảm biến phần cứng
-    MD0630T01A_init(); // Khởi tạo cảm biến rò điện
-    ES35SW_init();     // Khởi tạo cảm biến môi trường (nhiệt độ, độ ẩm)
-    PZEM016_init();    // Khởi tạo cảm biến điện năng (điện áp, dòng, công suất...)
+// Job đánh giá mẫu rò điện gần nhất: cảnh báo và bit thay đổi cho snapshot
+static void leakJob(void *ctx)
+{
+    bool warning = false;
+    xSemaphoreTake(leakLock, portMAX_DELAY);
+    handleLeakSensor(warning, leakChangedAcc); // Gộp thẳng bit thay đổi vào bộ tích lũy
+    leakWarning = warning;
+    xSemaphoreGive(leakLock);
+}
 
-    // 3. Khởi tạo kết nối mạng
-    IOT_MQTT_setupWifi();           // Kết nối WiFi, retry nếu thất bại, log trạng thái lên Serial
-    IOT_MQTT_setupTime();           // Đồng bộ thời gian thực (NTP), phục vụ timestamp cho dữ liệu
-    IOT_MQTT_setupMQTT(mqttClient); // Kết nối MQTT server, thiết lập client, topic, callback
+// Job đọc và xử lý cảm biến môi trường
+static void envJob(void *ctx)
+{
+    bool warning = false;
+    ChangeSet changed = {};
+    handleES35SW(warning, changed);
+    SensorSnapshot_mergeChanges(&envChangedAcc, &changed);
+    envWarning = warning;
 
-    // op_time_counter_reset(&op_time_auo_display);
-    // op_time_counter_reset(&op_time_ccu_img1s);
-    // op_time_counter_reset(&op_time_ccu_img1hub);
-    // op_time_counter_reset(&op_time_ccu_imgtricpal);
-    // op_time_counter_reset(&op_time_xenon_300);
-    // op_time_counter_reset(&op_time_UI400);
+    // Môi trường thay đổi chậm: đọc thưa, tăng tốc tạm thời khi nhiệt độ/độ ẩm vừa thay đổi
+    const ChangeMask measured = CHANGE_BIT(CHANGE_TEMPERATURE) | CHANGE_BIT(CHANGE_HUMIDITY);
+    Scheduler_setPeriod(&acqScheduler, envJobIndex,
+                        AdaptivePoll_updateEnvironment(&envPoll, (changed.cart & measured) != 0));
+}
 
-    Serial.println("=== SYSTEM READY ==="); // Thông báo hệ thống đã sẵn sàng
+// Job đọc một cảm biến PZEM, ctx là chỉ số ổ cắm
+static void pzemJob(void *ctx)
+{
+    readPZEM((uint8_t)(uintptr_t)ctx);
 }
-void loop()
+
+// Ổ cắm có thông số hoặc trạng thái nào thay đổi vượt ngưỡng delta trong chu kỳ này không
+static bool pzemSocketChanged(const ChangeSet &changed, int id)
+{
+    const ChangeMask activity = CHANGE_BIT(CHANGE_VOLTAGE) | CHANGE_BIT(CHANGE_CURRENT) | CHANGE_BIT(CHANGE_POWER) |
+                                CHANGE_BIT(CHANGE_FREQUENCY) | CHANGE_BIT(CHANGE_PF) |
+                                CHANGE_BIT(CHANGE_MACHINE_STATE) | CHANGE_BIT(CHANGE_SOCKET_STATE);
+    return (changed.device[id] & activity) != 0;
+}
+
+// Chọn lại chu kỳ đọc của từng ổ cắm: đang chạy đọc nhanh, tắt/mất nguồn đọc thưa
+static void updatePzemPollRates(const ChangeSet &changed)
 {
-    IOT_MQTT_ensureWifiConnected(); // Đảm bảo kết nối WiFi luôn duy trì, tự động reconnect nếu mất kết nối
-    
-    // Kiểm tra đủ chu kỳ mới thực hiện polling, tránh spam xử lý ...
-    if (millis() - lastReadTime >= readInterval)
+    for (int id = 0; id < NUM_DEVICES; id++)
     {
-        lastReadTime = millis(); // Cập nhật thời điểm polling mới
+        const uint32_t periodMs = AdaptivePoll_updateSocket(&pzemPoll[id], socketState[id],
+                                                            sensorData[id].machineState,
+                                                            pzemSocketChanged(changed, id));
+        Scheduler_setPeriod(&acqScheduler, pzemJobs[id], periodMs);
+    }
+}
+
+// Job đánh giá dữ liệu PZEM, đóng gói snapshot và chuyển sang task mạng (không chặn nếu mạng chậm)
+static void publishJob(void *ctx)
+{
+    Serial.println("\n================= DATA UPDATE ================="); // Log bắt đầu chu kỳ cập nhật dữ liệu
+
+    xSemaphoreTake(leakLock, portMAX_DELAY); // Giữ dữ liệu rò điện nhất quán trong lúc đóng gói snapshot
+    bool warning = leakWarning || envWarning;
+    ChangeSet changed = envChangedAcc; // Bit môi trường và rò điện tích lũy, PZEM gộp thêm vào
+    SensorSnapshot_mergeChanges(&changed, &leakChangedAcc);
+    handlePZEMSensors(warning, changed); // Đánh giá dữ liệu PZEM, cập nhật cảnh báo và bit thay đổi
+    cycleWarning = warning;
+
+    static SensorSnapshot snapshot;
+    SensorSnapshot_capture(&snapshot, warning, changed);
+    leakChangedAcc = {};
+    xSemaphoreGive(leakLock);
+    SensorSnapshot_submit(&snapshot);
+    updatePzemPollRates(changed);
+
+    envChangedAcc = {};
+
+    Serial.print("Warning Status: "); // Log trạng thái cảnh báo hiện tại
+    Serial.println(warning ? "YES" : "NO");
+
+    printSensorSnapshot(snapshot.leak); // In toàn bộ dữ liệu cảm biến, phần rò điện lấy từ snapshot (đã chụp dưới leakLock)
+}
+
+// Job xử lý còi cảnh báo dựa trên trạng thái cảnh báo của chu kỳ gần nhất
+static void beeperJob(void *ctx)
+{
+    handleWarningBeep(cycleWarning);
+}
+
+// In thống kê deadline miss và jitter của từng job trong một bộ lập lịch
+static void printSchedulerStats(const Scheduler *sched)
+{
+    for (int i = 0; i < sched->jobCount; i++)
+    {
+        const SchedulerJob *job = &sched->jobs[i];
+        Serial.printf("  %-10s %6lu | %4lu | %4lu/%4lu | %4lu\n", job->name,
+                      (unsigned long)job->runCount, (unsigned long)job->missCount,
+                      (unsigned long)(job->runCount ? job->sumJitterMs / job->runCount : 0),
+                      (unsigned long)job->maxJitterMs, (unsigned long)job->maxDurationMs);
+    }
+}
+
+// In mức sử dụng bus (thời gian bận / thời gian thực kể từ lần in trước), độ sâu hàng đợi và timeout từng slave
+static void printBusStats(const Rs485Bus *bus, Rs485BusStats *prev, uint32_t windowMs)
+{
+    const uint32_t busyUs = bus->stats.busTimeUs - prev->busTimeUs;
+    const uint32_t txns = bus->stats.transactions - prev->transactions;
+    const uint32_t fails = bus->stats.failures - prev->failures;
+    Serial.printf("  %-8s util %5.1f%% | txns %4lu | fails %3lu | queue %lu (max %lu)\n", bus->name,
+                  windowMs ? busyUs / (windowMs * 10.0f) : 0.0f, (unsigned long)txns, (unsigned long)fails,
+                  (unsigned long)RS485Bus_queueDepth(bus), (unsigned long)bus->stats.queueHighWater);
+    Serial.print("           rto:");
+    for (uint8_t slave = 0; slave < RS485_TRACKED_SLAVES; slave++)
+    {
+        const RtoEstimator *est = &bus->rto[slave];
+        if (est->samples > 0 || est->backoffs > 0)
+        {
+            Serial.printf(" 0x%02X=%ums (srtt %lu us)", slave, Rto_timeoutMs(est), (unsigned long)est->srttUs);
+        }
+    }
+    Serial.println();
+    *prev = bus->stats;
+}
 
-        bool warning = false; // Biến trạng thái cảnh báo, sẽ được cập nhật bởi các hàm xử lý cảm biến
+// Job dò slave mới trên bus cảm biến: chỉ chạy khi có ổ cắm/ES35-SW không trả lời, mỗi lần một địa chỉ
+static void discoveryJob(void *ctx)
+{
+    ModbusDiscovery_step();
+    BaudNegotiation_check(); // Quay về 9600 nếu ES35-SW chỉ còn trả lời ở tốc độ mặc định
+}
 
-        acLeakChangedFlags leakChanged = {};   // Struct lưu trạng thái thay đổi của cảm biến rò điện
-        teHuCartChangedFlags envCartChanged = {}; // Struct lưu trạng thái thay đổi của cảm biến môi trường (nhiệt độ, độ ẩm)
-        teHuDecviceChangedFlags envDeviceChanged = {}; // Struct lưu trạng thái thay đổi        
-        PZEMChangedFlags pzemChanged = {}; // Struct lưu trạng thái thay đổi của cảm biến điện năng (điện áp, dòng, công suất...)
+// Job in thống kê của 2 pipeline thu thập dữ liệu và 2 bus RS485
+static void statsJob(void *ctx)
+{
+    static Rs485BusStats sensorPrev = {};
+    static Rs485BusStats leakPrev = {};
+    static uint32_t lastMs = 0;
+    const uint32_t now = millis();
+    const uint32_t windowMs = now - lastMs;
+    lastMs = now;
 
-        Serial.println("\n================= DATA UPDATE ================="); // Log bắt đầu chu kỳ cập nhật dữ liệu
+    Serial.println("\n[SCHEDULER] job: runs | misses | jitter avg/max (ms) | duration max (ms)");
+    printSchedulerStats(&acqScheduler);
+    printSchedulerStats(&leakScheduler);
+    Serial.print("[POLL]");
+    for (int id = 0; id < NUM_DEVICES; id++)
+    {
+        Serial.printf(" %s=%s/%lums", SOCKET_NAMES[id], AdaptivePoll_className(pzemPoll[id].pollClass),
+                      (unsigned long)pzemPoll[id].periodMs);
+    }
+    Serial.printf(" ENV=%lums\n", (unsigned long)envPoll.periodMs);
+    Serial.println("[RS485] bus:");
+    printBusStats(&sensorBus, &sensorPrev, windowMs);
+    printBusStats(&leakBus, &leakPrev, windowMs);
+    Serial.print("[BREAKER] state/trips/skipped:");
+    for (int id = 0; id < NUM_DEVICES; id++)
+    {
+        Serial.printf(" %s=%s/%lu/%lu", SOCKET_NAMES[id], Breaker_stateName(pzemBreakers[id].state),
+                      (unsigned long)pzemBreakers[id].tripCount, (unsigned long)pzemBreakers[id].skipped);
+    }
+    Serial.printf(" ENV=%s/%lu/%lu LEAK=%s/%lu/%lu\n",
+                  Breaker_stateName(es35swBreaker.state), (unsigned long)es35swBreaker.tripCount,
+                  (unsigned long)es35swBreaker.skipped, Breaker_stateName(leakSensor.breaker.state),
+                  (unsigned long)leakSensor.breaker.tripCount, (unsigned long)leakSensor.breaker.skipped);
+    const LeakWindowCounters *window = LeakWindow_getCounters();
+    Serial.printf("[LEAK] windows=%lu lost=%lu | peaks=%lu lost=%lu\n", (unsigned long)window->windows,
+                  (unsigned long)window->windowsLost, (unsigned long)window->peaks, (unsigned long)window->peaksLost);
+    const LeakAlarmStats *alarm = LeakAlarm_getStats();
+    Serial.printf("[ALARM] edges=%lu events=%lu glitches=%lu dropped=%lu | detect->buzzer last/max %lu/%lu us"
+                  " | detect->publish last/max/mean %lu/%lu/%lu us\n",
+                  (unsigned long)alarm->edges, (unsigned long)alarm->events, (unsigned long)alarm->glitches,
+                  (unsigned long)alarm->dropped, (unsigned long)alarm->lastDetectToBuzzerUs,
+                  (unsigned long)alarm->maxDetectToBuzzerUs, (unsigned long)alarm->lastDetectToPublishUs,
+                  (unsigned long)alarm->maxDetectToPublishUs,
+                  (unsigned long)(alarm->published ? alarm->sumDetectToPublishUs / alarm->published : 0));
+}
 
-        handleLeakSensor(warning, leakChanged); // Đọc và xử lý cảm biến rò điện, cập nhật cảnh báo và flag thay đổi
-        delay(100);                            // Delay ngắn để tránh nhiễu khi đọc cảm biến
+// Task thu thập dữ liệu: chỉ chạy các job đến hạn rồi ngủ tới deadline kế tiếp
+static void acquisitionTask(void *param)
+{
+    static const char *pzemJobNames[NUM_DEVICES] = {"pzem1", "pzem2", "pzem3", "pzem4", "pzem5", "pzem6"};
 
-        handleES35SW(warning, envCartChanged, envDeviceChanged); // Đọc và xử lý cảm biến môi trường, cập nhật cảnh báo và flag thay đổi
-        delay(100);
+    Scheduler_init(&acqScheduler, schedulerClock);
+    envJobIndex = Scheduler_addJob(&acqScheduler, "es35sw", readInterval, JOB_PZEM_OFFSET / 2, JOB_SENSOR_DEADLINE, envJob, NULL);
+    AdaptivePoll_init(&envPoll, readInterval);
+    for (int id = 0; id < NUM_DEVICES; id++)
+    {
+        AdaptivePoll_init(&pzemPoll[id], readInterval);
+        pzemJobs[id] = Scheduler_addJob(&acqScheduler, pzemJobNames[id], readInterval,
+                                        JOB_PZEM_OFFSET, JOB_SENSOR_DEADLINE,
+                                        pzemJob, (void *)(uintptr_t)id);
+    }
+    Scheduler_addJob(&acqScheduler, "publish", readInterval, JOB_PUBLISH_OFFSET, JOB_PUBLISH_DEADLINE, publishJob, NULL);
+    Scheduler_addJob(&acqScheduler, "beeper", JOB_BEEPER_PERIOD, JOB_PUBLISH_OFFSET, 0, beeperJob, NULL);
+    Scheduler_addJob(&acqScheduler, "stats", JOB_STATS_PERIOD, JOB_STATS_PERIOD, 0, statsJob, NULL);
+    Scheduler_addJob(&acqScheduler, "discovery", JOB_DISCOVERY_PERIOD, JOB_PUBLISH_OFFSET, JOB_SENSOR_DEADLINE, discoveryJob, NULL);
 
-        handlePZEMSensors(warning, pzemChanged); // Đọc và xử lý cảm biến điện năng, cập nhật cảnh báo và flag thay đổi
-        delay(100);
+    for (;;)
+    {
+        const uint32_t waitMs = Scheduler_runDue(&acqScheduler); // Chạy các job đến hạn
+        if (waitMs > 0)
+        {
+            vTaskDelay(pdMS_TO_TICKS(waitMs)); // Ngủ đến deadline kế tiếp
+        }
+    }
+}
 
-        IOT_MQTT_ensureConnected(mqttClient); // Đảm bảo kết nối MQTT luôn duy trì, tự động reconnect nếu mất kết nối
+// Task đọc cảm biến rò điện: pipeline riêng trên bus UART1, chạy song song với bus PZEM/ES35-SW
+static void leakTask(void *param)
+{
+    Scheduler_init(&leakScheduler, schedulerClock);
+    Scheduler_addJob(&leakScheduler, "leaksample", JOB_LEAK_SAMPLE_PERIOD, 0, JOB_LEAK_SAMPLE_PERIOD, leakSampleJob, NULL);
+    Scheduler_addJob(&leakScheduler, "leak", JOB_LEAK_PERIOD, JOB_LEAK_SAMPLE_PERIOD / 2, JOB_SENSOR_DEADLINE, leakJob, NULL);
 
-        IOT_MQTT_publishAll(mqttClient, leakChanged, envCartChanged, envDeviceChanged, pzemChanged); // Publish dữ liệu lên các topic MQTT nếu có thông số thay đổi
+    for (;;)
+    {
+        const uint32_t waitMs = Scheduler_runDue(&leakScheduler);
+        if (waitMs > 0)
+        {
+            vTaskDelay(pdMS_TO_TICKS(waitMs));
+        }
+    }
+}
 
-        Serial.print("Warning Status: "); // Log trạng thái cảnh báo hiện tại
-        Serial.println(warning ? "YES" : "NO");
+// Task mạng: duy trì WiFi/MQTT và publish các snapshot nhận được từ task thu thập dữ liệu
+static void networkTask(void *param)
+{
+    IOT_MQTT_setupWifi();           // Khởi tạo WiFi, kết nối được thực hiện không chặn trong vòng lặp bên dưới
+    IOT_MQTT_setupTime();           // Đồng bộ thời gian thực (NTP) chạy nền, mẫu trước khi đồng bộ được hiệu chỉnh lúc publish
+    IOT_MQTT_setupMQTT(mqttClient); // Kết nối MQTT server, thiết lập client, topic, callback
 
-        handleWarningBeep(warning); // Xử lý cảnh báo còi (buzzer) dựa trên trạng thái cảnh báo hiện tại
+    static SensorSnapshot snapshot; // Bộ đệm nhận snapshot (static để không chiếm stack của task)
 
-        printSensorSnapshot(); // In toàn bộ snapshot dữ liệu cảm biến lên Serial để debug, kiểm tra hệ thống
+    for (;;)
+    {
+        // WiFi và MQTT đều không chặn (MQTT tối đa một lần thử mỗi vòng, có backoff);
+        // khi mất kết nối, snapshot được giữ lại và gộp flag ở phía thu thập dữ liệu
+        // Trước khi đồng bộ NTP, bản tin được giữ trong hàng đợi (tối đa NTP_SYNC_HOLD_MS) để có giờ thực
+        if (IOT_MQTT_ensureWifiConnected() && IOT_MQTT_ensureConnected(mqttClient) && IOT_MQTT_timestampsReady())
+        {
+            // Cảnh báo rò điện được publish trước và xen giữa các snapshot, không phải chờ hết hàng đợi
+            IOT_MQTT_publishLeakAlarms(mqttClient);
+            IOT_MQTT_publishLeakWindows(mqttClient); // Dòng rò vượt ngưỡng (gửi ngay) và thống kê theo cửa sổ
+            // Publish lần lượt toàn bộ snapshot đang chờ trong hàng đợi
+            while (SensorSnapshot_consume(&snapshot))
+            {
+                IOT_MQTT_publishAll(mqttClient, snapshot); // Publish dữ liệu lên các topic MQTT nếu có thông số thay đổi
+                IOT_MQTT_publishLeakAlarms(mqttClient);
+            }
+            IOT_MQTT_publishDiagnostics(mqttClient); // Chẩn đoán bus Modbus, chu kỳ chậm
+        }
+
+        // Ngủ đến khi có snapshot mới hoặc hết thời gian chờ để tiếp tục phục vụ MQTT keep-alive
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(NET_TASK_IDLE_MS));
     }
+}
+
+// Khởi tạo trạng thái và các module cảm biến phần cứng, bản đồ địa chỉ và tốc độ baud của bus cảm biến
+static void initSensors()
+{
+    SensorHandlers_init(); // Khởi tạo các biến, struct, trạng thái cảm biến (counter, flag, threshold...)
+    MD0630T01A_init();     // Khởi tạo cảm biến rò điện
+    ES35SW_init();         // Khởi tạo cảm biến môi trường (nhiệt độ, độ ẩm)
+    PZEM016_init();        // Khởi tạo cảm biến điện năng (điện áp, dòng, công suất...)
+    ModbusDiscovery_init(); // Nạp bản đồ địa chỉ Modbus từ NVS; chỉ quét bus khi chưa có (lần khởi động đầu)
+    BaudNegotiation_init(); // Khôi phục/thương lượng tốc độ baud của bus cảm biến (PZEM016T cố định 9600)
+    LeakWindow_init();     // Vòng đệm cửa sổ thống kê và hàng đợi sự kiện vượt ngưỡng của dòng rò (trước task rò điện và task mạng)
+
+    // op_time_counter_reset(&op_time_auo_display);
+    // op_time_counter_reset(&op_time_ccu_img1s);
+    // op_time_counter_reset(&op_time_ccu_img1hub);
+    // op_time_counter_reset(&op_time_ccu_imgtricpal);
+    // op_time_counter_reset(&op_time_xenon_300);
+    // op_time_counter_reset(&op_time_UI400);
+}
+
+// Khởi tạo còi (giai điệu khởi động phát nền, không chặn) và đường cảnh báo rò điện theo ngắt
+static void initAlarms()
+{
+    initBuzzer();         // Khởi tạo module cảnh báo âm thanh (buzzer)
+    LeakAlarm_init(NULL); // Ngắt trên các chân DO/AO/DA: còi và bản tin cảnh báo không chờ chu kỳ đọc Modbus
+}
+
+// Tạo 2 pipeline thu thập dữ liệu; snapshot được giữ trong hàng đợi cho đến khi mạng sẵn sàng
+static void startAcquisition()
+{
+    leakLock = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(leakTask, "leak", LEAK_TASK_STACK, NULL, LEAK_TASK_PRIORITY, &leakTaskHandle, ACQ_TASK_CORE);
+    xTaskCreatePinnedToCore(acquisitionTask, "acquisition", ACQ_TASK_STACK, NULL, ACQ_TASK_PRIORITY, &acquisitionTaskHandle, ACQ_TASK_CORE);
+}
+
+// Tạo task mạng và đăng ký nó nhận thông báo từ hàng đợi snapshot, cảnh báo và cửa sổ dòng rò
+static void startNetwork()
+{
+    xTaskCreatePinnedToCore(networkTask, "network", NET_TASK_STACK, NULL, NET_TASK_PRIORITY, &networkTaskHandle, NET_TASK_CORE);
+    SensorSnapshot_setConsumerTask(networkTaskHandle);
+    LeakAlarm_setConsumerTask(networkTaskHandle);
+    LeakWindow_setConsumerTask(networkTaskHandle);
+}
+
+void setup()
+{
+    Serial.begin(9600); // Khởi tạo giao tiếp Serial để debug, log trạng thái hệ thống
+
+    // FAST_BOOT chỉ chọn thứ tự khởi động, các bước giống nhau
+    initSensors();
+#if FAST_BOOT
+    startAcquisition(); // Lấy mẫu ngay khi cấp nguồn, còi và mạng sau
+    initAlarms();
+    startNetwork();
+#else
+    initAlarms();
+    startNetwork();     // Task mạng trước để có handle nhận thông báo từ hàng đợi snapshot
+    startAcquisition(); // Lấy mẫu ngay cả khi mạng chưa sẵn sàng
+#endif
+
+    Serial.println("=== SYSTEM READY ==="); // Thông báo hệ thống đã sẵn sàng
+}
+
+void loop()
+{
+    vTaskDelete(NULL); // Toàn bộ công việc chạy trong 3 task riêng (thu thập, rò điện, mạng), giải phóng loop task của Arduino
 }
\ No newline at end of file
@@ -0,0 +1,321 @@
+/**
+ * @file Arduino.h
+ * @brief Host stand-in for the parts of the ESP32 Arduino core the libraries use (native test build only).
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * Time comes from the host's steady clock. GPIO levels, pin interrupt handlers and LEDC tones are
+ * plain arrays that tests read and write. Serial prints to stdout; other UARTs can be attached to a
+ * file descriptor.
+ */
+
+#ifndef FAKE_ARDUINO_H
+#define FAKE_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <poll.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "freertos/FreeRTOS.h"
+
+#define IRAM_ATTR
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define FAKE_GPIO_COUNT 40   // GPIO numbers of the ESP32
+#define FAKE_LEDC_CHANNELS 16 // LEDC channels of the ESP32
+
+inline std::chrono::steady_clock::time_point fakeBootTime()
+{
+    static const std::chrono::steady_clock::time_point boot = std::chrono::steady_clock::now();
+    return boot;
+}
+
+inline unsigned long micros()
+{
+    return (unsigned long)(uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - fakeBootTime())
+        .count();
+}
+
+inline unsigned long millis()
+{
+    return (unsigned long)(uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - fakeBootTime())
+        .count();
+}
+
+inline void delay(uint32_t ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void delayMicroseconds(uint32_t us)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+// GPIO: tests set fakePinLevel[] and read fakePinMode[]
+inline int fakePinLevel[FAKE_GPIO_COUNT];
+inline uint8_t fakePinMode[FAKE_GPIO_COUNT];
+
+inline void pinMode(uint8_t pin, uint8_t mode)
+{
+    fakePinMode[pin] = mode;
+}
+
+inline int digitalRead(uint8_t pin)
+{
+    return fakePinLevel[pin];
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t level)
+{
+    fakePinLevel[pin] = level;
+}
+
+// Pin interrupts: tests call fakePinIsr[pin]() to raise an edge
+inline void (*fakePinIsr[FAKE_GPIO_COUNT])(void);
+
+#define digitalPinToInterrupt(pin) (pin)
+
+inline void attachInterrupt(uint8_t pin, void (*isr)(void), int mode)
+{
+    (void)mode;
+    fakePinIsr[pin] = isr;
+}
+
+inline void detachInterrupt(uint8_t pin)
+{
+    fakePinIsr[pin] = nullptr;
+}
+
+// LEDC: the last tone written to each channel
+inline uint32_t fakeLedcTone[FAKE_LEDC_CHANNELS];
+
+inline double ledcSetup(uint8_t channel, double frequency, uint8_t resolution)
+{
+    (void)channel;
+    (void)resolution;
+    return frequency;
+}
+
+inline void ledcAttachPin(uint8_t pin, uint8_t channel)
+{
+    (void)pin;
+    (void)channel;
+}
+
+inline double ledcWriteTone(uint8_t channel, double frequency)
+{
+    fakeLedcTone[channel] = (uint32_t)frequency;
+    return frequency;
+}
+
+#define SERIAL_8N1 0x800001c
+#define FAKE_UART_FIFO 120 // RX FIFO-full threshold of the ESP32 UART driver
+
+/**
+ * @brief UART. Unattached ports print to stdout (console). A port attached to a file descriptor,
+ *        e.g. the slave side of a pseudo-terminal, reads and writes that descriptor instead.
+ *
+ * @details A reader thread moves received bytes into an RX buffer and calls the onReceive()
+ *          callback when the line has been idle for setRxTimeout() characters or FAKE_UART_FIFO
+ *          bytes are buffered, like the ESP32 core's UART event task. flush() waits for the wire
+ *          time of the bytes written at the configured rate.
+ */
+class HardwareSerial
+{
+public:
+    explicit HardwareSerial(int uart) : uart_(uart), state_(new State()) {}
+
+    /**
+     * @brief Attach the port to @p fd (host tests only). Call before begin().
+     */
+    void fakeAttach(int fd) { state_->fd = fd; }
+
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1)
+    {
+        (void)config;
+        (void)rxPin;
+        (void)txPin;
+        state_->baud = (uint32_t)baud;
+        if (state_->fd >= 0 && !state_->readerStarted.exchange(true))
+        {
+            State *state = state_;
+            std::thread([state]()
+                        { readerLoop(state); })
+                .detach();
+        }
+    }
+
+    void updateBaudRate(unsigned long baud) { state_->baud = (uint32_t)baud; }
+    uint32_t baudRate() const { return state_->baud; }
+    bool setRxTimeout(uint8_t symbols)
+    {
+        state_->rxTimeoutSymbols = symbols;
+        return true;
+    }
+
+    void onReceive(std::function<void(void)> callback, bool onlyOnTimeout = false)
+    {
+        std::lock_guard<std::mutex> guard(state_->lock);
+        state_->callback = callback;
+        state_->onlyOnTimeout = onlyOnTimeout;
+    }
+
+    int available()
+    {
+        std::lock_guard<std::mutex> guard(state_->lock);
+        return (int)state_->rx.size();
+    }
+
+    int read()
+    {
+        std::lock_guard<std::mutex> guard(state_->lock);
+        if (state_->rx.empty())
+        {
+            return -1;
+        }
+        const uint8_t b = state_->rx.front();
+        state_->rx.pop_front();
+        return b;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size)
+    {
+        if (state_->fd < 0)
+        {
+            return fwrite(buffer, 1, size, stdout);
+        }
+        const uint32_t now = micros();
+        const uint32_t start = (int32_t)(state_->txDoneUs - now) > 0 ? state_->txDoneUs : now;
+        state_->txDoneUs = start + (uint32_t)size * charTimeUs(state_);
+        const ssize_t written = ::write(state_->fd, buffer, size);
+        return written > 0 ? (size_t)written : 0;
+    }
+
+    size_t write(uint8_t b) { return write(&b, 1); }
+
+    void flush()
+    {
+        while ((int32_t)(state_->txDoneUs - micros()) > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        va_list args;
+        va_start(args, format);
+        const int len = vprintf(format, args);
+        va_end(args);
+        return len > 0 ? (size_t)len : 0;
+    }
+
+    size_t print(const char *text) { return fputs(text, stdout) >= 0 ? strlen(text) : 0; }
+    size_t println(const char *text = "") { return print(text) + print("\n"); }
+
+private:
+    struct State
+    {
+        int fd = -1;
+        std::atomic<uint32_t> baud{115200};
+        std::atomic<uint8_t> rxTimeoutSymbols{2};
+        std::atomic<bool> readerStarted{false};
+        uint32_t txDoneUs = 0;
+        std::mutex lock;
+        std::deque<uint8_t> rx;
+        std::function<void(void)> callback;
+        bool onlyOnTimeout = false;
+    };
+
+    static uint32_t charTimeUs(const State *state) { return (11u * 1000000u + state->baud - 1) / state->baud; }
+
+    static void fireCallback(State *state)
+    {
+        std::function<void(void)> callback;
+        {
+            std::lock_guard<std::mutex> guard(state->lock);
+            callback = state->callback;
+        }
+        if (callback)
+        {
+            callback();
+        }
+    }
+
+    // Never returns while the descriptor is open; the State is never freed, so the thread cannot outlive it
+    static void readerLoop(State *state)
+    {
+        bool pending = false; // Bytes arrived since the last idle event
+        for (;;)
+        {
+            const uint32_t idleUs = state->rxTimeoutSymbols * charTimeUs(state);
+            const timespec timeout = {(time_t)(idleUs / 1000000), (long)(idleUs % 1000000) * 1000};
+            pollfd pfd = {state->fd, POLLIN, 0};
+            const int ready = ppoll(&pfd, 1, pending ? &timeout : nullptr, nullptr);
+            if (ready < 0 || (pfd.revents & (POLLNVAL | POLLERR)))
+            {
+                return;
+            }
+            if (ready == 0)
+            {
+                pending = false;
+                fireCallback(state); // RX idle: end of frame
+                continue;
+            }
+            uint8_t chunk[64];
+            const ssize_t n = ::read(state->fd, chunk, sizeof(chunk));
+            if (n <= 0)
+            {
+                if (pfd.revents & POLLHUP)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1)); // Other side not open yet
+                }
+                continue;
+            }
+            bool fifoFull;
+            bool everyChunk;
+            {
+                std::lock_guard<std::mutex> guard(state->lock);
+                state->rx.insert(state->rx.end(), chunk, chunk + n);
+                fifoFull = state->rx.size() >= FAKE_UART_FIFO;
+                everyChunk = !state->onlyOnTimeout;
+            }
+            pending = true;
+            if (fifoFull || everyChunk)
+            {
+                fireCallback(state);
+            }
+        }
+    }
+
+    int uart_;
+    State *state_;
+};
+
+inline HardwareSerial Serial(0);
+inline HardwareSerial Serial1(1);
+inline HardwareSerial Serial2(2);
+
+#endif // FAKE_ARDUINO_H
@@ -0,0 +1,292 @@
+/**
+ * @file FakeModbusSlave.h
+ * @brief Simulated RS485 bus for host tests: a pseudo-terminal whose far end is served by a thread
+ *        that answers Modbus-RTU requests like the slaves on the real bus (native test build only).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef FAKE_MODBUS_SLAVE_H
+#define FAKE_MODBUS_SLAVE_H
+
+#include <Arduino.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <map>
+#include <vector>
+#include "ModbusRtu.h"
+
+/**
+ * @brief Both ends of a raw-mode pseudo-terminal. The firmware's UART is attached to @c uart,
+ *        the simulated slaves to @c wire.
+ */
+typedef struct
+{
+    int wire; ///< pty master
+    int uart; ///< pty slave
+} FakePty;
+
+inline FakePty FakePty_open(void)
+{
+    FakePty pty = {-1, -1};
+    pty.wire = posix_openpt(O_RDWR | O_NOCTTY);
+    if (pty.wire < 0 || grantpt(pty.wire) != 0 || unlockpt(pty.wire) != 0)
+    {
+        return pty;
+    }
+    pty.uart = open(ptsname(pty.wire), O_RDWR | O_NOCTTY);
+    termios tio;
+    tcgetattr(pty.uart, &tio);
+    cfmakeraw(&tio); // Binary frames: no echo, no line editing, no CR/LF translation
+    tcsetattr(pty.uart, TCSANOW, &tio);
+    return pty;
+}
+
+/**
+ * @brief Slaves on the far end of a simulated bus.
+ */
+class FakeModbusSlave
+{
+public:
+    /**
+     * @brief Behaviour of one slave address.
+     */
+    struct Device
+    {
+        bool present = false;              ///< false = never answers (dead socket, empty address)
+        std::map<uint16_t, uint16_t> registers; ///< Shared by FC 0x03, 0x04 and 0x06; a missing register is exception 0x02
+        uint32_t latencyUs = 2000;         ///< Time from the end of the request to the first response byte
+        uint8_t exception = 0;             ///< Non-zero: answer every request with this exception code
+        uint32_t corruptNext = 0;          ///< Next responses sent with a broken CRC
+        uint32_t truncateNext = 0;         ///< Next responses sent without their last 2 bytes (CRC)
+        uint32_t shortNext = 0;            ///< Next read responses carry one register less, with a valid CRC
+        uint32_t splitGapUs = 0;           ///< Non-zero: the line goes silent this long in the middle of each response
+        uint32_t badEchoNext = 0;          ///< Next FC 0x06 writes store and echo the value with bit 0 flipped, with a valid CRC
+    };
+
+    /**
+     * @brief One request seen on the wire and its answer.
+     */
+    struct Exchange
+    {
+        uint8_t slave;
+        uint8_t function;
+        uint16_t start;
+        uint32_t requestUs;     ///< micros() when the last request byte was on the wire
+        uint32_t responseEndUs; ///< micros() after the last response byte, 0 if not answered
+    };
+
+    FakeModbusSlave(int wire, uint32_t baud) : state_(new State())
+    {
+        state_->wire = wire;
+        state_->baud = baud;
+        State *state = state_;
+        std::thread([state]()
+                    { serve(state); })
+            .detach();
+    }
+
+    /**
+     * @brief Configure a slave address. Call before requests reach it, or while the bus is idle.
+     */
+    Device &device(uint8_t address)
+    {
+        std::lock_guard<std::mutex> guard(state_->lock);
+        return state_->devices[address];
+    }
+
+    void setBaud(uint32_t baud) { state_->baud = baud; }
+
+    std::vector<Exchange> exchanges()
+    {
+        std::lock_guard<std::mutex> guard(state_->lock);
+        return state_->log;
+    }
+
+    void clearLog()
+    {
+        std::lock_guard<std::mutex> guard(state_->lock);
+        state_->log.clear();
+    }
+
+private:
+    struct State
+    {
+        int wire = -1;
+        std::atomic<uint32_t> baud{9600};
+        std::mutex lock;
+        std::map<uint8_t, Device> devices;
+        std::vector<Exchange> log;
+    };
+
+    static uint32_t charTimeUs(const State *state) { return (11u * 1000000u + state->baud - 1) / state->baud; }
+
+    static void sleepUntil(uint32_t dueUs)
+    {
+        while ((int32_t)(dueUs - micros()) > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    // Write @p len bytes at the wire rate: each byte is delivered once its character time has passed
+    static void sendPaced(State *state, const uint8_t *frame, size_t len, size_t splitAt, uint32_t splitGapUs)
+    {
+        const uint32_t charUs = charTimeUs(state);
+        uint32_t due = micros();
+        for (size_t i = 0; i < len; i++)
+        {
+            if (i == splitAt)
+            {
+                due += splitGapUs;
+            }
+            due += charUs;
+            sleepUntil(due);
+            if (::write(state->wire, &frame[i], 1) != 1)
+            {
+                return;
+            }
+        }
+    }
+
+    static size_t buildResponse(Device &dev, const uint8_t *request, uint8_t *response)
+    {
+        const uint8_t function = request[1];
+        const uint16_t start = (uint16_t)((request[2] << 8) | request[3]);
+        uint16_t value = (uint16_t)((request[4] << 8) | request[5]);
+        if (dev.shortNext > 0 && function != MODBUS_FC_WRITE_SINGLE && value > 1)
+        {
+            dev.shortNext--;
+            value--;
+        }
+        response[0] = request[0];
+        response[1] = function;
+
+        uint8_t exception = dev.exception;
+        if (exception == 0 && function != MODBUS_FC_READ_HOLDING && function != MODBUS_FC_READ_INPUT &&
+            function != MODBUS_FC_WRITE_SINGLE)
+        {
+            exception = 0x01; // Illegal function
+        }
+        if (exception == 0 && function == MODBUS_FC_WRITE_SINGLE)
+        {
+            if (dev.badEchoNext > 0)
+            {
+                dev.badEchoNext--;
+                value ^= 1;
+            }
+            dev.registers[start] = value;
+            memcpy(response, request, 4);
+            response[4] = (uint8_t)(value >> 8);
+            response[5] = (uint8_t)(value & 0xFF);
+            return ModbusRtu_appendCrc(response, 6);
+        }
+        if (exception == 0 && (value == 0 || value > MODBUS_RTU_MAX_READ_COUNT))
+        {
+            exception = 0x03; // Illegal data value
+        }
+        if (exception == 0)
+        {
+            for (uint16_t i = 0; i < value && exception == 0; i++)
+            {
+                if (dev.registers.count((uint16_t)(start + i)) == 0)
+                {
+                    exception = 0x02; // Illegal data address
+                }
+            }
+        }
+        if (exception != 0)
+        {
+            response[1] = (uint8_t)(function | MODBUS_EXCEPTION_FLAG);
+            response[2] = exception;
+            return ModbusRtu_appendCrc(response, 3);
+        }
+        response[2] = (uint8_t)(2 * value);
+        for (uint16_t i = 0; i < value; i++)
+        {
+            const uint16_t reg = dev.registers[(uint16_t)(start + i)];
+            response[3 + 2 * i] = (uint8_t)(reg >> 8);
+            response[4 + 2 * i] = (uint8_t)(reg & 0xFF);
+        }
+        return ModbusRtu_appendCrc(response, 3 + 2 * value);
+    }
+
+    // Every request the master sends (FC 0x03/0x04 read, FC 0x06 write) is 8 bytes long. The UART
+    // delivers a request as soon as it is written, so its wire time is added here
+    static void serve(State *state)
+    {
+        std::vector<uint8_t> rx;
+        for (;;)
+        {
+            uint8_t chunk[64];
+            const ssize_t n = ::read(state->wire, chunk, sizeof(chunk));
+            if (n <= 0)
+            {
+                if (n < 0 && errno != EAGAIN && errno != EINTR && errno != EIO)
+                {
+                    return;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            rx.insert(rx.end(), chunk, chunk + n);
+            while (rx.size() >= MODBUS_RTU_READ_REQUEST_LEN)
+            {
+                if (ModbusRtu_crc16(rx.data(), MODBUS_RTU_READ_REQUEST_LEN) != 0)
+                {
+                    rx.erase(rx.begin()); // Not a frame boundary: resynchronize
+                    continue;
+                }
+                uint8_t request[MODBUS_RTU_READ_REQUEST_LEN];
+                memcpy(request, rx.data(), sizeof(request));
+                rx.erase(rx.begin(), rx.begin() + MODBUS_RTU_READ_REQUEST_LEN);
+                answer(state, request);
+            }
+        }
+    }
+
+    static void answer(State *state, const uint8_t *request)
+    {
+        Exchange exchange = {request[0], request[1], (uint16_t)((request[2] << 8) | request[3]),
+                             (uint32_t)micros() + MODBUS_RTU_READ_REQUEST_LEN * charTimeUs(state), 0};
+        sleepUntil(exchange.requestUs);
+        uint8_t response[MODBUS_RTU_MAX_FRAME];
+        size_t len = 0;
+        uint32_t latencyUs = 0;
+        uint32_t splitGapUs = 0;
+        {
+            std::lock_guard<std::mutex> guard(state->lock);
+            Device &dev = state->devices[request[0]];
+            if (dev.present)
+            {
+                len = buildResponse(dev, request, response);
+                latencyUs = dev.latencyUs;
+                splitGapUs = dev.splitGapUs;
+                if (dev.corruptNext > 0)
+                {
+                    dev.corruptNext--;
+                    response[len - 1] ^= 0x5A;
+                }
+                if (dev.truncateNext > 0)
+                {
+                    dev.truncateNext--;
+                    len -= 2;
+                }
+            }
+        }
+        if (len > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(latencyUs));
+            sendPaced(state, response, len, splitGapUs != 0 ? len / 2 : len, splitGapUs);
+            exchange.responseEndUs = (uint32_t)micros();
+        }
+        std::lock_guard<std::mutex> guard(state->lock);
+        state->log.push_back(exchange);
+    }
+
+    State *state_;
+};
+
+#endif // FAKE_MODBUS_SLAVE_H
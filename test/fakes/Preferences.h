@@ -0,0 +1,129 @@
+/**
+ * @file Preferences.h
+ * @brief Host stand-in for the ESP32 Preferences (NVS) library (native test build only).
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * Namespaces and their keys live in one process-wide map, so values survive end() and a new
+ * Preferences object like they survive a reboot on the target. Tests wipe it with FakeNvs_erase().
+ */
+
+#ifndef FAKE_PREFERENCES_H
+#define FAKE_PREFERENCES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef std::map<std::string, std::vector<uint8_t>> FakeNvsNamespace;
+
+inline std::map<std::string, FakeNvsNamespace> &fakeNvs()
+{
+    static std::map<std::string, FakeNvsNamespace> nvs;
+    return nvs;
+}
+
+// Writes done so far (putBytes/putUInt/putUChar), for tests that check when NVS is written
+inline uint32_t fakeNvsWrites = 0;
+
+inline void FakeNvs_erase(void)
+{
+    fakeNvs().clear();
+    fakeNvsWrites = 0;
+}
+
+class Preferences
+{
+public:
+    bool begin(const char *name, bool readOnly = false)
+    {
+        ns_ = &fakeNvs()[name];
+        readOnly_ = readOnly;
+        return true;
+    }
+
+    void end() { ns_ = nullptr; }
+
+    size_t putBytes(const char *key, const void *value, size_t len)
+    {
+        if (ns_ == nullptr || readOnly_)
+        {
+            return 0;
+        }
+        const uint8_t *bytes = (const uint8_t *)value;
+        (*ns_)[key].assign(bytes, bytes + len);
+        fakeNvsWrites++;
+        return len;
+    }
+
+    size_t getBytes(const char *key, void *buf, size_t maxLen)
+    {
+        const std::vector<uint8_t> *value = find(key);
+        if (value == nullptr || value->size() > maxLen)
+        {
+            return 0;
+        }
+        memcpy(buf, value->data(), value->size());
+        return value->size();
+    }
+
+    size_t getBytesLength(const char *key)
+    {
+        const std::vector<uint8_t> *value = find(key);
+        return value != nullptr ? value->size() : 0;
+    }
+
+    size_t putUInt(const char *key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0)
+    {
+        uint32_t value = defaultValue;
+        const std::vector<uint8_t> *stored = find(key);
+        if (stored != nullptr && stored->size() == sizeof(value))
+        {
+            memcpy(&value, stored->data(), sizeof(value));
+        }
+        return value;
+    }
+
+    size_t putUChar(const char *key, uint8_t value) { return putBytes(key, &value, sizeof(value)); }
+
+    uint8_t getUChar(const char *key, uint8_t defaultValue = 0)
+    {
+        const std::vector<uint8_t> *stored = find(key);
+        return (stored != nullptr && stored->size() == 1) ? (*stored)[0] : defaultValue;
+    }
+
+    bool isKey(const char *key) { return find(key) != nullptr; }
+
+    bool remove(const char *key) { return ns_ != nullptr && !readOnly_ && ns_->erase(key) > 0; }
+
+    bool clear()
+    {
+        if (ns_ == nullptr || readOnly_)
+        {
+            return false;
+        }
+        ns_->clear();
+        return true;
+    }
+
+private:
+    const std::vector<uint8_t> *find(const char *key) const
+    {
+        if (ns_ == nullptr)
+        {
+            return nullptr;
+        }
+        const FakeNvsNamespace::const_iterator it = ns_->find(key);
+        return it != ns_->end() ? &it->second : nullptr;
+    }
+
+    FakeNvsNamespace *ns_ = nullptr;
+    bool readOnly_ = false;
+};
+
+#endif // FAKE_PREFERENCES_H
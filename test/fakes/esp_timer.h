@@ -0,0 +1,60 @@
+/**
+ * @file esp_timer.h
+ * @brief Host stand-in for the ESP-IDF high-resolution timer API (native test build only).
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * Timers are created but never fire: host tests drive periodic callbacks themselves (e.g. Buzzer_tick()
+ * with a fake time), which keeps timelines deterministic.
+ */
+
+#ifndef FAKE_ESP_TIMER_H
+#define FAKE_ESP_TIMER_H
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum
+{
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR
+} esp_timer_dispatch_t;
+
+typedef struct
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+typedef struct FakeEspTimer
+{
+    esp_timer_create_args_t args;
+    uint64_t periodUs;
+} *esp_timer_handle_t;
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+    *handle = new FakeEspTimer{*args, 0};
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs)
+{
+    timer->periodUs = periodUs;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    timer->periodUs = 0;
+    return ESP_OK;
+}
+
+#endif // FAKE_ESP_TIMER_H
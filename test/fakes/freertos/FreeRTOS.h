@@ -0,0 +1,292 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Host stand-in for the FreeRTOS API used by the libraries (native test build only).
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * Tasks are detached std::threads, notifications, queues and semaphores are built on a mutex and
+ * a condition variable. Priorities and cores are ignored. 1 tick = 1 ms.
+ */
+
+#ifndef FAKE_FREERTOS_H
+#define FAKE_FREERTOS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFu)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms)) // 1 tick = 1 ms
+
+/**
+ * @brief Spinlock standing in for the ESP32 critical-section mutex. "ISRs" of a host test run on
+ *        ordinary threads, so task and ISR variants are the same lock.
+ */
+typedef struct
+{
+    std::atomic<bool> locked;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {false}
+
+inline void fakePortEnterCritical(portMUX_TYPE *mux)
+{
+    while (mux->locked.exchange(true, std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+}
+
+inline void fakePortExitCritical(portMUX_TYPE *mux)
+{
+    mux->locked.store(false, std::memory_order_release);
+}
+
+#define portENTER_CRITICAL(mux) fakePortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) fakePortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) fakePortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux) fakePortExitCritical(mux)
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
+
+/**
+ * @brief Wait on @p cv until @p ready() or @p ticks have passed (portMAX_DELAY = forever).
+ */
+template <typename Ready>
+inline bool fakeWaitTicks(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, TickType_t ticks, Ready ready)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        cv.wait(lock, ready);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+// ========== Tasks and direct-to-task notifications ==========
+
+typedef void (*TaskFunction_t)(void *);
+
+typedef struct FakeTask
+{
+    std::mutex lock;
+    std::condition_variable notified;
+    uint32_t notifyCount = 0;
+    std::atomic<uint32_t> wakeups{0};        ///< Returns from ulTaskNotifyTake() (tests count RX wakeups)
+    clockid_t cpuClock = CLOCK_THREAD_CPUTIME_ID; ///< CPU-time clock of the task's thread (tests measure busy-waiting)
+} FakeTask;
+
+typedef FakeTask *TaskHandle_t;
+
+inline thread_local FakeTask *fakeCurrentTask = nullptr;
+
+/**
+ * @brief Task of the calling thread; threads not created through xTaskCreate*() get one on first use.
+ */
+inline TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (fakeCurrentTask == nullptr)
+    {
+        fakeCurrentTask = new FakeTask();
+    }
+    return fakeCurrentTask;
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stackDepth, void *param,
+                                          UBaseType_t priority, TaskHandle_t *created, BaseType_t core)
+{
+    (void)name;
+    (void)stackDepth;
+    (void)priority;
+    (void)core;
+    FakeTask *task = new FakeTask();
+    if (created != nullptr)
+    {
+        *created = task;
+    }
+    std::thread([task, code, param]()
+                {
+                    fakeCurrentTask = task;
+                    pthread_getcpuclockid(pthread_self(), &task->cpuClock);
+                    code(param); })
+        .detach();
+    return pdPASS;
+}
+
+inline void vTaskDelete(TaskHandle_t task)
+{
+    (void)task; // Task functions of the libraries never return; nothing to reclaim on a host
+}
+
+inline void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+inline void xTaskNotifyGive(TaskHandle_t task)
+{
+    {
+        std::lock_guard<std::mutex> guard(task->lock);
+        task->notifyCount++;
+    }
+    task->notified.notify_one();
+}
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken)
+{
+    xTaskNotifyGive(task);
+    if (higherPriorityTaskWoken != nullptr)
+    {
+        *higherPriorityTaskWoken = pdTRUE;
+    }
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticks)
+{
+    FakeTask *self = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(self->lock);
+    fakeWaitTicks(self->notified, lock, ticks, [self]()
+                  { return self->notifyCount > 0; });
+    const uint32_t count = self->notifyCount;
+    if (count > 0)
+    {
+        self->notifyCount = clearCountOnExit ? 0 : count - 1;
+    }
+    self->wakeups++;
+    return count;
+}
+
+// ========== Queues ==========
+
+typedef struct FakeQueue
+{
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+} FakeQueue;
+
+typedef FakeQueue *QueueHandle_t;
+
+#define errQUEUE_FULL pdFALSE
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    FakeQueue *queue = new FakeQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!fakeWaitTicks(queue->changed, lock, ticks, [queue]()
+                       { return queue->items.size() < queue->length; }))
+    {
+        return errQUEUE_FULL;
+    }
+    const uint8_t *bytes = (const uint8_t *)item;
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    lock.unlock();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!fakeWaitTicks(queue->changed, lock, ticks, [queue]()
+                       { return !queue->items.empty(); }))
+    {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    lock.unlock();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return (UBaseType_t)queue->items.size();
+}
+
+// ========== Semaphores ==========
+
+typedef struct FakeSemaphore
+{
+    std::mutex lock;
+    std::condition_variable given;
+    UBaseType_t count = 0;
+} FakeSemaphore;
+
+typedef FakeSemaphore *SemaphoreHandle_t;
+typedef struct
+{
+    FakeSemaphore semaphore;
+} StaticSemaphore_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer)
+{
+    buffer->semaphore.count = 0;
+    return &buffer->semaphore;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    FakeSemaphore *semaphore = new FakeSemaphore();
+    semaphore->count = 1; // A mutex starts available
+    return semaphore;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    // Notify under the lock: the taker may delete a static semaphore as soon as it wakes up
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    if (semaphore->count > 0)
+    {
+        return pdFALSE; // Binary semaphore and mutex hold at most one token
+    }
+    semaphore->count = 1;
+    semaphore->given.notify_one();
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(semaphore->lock);
+    if (!fakeWaitTicks(semaphore->given, lock, ticks, [semaphore]()
+                       { return semaphore->count > 0; }))
+    {
+        return pdFALSE;
+    }
+    semaphore->count = 0;
+    return pdTRUE;
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    (void)semaphore; // Static ones live in the caller's buffer, the few dynamic ones are never deleted
+}
+
+#endif // FAKE_FREERTOS_H
@@ -0,0 +1,389 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the adaptive poll periods: class and period transitions of a socket and of the
+ *        environment sensor, and a replay of a socket-state trace through the acquisition job set,
+ *        counting the bus transactions saved against the fixed 5 s schedule
+ *        (pio test -e native -f test_adaptive_polling).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "AdaptivePolling.h"
+#include "Scheduler.h"
+
+#define FIXED_PERIOD_MS 5000    // readInterval of the firmware: the fixed schedule
+#define PZEM_OFFSET_MS 200      // JOB_PZEM_OFFSET
+#define PUBLISH_OFFSET_MS 2000  // JOB_PUBLISH_OFFSET: evaluates the socket periods
+#define REPLAY_SOCKETS 6        // Sockets of the trace (NUM_DEVICES)
+#define REPLAY_MINUTES 120      // Length of the trace
+#define REPLAY_MS (REPLAY_MINUTES * 60000UL)
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/**
+ * @brief One evaluation of a socket and the class and period it must produce.
+ */
+typedef struct
+{
+    bool powered;
+    bool machineOn;
+    bool changed;
+    PollClass expectedClass;
+    uint32_t expectedPeriodMs;
+    uint8_t expectedActivity;
+} SocketStep;
+
+static void replaySteps(PollChannel *ch, const SocketStep *steps, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint32_t periodMs = AdaptivePoll_updateSocket(ch, steps[i].powered, steps[i].machineOn, steps[i].changed);
+        char line[96];
+        snprintf(line, sizeof(line), "step %u: %s/%lums", (unsigned)i, AdaptivePoll_className(ch->pollClass),
+                 (unsigned long)periodMs);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(steps[i].expectedClass, ch->pollClass, line);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(steps[i].expectedPeriodMs, periodMs, line);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(steps[i].expectedPeriodMs, ch->periodMs, line);
+        TEST_ASSERT_EQUAL_UINT8_MESSAGE(steps[i].expectedActivity, ch->activity, line);
+    }
+}
+
+void test_init_keeps_the_fixed_period_until_the_first_evaluation(void)
+{
+    PollChannel ch;
+    AdaptivePoll_init(&ch, FIXED_PERIOD_MS);
+    TEST_ASSERT_EQUAL_INT(POLL_CLASS_RUNNING, ch.pollClass);
+    TEST_ASSERT_EQUAL_UINT8(0, ch.activity);
+    TEST_ASSERT_EQUAL_UINT32(FIXED_PERIOD_MS, ch.periodMs);
+}
+
+void test_steady_class_follows_power_and_machine_state(void)
+{
+    static const SocketStep steps[] = {
+        {false, false, false, POLL_CLASS_LOST, POLL_PERIOD_LOST_MS, 0},
+        {false, true, false, POLL_CLASS_LOST, POLL_PERIOD_LOST_MS, 0}, // No power wins over a stale machine state
+        {true, false, false, POLL_CLASS_OFF, POLL_PERIOD_OFF_MS, 0},
+        {true, true, false, POLL_CLASS_RUNNING, POLL_PERIOD_RUNNING_MS, 0},
+        {true, false, false, POLL_CLASS_OFF, POLL_PERIOD_OFF_MS, 0}};
+    PollChannel ch;
+    AdaptivePoll_init(&ch, FIXED_PERIOD_MS);
+    replaySteps(&ch, steps, sizeof(steps) / sizeof(steps[0]));
+}
+
+void test_change_holds_fast_polling_for_the_activity_hold(void)
+{
+    TEST_ASSERT_EQUAL_INT(3, POLL_ACTIVITY_HOLD); // The steps below spell out three evaluations
+    static const SocketStep steps[] = {
+        {true, true, false, POLL_CLASS_RUNNING, POLL_PERIOD_RUNNING_MS, 0},
+        {true, true, true, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 3}, // Load step
+        {true, true, false, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 2},
+        {true, true, false, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 1},
+        {true, true, false, POLL_CLASS_RUNNING, POLL_PERIOD_RUNNING_MS, 0}, // Hold over
+        {true, true, true, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 3},
+        {true, true, false, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 2},
+        {true, true, true, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 3}, // A new change re-arms the full hold
+        {true, true, false, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 2},
+        {true, true, false, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 1},
+        {true, true, false, POLL_CLASS_RUNNING, POLL_PERIOD_RUNNING_MS, 0},
+        {true, true, false, POLL_CLASS_RUNNING, POLL_PERIOD_RUNNING_MS, 0}}; // Activity does not underflow
+    PollChannel ch;
+    AdaptivePoll_init(&ch, FIXED_PERIOD_MS);
+    replaySteps(&ch, steps, sizeof(steps) / sizeof(steps[0]));
+}
+
+void test_power_loss_and_power_up_are_followed_fast(void)
+{
+    static const SocketStep steps[] = {
+        {true, true, false, POLL_CLASS_RUNNING, POLL_PERIOD_RUNNING_MS, 0},
+        {false, false, true, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 3}, // Socket lost power
+        {false, false, false, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 2},
+        {false, false, false, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 1},
+        {false, false, false, POLL_CLASS_LOST, POLL_PERIOD_LOST_MS, 0},
+        {false, false, false, POLL_CLASS_LOST, POLL_PERIOD_LOST_MS, 0},
+        {true, false, true, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 3}, // Power back, machine off
+        {true, false, false, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 2},
+        {true, true, true, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 3}, // Machine switched on
+        {true, true, false, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 2},
+        {true, true, false, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 1},
+        {true, true, false, POLL_CLASS_RUNNING, POLL_PERIOD_RUNNING_MS, 0},
+        {true, false, true, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 3}, // Machine switched off
+        {true, false, false, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 2},
+        {true, false, false, POLL_CLASS_ACTIVE, POLL_PERIOD_ACTIVE_MS, 1},
+        {true, false, false, POLL_CLASS_OFF, POLL_PERIOD_OFF_MS, 0}};
+    PollChannel ch;
+    AdaptivePoll_init(&ch, FIXED_PERIOD_MS);
+    replaySteps(&ch, steps, sizeof(steps) / sizeof(steps[0]));
+}
+
+void test_environment_is_slow_unless_it_just_changed(void)
+{
+    PollChannel ch;
+    AdaptivePoll_init(&ch, FIXED_PERIOD_MS);
+    TEST_ASSERT_EQUAL_UINT32(POLL_PERIOD_ENV_MS, AdaptivePoll_updateEnvironment(&ch, false));
+    TEST_ASSERT_EQUAL_INT(POLL_CLASS_RUNNING, ch.pollClass);
+    TEST_ASSERT_EQUAL_UINT32(POLL_PERIOD_ENV_ACTIVE_MS, AdaptivePoll_updateEnvironment(&ch, true));
+    TEST_ASSERT_EQUAL_INT(POLL_CLASS_ACTIVE, ch.pollClass);
+    for (int i = 1; i < POLL_ACTIVITY_HOLD; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(POLL_PERIOD_ENV_ACTIVE_MS, AdaptivePoll_updateEnvironment(&ch, false));
+    }
+    TEST_ASSERT_EQUAL_UINT32(POLL_PERIOD_ENV_MS, AdaptivePoll_updateEnvironment(&ch, false));
+    TEST_ASSERT_EQUAL_INT(POLL_CLASS_RUNNING, ch.pollClass);
+    TEST_ASSERT_EQUAL_UINT8(0, ch.activity);
+}
+
+void test_class_names(void)
+{
+    TEST_ASSERT_EQUAL_STRING("lost", AdaptivePoll_className(POLL_CLASS_LOST));
+    TEST_ASSERT_EQUAL_STRING("off", AdaptivePoll_className(POLL_CLASS_OFF));
+    TEST_ASSERT_EQUAL_STRING("running", AdaptivePoll_className(POLL_CLASS_RUNNING));
+    TEST_ASSERT_EQUAL_STRING("active", AdaptivePoll_className(POLL_CLASS_ACTIVE));
+    TEST_ASSERT_EQUAL_STRING("?", AdaptivePoll_className((PollClass)42));
+}
+
+/**
+ * @brief True state of a socket over one segment of the trace.
+ */
+typedef enum
+{
+    TRACE_LOST,    ///< No power at the socket
+    TRACE_OFF,     ///< Powered, machine off
+    TRACE_STEADY,  ///< Machine running, readings within their deltas
+    TRACE_CHANGING ///< Machine running, readings beyond their deltas at every read
+} TraceState;
+
+typedef struct
+{
+    uint16_t untilMinute; ///< End of the segment
+    TraceState state;
+} TraceSegment;
+
+#define TRACE_END {0xFFFF, TRACE_OFF}
+
+/**
+ * @brief Two hours of an operating room: a display and a camera hub on all the time, an unplugged
+ *        camera, a light source and an insufflator switched on for a procedure.
+ */
+static const TraceSegment socketTrace[REPLAY_SOCKETS][8] = {
+    {{10, TRACE_OFF}, {12, TRACE_CHANGING}, {100, TRACE_STEADY}, {120, TRACE_OFF}, TRACE_END},
+    {{20, TRACE_LOST}, {30, TRACE_OFF}, {45, TRACE_STEADY}, {50, TRACE_CHANGING}, {90, TRACE_STEADY}, {120, TRACE_LOST}, TRACE_END},
+    {{120, TRACE_STEADY}, TRACE_END},
+    {{120, TRACE_LOST}, TRACE_END},
+    {{30, TRACE_OFF}, {33, TRACE_CHANGING}, {80, TRACE_STEADY}, {82, TRACE_CHANGING}, {120, TRACE_OFF}, TRACE_END},
+    {{40, TRACE_OFF}, {70, TRACE_CHANGING}, {120, TRACE_OFF}, TRACE_END}};
+
+// Minutes at which room temperature or humidity moves beyond its delta
+static const uint16_t envChangeMinutes[] = {15, 35, 36, 60, 95};
+
+static TraceState traceState(int socket, uint32_t nowMs)
+{
+    const uint32_t minute = nowMs / 60000;
+    for (const TraceSegment *seg = socketTrace[socket];; seg++)
+    {
+        if (minute < seg->untilMinute)
+        {
+            return seg->state;
+        }
+    }
+}
+
+static uint32_t envVersion(uint32_t nowMs)
+{
+    uint32_t version = 0;
+    for (size_t i = 0; i < sizeof(envChangeMinutes) / sizeof(envChangeMinutes[0]); i++)
+    {
+        version += nowMs >= envChangeMinutes[i] * 60000UL;
+    }
+    return version;
+}
+
+/**
+ * @brief The acquisition job set of the firmware on a fake clock: one read job per socket and one for
+ *        the environment sensor, and the publish job evaluating the socket periods every 5 s.
+ */
+static struct
+{
+    uint32_t nowMs;
+    bool adaptive;        ///< false = the fixed 5 s schedule
+    Scheduler sched;
+    int pzemJobs[REPLAY_SOCKETS];
+    int envJob;
+    PollChannel pzemPoll[REPLAY_SOCKETS];
+    PollChannel envPoll;
+
+    TraceState seen[REPLAY_SOCKETS];      ///< State returned by the last read
+    TraceState evaluated[REPLAY_SOCKETS]; ///< State at the last evaluation
+    bool readSinceEvaluation[REPLAY_SOCKETS];
+    uint32_t envSeen;
+
+    uint32_t socketReads;
+    uint32_t envReads;
+    uint32_t readsByClass[POLL_CLASS_ACTIVE + 1]; ///< Socket reads by the class of the socket's true state
+    uint32_t changeSinceMs[REPLAY_SOCKETS];       ///< When the true state last changed, unseen so far
+    uint32_t worstDetectionMs;                    ///< Longest time from a state change to the read seeing it
+} replay;
+
+static uint32_t replayClock(void)
+{
+    return replay.nowMs;
+}
+
+static PollClass classOf(TraceState state)
+{
+    return state == TRACE_LOST ? POLL_CLASS_LOST
+           : state == TRACE_OFF ? POLL_CLASS_OFF
+           : state == TRACE_STEADY ? POLL_CLASS_RUNNING
+                                   : POLL_CLASS_ACTIVE;
+}
+
+static void replayPzemJob(void *ctx)
+{
+    const int id = (int)(uintptr_t)ctx;
+    const TraceState state = traceState(id, replay.nowMs);
+    replay.socketReads++;
+    replay.readsByClass[classOf(state)]++;
+    if (classOf(state) != classOf(replay.seen[id]))
+    {
+        const uint32_t delayMs = replay.nowMs - replay.changeSinceMs[id];
+        replay.worstDetectionMs = delayMs > replay.worstDetectionMs ? delayMs : replay.worstDetectionMs;
+    }
+    replay.seen[id] = state;
+    replay.readSinceEvaluation[id] = true;
+}
+
+static void replayEnvJob(void *)
+{
+    const uint32_t version = envVersion(replay.nowMs);
+    replay.envReads++;
+    const bool changed = version != replay.envSeen;
+    replay.envSeen = version;
+    const uint32_t periodMs = AdaptivePoll_updateEnvironment(&replay.envPoll, changed);
+    if (replay.adaptive)
+    {
+        Scheduler_setPeriod(&replay.sched, replay.envJob, periodMs);
+    }
+}
+
+static void replayPublishJob(void *)
+{
+    for (int id = 0; id < REPLAY_SOCKETS; id++)
+    {
+        const TraceState seen = replay.seen[id];
+        const bool changed = seen != replay.evaluated[id] ||
+                             (seen == TRACE_CHANGING && replay.readSinceEvaluation[id]);
+        replay.evaluated[id] = seen;
+        replay.readSinceEvaluation[id] = false;
+        const uint32_t periodMs = AdaptivePoll_updateSocket(&replay.pzemPoll[id], seen != TRACE_LOST,
+                                                            seen == TRACE_STEADY || seen == TRACE_CHANGING, changed);
+        if (replay.adaptive)
+        {
+            Scheduler_setPeriod(&replay.sched, replay.pzemJobs[id], periodMs);
+        }
+    }
+}
+
+/**
+ * @brief Replay the trace with adaptive or fixed periods. The true state is sampled once a second
+ *        to time-stamp its changes for the detection delay.
+ */
+static void runReplay(bool adaptive)
+{
+    replay = {};
+    replay.adaptive = adaptive;
+    Scheduler_init(&replay.sched, replayClock);
+    replay.envJob = Scheduler_addJob(&replay.sched, "es35sw", FIXED_PERIOD_MS, PZEM_OFFSET_MS / 2, 0, replayEnvJob, NULL);
+    for (int id = 0; id < REPLAY_SOCKETS; id++)
+    {
+        AdaptivePoll_init(&replay.pzemPoll[id], FIXED_PERIOD_MS);
+        replay.pzemJobs[id] = Scheduler_addJob(&replay.sched, "pzem", FIXED_PERIOD_MS, PZEM_OFFSET_MS, 0, replayPzemJob,
+                                               (void *)(uintptr_t)id);
+        replay.seen[id] = replay.evaluated[id] = traceState(id, 0);
+    }
+    AdaptivePoll_init(&replay.envPoll, FIXED_PERIOD_MS);
+    Scheduler_addJob(&replay.sched, "publish", FIXED_PERIOD_MS, PUBLISH_OFFSET_MS, 0, replayPublishJob, NULL);
+
+    TraceState truth[REPLAY_SOCKETS];
+    for (int id = 0; id < REPLAY_SOCKETS; id++)
+    {
+        truth[id] = traceState(id, 0);
+    }
+    while (replay.nowMs < REPLAY_MS)
+    {
+        Scheduler_runDue(&replay.sched);
+        replay.nowMs++;
+        if (replay.nowMs % 1000 == 0)
+        {
+            for (int id = 0; id < REPLAY_SOCKETS; id++)
+            {
+                const TraceState state = traceState(id, replay.nowMs);
+                if (classOf(state) != classOf(truth[id]))
+                {
+                    replay.changeSinceMs[id] = replay.nowMs;
+                }
+                truth[id] = state;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Reads of the trace under both schedules. Reads go where the signal is: more reads than the
+ *        fixed schedule while a machine's readings change, far fewer on steady, off and lost sockets.
+ */
+void test_replay_saves_transactions_against_the_fixed_schedule(void)
+{
+    runReplay(false);
+    const uint32_t fixedSocketReads = replay.socketReads;
+    const uint32_t fixedEnvReads = replay.envReads;
+    uint32_t fixedByClass[POLL_CLASS_ACTIVE + 1];
+    memcpy(fixedByClass, replay.readsByClass, sizeof(fixedByClass));
+    const uint32_t fixedDetectionMs = replay.worstDetectionMs;
+
+    runReplay(true);
+    const uint32_t fixedTotal = fixedSocketReads + fixedEnvReads;
+    const uint32_t adaptiveTotal = replay.socketReads + replay.envReads;
+
+    char line[160];
+    snprintf(line, sizeof(line), "%d min trace: fixed 5 s %lu transactions (%lu env), adaptive %lu (%lu env), %.1f%% saved",
+             REPLAY_MINUTES, (unsigned long)fixedTotal, (unsigned long)fixedEnvReads, (unsigned long)adaptiveTotal,
+             (unsigned long)replay.envReads, 100.0 * ((double)fixedTotal - adaptiveTotal) / fixedTotal);
+    TEST_MESSAGE(line);
+    for (int c = POLL_CLASS_LOST; c <= POLL_CLASS_ACTIVE; c++)
+    {
+        snprintf(line, sizeof(line), "socket reads while %s: fixed %lu, adaptive %lu", AdaptivePoll_className((PollClass)c),
+                 (unsigned long)fixedByClass[c], (unsigned long)replay.readsByClass[c]);
+        TEST_MESSAGE(line);
+    }
+    snprintf(line, sizeof(line), "worst delay from a state change to the read seeing it: fixed %lu ms, adaptive %lu ms",
+             (unsigned long)fixedDetectionMs, (unsigned long)replay.worstDetectionMs);
+    TEST_MESSAGE(line);
+
+    // 7 jobs every 5 s over the whole trace
+    TEST_ASSERT_UINT32_WITHIN(REPLAY_SOCKETS + 1, (REPLAY_SOCKETS + 1) * (REPLAY_MS / FIXED_PERIOD_MS), fixedTotal);
+    // Fewer bus transactions overall, although the changing sockets are read five times as often
+    TEST_ASSERT_TRUE(adaptiveTotal * 10 < fixedTotal * 9);
+    TEST_ASSERT_TRUE(replay.envReads * 4 < fixedEnvReads);
+    TEST_ASSERT_TRUE(replay.readsByClass[POLL_CLASS_ACTIVE] > 3 * fixedByClass[POLL_CLASS_ACTIVE]);
+    TEST_ASSERT_TRUE(replay.readsByClass[POLL_CLASS_LOST] * 4 < fixedByClass[POLL_CLASS_LOST]);
+    TEST_ASSERT_TRUE(replay.readsByClass[POLL_CLASS_OFF] * 1.5 < fixedByClass[POLL_CLASS_OFF]);
+    // Slowest class: a power-up is seen within one lost period
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(POLL_PERIOD_LOST_MS, replay.worstDetectionMs);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_init_keeps_the_fixed_period_until_the_first_evaluation);
+    RUN_TEST(test_steady_class_follows_power_and_machine_state);
+    RUN_TEST(test_change_holds_fast_polling_for_the_activity_hold);
+    RUN_TEST(test_power_loss_and_power_up_are_followed_fast);
+    RUN_TEST(test_environment_is_slow_unless_it_just_changed);
+    RUN_TEST(test_class_names);
+    RUN_TEST(test_replay_saves_transactions_against_the_fixed_schedule);
+    return UNITY_END();
+}
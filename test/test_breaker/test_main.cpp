@@ -0,0 +1,197 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the per-slave circuit breaker: state transitions on a fake millisecond clock,
+ *        probe backoff, and the bus time a dead socket costs with and without the breaker
+ *        (pio test -e native -f test_breaker).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include "CircuitBreaker.h"
+
+#define POLL_PERIOD_MS 5000  // readInterval of the acquisition task
+#define READ_TIMEOUT_MS 100  // RS485_DEFAULT_TIMEOUT_MS: bus time of a read a dead slave never answers
+#define HOUR_MS 3600000UL
+
+static CircuitBreaker breaker;
+
+void setUp(void)
+{
+    Breaker_init(&breaker);
+}
+
+void tearDown(void) {}
+
+// Fail a closed breaker until it opens at @p nowMs
+static void trip(uint32_t nowMs)
+{
+    for (int i = 0; i < BREAKER_FAILURE_THRESHOLD; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(BREAKER_ALLOW, Breaker_allow(&breaker, nowMs));
+        Breaker_recordFailure(&breaker, nowMs);
+    }
+    TEST_ASSERT_EQUAL_INT(BREAKER_OPEN, breaker.state);
+}
+
+void test_closed_breaker_allows_requests(void)
+{
+    TEST_ASSERT_EQUAL_INT(BREAKER_CLOSED, breaker.state);
+    TEST_ASSERT_EQUAL_INT(BREAKER_ALLOW, Breaker_allow(&breaker, 0));
+    Breaker_recordSuccess(&breaker);
+    TEST_ASSERT_EQUAL_INT(BREAKER_ALLOW, Breaker_allow(&breaker, 1000));
+    TEST_ASSERT_EQUAL_UINT32(0, breaker.tripCount);
+}
+
+void test_opens_after_consecutive_failures_only(void)
+{
+    // A success between failures resets the count
+    for (int round = 0; round < 5; round++)
+    {
+        for (int i = 0; i < BREAKER_FAILURE_THRESHOLD - 1; i++)
+        {
+            Breaker_recordFailure(&breaker, 0);
+        }
+        Breaker_recordSuccess(&breaker);
+    }
+    TEST_ASSERT_EQUAL_INT(BREAKER_CLOSED, breaker.state);
+    TEST_ASSERT_EQUAL_UINT8(0, breaker.failures);
+
+    trip(1000);
+    TEST_ASSERT_EQUAL_UINT32(1, breaker.tripCount);
+    TEST_ASSERT_EQUAL_UINT32(1000, breaker.openedAtMs);
+    TEST_ASSERT_EQUAL_UINT32(BREAKER_PROBE_MIN_MS, breaker.probeDelayMs);
+}
+
+void test_open_breaker_skips_until_the_probe_delay(void)
+{
+    trip(1000);
+    TEST_ASSERT_EQUAL_INT(BREAKER_SKIP, Breaker_allow(&breaker, 1000));
+    TEST_ASSERT_EQUAL_INT(BREAKER_SKIP, Breaker_allow(&breaker, 1000 + BREAKER_PROBE_MIN_MS - 1));
+    TEST_ASSERT_EQUAL_UINT32(2, breaker.skipped);
+    TEST_ASSERT_EQUAL_INT(BREAKER_PROBE, Breaker_allow(&breaker, 1000 + BREAKER_PROBE_MIN_MS));
+    TEST_ASSERT_EQUAL_INT(BREAKER_HALF_OPEN, breaker.state);
+}
+
+void test_successful_probe_closes_and_resets_the_backoff(void)
+{
+    trip(0);
+    TEST_ASSERT_EQUAL_INT(BREAKER_PROBE, Breaker_allow(&breaker, BREAKER_PROBE_MIN_MS));
+    Breaker_recordFailure(&breaker, BREAKER_PROBE_MIN_MS); // Delay doubled
+    TEST_ASSERT_EQUAL_UINT32(2 * BREAKER_PROBE_MIN_MS, breaker.probeDelayMs);
+
+    TEST_ASSERT_EQUAL_INT(BREAKER_PROBE, Breaker_allow(&breaker, 3 * BREAKER_PROBE_MIN_MS));
+    Breaker_recordSuccess(&breaker);
+    TEST_ASSERT_EQUAL_INT(BREAKER_CLOSED, breaker.state);
+    TEST_ASSERT_EQUAL_UINT32(BREAKER_PROBE_MIN_MS, breaker.probeDelayMs);
+    TEST_ASSERT_EQUAL_INT(BREAKER_ALLOW, Breaker_allow(&breaker, 3 * BREAKER_PROBE_MIN_MS));
+
+    // The next outage starts again from the shortest probe delay
+    trip(4 * BREAKER_PROBE_MIN_MS);
+    TEST_ASSERT_EQUAL_UINT32(2, breaker.tripCount);
+    TEST_ASSERT_EQUAL_UINT32(BREAKER_PROBE_MIN_MS, breaker.probeDelayMs);
+}
+
+void test_failed_probes_double_the_delay_up_to_the_cap(void)
+{
+    trip(0);
+    uint32_t now = 0;
+    uint32_t expected = BREAKER_PROBE_MIN_MS;
+    for (int probe = 0; probe < 10; probe++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(expected, breaker.probeDelayMs);
+        TEST_ASSERT_EQUAL_INT(BREAKER_SKIP, Breaker_allow(&breaker, now + expected - 1));
+        now += expected;
+        TEST_ASSERT_EQUAL_INT(BREAKER_PROBE, Breaker_allow(&breaker, now));
+        Breaker_recordFailure(&breaker, now);
+        TEST_ASSERT_EQUAL_INT(BREAKER_OPEN, breaker.state);
+        expected = expected * 2 > BREAKER_PROBE_MAX_MS ? BREAKER_PROBE_MAX_MS : expected * 2;
+    }
+    TEST_ASSERT_EQUAL_UINT32(BREAKER_PROBE_MAX_MS, breaker.probeDelayMs);
+    TEST_ASSERT_EQUAL_UINT32(1, breaker.tripCount); // Failed probes re-open, they are not new trips
+}
+
+void test_half_open_without_a_result_probes_again(void)
+{
+    trip(0);
+    TEST_ASSERT_EQUAL_INT(BREAKER_PROBE, Breaker_allow(&breaker, BREAKER_PROBE_MIN_MS));
+    TEST_ASSERT_EQUAL_INT(BREAKER_PROBE, Breaker_allow(&breaker, BREAKER_PROBE_MIN_MS + 1));
+    TEST_ASSERT_EQUAL_INT(BREAKER_HALF_OPEN, breaker.state);
+}
+
+void test_probe_delay_survives_millis_wraparound(void)
+{
+    const uint32_t openedAt = 0xFFFFFFFFu - 1000;
+    trip(openedAt);
+    TEST_ASSERT_EQUAL_INT(BREAKER_SKIP, Breaker_allow(&breaker, openedAt + BREAKER_PROBE_MIN_MS - 1)); // Wrapped
+    TEST_ASSERT_EQUAL_INT(BREAKER_PROBE, Breaker_allow(&breaker, openedAt + BREAKER_PROBE_MIN_MS));
+}
+
+void test_state_names(void)
+{
+    TEST_ASSERT_EQUAL_STRING("closed", Breaker_stateName(BREAKER_CLOSED));
+    TEST_ASSERT_EQUAL_STRING("open", Breaker_stateName(BREAKER_OPEN));
+    TEST_ASSERT_EQUAL_STRING("half-open", Breaker_stateName(BREAKER_HALF_OPEN));
+}
+
+/**
+ * @brief One socket without power for an hour, polled every 5 s like readPZEM(), then powered again.
+ *        Without the breaker every poll costs a full response timeout; with it only the probes do.
+ */
+void test_dead_socket_bus_time_with_and_without_breaker(void)
+{
+    uint32_t deadBusMs = 0;
+    uint32_t probes = 0;
+    uint32_t polls = 0;
+    for (uint32_t now = 0; now < HOUR_MS; now += POLL_PERIOD_MS)
+    {
+        polls++;
+        const BreakerDecision decision = Breaker_allow(&breaker, now);
+        if (decision == BREAKER_SKIP)
+        {
+            continue;
+        }
+        probes += decision == BREAKER_PROBE;
+        deadBusMs += READ_TIMEOUT_MS; // Probe or full read: no answer either way
+        Breaker_recordFailure(&breaker, now);
+    }
+    const uint32_t withoutBreakerMs = polls * READ_TIMEOUT_MS;
+
+    // Power returns: polling resumes at the next probe, at most one capped probe delay later
+    const uint32_t powerBackMs = HOUR_MS;
+    uint32_t resumedMs = 0;
+    for (uint32_t now = powerBackMs; resumedMs == 0; now += POLL_PERIOD_MS)
+    {
+        const BreakerDecision decision = Breaker_allow(&breaker, now);
+        if (decision != BREAKER_SKIP)
+        {
+            Breaker_recordSuccess(&breaker);
+            resumedMs = now;
+        }
+    }
+
+    char line[160];
+    snprintf(line, sizeof(line), "dead socket for 1 h: %lu ms bus time with breaker (%lu probes), %lu ms without; resumed %lu s after power returned",
+             (unsigned long)deadBusMs, (unsigned long)probes, (unsigned long)withoutBreakerMs,
+             (unsigned long)((resumedMs - powerBackMs) / 1000));
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_LESS_THAN_UINT32(withoutBreakerMs / 20, deadBusMs); // Below 5 % of the unprotected cost
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(BREAKER_PROBE_MAX_MS + POLL_PERIOD_MS, resumedMs - powerBackMs);
+    TEST_ASSERT_EQUAL_INT(BREAKER_CLOSED, breaker.state);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_closed_breaker_allows_requests);
+    RUN_TEST(test_opens_after_consecutive_failures_only);
+    RUN_TEST(test_open_breaker_skips_until_the_probe_delay);
+    RUN_TEST(test_successful_probe_closes_and_resets_the_backoff);
+    RUN_TEST(test_failed_probes_double_the_delay_up_to_the_cap);
+    RUN_TEST(test_half_open_without_a_result_probes_again);
+    RUN_TEST(test_probe_delay_survives_millis_wraparound);
+    RUN_TEST(test_state_names);
+    RUN_TEST(test_dead_socket_bus_time_with_and_without_breaker);
+    return UNITY_END();
+}
@@ -0,0 +1,244 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the buzzer pattern sequencer: generated note timelines, priorities and
+ *        preemption, driven by a fake tick clock (pio test -e native -f test_buzzer).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include "Buzzer.h"
+
+#define TIMELINE_MAX 512 // Output changes recorded per test
+
+/**
+ * @brief One change of the buzzer output: @c frequency from @c atMs on.
+ */
+typedef struct
+{
+    uint32_t atMs;
+    uint16_t frequency;
+} ToneChange;
+
+static ToneChange timeline[TIMELINE_MAX];
+static size_t timelineLen = 0;
+static uint32_t fakeNowMs = 0;
+
+static void recordOutput(uint16_t frequency)
+{
+    if (timelineLen < TIMELINE_MAX)
+    {
+        timeline[timelineLen++] = {fakeNowMs, frequency};
+    }
+}
+
+/**
+ * @brief Call Buzzer_tick() every BUZZER_TICK_MS, like the esp_timer does, until @p endMs.
+ */
+static void tickUntil(uint32_t endMs)
+{
+    while (fakeNowMs < endMs)
+    {
+        Buzzer_tick(fakeNowMs);
+        fakeNowMs += BUZZER_TICK_MS;
+    }
+}
+
+/**
+ * @brief Expected output changes of @p pattern played once from @p startMs, with every note
+ *        start on the tick grid. Returns the time the pattern ends.
+ */
+static uint32_t expectPattern(const BuzzerPattern *pattern, uint32_t startMs, size_t *index)
+{
+    uint32_t t = startMs;
+    for (uint8_t r = 0; r < pattern->repeat; r++)
+    {
+        for (uint8_t n = 0; n < pattern->noteCount; n++)
+        {
+            TEST_ASSERT_TRUE_MESSAGE(*index < timelineLen, "timeline shorter than the pattern");
+            TEST_ASSERT_EQUAL_UINT32(t, timeline[*index].atMs);
+            TEST_ASSERT_EQUAL_UINT16(pattern->notes[n].frequency, timeline[*index].frequency);
+            t += pattern->notes[n].durationMs;
+            (*index)++;
+        }
+    }
+    return t;
+}
+
+void setUp(void)
+{
+    Buzzer_setOutput(recordOutput);
+    Buzzer_stop();
+    timelineLen = 0;
+    fakeNowMs = 0;
+}
+
+void tearDown(void) {}
+
+void test_startup_melody_timeline(void)
+{
+    TEST_ASSERT_TRUE(Buzzer_play(&BUZZER_PATTERN_STARTUP));
+    TEST_ASSERT_EQUAL_INT(BUZZER_PRIORITY_MELODY, Buzzer_currentPriority());
+    tickUntil(3000);
+
+    size_t i = 0;
+    const uint32_t endMs = expectPattern(&BUZZER_PATTERN_STARTUP, 0, &i);
+    TEST_ASSERT_EQUAL_UINT32(1130 + 7 * 40, endMs); // Notes + 40 ms gaps of the old blocking playStartupTone()
+    TEST_ASSERT_EQUAL_UINT32(i + 1, timelineLen);
+    TEST_ASSERT_EQUAL_UINT32(endMs, timeline[i].atMs); // Silenced when the pattern ends
+    TEST_ASSERT_EQUAL_UINT16(TONE_MIN_FREQ, timeline[i].frequency);
+    TEST_ASSERT_FALSE(Buzzer_isBusy());
+    TEST_ASSERT_EQUAL_INT(-1, Buzzer_currentPriority());
+}
+
+void test_warning_repeats_alarm_repeat_times(void)
+{
+    Buzzer_play(&BUZZER_PATTERN_WARNING);
+    tickUntil(10000);
+
+    size_t i = 0;
+    const uint32_t endMs = expectPattern(&BUZZER_PATTERN_WARNING, 0, &i);
+    TEST_ASSERT_EQUAL_UINT32(ALARM_REPEAT * (3 * (120 + 80) + 250), endMs);
+    TEST_ASSERT_EQUAL_UINT32(ALARM_REPEAT * BUZZER_PATTERN_WARNING.noteCount + 1, timelineLen);
+}
+
+void test_leak_alarm_preempts_warning_then_warning_restarts(void)
+{
+    Buzzer_play(&BUZZER_PATTERN_WARNING);
+    tickUntil(500);
+    const size_t beforePreempt = timelineLen;
+
+    TEST_ASSERT_TRUE(Buzzer_play(&BUZZER_PATTERN_LEAK_STRONG));
+    TEST_ASSERT_EQUAL_INT(BUZZER_PRIORITY_LEAK_STRONG, Buzzer_currentPriority());
+    tickUntil(20000);
+
+    // The siren starts on the first tick after the request, the preempted warning from its first note
+    size_t i = beforePreempt;
+    const uint32_t sirenEndMs = expectPattern(&BUZZER_PATTERN_LEAK_STRONG, 500, &i);
+    const uint32_t warningEndMs = expectPattern(&BUZZER_PATTERN_WARNING, sirenEndMs, &i);
+    TEST_ASSERT_EQUAL_UINT32(i + 1, timelineLen);
+    TEST_ASSERT_EQUAL_UINT32(warningEndMs, timeline[i].atMs);
+    TEST_ASSERT_FALSE(Buzzer_isBusy());
+}
+
+void test_lower_priority_waits_for_the_current_pattern(void)
+{
+    Buzzer_play(&BUZZER_PATTERN_LEAK_SOFT);
+    TEST_ASSERT_TRUE(Buzzer_play(&BUZZER_PATTERN_WARNING)); // Queued, does not interrupt
+    TEST_ASSERT_EQUAL_INT(BUZZER_PRIORITY_LEAK_SOFT, Buzzer_currentPriority());
+    tickUntil(20000);
+
+    size_t i = 0;
+    const uint32_t softEndMs = expectPattern(&BUZZER_PATTERN_LEAK_SOFT, 0, &i);
+    expectPattern(&BUZZER_PATTERN_WARNING, softEndMs, &i);
+}
+
+void test_pending_patterns_play_by_priority(void)
+{
+    Buzzer_play(&BUZZER_PATTERN_LEAK_STRONG);
+    Buzzer_play(&BUZZER_PATTERN_STARTUP);
+    Buzzer_play(&BUZZER_PATTERN_WARNING);
+    Buzzer_play(&BUZZER_PATTERN_LEAK_SOFT);
+    tickUntil(60000);
+
+    size_t i = 0;
+    uint32_t t = expectPattern(&BUZZER_PATTERN_LEAK_STRONG, 0, &i);
+    t = expectPattern(&BUZZER_PATTERN_LEAK_SOFT, t, &i);
+    t = expectPattern(&BUZZER_PATTERN_WARNING, t, &i);
+    expectPattern(&BUZZER_PATTERN_STARTUP, t, &i);
+}
+
+void test_duplicate_request_is_ignored(void)
+{
+    Buzzer_play(&BUZZER_PATTERN_WARNING);
+    tickUntil(300);
+    TEST_ASSERT_TRUE(Buzzer_play(&BUZZER_PATTERN_WARNING)); // Already playing: not restarted
+    tickUntil(10000);
+
+    size_t i = 0;
+    expectPattern(&BUZZER_PATTERN_WARNING, 0, &i);
+    TEST_ASSERT_EQUAL_UINT32(i + 1, timelineLen);
+}
+
+void test_full_queue_rejects_and_invalid_patterns(void)
+{
+    static const BuzzerNote note[] = {{1000, 10}};
+    static BuzzerPattern extra[BUZZER_QUEUE_SIZE + 1];
+    Buzzer_play(&BUZZER_PATTERN_LEAK_STRONG);
+    for (int i = 0; i < BUZZER_QUEUE_SIZE; i++)
+    {
+        extra[i] = {note, 1, 1, BUZZER_PRIORITY_MELODY};
+        TEST_ASSERT_TRUE(Buzzer_play(&extra[i]));
+    }
+    extra[BUZZER_QUEUE_SIZE] = {note, 1, 1, BUZZER_PRIORITY_MELODY};
+    TEST_ASSERT_FALSE(Buzzer_play(&extra[BUZZER_QUEUE_SIZE]));
+
+    const BuzzerPattern empty = {note, 0, 1, BUZZER_PRIORITY_WARNING};
+    TEST_ASSERT_FALSE(Buzzer_play(NULL));
+    TEST_ASSERT_FALSE(Buzzer_play(&empty));
+}
+
+void test_late_ticks_never_shorten_a_note(void)
+{
+    // Ticks delayed by a busy timer task: every note still lasts at least its duration
+    static const uint32_t steps[] = {10, 10, 37, 10, 3, 55, 10, 21};
+    Buzzer_play(&BUZZER_PATTERN_WARNING);
+    for (size_t n = 0; fakeNowMs < 10000; n++)
+    {
+        Buzzer_tick(fakeNowMs);
+        fakeNowMs += steps[n % (sizeof(steps) / sizeof(steps[0]))];
+    }
+
+    size_t i = 0;
+    for (uint8_t r = 0; r < BUZZER_PATTERN_WARNING.repeat; r++)
+    {
+        for (uint8_t n = 0; n < BUZZER_PATTERN_WARNING.noteCount; n++, i++)
+        {
+            TEST_ASSERT_TRUE(i + 1 < timelineLen);
+            TEST_ASSERT_EQUAL_UINT16(BUZZER_PATTERN_WARNING.notes[n].frequency, timeline[i].frequency);
+            TEST_ASSERT_GREATER_OR_EQUAL_UINT32(BUZZER_PATTERN_WARNING.notes[n].durationMs,
+                                                timeline[i + 1].atMs - timeline[i].atMs);
+        }
+    }
+}
+
+void test_stop_silences_and_clears_the_queue(void)
+{
+    Buzzer_play(&BUZZER_PATTERN_WARNING);
+    Buzzer_play(&BUZZER_PATTERN_STARTUP);
+    tickUntil(100);
+    Buzzer_stop();
+    TEST_ASSERT_FALSE(Buzzer_isBusy());
+    TEST_ASSERT_EQUAL_UINT16(TONE_MIN_FREQ, timeline[timelineLen - 1].frequency);
+
+    const size_t afterStop = timelineLen;
+    tickUntil(5000);
+    TEST_ASSERT_EQUAL_UINT32(afterStop, timelineLen);
+}
+
+void test_play_helpers_queue_without_blocking(void)
+{
+    const unsigned long start = micros();
+    playWarningTone();
+    playStartupTone();
+    const unsigned long elapsedUs = micros() - start;
+    TEST_ASSERT_TRUE(Buzzer_isBusy());
+    TEST_ASSERT_EQUAL_INT(BUZZER_PRIORITY_WARNING, Buzzer_currentPriority());
+    TEST_ASSERT_LESS_THAN_UINT32(10000, elapsedUs); // The old playWarningTone() blocked for 4.5 s
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_startup_melody_timeline);
+    RUN_TEST(test_warning_repeats_alarm_repeat_times);
+    RUN_TEST(test_leak_alarm_preempts_warning_then_warning_restarts);
+    RUN_TEST(test_lower_priority_waits_for_the_current_pattern);
+    RUN_TEST(test_pending_patterns_play_by_priority);
+    RUN_TEST(test_duplicate_request_is_ignored);
+    RUN_TEST(test_full_queue_rejects_and_invalid_patterns);
+    RUN_TEST(test_late_ticks_never_shorten_a_note);
+    RUN_TEST(test_stop_silences_and_clears_the_queue);
+    RUN_TEST(test_play_helpers_queue_without_blocking);
+    return UNITY_END();
+}
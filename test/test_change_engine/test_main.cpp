@@ -0,0 +1,569 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the change-detection channel registry: warm-up gates, force mask, pending
+ *        changes, state transitions and set-bit iteration, with a benchmark against the per-field
+ *        bool flag structs it replaced (pio test -e native -f test_change_engine).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "ChangeEngine.h"
+#include "PZEM016_Lib.h"
+
+#define GATE_REF 0x01  // Reference voltage ready (PZEM_GATE_REF)
+#define GATE_LINE 0x02 // Socket warm-up over (PZEM_GATE_LINE)
+#define GATE_LOAD 0x04 // Machine warm-up over (PZEM_GATE_LOAD)
+#define GATES_OPEN (GATE_REF | GATE_LINE | GATE_LOAD)
+
+#define BENCH_CYCLES 4096 // Recorded handler cycles replayed by the benchmark
+#define BENCH_ROUNDS 100  // Replays per benchmark pass
+
+// Bits of a device, at the positions of DeviceChangeBit
+enum
+{
+    BIT_VOLTAGE = 0,
+    BIT_CURRENT,
+    BIT_POWER,
+    BIT_FREQUENCY,
+    BIT_PF,
+    BIT_MACHINE_STATE,
+    BIT_OVER_VOLTAGE,
+    BIT_OVER_CURRENT,
+    BIT_OVER_POWER,
+    BIT_UNDER_VOLTAGE,
+    BIT_SOCKET_STATE,
+    BIT_OPERATING_TIME,
+    DEVICE_BITS
+};
+
+enum
+{
+    CH_VOLTAGE = 0,
+    CH_CURRENT,
+    CH_POWER,
+    CH_FREQUENCY,
+    CH_PF,
+    CH_COUNT
+};
+
+// The PZEM table of SensorHandlers
+static const ChangeChannel channels[CH_COUNT] = {
+    [CH_VOLTAGE] = {BIT_VOLTAGE, GATE_REF | GATE_LINE, &pzemVoltageGate},
+    [CH_CURRENT] = {BIT_CURRENT, GATE_LINE | GATE_LOAD, &pzemCurrentGate},
+    [CH_POWER] = {BIT_POWER, GATE_LINE | GATE_LOAD, &pzemPowerGate},
+    [CH_FREQUENCY] = {BIT_FREQUENCY, GATE_LINE, &pzemFreqGate},
+    [CH_PF] = {BIT_PF, GATE_LINE | GATE_LOAD, &pzemPfGate},
+};
+
+// A socket at rest: 230.0 V, 0.500 A, 115.0 W, 50.0 Hz, PF 1.00
+static const int32_t restValues[CH_COUNT] = {2300, 500, 1150, 500, 100};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_evaluate_waits_for_every_gate_of_a_channel(void)
+{
+    int32_t published[CH_COUNT];
+    memcpy(published, restValues, sizeof(published));
+    const int32_t moved[CH_COUNT] = {2400, 900, 2100, 510, 80}; // Every channel far past its gate
+
+    ChangeMask mask = ChangeEngine_evaluate(channels, CH_COUNT, moved, published, 0, 0);
+    TEST_ASSERT_EQUAL_HEX32(0, mask);
+    TEST_ASSERT_EQUAL_INT32(2300, published[CH_VOLTAGE]); // Nothing published while closed
+
+    mask = ChangeEngine_evaluate(channels, CH_COUNT, moved, published, GATE_LINE, 0);
+    TEST_ASSERT_EQUAL_HEX32(CHANGE_BIT(BIT_FREQUENCY), mask); // The only channel needing just LINE
+
+    mask = ChangeEngine_evaluate(channels, CH_COUNT, moved, published, GATE_REF | GATE_LINE, 0);
+    TEST_ASSERT_EQUAL_HEX32(CHANGE_BIT(BIT_VOLTAGE), mask); // Frequency is published already
+
+    mask = ChangeEngine_evaluate(channels, CH_COUNT, moved, published, GATES_OPEN, 0);
+    TEST_ASSERT_EQUAL_HEX32(CHANGE_BIT(BIT_CURRENT) | CHANGE_BIT(BIT_POWER) | CHANGE_BIT(BIT_PF), mask);
+    TEST_ASSERT_EQUAL_INT32_ARRAY(moved, published, CH_COUNT);
+}
+
+void test_evaluate_publishes_only_channels_past_their_gate(void)
+{
+    int32_t published[CH_COUNT];
+    memcpy(published, restValues, sizeof(published));
+    int32_t values[CH_COUNT];
+    memcpy(values, restValues, sizeof(values));
+
+    // One step below the smallest reported change of each channel: nothing moves
+    for (int ch = 0; ch < CH_COUNT; ch++)
+    {
+        values[ch] = restValues[ch] + channels[ch].gate->step(restValues[ch]) - 1;
+    }
+    ChangeMask mask = ChangeEngine_evaluate(channels, CH_COUNT, values, published, GATES_OPEN, 0);
+    TEST_ASSERT_EQUAL_HEX32(0, mask);
+    TEST_ASSERT_EQUAL_INT32_ARRAY(restValues, published, CH_COUNT);
+
+    // Voltage and PF at their smallest reported change, downwards for PF
+    values[CH_VOLTAGE] = restValues[CH_VOLTAGE] + channels[CH_VOLTAGE].gate->step(restValues[CH_VOLTAGE]);
+    values[CH_PF] = restValues[CH_PF] - channels[CH_PF].gate->step(restValues[CH_PF]);
+    mask = ChangeEngine_evaluate(channels, CH_COUNT, values, published, GATES_OPEN, 0);
+    TEST_ASSERT_EQUAL_HEX32(CHANGE_BIT(BIT_VOLTAGE) | CHANGE_BIT(BIT_PF), mask);
+    TEST_ASSERT_EQUAL_INT32(values[CH_VOLTAGE], published[CH_VOLTAGE]);
+    TEST_ASSERT_EQUAL_INT32(values[CH_PF], published[CH_PF]);
+    TEST_ASSERT_EQUAL_INT32(restValues[CH_CURRENT], published[CH_CURRENT]); // Unpublished channels keep their value
+}
+
+void test_force_publishes_unchanged_channels_behind_open_gates(void)
+{
+    int32_t published[CH_COUNT];
+    memcpy(published, restValues, sizeof(published));
+    int32_t values[CH_COUNT];
+    memcpy(values, restValues, sizeof(values));
+    values[CH_VOLTAGE] += 1; // Below the gate: only a force publishes it (voltage broadcast)
+
+    const ChangeMask force = CHANGE_BIT(BIT_VOLTAGE) | CHANGE_BIT(BIT_CURRENT);
+    ChangeMask mask = ChangeEngine_evaluate(channels, CH_COUNT, values, published, GATE_LINE, force);
+    TEST_ASSERT_EQUAL_HEX32(0, mask); // Gates win over force
+    mask = ChangeEngine_evaluate(channels, CH_COUNT, values, published, GATES_OPEN, force);
+    TEST_ASSERT_EQUAL_HEX32(force, mask);
+    TEST_ASSERT_EQUAL_INT32(2301, published[CH_VOLTAGE]);
+
+    // A force bit no channel owns sets nothing
+    mask = ChangeEngine_evaluate(channels, CH_COUNT, values, published, GATES_OPEN, CHANGE_BIT(BIT_OPERATING_TIME));
+    TEST_ASSERT_EQUAL_HEX32(0, mask);
+}
+
+void test_pending_matches_evaluate_without_publishing(void)
+{
+    int32_t published[CH_COUNT];
+    memcpy(published, restValues, sizeof(published));
+    const int32_t values[CH_COUNT] = {2400, 500, 2100, 500, 100};
+
+    const ChangeMask pending = ChangeEngine_pending(channels, CH_COUNT, values, published, GATES_OPEN);
+    TEST_ASSERT_EQUAL_HEX32(CHANGE_BIT(BIT_VOLTAGE) | CHANGE_BIT(BIT_POWER), pending);
+    TEST_ASSERT_EQUAL_INT32_ARRAY(restValues, published, CH_COUNT);
+    const ChangeMask closed = ChangeEngine_pending(channels, CH_COUNT, values, published, GATE_LINE);
+    TEST_ASSERT_EQUAL_HEX32(0, closed);
+
+    const ChangeMask evaluated = ChangeEngine_evaluate(channels, CH_COUNT, values, published, GATES_OPEN, 0);
+    TEST_ASSERT_EQUAL_HEX32(pending, evaluated);
+    const ChangeMask after = ChangeEngine_pending(channels, CH_COUNT, values, published, GATES_OPEN);
+    TEST_ASSERT_EQUAL_HEX32(0, after);
+}
+
+void test_publish_all_and_clear(void)
+{
+    int32_t published[CH_COUNT] = {};
+    const ChangeMask channelBits = CHANGE_BITS(CH_COUNT); // Channels 0..4 own bits 0..4
+
+    ChangeMask mask = ChangeEngine_publishAll(channels, CH_COUNT, restValues, published);
+    TEST_ASSERT_EQUAL_HEX32(channelBits, mask);
+    TEST_ASSERT_EQUAL_INT32_ARRAY(restValues, published, CH_COUNT);
+
+    published[CH_PF] = 0; // Already zero: not reported again
+    mask = ChangeEngine_clear(channels, CH_COUNT, published);
+    TEST_ASSERT_EQUAL_HEX32(channelBits & ~CHANGE_BIT(BIT_PF), mask);
+    const int32_t zeros[CH_COUNT] = {};
+    TEST_ASSERT_EQUAL_INT32_ARRAY(zeros, published, CH_COUNT);
+    mask = ChangeEngine_clear(channels, CH_COUNT, published);
+    TEST_ASSERT_EQUAL_HEX32(0, mask);
+}
+
+void test_transitions_are_the_xor_of_packed_states(void)
+{
+    const ChangeMask before = ChangeEngine_state(true, BIT_MACHINE_STATE) | ChangeEngine_state(false, BIT_OVER_VOLTAGE) |
+                              ChangeEngine_state(true, BIT_UNDER_VOLTAGE);
+    TEST_ASSERT_EQUAL_HEX32(CHANGE_BIT(BIT_MACHINE_STATE) | CHANGE_BIT(BIT_UNDER_VOLTAGE), before);
+
+    const ChangeMask after = ChangeEngine_state(true, BIT_MACHINE_STATE) | ChangeEngine_state(true, BIT_OVER_VOLTAGE) |
+                             ChangeEngine_state(false, BIT_UNDER_VOLTAGE);
+    // Rising and falling edges both count; a state that stayed set does not
+    TEST_ASSERT_EQUAL_HEX32(CHANGE_BIT(BIT_OVER_VOLTAGE) | CHANGE_BIT(BIT_UNDER_VOLTAGE), ChangeEngine_transitions(before, after));
+    TEST_ASSERT_EQUAL_HEX32(0, ChangeEngine_transitions(after, after));
+    TEST_ASSERT_EQUAL_HEX32(0x80000000u, ChangeEngine_state(true, 31));
+}
+
+void test_for_each_bit_visits_the_set_bits_lowest_first(void)
+{
+    uint32_t calls = 0;
+    ChangeEngine_forEachBit(0, [&](unsigned)
+                            { calls++; });
+    TEST_ASSERT_EQUAL_UINT32(0, calls);
+
+    uint32_t rng = 0x2545F491u;
+    for (int i = 0; i < 1000; i++)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        const ChangeMask mask = i == 0 ? 0xFFFFFFFFu : (i == 1 ? 0x80000001u : rng);
+        unsigned visited[32];
+        uint32_t count = 0;
+        ChangeEngine_forEachBit(mask, [&](unsigned bit)
+                                { visited[count++] = bit; });
+        TEST_ASSERT_EQUAL_UINT32((uint32_t)__builtin_popcount(mask), count);
+        ChangeMask rebuilt = 0;
+        for (uint32_t k = 0; k < count; k++)
+        {
+            TEST_ASSERT_TRUE(k == 0 || visited[k] > visited[k - 1]);
+            rebuilt |= CHANGE_BIT(visited[k]);
+        }
+        TEST_ASSERT_EQUAL_HEX32(mask, rebuilt);
+    }
+}
+
+/**
+ * @brief The per-field flags the masks replaced (PZEMChangedFlags and its siblings, as they were in
+ *        SensorHandlers.h), for the footprint and the benchmark.
+ */
+struct OldPzemFlags
+{
+    bool voltage[NUM_DEVICES];
+    bool current[NUM_DEVICES];
+    bool power[NUM_DEVICES];
+    bool frequency[NUM_DEVICES];
+    bool pf[NUM_DEVICES];
+    bool machineState[NUM_DEVICES];
+    bool overVoltage[NUM_DEVICES];
+    bool overCurrent[NUM_DEVICES];
+    bool overPower[NUM_DEVICES];
+    bool underVoltage[NUM_DEVICES];
+    bool socketState[NUM_DEVICES];
+    bool operating_time[NUM_DEVICES];
+};
+
+struct OldCartFlags
+{
+    bool temperature, humidity;
+    bool overRoomTemp, underRoomTemp, overRoomHumi, underRoomHumi;
+    bool overComDeviceTemp, underComDeviceTemp, overComDeviceHumi, underComDeviceHumi;
+};
+
+struct OldDeviceEnvFlags
+{
+    bool overDeviceTemp[NUM_DEVICES];
+    bool underDeviceTemp[NUM_DEVICES];
+    bool overDeviceHumi[NUM_DEVICES];
+    bool underDeviceHumi[NUM_DEVICES];
+};
+
+struct OldLeakFlags
+{
+    bool changeLeakACCurrent, leakStatus, acLeakCurrent, softWarning, strongWarning;
+};
+
+/**
+ * @brief One recorded handler cycle: channel values and open gates of every socket.
+ */
+typedef struct
+{
+    int32_t values[NUM_DEVICES][CH_COUNT];
+    uint8_t open[NUM_DEVICES];
+} BenchCycle;
+
+static BenchCycle benchCycles[BENCH_CYCLES];
+
+// The alarm states a cycle derives from its values
+static void deviceStates(const int32_t *values, bool states[5])
+{
+    states[0] = values[CH_CURRENT] > 20;    // Machine running
+    states[1] = values[CH_VOLTAGE] > 2530;  // Over-voltage
+    states[2] = values[CH_CURRENT] > 1500;  // Over-current
+    states[3] = values[CH_POWER] > 3000;    // Over-power
+    states[4] = values[CH_VOLTAGE] < 1980;  // Under-voltage
+}
+
+/**
+ * @brief Change detection with one bool per field, as handlePZEMSensors did before the channel table.
+ */
+struct OldEngine
+{
+    int32_t last[NUM_DEVICES][CH_COUNT];
+    bool prev[NUM_DEVICES][5];
+
+    void evaluate(const BenchCycle &cycle, OldPzemFlags &changed)
+    {
+        for (int id = 0; id < NUM_DEVICES; id++)
+        {
+            changed.voltage[id] = false;
+            changed.current[id] = false;
+            changed.power[id] = false;
+            changed.frequency[id] = false;
+            changed.pf[id] = false;
+            changed.machineState[id] = false;
+            changed.overVoltage[id] = false;
+            changed.overCurrent[id] = false;
+            changed.overPower[id] = false;
+            changed.underVoltage[id] = false;
+            changed.socketState[id] = false;
+            changed.operating_time[id] = false;
+
+            const int32_t *v = cycle.values[id];
+            const bool allowRef = cycle.open[id] & GATE_REF;
+            const bool allowLine = cycle.open[id] & GATE_LINE;
+            const bool allowLoad = cycle.open[id] & GATE_LOAD;
+            if (allowRef && allowLine && pzemVoltageGate.RawDeltaGate::exceeded(v[CH_VOLTAGE], last[id][CH_VOLTAGE]))
+            {
+                changed.voltage[id] = true;
+                last[id][CH_VOLTAGE] = v[CH_VOLTAGE];
+            }
+            if (allowLine && allowLoad && pzemCurrentGate.RawDeltaGate::exceeded(v[CH_CURRENT], last[id][CH_CURRENT]))
+            {
+                changed.current[id] = true;
+                last[id][CH_CURRENT] = v[CH_CURRENT];
+            }
+            if (allowLine && allowLoad && pzemPowerGate.RawDeltaGate::exceeded(v[CH_POWER], last[id][CH_POWER]))
+            {
+                changed.power[id] = true;
+                last[id][CH_POWER] = v[CH_POWER];
+            }
+            if (allowLine && pzemFreqGate.RawDeltaGate::exceeded(v[CH_FREQUENCY], last[id][CH_FREQUENCY]))
+            {
+                changed.frequency[id] = true;
+                last[id][CH_FREQUENCY] = v[CH_FREQUENCY];
+            }
+            if (allowLine && allowLoad && pzemPfGate.RawDeltaGate::exceeded(v[CH_PF], last[id][CH_PF]))
+            {
+                changed.pf[id] = true;
+                last[id][CH_PF] = v[CH_PF];
+            }
+
+            bool states[5];
+            deviceStates(v, states);
+            changed.machineState[id] = states[0] != prev[id][0];
+            changed.overVoltage[id] = states[1] != prev[id][1];
+            changed.overCurrent[id] = states[2] != prev[id][2];
+            changed.overPower[id] = states[3] != prev[id][3];
+            changed.underVoltage[id] = states[4] != prev[id][4];
+            memcpy(prev[id], states, sizeof(states));
+        }
+    }
+
+    static void merge(OldPzemFlags &acc, const OldPzemFlags &cycle)
+    {
+        for (int id = 0; id < NUM_DEVICES; id++)
+        {
+            acc.voltage[id] |= cycle.voltage[id];
+            acc.current[id] |= cycle.current[id];
+            acc.power[id] |= cycle.power[id];
+            acc.frequency[id] |= cycle.frequency[id];
+            acc.pf[id] |= cycle.pf[id];
+            acc.machineState[id] |= cycle.machineState[id];
+            acc.overVoltage[id] |= cycle.overVoltage[id];
+            acc.overCurrent[id] |= cycle.overCurrent[id];
+            acc.overPower[id] |= cycle.overPower[id];
+            acc.underVoltage[id] |= cycle.underVoltage[id];
+            acc.socketState[id] |= cycle.socketState[id];
+            acc.operating_time[id] |= cycle.operating_time[id];
+        }
+    }
+
+    // The serializer's question for every field: write it or not
+    template <typename F>
+    static void forEachChanged(const OldPzemFlags &changed, int id, F fn)
+    {
+        if (changed.voltage[id]) fn(BIT_VOLTAGE);
+        if (changed.current[id]) fn(BIT_CURRENT);
+        if (changed.power[id]) fn(BIT_POWER);
+        if (changed.frequency[id]) fn(BIT_FREQUENCY);
+        if (changed.pf[id]) fn(BIT_PF);
+        if (changed.machineState[id]) fn(BIT_MACHINE_STATE);
+        if (changed.overVoltage[id]) fn(BIT_OVER_VOLTAGE);
+        if (changed.overCurrent[id]) fn(BIT_OVER_CURRENT);
+        if (changed.overPower[id]) fn(BIT_OVER_POWER);
+        if (changed.underVoltage[id]) fn(BIT_UNDER_VOLTAGE);
+        if (changed.socketState[id]) fn(BIT_SOCKET_STATE);
+        if (changed.operating_time[id]) fn(BIT_OPERATING_TIME);
+    }
+};
+
+/**
+ * @brief The same detection through the channel table into one mask per socket.
+ */
+struct MaskEngine
+{
+    int32_t published[NUM_DEVICES][CH_COUNT];
+    ChangeMask states[NUM_DEVICES];
+
+    void evaluate(const BenchCycle &cycle, ChangeMask changed[NUM_DEVICES])
+    {
+        for (int id = 0; id < NUM_DEVICES; id++)
+        {
+            bool s[5];
+            deviceStates(cycle.values[id], s);
+            const ChangeMask now = ChangeEngine_state(s[0], BIT_MACHINE_STATE) | ChangeEngine_state(s[1], BIT_OVER_VOLTAGE) |
+                                   ChangeEngine_state(s[2], BIT_OVER_CURRENT) | ChangeEngine_state(s[3], BIT_OVER_POWER) |
+                                   ChangeEngine_state(s[4], BIT_UNDER_VOLTAGE);
+            changed[id] = ChangeEngine_evaluate(channels, CH_COUNT, cycle.values[id], published[id], cycle.open[id], 0) |
+                          ChangeEngine_transitions(states[id], now);
+            states[id] = now;
+        }
+    }
+};
+
+static ChangeMask oldFlagsMask(const OldPzemFlags &changed, int id)
+{
+    ChangeMask mask = 0;
+    OldEngine::forEachChanged(changed, id, [&](unsigned bit)
+                              { mask |= CHANGE_BIT(bit); });
+    return mask;
+}
+
+/**
+ * @brief A random walk of 6 sockets: noise below the gates, steps past them, machines switching,
+ *        over- and under-voltage episodes and closed warm-up gates.
+ */
+static void recordCycles(void)
+{
+    uint32_t rng = 0x9E3779B9u;
+    int32_t v[NUM_DEVICES][CH_COUNT];
+    for (int id = 0; id < NUM_DEVICES; id++)
+    {
+        memcpy(v[id], restValues, sizeof(restValues));
+    }
+    for (int c = 0; c < BENCH_CYCLES; c++)
+    {
+        for (int id = 0; id < NUM_DEVICES; id++)
+        {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            v[id][CH_VOLTAGE] = 2300 + (int32_t)(rng % 7) - 3 + ((rng >> 8) % 64 == 0 ? 260 : 0) - ((rng >> 14) % 64 == 0 ? 340 : 0);
+            if ((rng >> 20) % 16 == 0)
+            {
+                v[id][CH_CURRENT] = (rng >> 24) % 2 ? 10 : 400 + (int32_t)((rng >> 4) % 1400);
+            }
+            v[id][CH_POWER] = v[id][CH_VOLTAGE] * v[id][CH_CURRENT] / 1000;
+            v[id][CH_FREQUENCY] = 500 + (int32_t)((rng >> 26) % 3) - 1;
+            v[id][CH_PF] = 90 + (int32_t)((rng >> 12) % 11);
+            memcpy(benchCycles[c].values[id], v[id], sizeof(v[id]));
+            benchCycles[c].open[id] = (rng >> 28) == 0 ? GATE_REF : GATES_OPEN; // Warm-up now and then
+        }
+    }
+}
+
+// Nanoseconds per handler cycle (6 sockets) of the flag structs: evaluate, merge, dispatch
+static double oldNsPerCycle(volatile uint32_t *sink)
+{
+    static OldEngine engine;
+    memset(&engine, 0, sizeof(engine));
+    OldPzemFlags cycle;
+    OldPzemFlags acc = {};
+    uint32_t fields = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (int c = 0; c < BENCH_CYCLES; c++)
+        {
+            engine.evaluate(benchCycles[c], cycle);
+            OldEngine::merge(acc, cycle);
+            for (int id = 0; id < NUM_DEVICES; id++)
+            {
+                OldEngine::forEachChanged(cycle, id, [&](unsigned bit)
+                                          { fields += bit + 1; });
+            }
+        }
+    }
+    *sink = fields + acc.voltage[0];
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / ((double)BENCH_ROUNDS * BENCH_CYCLES);
+}
+
+// Nanoseconds per handler cycle of the channel table and masks
+static double maskNsPerCycle(volatile uint32_t *sink)
+{
+    static MaskEngine engine;
+    memset(&engine, 0, sizeof(engine));
+    ChangeMask cycle[NUM_DEVICES];
+    ChangeMask acc[NUM_DEVICES] = {};
+    uint32_t fields = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (int c = 0; c < BENCH_CYCLES; c++)
+        {
+            engine.evaluate(benchCycles[c], cycle);
+            for (int id = 0; id < NUM_DEVICES; id++)
+            {
+                acc[id] |= cycle[id];
+                ChangeEngine_forEachBit(cycle[id], [&](unsigned bit)
+                                        { fields += bit + 1; });
+            }
+        }
+    }
+    *sink = fields + acc[0];
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / ((double)BENCH_ROUNDS * BENCH_CYCLES);
+}
+
+/**
+ * @brief Both detections see the same trace and must agree on every field of every cycle; then
+ *        the cost of a handler cycle and the memory of the change flags.
+ */
+void test_benchmark_masks_vs_flag_structs(void)
+{
+    recordCycles();
+
+    static OldEngine oldEngine;
+    static MaskEngine maskEngine;
+    memset(&oldEngine, 0, sizeof(oldEngine));
+    memset(&maskEngine, 0, sizeof(maskEngine));
+    uint32_t changes = 0;
+    ChangeMask seen = 0;
+    for (int c = 0; c < BENCH_CYCLES; c++)
+    {
+        OldPzemFlags flags;
+        ChangeMask masks[NUM_DEVICES];
+        oldEngine.evaluate(benchCycles[c], flags);
+        maskEngine.evaluate(benchCycles[c], masks);
+        for (int id = 0; id < NUM_DEVICES; id++)
+        {
+            const ChangeMask expected = oldFlagsMask(flags, id);
+            TEST_ASSERT_EQUAL_HEX32(expected, masks[id]);
+            changes += (uint32_t)__builtin_popcount(masks[id]);
+            seen |= masks[id];
+        }
+    }
+    TEST_ASSERT_EQUAL_HEX32(CHANGE_BITS(BIT_UNDER_VOLTAGE + 1), seen); // Every channel and state bit exercised
+
+    volatile uint32_t sink;
+    oldNsPerCycle(&sink); // Warm up
+    double oldNs = 1e9;
+    double maskNs = 1e9;
+    for (int pass = 0; pass < 3; pass++) // Best of 3 against scheduler noise
+    {
+        const double o = oldNsPerCycle(&sink);
+        const double m = maskNsPerCycle(&sink);
+        oldNs = o < oldNs ? o : oldNs;
+        maskNs = m < maskNs ? m : maskNs;
+    }
+
+    const size_t oldBytes = sizeof(OldPzemFlags) + sizeof(OldCartFlags) + sizeof(OldDeviceEnvFlags) + sizeof(OldLeakFlags);
+    const size_t maskBytes = sizeof(ChangeMask) * (NUM_DEVICES + 1); // ChangeSet: one mask per socket + the cart
+    char line[160];
+    snprintf(line, sizeof(line), "%lu field changes over %d cycles; per cycle (6 sockets, evaluate + merge + dispatch): "
+                                 "flags %.1f ns, masks %.1f ns (%.2fx)",
+             (unsigned long)changes, BENCH_CYCLES, oldNs, maskNs, oldNs / maskNs);
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line), "change flags: %lu bytes as bool structs, %lu bytes as masks",
+             (unsigned long)oldBytes, (unsigned long)maskBytes);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL_UINT32(111, oldBytes);
+    TEST_ASSERT_EQUAL_UINT32(28, maskBytes);
+    TEST_ASSERT_TRUE(maskNs < oldNs * 1.25); // Not slower, beyond timing noise
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_evaluate_waits_for_every_gate_of_a_channel);
+    RUN_TEST(test_evaluate_publishes_only_channels_past_their_gate);
+    RUN_TEST(test_force_publishes_unchanged_channels_behind_open_gates);
+    RUN_TEST(test_pending_matches_evaluate_without_publishing);
+    RUN_TEST(test_publish_all_and_clear);
+    RUN_TEST(test_transitions_are_the_xor_of_packed_states);
+    RUN_TEST(test_for_each_bit_visits_the_set_bits_lowest_first);
+    RUN_TEST(test_benchmark_masks_vs_flag_structs);
+    return UNITY_END();
+}
@@ -0,0 +1,362 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the register-unit (fixed-point) measurement path against the float path it
+ *        replaced, documenting every place where their decisions differ, and a timing benchmark of
+ *        both paths (pio test -e native -f test_fixed_point).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include "PZEM016_Lib.h"
+
+#define VOLTAGE_REG_MIN 2000 // 200.0 V: sweep of the voltage register
+#define VOLTAGE_REG_MAX 2600 // 260.0 V
+#define CURRENT_REG_MAX 2500 // 2.500 A: above every current_max of the sockets
+#define BENCH_READINGS 4096  // Voltage/current register pairs replayed by the benchmark
+#define BENCH_ROUNDS 500     // Replays per benchmark pass
+
+/**
+ * @brief Over-current and over-power thresholds of the float path, as they were in pzemThresholds.
+ */
+typedef struct
+{
+    float current_max;
+    float power_max;
+} FloatThresholds;
+
+static const FloatThresholds floatThresholds[NUM_DEVICES] = {
+    [AUO_DISPLAY] = {0.65f, 142.5f},
+    [CCU_IMAGE1_S] = {0.534f, 128.25f},
+    [CCU_IMAGE_1_HUB] = {0.38f, 91.2f},
+    [CCU_TRICAM_PAL] = {0.237f, 57.0f},
+    [XENON_300] = {1.78f, 427.5f},
+    [ENDOFLATOR_UI400] = {1.52f, 364.8f}};
+
+// calculateDelta() of the float path
+static float floatDelta(float value, float accuracy_pct, float resolution, float sigma, float F_u, int N_lsb, float delta_min)
+{
+    float delta = F_u * (fabs(value) * accuracy_pct + sigma + N_lsb * resolution);
+    return (delta > delta_min) ? delta : delta_min;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_apparent_power_is_rounded_to_the_register_step(void)
+{
+    // 230.0 V x 0.557 A = 128.11 W
+    TEST_ASSERT_EQUAL_INT32(1281, PZEM016_apparentPower(Voltage(230.0), Current(0.557)).raw);
+    // Ties round up: 225.0 V x 0.570 A = 128.25 W exactly
+    TEST_ASSERT_EQUAL_INT32(1283, PZEM016_apparentPower(Voltage(225.0), Current(0.570)).raw);
+    TEST_ASSERT_EQUAL_INT32(0, PZEM016_apparentPower(Voltage(230.0), Current(0.0)).raw);
+    // 32-bit current register: the product saturates instead of wrapping, and the range check rejects it
+    TEST_ASSERT_EQUAL_INT32(INT32_MAX, PZEM016_apparentPower(Voltage::fromRaw(65535), Current::fromRaw(INT32_MAX)).raw);
+
+    // Against float U x I over the sweep: never more than half a step (0.05 W) apart
+    double worstW = 0.0;
+    for (int32_t u = VOLTAGE_REG_MIN; u <= VOLTAGE_REG_MAX; u++)
+    {
+        for (int32_t i = 0; i <= CURRENT_REG_MAX; i++)
+        {
+            const float floatW = (u * 0.1f) * (i * 0.001f);
+            const double diffW = fabs(PZEM016_apparentPower(Voltage::fromRaw(u), Current::fromRaw(i)).raw / 10.0 - floatW);
+            worstW = diffW > worstW ? diffW : worstW;
+        }
+    }
+    char line[96];
+    snprintf(line, sizeof(line), "largest difference from float U x I: %.4f W", worstW);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(worstW <= 0.05 + 1e-4);
+}
+
+void test_power_thresholds_lie_on_the_register_grid(void)
+{
+    for (int id = 0; id < NUM_DEVICES; id++)
+    {
+        TEST_ASSERT_EQUAL_INT32(lroundf(floatThresholds[id].current_max * 1000), pzemThresholds[id].current_max.raw);
+        if (id == CCU_IMAGE1_S)
+        {
+            continue;
+        }
+        TEST_ASSERT_EQUAL_INT32(lroundf(floatThresholds[id].power_max * 10), pzemThresholds[id].power_max.raw);
+    }
+    // 128.25 W is off the 0.1 W grid. Power(128.25) would round up to 128.3 W; the table says 128.2 W,
+    // which keeps the strict "> 128.25 W" of the float path on register values (next test)
+    TEST_ASSERT_EQUAL_INT32(1283, Power(128.25).raw);
+    TEST_ASSERT_EQUAL_INT32(1282, pzemThresholds[CCU_IMAGE1_S].power_max.raw);
+}
+
+/**
+ * @brief Compare "register x step > float threshold" with the integer compare of the same register
+ *        over 0..@p regMax. A decision may only differ at the threshold itself, where float rounding
+ *        of the product can make a reading equal to the threshold "over"; the integer compare never
+ *        does. Returns the number of differing registers (0 or 1).
+ */
+template <typename T>
+static uint32_t registerMismatches(float step, float floatThreshold, T threshold, int32_t regMax)
+{
+    uint32_t mismatches = 0;
+    for (int32_t reg = 0; reg <= regMax; reg++)
+    {
+        const bool floatOver = reg * step > floatThreshold;
+        const bool fixedOver = T::fromRaw(reg) > threshold;
+        if (floatOver != fixedOver)
+        {
+            TEST_ASSERT_EQUAL_INT32(threshold.raw, reg);
+            TEST_ASSERT_TRUE(floatOver);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+/**
+ * @brief Power from the meter register (AUO_DISPLAY) and the over-current check of every socket: the
+ *        register value is compared directly. The power register is swept for every socket, so the
+ *        128.25 W threshold written as 128.2 W is shown to keep the float decisions.
+ */
+void test_register_comparisons_match_float_except_exactly_at_the_threshold(void)
+{
+    for (int id = 0; id < NUM_DEVICES; id++)
+    {
+        const uint32_t power = registerMismatches(0.1f, floatThresholds[id].power_max, pzemThresholds[id].power_max, 65535);
+        const uint32_t current = registerMismatches(0.001f, floatThresholds[id].current_max, pzemThresholds[id].current_max, CURRENT_REG_MAX);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(1, power);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(1, current);
+        if (id == CCU_IMAGE1_S)
+        {
+            TEST_ASSERT_EQUAL_UINT32(0, power); // 128.25 W is between two register values: no tie to round
+        }
+        if (power + current > 0)
+        {
+            char line[128];
+            snprintf(line, sizeof(line), "%s: float calls a reading equal to the threshold over (power %lu, current %lu)",
+                     SOCKET_NAMES[id], (unsigned long)power, (unsigned long)current);
+            TEST_MESSAGE(line);
+        }
+    }
+}
+
+/**
+ * @brief Sockets whose power is U x I: the product is rounded to 0.1 W before the threshold compare,
+ *        so products less than 0.05 W above a threshold T no longer count as over-power (the float
+ *        path compared the unrounded product). For CCU_IMAGE1_S (T = 128.2 W, formerly 128.25 W)
+ *        the band collapses to the single tie at exactly 128.25 W, which is now over-power.
+ */
+void test_apparent_power_threshold_differs_only_within_half_a_step(void)
+{
+    for (int id = 0; id < NUM_DEVICES; id++)
+    {
+        if (id == AUO_DISPLAY)
+        {
+            continue; // Power from the meter register
+        }
+        const int64_t thresholdProduct = (int64_t)pzemThresholds[id].power_max.raw * 1000; // In 0.0001 W
+        uint32_t floatOnly = 0; // Over-power for float only
+        uint32_t fixedOnly = 0; // Over-power for fixed only
+        for (int32_t u = VOLTAGE_REG_MIN; u <= VOLTAGE_REG_MAX; u++)
+        {
+            for (int32_t i = 0; i <= CURRENT_REG_MAX; i++)
+            {
+                const bool floatOver = (u * 0.1f) * (i * 0.001f) > floatThresholds[id].power_max;
+                const bool fixedOver = PZEM016_apparentPower(Voltage::fromRaw(u), Current::fromRaw(i)) > pzemThresholds[id].power_max;
+                if (floatOver == fixedOver)
+                {
+                    continue;
+                }
+                const int64_t product = (int64_t)u * i; // Exact U x I in 0.0001 W
+                TEST_ASSERT_TRUE(product >= thresholdProduct && product <= thresholdProduct + 500);
+                if (id == CCU_IMAGE1_S)
+                {
+                    TEST_ASSERT_EQUAL_INT64(thresholdProduct + 500, product); // Exactly 128.25 W
+                }
+                floatOver ? floatOnly++ : fixedOnly++;
+            }
+        }
+        char line[128];
+        snprintf(line, sizeof(line), "%s (> %.1f W): %lu U,I pairs over for float only, %lu for fixed only",
+                 SOCKET_NAMES[id], pzemThresholds[id].power_max.toFloat(), (unsigned long)floatOnly, (unsigned long)fixedOnly);
+        TEST_MESSAGE(line);
+        if (id == CCU_IMAGE1_S)
+        {
+            TEST_ASSERT_EQUAL_UINT32(0, floatOnly);
+            TEST_ASSERT_GREATER_THAN_UINT32(0, fixedOnly);
+        }
+        else
+        {
+            TEST_ASSERT_GREATER_THAN_UINT32(0, floatOnly);
+        }
+    }
+}
+
+/**
+ * @brief The integer change gate only differs from calculateDelta() on a change of exactly the gate
+ *        bound, which float rounding reported as exceeding it.
+ */
+void test_voltage_gate_differs_only_at_the_bound(void)
+{
+    uint32_t checked = 0;
+    uint32_t floatOnly = 0;
+    for (int32_t value = VOLTAGE_REG_MIN; value <= VOLTAGE_REG_MAX; value++)
+    {
+        const float delta = floatDelta(value * 0.1f, PZEM_ACCURACY_VOLTAGE, PZEM_RESOLUTION_VOLTAGE, PZEM_SIGMA_VOLTAGE,
+                                       PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_VOLTAGE_MIN);
+        for (int32_t last = value - 30; last <= value + 30; last++)
+        {
+            const bool floatExceeded = fabsf(value * 0.1f - last * 0.1f) > delta;
+            const bool fixedExceeded = pzemVoltageGate.exceeded(Voltage::fromRaw(value), Voltage::fromRaw(last));
+            checked++;
+            if (floatExceeded == fixedExceeded)
+            {
+                continue;
+            }
+            TEST_ASSERT_TRUE(floatExceeded);
+            const int32_t steps = value > last ? value - last : last - value;
+            TEST_ASSERT_EQUAL_INT32(pzemVoltageGate.step(Voltage::fromRaw(value)).raw - 1, steps); // Largest unreported change
+            floatOnly++;
+        }
+    }
+    char line[96];
+    snprintf(line, sizeof(line), "voltage gate: %lu of %lu value/last pairs reported by float only",
+             (unsigned long)floatOnly, (unsigned long)checked);
+    TEST_MESSAGE(line);
+}
+
+/**
+ * @brief One socket reading as the benchmark replays it: registers as decoded from the meter.
+ */
+typedef struct
+{
+    uint8_t socket;
+    int32_t voltage; ///< 0.1 V
+    int32_t current; ///< 0.001 A
+} BenchReading;
+
+static BenchReading benchReadings[BENCH_READINGS];
+
+/**
+ * @brief Nanoseconds per reading of the fixed-point evaluation: U x I rounded to the power register,
+ *        the over-current/over-power compare and the voltage, current and power change gates against
+ *        the previous reading.
+ */
+static double fixedNsPerReading(volatile uint32_t *sink)
+{
+    uint32_t acc = 0;
+    Voltage lastV = Voltage::fromRaw(benchReadings[BENCH_READINGS - 1].voltage);
+    Current lastI = Current::fromRaw(benchReadings[BENCH_READINGS - 1].current);
+    Power lastP = PZEM016_apparentPower(lastV, lastI);
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (size_t k = 0; k < BENCH_READINGS; k++)
+        {
+            const BenchReading &r = benchReadings[k];
+            const Voltage v = Voltage::fromRaw(r.voltage);
+            const Current i = Current::fromRaw(r.current);
+            const Power p = PZEM016_apparentPower(v, i);
+            const bool over = p > pzemThresholds[r.socket].power_max || i > pzemThresholds[r.socket].current_max;
+            const bool changed = pzemVoltageGate.exceeded(v, lastV) || pzemCurrentGate.exceeded(i, lastI) ||
+                                 pzemPowerGate.exceeded(p, lastP);
+            acc += (uint32_t)over + 2u * changed + (uint32_t)p.raw;
+            lastV = v;
+            lastI = i;
+            lastP = p;
+        }
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    *sink = acc;
+    return ns / ((double)BENCH_ROUNDS * BENCH_READINGS);
+}
+
+// The same evaluation on the float path: registers scaled to float, calculateDelta() per quantity
+static double floatNsPerReading(volatile uint32_t *sink)
+{
+    uint32_t acc = 0;
+    float lastV = benchReadings[BENCH_READINGS - 1].voltage * 0.1f;
+    float lastI = benchReadings[BENCH_READINGS - 1].current * 0.001f;
+    float lastP = lastV * lastI;
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (size_t k = 0; k < BENCH_READINGS; k++)
+        {
+            const BenchReading &r = benchReadings[k];
+            const float v = r.voltage * 0.1f;
+            const float i = r.current * 0.001f;
+            const float p = v * i;
+            const bool over = p > floatThresholds[r.socket].power_max || i > floatThresholds[r.socket].current_max;
+            const bool changed =
+                fabsf(v - lastV) > floatDelta(v, PZEM_ACCURACY_VOLTAGE, PZEM_RESOLUTION_VOLTAGE, PZEM_SIGMA_VOLTAGE,
+                                              PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_VOLTAGE_MIN) ||
+                fabsf(i - lastI) > floatDelta(i, PZEM_ACCURACY_CURRENT, PZEM_RESOLUTION_CURRENT, PZEM_SIGMA_CURRENT,
+                                              PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_CURRENT_MIN) ||
+                fabsf(p - lastP) > floatDelta(p, PZEM_ACCURACY_POWER, PZEM_RESOLUTION_POWER, PZEM_SIGMA_POWER,
+                                              PZEM_DELTA_FU, PZEM_DELTA_N_LSB, PZEM_DELTA_POWER_MIN);
+            acc += (uint32_t)over + 2u * changed + (uint32_t)(p * 10.0f);
+            lastV = v;
+            lastI = i;
+            lastP = p;
+        }
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    *sink = acc;
+    return ns / ((double)BENCH_ROUNDS * BENCH_READINGS);
+}
+
+/**
+ * @brief Time both evaluations over the same readings. On the host both are a few nanoseconds; the
+ *        numbers matter on the ESP32, whose FPU is single precision only, so calculateDelta()'s
+ *        double fabs() and the float-to-double conversions run in software there.
+ */
+void test_benchmark_fixed_against_float(void)
+{
+    uint32_t rng = 0x2545F491u;
+    for (size_t k = 0; k < BENCH_READINGS; k++)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        BenchReading &r = benchReadings[k];
+        r.socket = (uint8_t)(k % NUM_DEVICES);
+        r.voltage = 2280 + (int32_t)(rng % 50); // 228.0..232.9 V
+        r.current = pzemThresholds[r.socket].current_max.raw - 40 + (int32_t)((rng >> 8) % 80); // Around current_max
+    }
+
+    volatile uint32_t sink;
+    fixedNsPerReading(&sink); // Warm up
+    floatNsPerReading(&sink);
+    double fixedNs = 1e9;
+    double floatNs = 1e9;
+    for (int pass = 0; pass < 3; pass++) // Best of 3 against scheduler noise, interleaved
+    {
+        const double f = fixedNsPerReading(&sink);
+        const double g = floatNsPerReading(&sink);
+        fixedNs = f < fixedNs ? f : fixedNs;
+        floatNs = g < floatNs ? g : floatNs;
+    }
+    char line[128];
+    snprintf(line, sizeof(line), "host: fixed-point %.2f ns/reading, float %.2f ns/reading (%.2fx)", fixedNs, floatNs,
+             floatNs / fixedNs);
+    TEST_MESSAGE(line);
+#ifndef __SANITIZE_ADDRESS__ // Sanitizer builds check every 64-bit product of the gates: timing only
+    // Lenient: integer math must not make the evaluation noticeably slower even where floats are cheap
+    TEST_ASSERT_TRUE(fixedNs < 1.5 * floatNs);
+#endif
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_apparent_power_is_rounded_to_the_register_step);
+    RUN_TEST(test_power_thresholds_lie_on_the_register_grid);
+    RUN_TEST(test_register_comparisons_match_float_except_exactly_at_the_threshold);
+    RUN_TEST(test_apparent_power_threshold_differs_only_within_half_a_step);
+    RUN_TEST(test_voltage_gate_differs_only_at_the_bound);
+    RUN_TEST(test_benchmark_fixed_against_float);
+    return UNITY_END();
+}
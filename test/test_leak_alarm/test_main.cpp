@@ -0,0 +1,206 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the leakage alarm fast path with a simulated pin source: edge to buzzer and
+ *        publish latency, glitch filtering, edge bursts and the event queue
+ *        (pio test -e native -f test_leak_alarm).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include "LeakAlarm.h"
+
+#define EVENT_WAIT_MS 50 // Longest wait for the alarm task (confirm delay is LEAK_ALARM_CONFIRM_MS)
+
+static std::atomic<uint8_t> simulatedPins; // LEAK_ALARM_PIN_* levels seen by the alarm task
+static bool alarmStarted = false;
+
+static uint8_t readSimulatedPins(void)
+{
+    return simulatedPins.load();
+}
+
+// Set the outputs and raise the edge interrupt, as the GPIO ISR would
+static uint32_t edge(uint8_t pins)
+{
+    simulatedPins = pins;
+    const uint32_t nowUs = micros();
+    LeakAlarm_onEdge(nowUs);
+    return nowUs;
+}
+
+// Wait for the consumer notification, then take the event, as the network task does
+static bool waitEvent(LeakAlarmEvent *event)
+{
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(EVENT_WAIT_MS));
+    return LeakAlarm_takeEvent(event);
+}
+
+static void drainEvents(void)
+{
+    LeakAlarmEvent event;
+    while (LeakAlarm_takeEvent(&event))
+    {
+    }
+    ulTaskNotifyTake(pdTRUE, 0);
+}
+
+void setUp(void)
+{
+    if (!alarmStarted)
+    {
+        simulatedPins = 0;
+        LeakAlarm_init(readSimulatedPins);
+        alarmStarted = true;
+        delay(EVENT_WAIT_MS); // Boot level (no alarm) evaluated
+    }
+    LeakAlarm_setConsumerTask(xTaskGetCurrentTaskHandle());
+    if (LeakAlarm_activePins() != 0)
+    {
+        LeakAlarmEvent event;
+        edge(0);
+        waitEvent(&event);
+    }
+    drainEvents();
+    Buzzer_stop();
+}
+
+void tearDown(void)
+{
+    Buzzer_stop();
+}
+
+void test_raised_alarm_starts_the_buzzer_within_milliseconds(void)
+{
+    const uint32_t eventsBefore = LeakAlarm_getStats()->events;
+    const uint32_t detectUs = edge(LEAK_ALARM_PIN_AO);
+    LeakAlarmEvent event;
+    TEST_ASSERT_TRUE(waitEvent(&event));
+    LeakAlarm_recordPublished(&event, micros());
+
+    TEST_ASSERT_EQUAL_HEX8(LEAK_ALARM_PIN_AO, event.active);
+    TEST_ASSERT_EQUAL_HEX8(LEAK_ALARM_PIN_AO, event.changed);
+    TEST_ASSERT_EQUAL_UINT32(detectUs, event.detectUs);
+    TEST_ASSERT_EQUAL_HEX8(LEAK_ALARM_PIN_AO, LeakAlarm_activePins());
+    TEST_ASSERT_EQUAL_INT(BUZZER_PRIORITY_LEAK_STRONG, Buzzer_currentPriority());
+
+    const LeakAlarmStats *stats = LeakAlarm_getStats();
+    TEST_ASSERT_EQUAL_UINT32(eventsBefore + 1, stats->events);
+    char line[128];
+    snprintf(line, sizeof(line), "edge to buzzer %lu us, edge to publish %lu us (confirm delay %d ms)",
+             (unsigned long)stats->lastDetectToBuzzerUs, (unsigned long)stats->lastDetectToPublishUs, LEAK_ALARM_CONFIRM_MS);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(LEAK_ALARM_CONFIRM_MS * 1000, stats->lastDetectToBuzzerUs);
+    TEST_ASSERT_LESS_THAN_UINT32(LEAK_ALARM_CONFIRM_MS * 1000 + 10000, stats->lastDetectToBuzzerUs);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(stats->lastDetectToBuzzerUs, stats->lastDetectToPublishUs);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(stats->lastDetectToPublishUs, stats->maxDetectToPublishUs);
+}
+
+void test_second_output_reports_only_what_changed(void)
+{
+    LeakAlarmEvent event;
+    edge(LEAK_ALARM_PIN_DO);
+    TEST_ASSERT_TRUE(waitEvent(&event));
+    edge(LEAK_ALARM_PIN_DO | LEAK_ALARM_PIN_DA);
+    TEST_ASSERT_TRUE(waitEvent(&event));
+    TEST_ASSERT_EQUAL_HEX8(LEAK_ALARM_PIN_DO | LEAK_ALARM_PIN_DA, event.active);
+    TEST_ASSERT_EQUAL_HEX8(LEAK_ALARM_PIN_DA, event.changed);
+}
+
+void test_cleared_alarm_is_reported_without_the_buzzer(void)
+{
+    LeakAlarmEvent event;
+    edge(LEAK_ALARM_PIN_AO);
+    TEST_ASSERT_TRUE(waitEvent(&event));
+    Buzzer_stop();
+    const uint32_t buzzerUs = LeakAlarm_getStats()->lastDetectToBuzzerUs;
+
+    edge(0);
+    TEST_ASSERT_TRUE(waitEvent(&event));
+    TEST_ASSERT_EQUAL_HEX8(0, event.active);
+    TEST_ASSERT_EQUAL_HEX8(LEAK_ALARM_PIN_AO, event.changed);
+    TEST_ASSERT_FALSE(Buzzer_isBusy());
+    TEST_ASSERT_EQUAL_UINT32(buzzerUs, LeakAlarm_getStats()->lastDetectToBuzzerUs);
+}
+
+void test_pulse_shorter_than_the_confirm_delay_is_a_glitch(void)
+{
+    const uint32_t glitches = LeakAlarm_getStats()->glitches;
+    const uint32_t events = LeakAlarm_getStats()->events;
+    edge(LEAK_ALARM_PIN_DO);
+    simulatedPins = 0; // Back to idle before the task reads the level
+    LeakAlarmEvent event;
+    TEST_ASSERT_FALSE(waitEvent(&event));
+    TEST_ASSERT_EQUAL_UINT32(glitches + 1, LeakAlarm_getStats()->glitches);
+    TEST_ASSERT_EQUAL_UINT32(events, LeakAlarm_getStats()->events);
+    TEST_ASSERT_EQUAL_HEX8(0, LeakAlarm_activePins());
+}
+
+void test_edge_burst_keeps_the_first_timestamp(void)
+{
+    const uint32_t edges = LeakAlarm_getStats()->edges;
+    simulatedPins = LEAK_ALARM_PIN_DA;
+    const uint32_t firstUs = micros();
+    LeakAlarm_onEdge(firstUs); // Contact bounce: three edges within the confirm delay
+    LeakAlarm_onEdge(firstUs + 200);
+    LeakAlarm_onEdge(firstUs + 400);
+    LeakAlarmEvent event;
+    TEST_ASSERT_TRUE(waitEvent(&event));
+    TEST_ASSERT_EQUAL_UINT32(firstUs, event.detectUs);
+    TEST_ASSERT_EQUAL_UINT32(edges + 3, LeakAlarm_getStats()->edges);
+    TEST_ASSERT_FALSE(LeakAlarm_takeEvent(&event)); // One event for the whole burst
+}
+
+void test_full_queue_drops_the_oldest_event(void)
+{
+    LeakAlarm_setConsumerTask(NULL); // Network down: nobody takes events
+    const uint32_t dropped = LeakAlarm_getStats()->dropped;
+    const int changes = LEAK_ALARM_QUEUE_DEPTH + 2;
+    for (int i = 0; i < changes; i++)
+    {
+        const uint32_t events = LeakAlarm_getStats()->events;
+        edge((i & 1) ? 0 : LEAK_ALARM_PIN_AO);
+        for (int ms = 0; ms < EVENT_WAIT_MS && LeakAlarm_getStats()->events == events; ms++)
+        {
+            delay(1);
+        }
+        TEST_ASSERT_EQUAL_UINT32(events + 1, LeakAlarm_getStats()->events);
+    }
+    TEST_ASSERT_EQUAL_UINT32(dropped + 2, LeakAlarm_getStats()->dropped);
+
+    // The newest LEAK_ALARM_QUEUE_DEPTH changes remain, oldest first
+    LeakAlarmEvent event;
+    for (int i = changes - LEAK_ALARM_QUEUE_DEPTH; i < changes; i++)
+    {
+        TEST_ASSERT_TRUE(LeakAlarm_takeEvent(&event));
+        TEST_ASSERT_EQUAL_HEX8((i & 1) ? 0 : LEAK_ALARM_PIN_AO, event.active);
+    }
+    TEST_ASSERT_FALSE(LeakAlarm_takeEvent(&event));
+}
+
+void test_publish_latency_statistics(void)
+{
+    const LeakAlarmStats before = *LeakAlarm_getStats();
+    LeakAlarmEvent event = {};
+    event.detectUs = 1000;
+    LeakAlarm_recordPublished(&event, 4000);
+    LeakAlarm_recordPublished(&event, 2500);
+    const LeakAlarmStats *stats = LeakAlarm_getStats();
+    TEST_ASSERT_EQUAL_UINT32(before.published + 2, stats->published);
+    TEST_ASSERT_EQUAL_UINT32(1500, stats->lastDetectToPublishUs);
+    TEST_ASSERT_EQUAL_UINT64(before.sumDetectToPublishUs + 3000 + 1500, stats->sumDetectToPublishUs);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(3000, stats->maxDetectToPublishUs);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_raised_alarm_starts_the_buzzer_within_milliseconds);
+    RUN_TEST(test_second_output_reports_only_what_changed);
+    RUN_TEST(test_cleared_alarm_is_reported_without_the_buzzer);
+    RUN_TEST(test_pulse_shorter_than_the_confirm_delay_is_a_glitch);
+    RUN_TEST(test_edge_burst_keeps_the_first_timestamp);
+    RUN_TEST(test_full_queue_drops_the_oldest_event);
+    RUN_TEST(test_publish_latency_statistics);
+    return UNITY_END();
+}
@@ -0,0 +1,296 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the Modbus discovery scan on simulated buses: adoption of a replaced PZEM016T
+ *        only when exactly one socket is silent, ES35-SW and leak sensor relocation, the early stop of a
+ *        factory cart, the bus map saved in NVS, and the scan time of each case
+ *        (pio test -e native -f test_modbus_discovery).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "ModbusDiscovery.h"
+#include "FakeModbusSlave.h"
+#include "Preferences.h"
+
+#define NEW_PZEM_ADDR 0x0B   // Replacement meter configured to an address outside the factory layout
+#define OTHER_PZEM_ADDR 0x0C // A second unmapped meter
+#define NEW_ES35_ADDR 0x0A   // ES35-SW moved off its factory address 0x09
+#define NEW_LEAK_ADDR 0x03   // Leak sensor moved off its factory address 0x01
+
+static FakeModbusSlave *sensorSlaves;
+static FakeModbusSlave *leakSlaves;
+static const ModbusBusMap factoryMap = {DISCOVERY_MAP_VERSION, {0x01, 0x02, 0x03, 0x04, 0x05, 0x06}, ES35SW_SLAVE_ID,
+                                        LEAK_SENSOR_SLAVE_ID};
+
+// Attach one of the drivers' global buses to a simulated bus
+static FakeModbusSlave *attachBus(Rs485Bus *bus, const char *name, int uart)
+{
+    const FakePty pty = FakePty_open();
+    TEST_ASSERT_TRUE(pty.wire >= 0 && pty.uart >= 0);
+    HardwareSerial *serial = new HardwareSerial(uart);
+    serial->fakeAttach(pty.uart);
+    FakeModbusSlave *slaves = new FakeModbusSlave(pty.wire, SENSOR_BUS_BAUD);
+    RS485Bus_init(bus, name, serial, SENSOR_BUS_BAUD, -1, -1);
+    return slaves;
+}
+
+static void addPzem(uint8_t address)
+{
+    FakeModbusSlave::Device &dev = sensorSlaves->device(address);
+    dev.present = true;
+    for (uint16_t reg = 0; reg < PZEM_REG_COUNT; reg++)
+    {
+        dev.registers[reg] = (uint16_t)(0x0900 + reg);
+    }
+    dev.registers[PZEM_HOLD_REG_ADDRESS] = address; // Also the current high word: the scan does not decode it
+}
+
+static void addEs35(uint8_t address)
+{
+    FakeModbusSlave::Device &dev = sensorSlaves->device(address);
+    dev.present = true;
+    dev.registers[REG_TEMPERATURE] = 235;
+    dev.registers[REG_TEMPERATURE + 1] = 612;
+    dev.registers[REG_SLAVE_ID] = address;
+}
+
+static void addLeak(uint8_t address)
+{
+    FakeModbusSlave::Device &dev = leakSlaves->device(address);
+    dev.present = true;
+    for (uint16_t reg = 0; reg < LEAK_REG_COUNT; reg++)
+    {
+        dev.registers[REG_DC_CURRENT + reg] = (uint16_t)(10 * reg);
+    }
+}
+
+// A cart with the factory addresses: six PZEM016T at 0x01..0x06, the ES35-SW at 0x09, the leak sensor at 0x01
+static void addFactoryCart(void)
+{
+    for (uint8_t address = 0x01; address <= 0x06; address++)
+    {
+        addPzem(address);
+    }
+    addEs35(ES35SW_SLAVE_ID);
+    addLeak(LEAK_SENSOR_SLAVE_ID);
+}
+
+// Highest address probed on a bus since the last clearLog()
+static uint8_t highestProbed(FakeModbusSlave *slaves)
+{
+    uint8_t highest = 0;
+    for (const FakeModbusSlave::Exchange &ex : slaves->exchanges())
+    {
+        highest = ex.slave > highest ? ex.slave : highest;
+    }
+    return highest;
+}
+
+static void reportScan(const char *what, const ModbusScanStats &stats)
+{
+    char line[128];
+    snprintf(line, sizeof(line), "%s: %u probes, %u devices in %lu ms", what, stats.probes, stats.found,
+             (unsigned long)stats.durationMs);
+    TEST_MESSAGE(line);
+}
+
+void setUp(void)
+{
+    if (sensorSlaves == NULL)
+    {
+        sensorSlaves = attachBus(&sensorBus, "sensor", 2);
+        leakSlaves = attachBus(&leakBus, "leak", 1);
+    }
+    for (uint8_t address = DISCOVERY_FIRST_ADDRESS; address <= DISCOVERY_LAST_ADDRESS; address++)
+    {
+        sensorSlaves->device(address) = FakeModbusSlave::Device();
+        leakSlaves->device(address) = FakeModbusSlave::Device();
+    }
+    sensorSlaves->clearLog();
+    leakSlaves->clearLog();
+    FakeNvs_erase();
+}
+
+void tearDown(void) {}
+
+void test_factory_cart_stops_after_the_es35(void)
+{
+    addFactoryCart();
+    ModbusBusMap map = factoryMap;
+    ModbusScanStats stats;
+    const bool changed = ModbusDiscovery_scan(&map, &stats);
+    reportScan("factory cart", stats);
+    TEST_ASSERT_FALSE(changed);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&factoryMap, &map, sizeof(map));
+    TEST_ASSERT_EQUAL_UINT16(1 + ES35SW_SLAVE_ID, stats.probes); // Leak bus: 0x01; sensor bus: 0x01..0x09
+    TEST_ASSERT_EQUAL_UINT8(8, stats.found);
+    TEST_ASSERT_EQUAL_UINT8(ES35SW_SLAVE_ID, highestProbed(sensorSlaves));
+    TEST_ASSERT_EQUAL_UINT8(LEAK_SENSOR_SLAVE_ID, highestProbed(leakSlaves));
+}
+
+void test_identify_tells_the_devices_apart(void)
+{
+    addFactoryCart();
+    sensorSlaves->device(0x0D).present = true; // Answers every read with exception 0x02
+    TEST_ASSERT_EQUAL_INT(MODBUS_DEVICE_PZEM016, ModbusDiscovery_identify(&sensorBus, 0x03));
+    TEST_ASSERT_EQUAL_INT(MODBUS_DEVICE_ES35SW, ModbusDiscovery_identify(&sensorBus, ES35SW_SLAVE_ID));
+    TEST_ASSERT_EQUAL_INT(MODBUS_DEVICE_UNKNOWN, ModbusDiscovery_identify(&sensorBus, 0x0D));
+    TEST_ASSERT_EQUAL_INT(MODBUS_DEVICE_LEAK, ModbusDiscovery_identify(&leakBus, LEAK_SENSOR_SLAVE_ID));
+
+    // A PZEM016T whose address register disagrees with the address it answers on is not recognized
+    addPzem(0x0E);
+    sensorSlaves->device(0x0E).registers[PZEM_HOLD_REG_ADDRESS] = 0x01;
+    TEST_ASSERT_EQUAL_INT(MODBUS_DEVICE_UNKNOWN, ModbusDiscovery_identify(&sensorBus, 0x0E));
+}
+
+void test_replaced_meter_fills_the_only_silent_socket(void)
+{
+    addFactoryCart();
+    sensorSlaves->device(0x06) = FakeModbusSlave::Device(); // Meter of socket 6 replaced...
+    addPzem(NEW_PZEM_ADDR);                                  // ...by one configured to another address
+    ModbusBusMap map = factoryMap;
+    ModbusScanStats stats;
+    const bool changed = ModbusDiscovery_scan(&map, &stats);
+    reportScan("one silent socket", stats);
+    TEST_ASSERT_TRUE(changed);
+    TEST_ASSERT_EQUAL_UINT8(NEW_PZEM_ADDR, map.pzem[NUM_DEVICES - 1]);
+    for (int i = 0; i < NUM_DEVICES - 1; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT8(factoryMap.pzem[i], map.pzem[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT8(ES35SW_SLAVE_ID, map.es35sw);
+    TEST_ASSERT_EQUAL_UINT8(NEW_PZEM_ADDR, highestProbed(sensorSlaves)); // Seven devices found: stop there
+}
+
+void test_no_silent_socket_leaves_a_stray_meter_unmapped(void)
+{
+    addFactoryCart();
+    addPzem(0x07);
+    ModbusBusMap map = factoryMap;
+    ModbusScanStats stats;
+    const bool changed = ModbusDiscovery_scan(&map, &stats);
+    reportScan("no silent socket", stats);
+    TEST_ASSERT_FALSE(changed);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&factoryMap, &map, sizeof(map));
+    // Seven devices identified at 0x07: the ES35-SW keeps its mapped address without being probed
+    TEST_ASSERT_EQUAL_UINT8(0x07, highestProbed(sensorSlaves));
+}
+
+void test_two_silent_sockets_adopt_nothing(void)
+{
+    addFactoryCart();
+    sensorSlaves->device(0x05) = FakeModbusSlave::Device(); // Socket 5 unpowered
+    sensorSlaves->device(0x06) = FakeModbusSlave::Device(); // Socket 6 meter replaced
+    addPzem(NEW_PZEM_ADDR);
+    ModbusBusMap map = factoryMap;
+    ModbusScanStats stats;
+    bool changed = ModbusDiscovery_scan(&map, &stats);
+    reportScan("two silent sockets", stats);
+    TEST_ASSERT_FALSE(changed); // The meter could belong to either socket
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&factoryMap, &map, sizeof(map));
+
+    addPzem(OTHER_PZEM_ADDR); // Both replaced: still no way to tell which is which
+    changed = ModbusDiscovery_scan(&map, &stats);
+    TEST_ASSERT_FALSE(changed);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&factoryMap, &map, sizeof(map));
+
+    addPzem(0x05); // Socket 5 powered again: socket 6 is the only silent one, the first new meter takes it
+    changed = ModbusDiscovery_scan(&map, &stats);
+    TEST_ASSERT_TRUE(changed);
+    TEST_ASSERT_EQUAL_UINT8(0x05, map.pzem[4]);
+    TEST_ASSERT_EQUAL_UINT8(NEW_PZEM_ADDR, map.pzem[5]);
+}
+
+void test_es35_and_leak_sensor_are_relocated(void)
+{
+    addFactoryCart();
+    sensorSlaves->device(ES35SW_SLAVE_ID) = FakeModbusSlave::Device();
+    addEs35(NEW_ES35_ADDR);
+    leakSlaves->device(LEAK_SENSOR_SLAVE_ID) = FakeModbusSlave::Device();
+    addLeak(NEW_LEAK_ADDR);
+    ModbusBusMap map = factoryMap;
+    ModbusScanStats stats;
+    const bool changed = ModbusDiscovery_scan(&map, &stats);
+    reportScan("ES35-SW and leak sensor moved", stats);
+    TEST_ASSERT_TRUE(changed);
+    TEST_ASSERT_EQUAL_UINT8(NEW_ES35_ADDR, map.es35sw);
+    TEST_ASSERT_EQUAL_UINT8(NEW_LEAK_ADDR, map.leak);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(factoryMap.pzem, map.pzem, NUM_DEVICES);
+    TEST_ASSERT_EQUAL_UINT8(NEW_ES35_ADDR, highestProbed(sensorSlaves));
+    TEST_ASSERT_EQUAL_UINT8(NEW_LEAK_ADDR, highestProbed(leakSlaves));
+}
+
+void test_init_scans_once_and_then_uses_the_saved_map(void)
+{
+    addFactoryCart();
+    sensorSlaves->device(0x06) = FakeModbusSlave::Device();
+    addPzem(NEW_PZEM_ADDR);
+    modbusBusMap = factoryMap;
+
+    ModbusDiscovery_init(); // No map in NVS: scan, save, apply
+    TEST_ASSERT_EQUAL_UINT32(1, fakeNvsWrites);
+    TEST_ASSERT_EQUAL_UINT8(NEW_PZEM_ADDR, modbusBusMap.pzem[NUM_DEVICES - 1]);
+    TEST_ASSERT_EQUAL_UINT8(NEW_PZEM_ADDR, pzemAddresses[NUM_DEVICES - 1]);
+    TEST_ASSERT_TRUE(sensorSlaves->exchanges().size() > 0);
+
+    sensorSlaves->clearLog();
+    leakSlaves->clearLog();
+    modbusBusMap = factoryMap; // Reboot
+    ModbusDiscovery_init();
+    TEST_ASSERT_EQUAL_UINT32(0, sensorSlaves->exchanges().size()); // No scan
+    TEST_ASSERT_EQUAL_UINT32(0, leakSlaves->exchanges().size());
+    TEST_ASSERT_EQUAL_UINT32(1, fakeNvsWrites);
+    TEST_ASSERT_EQUAL_UINT8(NEW_PZEM_ADDR, modbusBusMap.pzem[NUM_DEVICES - 1]);
+
+    // Drivers back to the factory layout for the other tests
+    modbusBusMap = factoryMap;
+    memcpy(pzemAddresses, factoryMap.pzem, sizeof(pzemAddresses));
+}
+
+/**
+ * @brief Scan time of a factory cart (early stop after 0x09), of a cart with a replaced meter, and of
+ *        a cart with nothing connected (every address of both buses costs a probe timeout).
+ */
+void test_benchmark_scan_time(void)
+{
+    ModbusBusMap map = factoryMap;
+    ModbusScanStats empty;
+    ModbusDiscovery_scan(&map, &empty);
+    reportScan("nothing connected", empty);
+    TEST_ASSERT_EQUAL_UINT16(2 * (DISCOVERY_LAST_ADDRESS - DISCOVERY_FIRST_ADDRESS + 1), empty.probes);
+    TEST_ASSERT_EQUAL_UINT8(0, empty.found);
+    TEST_ASSERT_TRUE(empty.durationMs >= empty.probes * DISCOVERY_PROBE_TIMEOUT_MS);
+
+    addFactoryCart();
+    ModbusScanStats factory;
+    ModbusDiscovery_scan(&map, &factory);
+    addPzem(NEW_PZEM_ADDR);
+    sensorSlaves->device(0x06) = FakeModbusSlave::Device();
+    ModbusScanStats replaced;
+    ModbusDiscovery_scan(&map, &replaced);
+
+    char line[160];
+    snprintf(line, sizeof(line), "scan at %d baud: factory cart %lu ms, replaced meter at 0x%02X %lu ms, nothing connected %lu ms",
+             SENSOR_BUS_BAUD, (unsigned long)factory.durationMs, NEW_PZEM_ADDR, (unsigned long)replaced.durationMs,
+             (unsigned long)empty.durationMs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(factory.durationMs < empty.durationMs);
+    TEST_ASSERT_TRUE(replaced.durationMs > factory.durationMs);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_factory_cart_stops_after_the_es35);
+    RUN_TEST(test_identify_tells_the_devices_apart);
+    RUN_TEST(test_replaced_meter_fills_the_only_silent_socket);
+    RUN_TEST(test_no_silent_socket_leaves_a_stray_meter_unmapped);
+    RUN_TEST(test_two_silent_sockets_adopt_nothing);
+    RUN_TEST(test_es35_and_leak_sensor_are_relocated);
+    RUN_TEST(test_init_scans_once_and_then_uses_the_saved_map);
+    RUN_TEST(test_benchmark_scan_time);
+    return UNITY_END();
+}
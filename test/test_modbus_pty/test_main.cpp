@@ -0,0 +1,215 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the RS485 master's frame assembly and timeout handling over a pseudo-terminal:
+ *        split and truncated frames, early stop on exceptions, stale bytes, timeouts and RX-idle
+ *        wakeups instead of polling, and the MD0630T01A block read (pio test -e native -f test_modbus_pty).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include "RS485_Bus.h"
+#include "MD0630T01A_LeakSensor.h"
+#include "FakeModbusSlave.h"
+
+#define SLAVE_ADDR 0x05       // Simulated slave that answers
+#define SILENT_ADDR 0x0B      // Address nobody answers
+#define LEAK_ADDR 0x01        // Simulated MD0630T01A
+#define READ_REGS 10          // Registers of a normal read (25-byte response)
+#define LONG_READ_REGS 125    // Largest read: 255-byte response, more than the RX FIFO threshold
+#define PROBE_TIMEOUT_MS 500  // Long fixed timeout: a frame that ends early must not wait for it
+
+static Rs485Bus *bus;
+static HardwareSerial *uart;
+static FakeModbusSlave *slaves;
+
+void setUp(void)
+{
+    const FakePty pty = FakePty_open();
+    TEST_ASSERT_TRUE(pty.wire >= 0 && pty.uart >= 0);
+    uart = new HardwareSerial(1);
+    uart->fakeAttach(pty.uart);
+    slaves = new FakeModbusSlave(pty.wire, SENSOR_BUS_BAUD);
+    FakeModbusSlave::Device &dev = slaves->device(SLAVE_ADDR);
+    dev.present = true;
+    for (uint16_t reg = 0; reg < LONG_READ_REGS; reg++)
+    {
+        dev.registers[reg] = (uint16_t)(0x1000 + reg);
+    }
+    FakeModbusSlave::Device &leak = slaves->device(LEAK_ADDR);
+    leak.present = true;
+    leak.registers[REG_DC_CURRENT] = 12;       // 1.2 mA
+    leak.registers[REG_AC_CURRENT] = 0x0123;   // 29.1 mA: both bytes in use
+    leak.registers[REG_DC_THRESHOLD] = 300;    // 30.0 mA
+    leak.registers[REG_AC_THRESHOLD] = 0x0BB8; // 300.0 mA
+    bus = new Rs485Bus();
+    RS485Bus_init(bus, "pty", uart, SENSOR_BUS_BAUD, -1, -1);
+}
+
+void tearDown(void) {}
+
+// Read through the bus with a fixed timeout; @p elapsedMs receives the time the call took
+static Rs485Status probe(uint8_t slave, uint16_t count, uint16_t timeoutMs, uint32_t *elapsedMs)
+{
+    static uint8_t data[2 * LONG_READ_REGS];
+    const uint32_t start = millis();
+    const Rs485Status status = RS485Bus_probeRegisters(bus, slave, MODBUS_FC_READ_HOLDING, 0, count, timeoutMs,
+                                                       "test", data);
+    *elapsedMs = millis() - start;
+    return status;
+}
+
+// CPU time the bus worker has used so far (us)
+static uint64_t workerCpuUs(void)
+{
+    timespec ts;
+    clock_gettime(bus->worker->cpuClock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+void test_complete_frame_takes_one_rx_wakeup(void)
+{
+    uint32_t elapsedMs;
+    TEST_ASSERT_EQUAL_INT(RS485_OK, probe(SLAVE_ADDR, READ_REGS, PROBE_TIMEOUT_MS, &elapsedMs));
+    const uint32_t wakeups = bus->worker->wakeups.load();
+    TEST_ASSERT_EQUAL_INT(RS485_OK, probe(SLAVE_ADDR, READ_REGS, PROBE_TIMEOUT_MS, &elapsedMs));
+    // One to clear stale RX events before sending, one at RX idle after the last byte
+    TEST_ASSERT_EQUAL_UINT32(2, bus->worker->wakeups.load() - wakeups);
+    TEST_ASSERT_LESS_THAN_UINT32(100, elapsedMs);
+}
+
+void test_gap_shorter_than_t35_keeps_one_frame(void)
+{
+    slaves->device(SLAVE_ADDR).splitGapUs = 2000; // Below t3.5 (4011 us) and the RX idle time
+    uint32_t elapsedMs;
+    TEST_ASSERT_EQUAL_INT(RS485_OK, probe(SLAVE_ADDR, READ_REGS, PROBE_TIMEOUT_MS, &elapsedMs));
+}
+
+void test_gap_longer_than_t35_ends_the_frame(void)
+{
+    slaves->device(SLAVE_ADDR).splitGapUs = 30000;
+    uint32_t elapsedMs;
+    const Rs485Status status = probe(SLAVE_ADDR, READ_REGS, PROBE_TIMEOUT_MS, &elapsedMs);
+    TEST_ASSERT_TRUE(status == RS485_CRC_ERROR || status == RS485_FRAME_ERROR); // First half only
+    TEST_ASSERT_LESS_THAN_UINT32(PROBE_TIMEOUT_MS / 4, elapsedMs);
+}
+
+void test_stale_bytes_are_dropped_before_the_next_request(void)
+{
+    FakeModbusSlave::Device &dev = slaves->device(SLAVE_ADDR);
+    dev.splitGapUs = 30000;
+    uint32_t elapsedMs;
+    TEST_ASSERT_NOT_EQUAL(RS485_OK, probe(SLAVE_ADDR, READ_REGS, PROBE_TIMEOUT_MS, &elapsedMs));
+    dev.splitGapUs = 0;
+    delay(60); // The second half arrives after the transaction ended
+    TEST_ASSERT_GREATER_THAN(0, uart->available());
+    TEST_ASSERT_EQUAL_INT(RS485_OK, probe(SLAVE_ADDR, READ_REGS, PROBE_TIMEOUT_MS, &elapsedMs));
+    TEST_ASSERT_EQUAL_INT(0, uart->available());
+}
+
+void test_truncated_frame_is_a_crc_error_without_waiting_for_the_timeout(void)
+{
+    slaves->device(SLAVE_ADDR).truncateNext = 1;
+    uint32_t elapsedMs;
+    TEST_ASSERT_EQUAL_INT(RS485_CRC_ERROR, probe(SLAVE_ADDR, READ_REGS, PROBE_TIMEOUT_MS, &elapsedMs));
+    TEST_ASSERT_LESS_THAN_UINT32(PROBE_TIMEOUT_MS / 4, elapsedMs);
+    TEST_ASSERT_EQUAL_UINT32(1, bus->telemetry[SLAVE_ADDR].crcErrors);
+}
+
+void test_exception_frame_stops_reception_early(void)
+{
+    slaves->device(SLAVE_ADDR).exception = 0x02;
+    uint32_t elapsedMs;
+    const uint32_t wakeups = bus->worker->wakeups.load();
+    TEST_ASSERT_EQUAL_INT(RS485_EXCEPTION, probe(SLAVE_ADDR, READ_REGS, PROBE_TIMEOUT_MS, &elapsedMs));
+    // Stops at the 5-byte exception frame instead of waiting t3.5 of silence for the 25 expected bytes
+    TEST_ASSERT_EQUAL_UINT32(2, bus->worker->wakeups.load() - wakeups);
+    TEST_ASSERT_LESS_THAN_UINT32(PROBE_TIMEOUT_MS / 4, elapsedMs);
+    TEST_ASSERT_EQUAL_UINT32(1, bus->telemetry[SLAVE_ADDR].exceptionCodes[0x02]);
+}
+
+void test_silent_slave_times_out_without_polling(void)
+{
+    const uint16_t timeoutMs = 40;
+    uint32_t elapsedMs;
+    TEST_ASSERT_EQUAL_INT(RS485_OK, probe(SLAVE_ADDR, 1, PROBE_TIMEOUT_MS, &elapsedMs)); // Worker thread is running
+    const uint32_t wakeups = bus->worker->wakeups.load();
+    const uint64_t cpuUs = workerCpuUs();
+    TEST_ASSERT_EQUAL_INT(RS485_TIMEOUT, probe(SILENT_ADDR, READ_REGS, timeoutMs, &elapsedMs));
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(timeoutMs, elapsedMs);
+    TEST_ASSERT_LESS_THAN_UINT32(timeoutMs + 30, elapsedMs); // Request wire time (8.3 ms) + scheduling
+    TEST_ASSERT_EQUAL_UINT32(2, bus->worker->wakeups.load() - wakeups); // Stale-event clear + timeout
+    TEST_ASSERT_LESS_THAN_UINT32(2000, (uint32_t)(workerCpuUs() - cpuUs));
+    TEST_ASSERT_EQUAL_UINT32(1, bus->stats.timeouts);
+}
+
+/**
+ * @brief A 255-byte response takes about 290 ms at 9600 baud. The worker sleeps until the RX FIFO
+ *        fills, then wakes once per t3.5 to check for an early end, and uses a small fraction of
+ *        that time on the CPU.
+ */
+void test_long_frame_leaves_the_cpu_free(void)
+{
+    uint32_t elapsedMs;
+    TEST_ASSERT_EQUAL_INT(RS485_OK, probe(SLAVE_ADDR, 1, PROBE_TIMEOUT_MS, &elapsedMs));
+    const uint32_t wakeups = bus->worker->wakeups.load();
+    const uint64_t cpuUs = workerCpuUs();
+    TEST_ASSERT_EQUAL_INT(RS485_OK, probe(SLAVE_ADDR, LONG_READ_REGS, PROBE_TIMEOUT_MS, &elapsedMs));
+    const uint32_t frameWakeups = bus->worker->wakeups.load() - wakeups;
+    const uint32_t busyUs = (uint32_t)(workerCpuUs() - cpuUs);
+
+    char line[128];
+    snprintf(line, sizeof(line), "255-byte response: %lu ms on the wire, %lu wakeups, %lu us worker CPU time",
+             (unsigned long)elapsedMs, (unsigned long)frameWakeups, (unsigned long)busyUs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(ModbusRtu_readResponseLen(LONG_READ_REGS) * bus->charTimeUs / 1000, elapsedMs);
+    // Asleep until the RX FIFO fills, then one silence check per t3.5 while the rest streams in
+    const uint32_t streamingUs = (ModbusRtu_readResponseLen(LONG_READ_REGS) - FAKE_UART_FIFO) * bus->charTimeUs;
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(streamingUs / bus->interFrameGapUs + 6, frameWakeups);
+    TEST_ASSERT_LESS_THAN_UINT32(elapsedMs * 1000 / 20, busyUs); // Below 5 % of the transaction
+}
+
+void test_leak_block_read_is_one_transaction(void)
+{
+    LeakSensor sensor = {bus, LEAK_ADDR, {}};
+    Breaker_init(&sensor.breaker);
+    LeakSensorData data = {};
+    slaves->clearLog();
+    TEST_ASSERT_TRUE(MD0630T01A_readAll(&sensor, &data));
+    TEST_ASSERT_TRUE(data.valid);
+    TEST_ASSERT_EQUAL_FLOAT(1.2f, data.dcCurrent);
+    TEST_ASSERT_EQUAL_FLOAT(29.1f, data.acCurrent);
+    TEST_ASSERT_EQUAL_UINT16(0x0123, data.acCurrentRaw);
+    TEST_ASSERT_EQUAL_FLOAT(30.0f, data.dcThreshold);
+    TEST_ASSERT_EQUAL_FLOAT(300.0f, data.acThreshold);
+
+    const std::vector<FakeModbusSlave::Exchange> log = slaves->exchanges();
+    TEST_ASSERT_EQUAL_UINT32(1, log.size());
+    TEST_ASSERT_EQUAL_UINT8(LEAK_ADDR, log[0].slave);
+    TEST_ASSERT_EQUAL_UINT8(LEAK_CMD_READ_INPUT, log[0].function);
+    TEST_ASSERT_EQUAL_UINT16(REG_DC_CURRENT, log[0].start);
+    TEST_ASSERT_EQUAL_UINT32(1, bus->stats.transactions);
+
+    // A failed read clears valid and leaves the last values in place
+    sensor.slave = SILENT_ADDR;
+    TEST_ASSERT_FALSE(MD0630T01A_readAll(&sensor, &data));
+    TEST_ASSERT_FALSE(data.valid);
+    TEST_ASSERT_EQUAL_FLOAT(29.1f, data.acCurrent);
+    TEST_ASSERT_EQUAL_UINT16(0x0123, data.acCurrentRaw);
+    TEST_ASSERT_EQUAL_UINT32(2, slaves->exchanges().size());
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_complete_frame_takes_one_rx_wakeup);
+    RUN_TEST(test_gap_shorter_than_t35_keeps_one_frame);
+    RUN_TEST(test_gap_longer_than_t35_ends_the_frame);
+    RUN_TEST(test_stale_bytes_are_dropped_before_the_next_request);
+    RUN_TEST(test_truncated_frame_is_a_crc_error_without_waiting_for_the_timeout);
+    RUN_TEST(test_exception_frame_stops_reception_early);
+    RUN_TEST(test_silent_slave_times_out_without_polling);
+    RUN_TEST(test_long_frame_leaves_the_cpu_free);
+    RUN_TEST(test_leak_block_read_is_one_transaction);
+    return UNITY_END();
+}
@@ -0,0 +1,220 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the per-slave Modbus telemetry: latency bucketing at every bucket bound,
+ *        outcome and exception counters, and a micro-benchmark of the per-transaction recording cost
+ *        (pio test -e native -f test_modbus_telemetry).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "ModbusTelemetry.h"
+
+#define BENCH_TRANSACTIONS 4096 // Recorded outcomes replayed by the benchmark
+#define BENCH_ROUNDS 2000       // Replays per benchmark pass
+#define BENCH_SLAVES 16         // Slaves the benchmark spreads its transactions over
+#define MEASURE_READ_US 45000   // A 9600-baud FC 0x04 read of 10 registers on the wire
+
+static SlaveTelemetry t;
+
+void setUp(void)
+{
+    memset(&t, 0, sizeof(t));
+}
+
+void tearDown(void) {}
+
+void test_bucket_bounds_are_inclusive(void)
+{
+    TEST_ASSERT_EQUAL_UINT8(0, Telemetry_bucketOf(0));
+    for (uint8_t b = 0; b < TELEMETRY_LATENCY_BUCKETS - 1; b++)
+    {
+        const uint32_t upperUs = TELEMETRY_BUCKET_UPPER_MS[b] * 1000UL;
+        const uint8_t atBound = Telemetry_bucketOf(upperUs);
+        const uint8_t aboveBound = Telemetry_bucketOf(upperUs + 1);
+        TEST_ASSERT_EQUAL_UINT8(b, atBound);
+        TEST_ASSERT_EQUAL_UINT8(b + 1, aboveBound);
+        if (b > 0)
+        {
+            TEST_ASSERT_TRUE(TELEMETRY_BUCKET_UPPER_MS[b] > TELEMETRY_BUCKET_UPPER_MS[b - 1]); // Bounds ascend
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT8(TELEMETRY_LATENCY_BUCKETS - 1, Telemetry_bucketOf(UINT32_MAX)); // Open-ended last bucket
+    TEST_ASSERT_EQUAL_UINT8(4, Telemetry_bucketOf(MEASURE_READ_US)); // A PZEM measurement read: 40..50 ms
+}
+
+void test_answered_transactions_fill_the_histogram(void)
+{
+    Telemetry_record(&t, TELEMETRY_OK, MEASURE_READ_US, 0);
+    Telemetry_record(&t, TELEMETRY_OK, 20000, 0);
+    Telemetry_record(&t, TELEMETRY_CRC_ERROR, 44000, 0);
+    Telemetry_record(&t, TELEMETRY_FRAME_ERROR, 9000, 0);
+    Telemetry_record(&t, TELEMETRY_EXCEPTION, 18000, 0x02);
+    TEST_ASSERT_EQUAL_UINT32(2, t.ok);
+    TEST_ASSERT_EQUAL_UINT32(1, t.crcErrors);
+    TEST_ASSERT_EQUAL_UINT32(1, t.frameErrors);
+    TEST_ASSERT_EQUAL_UINT32(1, t.exceptions);
+    TEST_ASSERT_EQUAL_UINT32(0, t.timeouts);
+
+    static const uint32_t expected[TELEMETRY_LATENCY_BUCKETS] = {1, 2, 0, 0, 2, 0, 0, 0, 0, 0};
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(expected, t.latency, TELEMETRY_LATENCY_BUCKETS);
+    TEST_ASSERT_EQUAL_UINT32(MEASURE_READ_US, t.maxLatencyUs);
+    TEST_ASSERT_EQUAL_UINT32(5, Telemetry_total(&t));
+}
+
+void test_timeouts_are_counted_outside_the_histogram(void)
+{
+    Telemetry_record(&t, TELEMETRY_OK, 12000, 0);
+    Telemetry_record(&t, TELEMETRY_TIMEOUT, 100000, 0); // Bus time of a timeout is the timeout itself
+    Telemetry_record(&t, TELEMETRY_TIMEOUT, 250000, 0);
+    TEST_ASSERT_EQUAL_UINT32(2, t.timeouts);
+    TEST_ASSERT_EQUAL_UINT32(12000, t.maxLatencyUs);
+    uint32_t histogram = 0;
+    for (int b = 0; b < TELEMETRY_LATENCY_BUCKETS; b++)
+    {
+        histogram += t.latency[b];
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, histogram);
+    TEST_ASSERT_EQUAL_UINT32(1, t.latency[1]);
+    TEST_ASSERT_EQUAL_UINT32(3, Telemetry_total(&t));
+}
+
+void test_exception_codes_are_counted_by_code(void)
+{
+    for (uint8_t code = 0x01; code <= 0x04; code++)
+    {
+        for (uint8_t n = 0; n < code; n++)
+        {
+            Telemetry_record(&t, TELEMETRY_EXCEPTION, 15000, code);
+        }
+    }
+    Telemetry_record(&t, TELEMETRY_EXCEPTION, 15000, 0x0B); // Gateway target failed: "other"
+    Telemetry_record(&t, TELEMETRY_EXCEPTION, 15000, 0x00);
+    Telemetry_record(&t, TELEMETRY_OK, 15000, 0x03);        // The code is ignored for other outcomes
+
+    static const uint32_t expected[TELEMETRY_EXCEPTION_CODES] = {2, 1, 2, 3, 4};
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(expected, t.exceptionCodes, TELEMETRY_EXCEPTION_CODES);
+    TEST_ASSERT_EQUAL_UINT32(12, t.exceptions);
+    TEST_ASSERT_EQUAL_UINT32(13, t.latency[1]);
+}
+
+void test_rejected_responses_are_not_transactions(void)
+{
+    Telemetry_record(&t, TELEMETRY_OK, 30000, 0);
+    Telemetry_recordRejected(&t); // The same response, failing the driver's range check
+    TEST_ASSERT_EQUAL_UINT32(1, t.rejected);
+    TEST_ASSERT_EQUAL_UINT32(1, t.ok);
+    TEST_ASSERT_EQUAL_UINT32(1, Telemetry_total(&t));
+}
+
+/**
+ * @brief A recorded transaction of the benchmark.
+ */
+typedef struct
+{
+    uint8_t slave;
+    uint8_t outcome;
+    uint8_t exceptionCode;
+    uint32_t busTimeUs;
+} BenchTransaction;
+
+static BenchTransaction benchTransactions[BENCH_TRANSACTIONS];
+static SlaveTelemetry benchTelemetry[BENCH_SLAVES];
+
+static uint32_t rngState = 0x2545F491u;
+
+static uint32_t nextRandom(void)
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+/**
+ * @brief Nanoseconds per transaction over BENCH_ROUNDS replays of benchTransactions: Telemetry_record()
+ *        when @p record is true, otherwise only the single counter the bus stats keep per transaction.
+ */
+static double nsPerTransaction(bool record, volatile uint32_t *sink)
+{
+    memset(benchTelemetry, 0, sizeof(benchTelemetry));
+    uint32_t counted = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (size_t i = 0; i < BENCH_TRANSACTIONS; i++)
+        {
+            const BenchTransaction &txn = benchTransactions[i];
+            if (record)
+            {
+                Telemetry_record(&benchTelemetry[txn.slave], (TelemetryOutcome)txn.outcome, txn.busTimeUs, txn.exceptionCode);
+            }
+            else
+            {
+                counted += txn.busTimeUs != 0;
+            }
+        }
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    for (int s = 0; s < BENCH_SLAVES; s++)
+    {
+        counted += Telemetry_total(&benchTelemetry[s]) + benchTelemetry[s].latency[4];
+    }
+    *sink = counted;
+    return ns / ((double)BENCH_ROUNDS * BENCH_TRANSACTIONS);
+}
+
+/**
+ * @brief Recording cost per transaction, against a bare counter and against the bus time of the
+ *        transaction it describes.
+ */
+void test_benchmark_recording_overhead(void)
+{
+    for (size_t i = 0; i < BENCH_TRANSACTIONS; i++)
+    {
+        BenchTransaction &txn = benchTransactions[i];
+        const uint32_t r = nextRandom();
+        txn.slave = (uint8_t)(r % BENCH_SLAVES);
+        const uint32_t kind = (r >> 8) % 100; // Mostly answered, a few errors and timeouts
+        txn.outcome = kind < 90 ? TELEMETRY_OK
+                      : kind < 94 ? TELEMETRY_TIMEOUT
+                      : kind < 96 ? TELEMETRY_CRC_ERROR
+                      : kind < 98 ? TELEMETRY_FRAME_ERROR
+                                  : TELEMETRY_EXCEPTION;
+        txn.exceptionCode = (uint8_t)((r >> 16) % 6);
+        txn.busTimeUs = 8000 + (r >> 20) % 160000; // Across every bucket
+    }
+
+    volatile uint32_t sink;
+    nsPerTransaction(true, &sink); // Warm up
+    double recordNs = 1e9;
+    double counterNs = 1e9;
+    for (int pass = 0; pass < 3; pass++) // Best of 3 against scheduler noise
+    {
+        const double r = nsPerTransaction(true, &sink);
+        const double c = nsPerTransaction(false, &sink);
+        recordNs = r < recordNs ? r : recordNs;
+        counterNs = c < counterNs ? c : counterNs;
+    }
+    char line[160];
+    snprintf(line, sizeof(line), "host: Telemetry_record %.2f ns/transaction (bare counter %.2f ns), %.5f%% of a %d ms read",
+             recordNs, counterNs, 100.0 * recordNs / (MEASURE_READ_US * 1000.0), MEASURE_READ_US / 1000);
+    TEST_MESSAGE(line);
+    // Lenient: the point is the order of magnitude against milliseconds of bus time
+    TEST_ASSERT_TRUE(recordNs < 1000.0);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bucket_bounds_are_inclusive);
+    RUN_TEST(test_answered_transactions_fill_the_histogram);
+    RUN_TEST(test_timeouts_are_counted_outside_the_histogram);
+    RUN_TEST(test_exception_codes_are_counted_by_code);
+    RUN_TEST(test_rejected_responses_are_not_transactions);
+    RUN_TEST(test_benchmark_recording_overhead);
+    return UNITY_END();
+}
@@ -0,0 +1,464 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the MQTT connection manager: backoff and jitter against a fake client, then
+ *        connection, session resumption and a broker outage against a local mosquitto
+ *        (pio test -e native -f test_mqtt_session).
+ * @date 2026-10-17
+ * @license MIT
+ *
+ * @details The mosquitto tests start `mosquitto -p <port>` from PATH (or $MOSQUITTO) on a private
+ *          port and kill it to simulate an outage. They are ignored when mosquitto is not
+ *          installed.
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <thread>
+#include "MqttSession.h"
+
+// PubSubClient state codes reported by the host client
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+#define SOCKET_TIMEOUT_S 3   // Same bound as MQTT_SOCKET_TIMEOUT_S on the target
+#define ATTEMPT_LOG_MAX 64   // Connect attempts recorded per test
+
+static const uint8_t DEVICE_MAC[6] = {0x24, 0x6F, 0x28, 0xAB, 0xCD, 0xEF};
+
+static MqttSession session;
+static uint32_t attemptLog[ATTEMPT_LOG_MAX]; // Clock value of every connect attempt
+static size_t attemptCount;
+
+// ========== Fake clock ==========
+// Steady time plus a skew the tests add to jump over backoff periods without sleeping
+
+static const auto clockOrigin = std::chrono::steady_clock::now();
+static uint32_t clockSkewMs;
+
+static uint32_t testMillis(void)
+{
+    const auto elapsed = std::chrono::steady_clock::now() - clockOrigin;
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() + clockSkewMs;
+}
+
+static uint32_t randomResult; // 0 = shortest jitter, UINT32_MAX = longest
+
+static uint32_t testRandom(uint32_t bound)
+{
+    return randomResult < bound ? randomResult : bound - 1;
+}
+
+static void logAttempt(void)
+{
+    if (attemptCount < ATTEMPT_LOG_MAX)
+    {
+        attemptLog[attemptCount] = testMillis();
+    }
+    attemptCount++;
+}
+
+// ========== Fake client ==========
+
+static bool fakeIsConnected;
+static bool fakeAccept;           // Result of the next connect attempts
+static uint32_t fakeConnectCostMs; // Time a connect attempt takes
+static uint32_t fakeLoops;
+static char fakeLastClientId[32];
+
+static bool fakeConnected(void) { return fakeIsConnected; }
+static int fakeState(void) { return fakeIsConnected ? MQTT_CONNECTED : MQTT_CONNECT_FAILED; }
+static void fakeLoop(void) { fakeLoops++; }
+
+static bool fakeConnect(const char *clientId)
+{
+    logAttempt();
+    snprintf(fakeLastClientId, sizeof(fakeLastClientId), "%s", clientId);
+    clockSkewMs += fakeConnectCostMs;
+    fakeIsConnected = fakeAccept;
+    return fakeAccept;
+}
+
+static const MqttSessionDriver fakeDriver = {fakeConnected, fakeConnect, fakeState, fakeLoop, testMillis, testRandom};
+
+// ========== Host MQTT 3.1.1 client on a TCP socket ==========
+
+static int brokerPort;
+static int clientFd = -1;
+static int clientState = MQTT_DISCONNECTED;
+static bool sessionPresent; // CONNACK flag of the last successful connect
+
+static void hostClose(int state)
+{
+    if (clientFd >= 0)
+    {
+        close(clientFd);
+        clientFd = -1;
+    }
+    clientState = state;
+}
+
+static bool hostConnected(void) { return clientFd >= 0; }
+static int hostState(void) { return clientState; }
+
+static bool hostConnect(const char *clientId)
+{
+    logAttempt();
+    clientFd = socket(AF_INET, SOCK_STREAM, 0);
+    const timeval timeout = {SOCKET_TIMEOUT_S, 0};
+    setsockopt(clientFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(clientFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)brokerPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(clientFd, (const sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        hostClose(MQTT_CONNECT_FAILED);
+        return false;
+    }
+
+    // CONNECT: protocol level 4, cleanSession = 0, keep alive 15 s, clientId only
+    const size_t idLen = strlen(clientId);
+    uint8_t packet[64] = {0x10, (uint8_t)(12 + idLen), 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0x00, 0x00, 15,
+                          (uint8_t)(idLen >> 8), (uint8_t)idLen};
+    memcpy(&packet[14], clientId, idLen);
+    uint8_t ack[4];
+    if (send(clientFd, packet, 14 + idLen, MSG_NOSIGNAL) != (ssize_t)(14 + idLen) ||
+        recv(clientFd, ack, sizeof(ack), MSG_WAITALL) != (ssize_t)sizeof(ack))
+    {
+        hostClose((errno == EAGAIN || errno == EWOULDBLOCK) ? MQTT_CONNECTION_TIMEOUT : MQTT_CONNECT_FAILED);
+        return false;
+    }
+    if (ack[0] != 0x20 || ack[1] != 0x02 || ack[3] != 0)
+    {
+        hostClose(ack[0] == 0x20 ? ack[3] : MQTT_CONNECT_FAILED); // Broker refusal code, like PubSubClient
+        return false;
+    }
+    sessionPresent = (ack[2] & 0x01) != 0;
+    clientState = MQTT_CONNECTED;
+    return true;
+}
+
+/**
+ * @brief Notice a connection closed by the broker, like PubSubClient::loop().
+ */
+static void hostLoop(void)
+{
+    pollfd pfd = {clientFd, POLLIN, 0};
+    if (poll(&pfd, 1, 0) > 0)
+    {
+        uint8_t buffer[64];
+        const ssize_t n = recv(clientFd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            hostClose(MQTT_CONNECTION_LOST);
+        }
+    }
+}
+
+static const MqttSessionDriver hostDriver = {hostConnected, hostConnect, hostState, hostLoop, testMillis, testRandom};
+
+// ========== Local mosquitto ==========
+
+static pid_t brokerPid = -1;
+
+static bool brokerAccepts(void)
+{
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)brokerPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const bool ok = connect(fd, (const sockaddr *)&addr, sizeof(addr)) == 0;
+    close(fd);
+    return ok;
+}
+
+static void stopBroker(void)
+{
+    if (brokerPid > 0)
+    {
+        kill(brokerPid, SIGTERM);
+        waitpid(brokerPid, NULL, 0);
+        brokerPid = -1;
+    }
+}
+
+/**
+ * @brief Start mosquitto on brokerPort and wait until it accepts connections.
+ * @return false if mosquitto could not be started.
+ */
+static bool startBroker(void)
+{
+    const char *binary = getenv("MOSQUITTO") != NULL ? getenv("MOSQUITTO") : "mosquitto";
+    char port[8];
+    snprintf(port, sizeof(port), "%d", brokerPort);
+
+    brokerPid = fork();
+    if (brokerPid == 0)
+    {
+        const int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        execlp(binary, binary, "-p", port, (char *)NULL);
+        _exit(127);
+    }
+
+    for (int i = 0; i < 100; i++)
+    {
+        if (brokerAccepts())
+        {
+            return true;
+        }
+        if (waitpid(brokerPid, NULL, WNOHANG) == brokerPid)
+        {
+            brokerPid = -1; // Not installed, or the port is taken
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    stopBroker();
+    return false;
+}
+
+#define REQUIRE_BROKER()                                                        \
+    do                                                                          \
+    {                                                                           \
+        if (!startBroker())                                                     \
+        {                                                                       \
+            TEST_IGNORE_MESSAGE("mosquitto not found on PATH (set $MOSQUITTO)"); \
+        }                                                                       \
+    } while (0)
+
+/**
+ * @brief Tick every @p stepMs of fake time until connected or @p limit ticks; returns the tick count.
+ */
+static int tickUntilConnected(uint32_t stepMs, int limit)
+{
+    int ticks = 0;
+    while (!MqttSession_tick(&session) && ticks < limit)
+    {
+        clockSkewMs += stepMs;
+        ticks++;
+    }
+    return ticks;
+}
+
+void setUp(void)
+{
+    clockSkewMs = 0;
+    randomResult = 0;
+    attemptCount = 0;
+    fakeIsConnected = false;
+    fakeAccept = false;
+    fakeConnectCostMs = 0;
+    fakeLoops = 0;
+    sessionPresent = false;
+    brokerPort = 18830 + (int)(getpid() % 1000);
+}
+
+void tearDown(void)
+{
+    hostClose(MQTT_DISCONNECTED);
+    stopBroker();
+}
+
+// ========== Fake client ==========
+
+void test_client_id_is_derived_from_the_mac(void)
+{
+    MqttSession_init(&session, DEVICE_MAC, &fakeDriver);
+    TEST_ASSERT_EQUAL_STRING("ESP32Client-246F28ABCDEF", session.clientId);
+
+    fakeAccept = true;
+    TEST_ASSERT_TRUE(MqttSession_tick(&session));
+    TEST_ASSERT_EQUAL_STRING(session.clientId, fakeLastClientId);
+}
+
+void test_first_tick_attempts_and_records_latency(void)
+{
+    MqttSession_init(&session, DEVICE_MAC, &fakeDriver);
+    fakeAccept = true;
+    fakeConnectCostMs = 240;
+    TEST_ASSERT_TRUE(MqttSession_tick(&session));
+    TEST_ASSERT_EQUAL_UINT32(1, session.stats.attempts);
+    TEST_ASSERT_EQUAL_UINT32(1, session.stats.connects);
+    TEST_ASSERT_UINT32_WITHIN(5, 240, session.stats.lastConnectLatencyMs);
+    TEST_ASSERT_EQUAL_INT(MQTT_CONNECTED, session.stats.lastState);
+
+    // Connected: ticks only service the client
+    for (int i = 0; i < 10; i++)
+    {
+        TEST_ASSERT_TRUE(MqttSession_tick(&session));
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, session.stats.attempts);
+    TEST_ASSERT_EQUAL_UINT32(10, fakeLoops);
+}
+
+void test_at_most_one_attempt_per_tick_within_the_backoff(void)
+{
+    MqttSession_init(&session, DEVICE_MAC, &fakeDriver);
+    TEST_ASSERT_FALSE(MqttSession_tick(&session));
+    for (int i = 0; i < 1000; i++)
+    {
+        TEST_ASSERT_FALSE(MqttSession_tick(&session)); // No time passed: still backing off
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, session.stats.attempts);
+    TEST_ASSERT_EQUAL_UINT32(1, session.stats.failures);
+    TEST_ASSERT_EQUAL_INT(MQTT_CONNECT_FAILED, session.stats.lastState);
+}
+
+/**
+ * @brief Run failing attempts with the given jitter and check the delay before each one.
+ */
+static void checkBackoffSequence(uint32_t jitter, const uint32_t *expectedWaits, size_t count)
+{
+    randomResult = jitter;
+    MqttSession_init(&session, DEVICE_MAC, &fakeDriver);
+    MqttSession_tick(&session);
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint32_t failedAt = attemptLog[attemptCount - 1];
+        const uint32_t before = session.stats.attempts;
+        clockSkewMs += expectedWaits[i] - 10;
+        MqttSession_tick(&session);
+        TEST_ASSERT_EQUAL_UINT32(before, session.stats.attempts);
+        clockSkewMs += 10;
+        MqttSession_tick(&session);
+        TEST_ASSERT_EQUAL_UINT32(before + 1, session.stats.attempts);
+        TEST_ASSERT_UINT32_WITHIN(2, expectedWaits[i], attemptLog[attemptCount - 1] - failedAt);
+    }
+}
+
+void test_backoff_doubles_with_jitter_up_to_the_cap(void)
+{
+    // Wait = backoff/2 + jitter in [0, backoff/2]
+    const uint32_t shortest[] = {500, 1000, 2000, 4000, 8000, 16000, 30000, 30000};
+    const uint32_t longest[] = {1000, 2000, 4000, 8000, 16000, 32000, 60000, 60000};
+    checkBackoffSequence(0, shortest, sizeof(shortest) / sizeof(shortest[0]));
+    checkBackoffSequence(UINT32_MAX, longest, sizeof(longest) / sizeof(longest[0]));
+}
+
+void test_success_resets_the_backoff(void)
+{
+    MqttSession_init(&session, DEVICE_MAC, &fakeDriver);
+    for (int i = 0; i < 5; i++)
+    {
+        MqttSession_tick(&session);
+        clockSkewMs += MQTT_BACKOFF_MAX_MS;
+    }
+    TEST_ASSERT_EQUAL_UINT32(32000, session.backoffMs);
+
+    fakeAccept = true;
+    TEST_ASSERT_TRUE(MqttSession_tick(&session));
+    TEST_ASSERT_EQUAL_UINT32(MQTT_BACKOFF_MIN_MS, session.backoffMs);
+    TEST_ASSERT_EQUAL_UINT32(6, session.stats.attempts);
+    TEST_ASSERT_EQUAL_UINT32(5, session.stats.failures);
+}
+
+// ========== Local mosquitto ==========
+
+void test_mosquitto_connect(void)
+{
+    REQUIRE_BROKER();
+    MqttSession_init(&session, DEVICE_MAC, &hostDriver);
+
+    TEST_ASSERT_TRUE(MqttSession_tick(&session));
+    TEST_ASSERT_EQUAL_UINT32(1, session.stats.connects);
+    TEST_ASSERT_EQUAL_INT(MQTT_CONNECTED, session.stats.lastState);
+    TEST_ASSERT_LESS_THAN_UINT32(SOCKET_TIMEOUT_S * 1000, session.stats.lastConnectLatencyMs);
+
+    char line[96];
+    snprintf(line, sizeof(line), "connect latency to local mosquitto: %lu ms",
+             (unsigned long)session.stats.lastConnectLatencyMs);
+    TEST_MESSAGE(line);
+}
+
+void test_mosquitto_resumes_the_session_of_a_stable_client_id(void)
+{
+    REQUIRE_BROKER();
+    MqttSession_init(&session, DEVICE_MAC, &hostDriver);
+    TEST_ASSERT_TRUE(MqttSession_tick(&session));
+    TEST_ASSERT_FALSE(sessionPresent); // First connection of this clientId
+
+    // Link drop without DISCONNECT: the reconnect finds the broker-side session again
+    hostClose(MQTT_CONNECTION_LOST);
+    TEST_ASSERT_TRUE(MqttSession_tick(&session));
+    TEST_ASSERT_TRUE(sessionPresent);
+    TEST_ASSERT_EQUAL_UINT32(2, session.stats.connects);
+
+    // Another device gets its own session
+    const uint8_t otherMac[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+    hostClose(MQTT_DISCONNECTED);
+    MqttSession_init(&session, otherMac, &hostDriver);
+    TEST_ASSERT_TRUE(MqttSession_tick(&session));
+    TEST_ASSERT_FALSE(sessionPresent);
+}
+
+void test_mosquitto_outage_never_blocks_and_backs_off(void)
+{
+    REQUIRE_BROKER();
+    randomResult = UINT32_MAX;
+    MqttSession_init(&session, DEVICE_MAC, &hostDriver);
+    TEST_ASSERT_TRUE(MqttSession_tick(&session));
+
+    stopBroker();
+
+    // Two minutes of the network task ticking every 100 ms while the broker is down
+    uint32_t slowestTickMs = 0;
+    for (int i = 0; i < 1200; i++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        MqttSession_tick(&session);
+        const auto spent = std::chrono::steady_clock::now() - start;
+        const uint32_t spentMs = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(spent).count();
+        slowestTickMs = spentMs > slowestTickMs ? spentMs : slowestTickMs;
+        clockSkewMs += 100;
+    }
+    TEST_ASSERT_FALSE(hostConnected());
+    TEST_ASSERT_EQUAL_INT(MQTT_CONNECT_FAILED, session.stats.lastState);
+    TEST_ASSERT_LESS_THAN_UINT32(100, slowestTickMs);
+
+    // Longest jitter: failed attempts at 0, 1, 3, 7, 15, 31 and 63 s, the next one due at 123 s
+    TEST_ASSERT_EQUAL_UINT32(1 + 7, session.stats.attempts);
+    TEST_ASSERT_EQUAL_UINT32(7, session.stats.failures);
+
+    // The broker comes back: the session reconnects at the end of the current backoff
+    TEST_ASSERT_TRUE(startBroker());
+    const int ticks = tickUntilConnected(100, 700);
+    TEST_ASSERT_TRUE(MqttSession_tick(&session));
+    TEST_ASSERT_INT_WITHIN(5, 30, ticks);
+    TEST_ASSERT_EQUAL_UINT32(2, session.stats.connects);
+    TEST_ASSERT_EQUAL_UINT32(MQTT_BACKOFF_MIN_MS, session.backoffMs);
+}
+
+int main(void)
+{
+    signal(SIGPIPE, SIG_IGN);
+    UNITY_BEGIN();
+    RUN_TEST(test_client_id_is_derived_from_the_mac);
+    RUN_TEST(test_first_tick_attempts_and_records_latency);
+    RUN_TEST(test_at_most_one_attempt_per_tick_within_the_backoff);
+    RUN_TEST(test_backoff_doubles_with_jitter_up_to_the_cap);
+    RUN_TEST(test_success_resets_the_backoff);
+    RUN_TEST(test_mosquitto_connect);
+    RUN_TEST(test_mosquitto_resumes_the_session_of_a_stable_client_id);
+    RUN_TEST(test_mosquitto_outage_never_blocks_and_backs_off);
+    return UNITY_END();
+}
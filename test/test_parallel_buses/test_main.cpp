@@ -0,0 +1,227 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the two acquisition buses running in parallel: the leak-sensor bus (UART1) and
+ *        the PZEM/ES35-SW bus (UART2) on two simulated serial endpoints. Leak reads must not wait
+ *        behind PZEM reads; utilization and queue depth are reported per bus
+ *        (pio test -e native -f test_parallel_buses).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include <algorithm>
+#include "RS485_Bus.h"
+#include "FakeModbusSlave.h"
+
+#define PZEM_FIRST_ADDR 0x01  // PZEM016T sockets 0x01..0x06 on the sensor bus
+#define PZEM_COUNT 6
+#define PZEM_REGS 10          // One measurement read: input registers 0x0000..0x0009
+#define ES35_ADDR 0x09        // ES35-SW on the sensor bus
+#define ES35_REGS 2
+#define LEAK_ADDR 0x01        // MD0630T01A on its own bus (same address as PZEM 1, different wire)
+#define LEAK_REGS 4           // DC current, AC current, DC threshold, AC threshold
+#define CYCLES 3              // Acquisition cycles per test
+
+static Rs485Bus *sensorBusUnderTest;
+static Rs485Bus *leakBusUnderTest;
+static FakeModbusSlave *sensorSlaves;
+static FakeModbusSlave *leakSlaves;
+
+// One bus on a fresh pseudo-terminal
+static Rs485Bus *openBus(const char *name, int uart, FakeModbusSlave **slaves)
+{
+    const FakePty pty = FakePty_open();
+    TEST_ASSERT_TRUE(pty.wire >= 0 && pty.uart >= 0);
+    HardwareSerial *serial = new HardwareSerial(uart);
+    serial->fakeAttach(pty.uart);
+    *slaves = new FakeModbusSlave(pty.wire, SENSOR_BUS_BAUD);
+    Rs485Bus *bus = new Rs485Bus();
+    RS485Bus_init(bus, name, serial, SENSOR_BUS_BAUD, -1, -1);
+    return bus;
+}
+
+void setUp(void)
+{
+    sensorBusUnderTest = openBus("sensor", 2, &sensorSlaves);
+    leakBusUnderTest = openBus("leak", 1, &leakSlaves);
+    for (uint8_t addr = PZEM_FIRST_ADDR; addr < PZEM_FIRST_ADDR + PZEM_COUNT; addr++)
+    {
+        FakeModbusSlave::Device &dev = sensorSlaves->device(addr);
+        dev.present = true;
+        for (uint16_t reg = 0; reg < PZEM_REGS; reg++)
+        {
+            dev.registers[reg] = (uint16_t)(addr * 0x100 + reg);
+        }
+    }
+    FakeModbusSlave::Device &es35 = sensorSlaves->device(ES35_ADDR);
+    es35.present = true;
+    es35.registers[0] = 235;
+    es35.registers[1] = 612;
+    FakeModbusSlave::Device &leak = leakSlaves->device(LEAK_ADDR);
+    leak.present = true;
+    leak.registers[0] = 0;   // DC current
+    leak.registers[1] = 12;  // AC current, 1.2 mA
+    leak.registers[2] = 300; // DC threshold
+    leak.registers[3] = 30;  // AC threshold
+}
+
+void tearDown(void) {}
+
+// One acquisition cycle of the sensor pipeline: ES35-SW, then the six PZEM sockets
+static void sensorCycle(void)
+{
+    uint8_t data[2 * PZEM_REGS];
+    TEST_ASSERT_EQUAL_INT(RS485_OK, RS485Bus_readRegisters(sensorBusUnderTest, ES35_ADDR, MODBUS_FC_READ_HOLDING, 0,
+                                                            ES35_REGS, "es35.update", data));
+    for (uint8_t addr = PZEM_FIRST_ADDR; addr < PZEM_FIRST_ADDR + PZEM_COUNT; addr++)
+    {
+        TEST_ASSERT_EQUAL_INT(RS485_OK, RS485Bus_readRegisters(sensorBusUnderTest, addr, MODBUS_FC_READ_INPUT, 0,
+                                                                PZEM_REGS, "pzem.measure", data));
+    }
+}
+
+static Rs485Status leakRead(uint32_t *latencyUs)
+{
+    uint8_t data[2 * LEAK_REGS];
+    const uint32_t start = micros();
+    const Rs485Status status = RS485Bus_readRegisters(leakBusUnderTest, LEAK_ADDR, MODBUS_FC_READ_INPUT, 0, LEAK_REGS,
+                                                      "leak.read", data);
+    *latencyUs = micros() - start;
+    return status;
+}
+
+/**
+ * @brief The leak pipeline reads while the sensor pipeline is busy with its PZEM cycle. Every leak
+ *        read takes only its own bus round trip; on one shared bus it could wait for a whole cycle.
+ */
+void test_leak_reads_do_not_wait_behind_pzem_reads(void)
+{
+    uint32_t leakOnlyUs;
+    TEST_ASSERT_EQUAL_INT(RS485_OK, leakRead(&leakOnlyUs)); // Round trip of an idle leak bus
+
+    static std::atomic<bool> sensorDone;
+    sensorDone = false;
+    const uint32_t cycleStart = micros();
+    std::thread sensorTask([]()
+                           {
+                               for (int c = 0; c < CYCLES; c++)
+                               {
+                                   sensorCycle();
+                               }
+                               sensorDone = true; });
+
+    std::vector<uint32_t> latencies;
+    while (!sensorDone)
+    {
+        uint32_t latencyUs;
+        TEST_ASSERT_EQUAL_INT(RS485_OK, leakRead(&latencyUs));
+        latencies.push_back(latencyUs);
+    }
+    sensorTask.join();
+    const uint32_t sensorCycleUs = (micros() - cycleStart) / CYCLES;
+
+    std::sort(latencies.begin(), latencies.end());
+    char line[160];
+    snprintf(line, sizeof(line), "leak reads during %d sensor cycles: %u, latency max %lu us (idle %lu us), sensor cycle %lu us",
+             CYCLES, (unsigned)latencies.size(), (unsigned long)latencies.back(), (unsigned long)leakOnlyUs,
+             (unsigned long)sensorCycleUs);
+    TEST_MESSAGE(line);
+
+    // Many leak samples per sensor cycle, each about as long as on an idle bus
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(CYCLES * PZEM_COUNT, latencies.size());
+    TEST_ASSERT_LESS_THAN_UINT32(2 * leakOnlyUs + 10000, latencies.back());
+    TEST_ASSERT_LESS_THAN_UINT32(sensorCycleUs / 4, latencies.back());
+
+    // The two endpoints were really on the wire at the same time
+    const std::vector<FakeModbusSlave::Exchange> sensorLog = sensorSlaves->exchanges();
+    const std::vector<FakeModbusSlave::Exchange> leakLog = leakSlaves->exchanges();
+    TEST_ASSERT_EQUAL_UINT32(CYCLES * (PZEM_COUNT + 1), sensorLog.size());
+    int overlapping = 0;
+    for (const FakeModbusSlave::Exchange &leak : leakLog)
+    {
+        for (const FakeModbusSlave::Exchange &sensor : sensorLog)
+        {
+            if ((int32_t)(leak.requestUs - sensor.requestUs) > 0 && (int32_t)(sensor.responseEndUs - leak.requestUs) > 0)
+            {
+                overlapping++; // Leak request on the wire while a PZEM/ES35 response was in flight
+                break;
+            }
+        }
+    }
+    TEST_ASSERT_GREATER_THAN(0, overlapping);
+}
+
+/**
+ * @brief Both buses fed at once through the async API: each bus keeps its own queue, so a burst of
+ *        PZEM reads does not hold up the leak queue. Reports utilization and queue depth per bus.
+ */
+void test_utilization_and_queue_depth_per_bus(void)
+{
+    static uint8_t requests[PZEM_COUNT + 1][MODBUS_RTU_READ_REQUEST_LEN];
+    static uint8_t responses[PZEM_COUNT + 1][RS485_MAX_FRAME];
+    static Rs485Transaction txns[PZEM_COUNT + 1];
+    static std::atomic<int> done;
+    done = 0;
+    Rs485Callback countDone = [](Rs485Transaction *, void *)
+    { done++; };
+
+    const uint32_t startMs = millis();
+    for (int i = 0; i <= PZEM_COUNT; i++)
+    {
+        const bool isLeak = i == PZEM_COUNT;
+        const uint8_t slave = isLeak ? LEAK_ADDR : (uint8_t)(PZEM_FIRST_ADDR + i);
+        const uint16_t count = isLeak ? LEAK_REGS : PZEM_REGS;
+        txns[i] = {};
+        txns[i].slave = slave;
+        txns[i].purpose = isLeak ? "leak.read" : "pzem.measure";
+        txns[i].request = requests[i];
+        txns[i].requestLen = (uint16_t)ModbusRtu_buildReadRequest(requests[i], sizeof(requests[i]), slave,
+                                                                  MODBUS_FC_READ_INPUT, 0, count);
+        txns[i].response = responses[i];
+        txns[i].responseCap = RS485_MAX_FRAME;
+        txns[i].expectedLen = ModbusRtu_readResponseLen(count);
+        txns[i].onComplete = countDone;
+        TEST_ASSERT_TRUE(RS485Bus_submit(isLeak ? leakBusUnderTest : sensorBusUnderTest, &txns[i]));
+    }
+    const uint32_t sensorDepth = RS485Bus_queueDepth(sensorBusUnderTest);
+    const uint32_t leakDepth = RS485Bus_queueDepth(leakBusUnderTest);
+
+    // The leak read completes first although it was queued last
+    for (int i = 0; i < 500 && txns[PZEM_COUNT].status == RS485_PENDING; i++)
+    {
+        delay(1);
+    }
+    TEST_ASSERT_EQUAL_INT(RS485_OK, txns[PZEM_COUNT].status);
+    TEST_ASSERT_TRUE(RS485Bus_queueDepth(sensorBusUnderTest) > 0);
+
+    for (int i = 0; i < 2000 && done.load() < PZEM_COUNT + 1; i++)
+    {
+        delay(1);
+    }
+    TEST_ASSERT_EQUAL_INT(PZEM_COUNT + 1, done.load());
+    const uint32_t windowMs = millis() - startMs;
+
+    const Rs485BusStats &sensor = sensorBusUnderTest->stats;
+    const Rs485BusStats &leak = leakBusUnderTest->stats;
+    char line[160];
+    snprintf(line, sizeof(line), "window %lu ms | sensor util %.1f%% queue %lu (max %lu) | leak util %.1f%% queue %lu (max %lu)",
+             (unsigned long)windowMs, sensor.busTimeUs / (windowMs * 10.0f), (unsigned long)sensorDepth,
+             (unsigned long)sensor.queueHighWater, leak.busTimeUs / (windowMs * 10.0f), (unsigned long)leakDepth,
+             (unsigned long)leak.queueHighWater);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(PZEM_COUNT - 1, sensor.queueHighWater); // One may already be on the wire
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(1, leak.queueHighWater);
+    TEST_ASSERT_EQUAL_UINT32(PZEM_COUNT, sensor.transactions);
+    TEST_ASSERT_EQUAL_UINT32(1, leak.transactions);
+    TEST_ASSERT_TRUE(sensor.busTimeUs > 4 * leak.busTimeUs);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(windowMs * 1000, sensor.busTimeUs); // Utilization <= 100 %
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_leak_reads_do_not_wait_behind_pzem_reads);
+    RUN_TEST(test_utilization_and_queue_depth_per_bus);
+    return UNITY_END();
+}
@@ -0,0 +1,210 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the PZEM016T measurement read: decoding of a known register block, one FC 0x04
+ *        transaction per socket on a simulated bus, and its cost against one read per quantity
+ *        (pio test -e native -f test_pzem_read).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "PZEM016_Lib.h"
+#include "RS485_Bus.h"
+#include "FakeModbusSlave.h"
+
+#define PZEM_ADDR 0x03  // Socket under test
+#define DEAD_ADDR 0x05  // Socket whose meter does not answer
+#define PER_QUANTITY 5  // Voltage, current, power, frequency, PF: one read each
+
+// A socket drawing 0.500 A at 230.4 V: 111.0 W, 70196 Wh, 50.0 Hz, PF 0.96, power alarm on
+static const uint16_t knownRegisters[PZEM_REG_COUNT] = {
+    0x0900,         // Voltage 2304 = 230.4 V
+    0x01F4, 0x0000, // Current 500 = 0.500 A (low word first)
+    0x0456, 0x0000, // Power 1110 = 111.0 W
+    0x1234, 0x0001, // Energy 0x00011234 = 70196 Wh
+    0x01F4,         // Frequency 500 = 50.0 Hz
+    0x0060,         // PF 96 = 0.96
+    PZEM_ALARM_ON};
+
+/**
+ * @brief One read per quantity, as a driver with a getter per value (or a wrapper retrying its cache
+ *        from each getter) puts on the wire.
+ */
+static const struct
+{
+    uint16_t start;
+    uint16_t count;
+} perQuantityReads[PER_QUANTITY] = {{0, 1}, {1, 2}, {3, 2}, {7, 1}, {8, 1}};
+
+static FakeModbusSlave *slaves;
+
+// Big-endian data bytes of a register block, as they follow the byte count of a response
+static void toBytes(const uint16_t *regs, uint8_t *bytes)
+{
+    for (int k = 0; k < PZEM_REG_COUNT; k++)
+    {
+        bytes[2 * k] = (uint8_t)(regs[k] >> 8);
+        bytes[2 * k + 1] = (uint8_t)(regs[k] & 0xFF);
+    }
+}
+
+/**
+ * @brief The driver reads through the global sensorBus: attach it once to a simulated bus. Later
+ *        calls only clear the exchange log (RS485Bus_init ignores an initialized bus).
+ */
+static void attachSensorBus(void)
+{
+    if (slaves == NULL)
+    {
+        const FakePty pty = FakePty_open();
+        TEST_ASSERT_TRUE(pty.wire >= 0 && pty.uart >= 0);
+        HardwareSerial *serial = new HardwareSerial(2);
+        serial->fakeAttach(pty.uart);
+        slaves = new FakeModbusSlave(pty.wire, SENSOR_BUS_BAUD);
+        RS485Bus_init(&sensorBus, "sensor", serial, SENSOR_BUS_BAUD, -1, -1);
+
+        FakeModbusSlave::Device &dev = slaves->device(PZEM_ADDR);
+        dev.present = true;
+        for (uint16_t reg = 0; reg < PZEM_REG_COUNT; reg++)
+        {
+            dev.registers[reg] = knownRegisters[reg];
+        }
+    }
+    slaves->clearLog();
+}
+
+void setUp(void)
+{
+    attachSensorBus();
+}
+
+void tearDown(void) {}
+
+void test_decode_known_register_block(void)
+{
+    uint8_t bytes[2 * PZEM_REG_COUNT];
+    toBytes(knownRegisters, bytes);
+    PZEMData data = {};
+    PZEM016_decodeMeasurements(bytes, &data);
+    TEST_ASSERT_EQUAL_INT32(2304, data.voltage.raw);
+    TEST_ASSERT_EQUAL_INT32(500, data.current.raw);
+    TEST_ASSERT_EQUAL_INT32(1110, data.power.raw);
+    TEST_ASSERT_EQUAL_INT32(70196, data.energy.raw);
+    TEST_ASSERT_EQUAL_INT32(500, data.frequency.raw);
+    TEST_ASSERT_EQUAL_INT32(96, data.pf.raw);
+    TEST_ASSERT_TRUE(data.alarm);
+}
+
+void test_decode_puts_the_low_word_first(void)
+{
+    uint16_t regs[PZEM_REG_COUNT];
+    memcpy(regs, knownRegisters, sizeof(regs));
+    regs[1] = 0x86A0; // Current 0x000186A0 = 100.000 A: only right if the high word is the second register
+    regs[2] = 0x0001;
+    regs[3] = 0xFFFF; // Power 0x0001FFFF = 13107.1 W
+    regs[4] = 0x0001;
+    regs[9] = 0x0000; // Alarm off
+    uint8_t bytes[2 * PZEM_REG_COUNT];
+    toBytes(regs, bytes);
+    PZEMData data = {};
+    PZEM016_decodeMeasurements(bytes, &data);
+    TEST_ASSERT_EQUAL_INT32(100000, data.current.raw);
+    TEST_ASSERT_EQUAL_INT32(131071, data.power.raw);
+    TEST_ASSERT_FALSE(data.alarm);
+}
+
+void test_read_is_one_transaction_of_all_registers(void)
+{
+    const uint32_t before = sensorBus.stats.transactions;
+    PZEMData data = {};
+    const bool ok = PZEM016_readMeasurements(PZEM_ADDR, &data);
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_TRUE(data.valid);
+    TEST_ASSERT_EQUAL_INT32(2304, data.voltage.raw);
+    TEST_ASSERT_EQUAL_INT32(500, data.current.raw);
+    TEST_ASSERT_EQUAL_INT32(1110, data.power.raw);
+    TEST_ASSERT_EQUAL_INT32(70196, data.energy.raw);
+    TEST_ASSERT_EQUAL_INT32(500, data.frequency.raw);
+    TEST_ASSERT_EQUAL_INT32(96, data.pf.raw);
+    TEST_ASSERT_TRUE(data.alarm);
+
+    const std::vector<FakeModbusSlave::Exchange> log = slaves->exchanges();
+    TEST_ASSERT_EQUAL_UINT32(1, log.size());
+    TEST_ASSERT_EQUAL_UINT8(PZEM_ADDR, log[0].slave);
+    TEST_ASSERT_EQUAL_UINT8(PZEM_CMD_READ_INPUT, log[0].function);
+    TEST_ASSERT_EQUAL_UINT16(PZEM_REG_START, log[0].start);
+    TEST_ASSERT_EQUAL_UINT32(before + 1, sensorBus.stats.transactions);
+}
+
+void test_dead_socket_costs_one_timeout(void)
+{
+    const uint32_t before = sensorBus.stats.timeouts;
+    PZEMData data = {};
+    data.valid = true;
+    const uint32_t start = millis();
+    const bool ok = PZEM016_readMeasurements(DEAD_ADDR, &data);
+    const uint32_t waitedMs = millis() - start;
+    TEST_ASSERT_FALSE(ok);
+    TEST_ASSERT_FALSE(data.valid);
+    TEST_ASSERT_EQUAL_UINT32(1, slaves->exchanges().size());
+    TEST_ASSERT_EQUAL_UINT32(before + 1, sensorBus.stats.timeouts);
+
+    char line[128];
+    snprintf(line, sizeof(line), "dead socket: 1 timeout, %lu ms (one retry per getter was %d x %d ms)",
+             (unsigned long)waitedMs, PER_QUANTITY, RS485_DEFAULT_TIMEOUT_MS);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_LESS_THAN_UINT32(2 * RS485_DEFAULT_TIMEOUT_MS, waitedMs);
+}
+
+/**
+ * @brief Transactions and bus time of one socket: one 10-register read against one read per quantity.
+ */
+void test_benchmark_one_transaction_against_five(void)
+{
+    PZEMData data = {};
+    uint32_t busBefore = sensorBus.stats.busTimeUs;
+    uint32_t start = micros();
+    TEST_ASSERT_TRUE(PZEM016_readMeasurements(PZEM_ADDR, &data));
+    const uint32_t oneWallUs = micros() - start;
+    const uint32_t oneBusUs = sensorBus.stats.busTimeUs - busBefore;
+    const uint32_t oneTransactions = (uint32_t)slaves->exchanges().size();
+
+    slaves->clearLog();
+    busBefore = sensorBus.stats.busTimeUs;
+    start = micros();
+    for (int q = 0; q < PER_QUANTITY; q++)
+    {
+        uint8_t bytes[4];
+        const Rs485Status status = RS485Bus_readRegisters(&sensorBus, PZEM_ADDR, PZEM_CMD_READ_INPUT, perQuantityReads[q].start,
+                                                          perQuantityReads[q].count, "pzem.quantity", bytes);
+        TEST_ASSERT_EQUAL_INT(RS485_OK, status);
+    }
+    const uint32_t fiveWallUs = micros() - start;
+    const uint32_t fiveBusUs = sensorBus.stats.busTimeUs - busBefore;
+    const uint32_t fiveTransactions = (uint32_t)slaves->exchanges().size();
+
+    char line[224];
+    snprintf(line, sizeof(line), "one socket at %d baud: block read %lu transaction, %lu us on the bus (%lu us wall); "
+                                 "per quantity %lu transactions, %lu us on the bus (%lu us wall)",
+             SENSOR_BUS_BAUD, (unsigned long)oneTransactions, (unsigned long)oneBusUs, (unsigned long)oneWallUs,
+             (unsigned long)fiveTransactions, (unsigned long)fiveBusUs, (unsigned long)fiveWallUs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL_UINT32(1, oneTransactions);
+    TEST_ASSERT_EQUAL_UINT32(PER_QUANTITY, fiveTransactions);
+    // 33 characters once against 79 over five frames, plus a slave turnaround and a t3.5 gap per frame
+    TEST_ASSERT_TRUE(fiveBusUs > 2 * oneBusUs);
+    TEST_ASSERT_TRUE(fiveWallUs > 2 * oneWallUs);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_decode_known_register_block);
+    RUN_TEST(test_decode_puts_the_low_word_first);
+    RUN_TEST(test_read_is_one_transaction_of_all_registers);
+    RUN_TEST(test_dead_socket_costs_one_timeout);
+    RUN_TEST(test_benchmark_one_transaction_against_five);
+    return UNITY_END();
+}
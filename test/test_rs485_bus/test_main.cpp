@@ -0,0 +1,427 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the RS485 bus owner on a simulated bus: t3.5 spacing, serialization of the
+ *        PZEM and ES35-SW drivers, transaction tags, queue overflow, bus counters, the write echo
+ *        check and throughput per baud rate (pio test -e native -f test_rs485_bus).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include <algorithm>
+#include "RS485_Bus.h"
+#include "FakeModbusSlave.h"
+
+#define PZEM_FIRST_ADDR 0x01  // PZEM016T sockets 0x01..0x06
+#define PZEM_COUNT 6
+#define PZEM_REGS 10          // One measurement read: input registers 0x0000..0x0009
+#define ES35_ADDR 0x09        // ES35-SW temperature/humidity sensor
+#define ES35_REGS 2           // Holding registers 0x0000..0x0001
+#define ES35_BAUD_REG 0x0065  // REG_BAUD_RATE of the ES35-SW
+#define ES35_BAUD_19200 3     // Its code for 19200 baud
+#define EMPTY_ADDR 0x03       // Address nobody answers in the timeout tests
+
+static Rs485Bus *bus;
+static FakeModbusSlave *slaves;
+
+/**
+ * @brief Fresh bus and simulated slaves for every test: the old worker stays parked on its own queue.
+ */
+static void openBus(uint32_t baud)
+{
+    const FakePty pty = FakePty_open();
+    TEST_ASSERT_TRUE(pty.wire >= 0 && pty.uart >= 0);
+    HardwareSerial *serial = new HardwareSerial(2);
+    serial->fakeAttach(pty.uart);
+    slaves = new FakeModbusSlave(pty.wire, baud);
+    bus = new Rs485Bus();
+    RS485Bus_init(bus, "test", serial, baud, SENSOR_BUS_RX_PIN, SENSOR_BUS_TX_PIN);
+}
+
+static void addPzems(void)
+{
+    for (uint8_t addr = PZEM_FIRST_ADDR; addr < PZEM_FIRST_ADDR + PZEM_COUNT; addr++)
+    {
+        FakeModbusSlave::Device &dev = slaves->device(addr);
+        dev.present = true;
+        for (uint16_t reg = 0; reg < PZEM_REGS; reg++)
+        {
+            dev.registers[reg] = (uint16_t)(addr * 0x100 + reg);
+        }
+    }
+}
+
+static void addEs35(void)
+{
+    FakeModbusSlave::Device &dev = slaves->device(ES35_ADDR);
+    dev.present = true;
+    dev.registers[0] = 235; // 23.5 °C
+    dev.registers[1] = 612; // 61.2 %RH
+}
+
+void setUp(void)
+{
+    openBus(SENSOR_BUS_BAUD);
+}
+
+void tearDown(void) {}
+
+void test_inter_frame_gap_is_three_and_a_half_characters(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(4011, RS485Bus_interFrameGapUs(9600));  // ceil(3.5 * 11 bits / 9600 baud)
+    TEST_ASSERT_EQUAL_UINT32(2006, RS485Bus_interFrameGapUs(19200));
+    TEST_ASSERT_EQUAL_UINT32(RS485_FIXED_GAP_US, RS485Bus_interFrameGapUs(38400));
+    TEST_ASSERT_EQUAL_UINT32(RS485_FIXED_GAP_US, RS485Bus_interFrameGapUs(115200));
+    TEST_ASSERT_EQUAL_UINT32(4011, bus->interFrameGapUs);
+}
+
+void test_read_round_trip(void)
+{
+    addPzems();
+    uint8_t data[2 * PZEM_REGS];
+    TEST_ASSERT_EQUAL_INT(RS485_OK, RS485Bus_readRegisters(bus, 0x02, MODBUS_FC_READ_INPUT, 0, PZEM_REGS,
+                                                            "pzem.measure", data));
+    for (uint16_t reg = 0; reg < PZEM_REGS; reg++)
+    {
+        TEST_ASSERT_EQUAL_UINT16(0x0200 + reg, (uint16_t)((data[2 * reg] << 8) | data[2 * reg + 1]));
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, bus->stats.transactions);
+    TEST_ASSERT_EQUAL_UINT32(0, bus->stats.failures);
+    TEST_ASSERT_EQUAL_UINT32(1, bus->telemetry[0x02].ok);
+
+    const std::vector<FakeModbusSlave::Exchange> log = slaves->exchanges();
+    TEST_ASSERT_EQUAL_UINT32(1, log.size());
+    TEST_ASSERT_EQUAL_UINT8(0x02, log[0].slave);
+    TEST_ASSERT_EQUAL_UINT8(MODBUS_FC_READ_INPUT, log[0].function);
+}
+
+void test_write_single_register_checks_the_echo(void)
+{
+    addEs35();
+    TEST_ASSERT_EQUAL_INT(RS485_OK, RS485Bus_writeRegister(bus, ES35_ADDR, 0x0001, 600, 0, "es35.config"));
+    TEST_ASSERT_EQUAL_UINT16(600, slaves->device(ES35_ADDR).registers[1]);
+}
+
+/**
+ * @brief A well-formed echo carrying another value fails the write and keeps the bus rate: the
+ *        worker checks the echo before it acts on switchBaud.
+ */
+void test_mismatched_echo_does_not_switch_the_baud_rate(void)
+{
+    addEs35();
+    slaves->device(ES35_ADDR).badEchoNext = 1;
+    const Rs485Status bad = RS485Bus_writeRegister(bus, ES35_ADDR, ES35_BAUD_REG, ES35_BAUD_19200, 19200, "es35.baud");
+    TEST_ASSERT_EQUAL_INT(RS485_FRAME_ERROR, bad);
+    TEST_ASSERT_EQUAL_UINT32(SENSOR_BUS_BAUD, bus->baud);
+    TEST_ASSERT_EQUAL_UINT32(1, bus->stats.failures);
+    TEST_ASSERT_EQUAL_UINT32(1, bus->telemetry[ES35_ADDR].frameErrors);
+
+    const Rs485Status good = RS485Bus_writeRegister(bus, ES35_ADDR, ES35_BAUD_REG, ES35_BAUD_19200, 19200, "es35.baud");
+    TEST_ASSERT_EQUAL_INT(RS485_OK, good);
+    TEST_ASSERT_EQUAL_UINT32(19200, bus->baud); // Applied before the write completed
+    TEST_ASSERT_EQUAL_UINT32(RS485Bus_interFrameGapUs(19200), bus->interFrameGapUs);
+}
+
+/**
+ * @brief The PZEM and ES35-SW drivers poll from two tasks at once: their frames never overlap on
+ *        the wire and every request starts at least t3.5 after the previous response ended.
+ */
+void test_concurrent_drivers_are_serialized_with_the_minimum_gap(void)
+{
+    addPzems();
+    addEs35();
+    const int cycles = 5;
+    static Rs485Status pzemResults[cycles * PZEM_COUNT];
+    static Rs485Status es35Results[cycles * 3];
+
+    std::thread pzemTask([]()
+                         {
+                             uint8_t data[2 * PZEM_REGS];
+                             for (int i = 0; i < cycles * PZEM_COUNT; i++)
+                             {
+                                 pzemResults[i] = RS485Bus_readRegisters(bus, (uint8_t)(PZEM_FIRST_ADDR + i % PZEM_COUNT),
+                                                                         MODBUS_FC_READ_INPUT, 0, PZEM_REGS, "pzem.measure", data);
+                             } });
+    std::thread es35Task([]()
+                         {
+                             uint8_t data[2 * ES35_REGS];
+                             for (int i = 0; i < cycles * 3; i++)
+                             {
+                                 es35Results[i] = RS485Bus_readRegisters(bus, ES35_ADDR, MODBUS_FC_READ_HOLDING, 0, ES35_REGS,
+                                                                         "es35.update", data);
+                             } });
+    pzemTask.join();
+    es35Task.join();
+
+    for (int i = 0; i < cycles * PZEM_COUNT; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(RS485_OK, pzemResults[i]);
+    }
+    for (int i = 0; i < cycles * 3; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(RS485_OK, es35Results[i]);
+    }
+
+    const std::vector<FakeModbusSlave::Exchange> log = slaves->exchanges();
+    TEST_ASSERT_EQUAL_UINT32(cycles * (PZEM_COUNT + 3), log.size());
+    std::vector<uint32_t> spacing;
+    bool sawEs35BetweenPzems = false;
+    for (size_t i = 1; i < log.size(); i++)
+    {
+        // requestUs is the end of the 8-byte request: subtract its wire time
+        const uint32_t requestStartUs = log[i].requestUs - MODBUS_RTU_READ_REQUEST_LEN * bus->charTimeUs;
+        const int32_t silentUs = (int32_t)(requestStartUs - log[i - 1].responseEndUs);
+        TEST_ASSERT_GREATER_OR_EQUAL_INT32((int32_t)bus->interFrameGapUs - 500, silentUs); // 500 us: pty scheduling
+        spacing.push_back((uint32_t)silentUs);
+        sawEs35BetweenPzems |= log[i].slave == ES35_ADDR && i + 1 < log.size() && log[i + 1].slave != ES35_ADDR;
+    }
+    TEST_ASSERT_TRUE(sawEs35BetweenPzems); // Both drivers really shared the bus
+
+    std::sort(spacing.begin(), spacing.end());
+    char line[128];
+    snprintf(line, sizeof(line), "silent time between frames: min %lu us, median %lu us (t3.5 = %lu us, old guard delay 100 ms)",
+             (unsigned long)spacing.front(), (unsigned long)spacing[spacing.size() / 2], (unsigned long)bus->interFrameGapUs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_LESS_THAN_UINT32(20000, spacing[spacing.size() / 2]);
+}
+
+typedef struct
+{
+    uint8_t slave;
+    const char *purpose;
+    Rs485Status status;
+} CompletionRecord;
+
+static CompletionRecord completions[RS485_QUEUE_DEPTH + 4];
+static std::atomic<int> completionCount;
+
+static void recordCompletion(Rs485Transaction *txn, void *ctx)
+{
+    (void)ctx;
+    const int i = completionCount.load();
+    completions[i] = {txn->slave, txn->purpose, txn->status};
+    completionCount.store(i + 1);
+}
+
+static void waitCompletions(int count)
+{
+    for (int i = 0; i < 2000 && completionCount.load() < count; i++)
+    {
+        delay(1);
+    }
+    TEST_ASSERT_EQUAL_INT(count, completionCount.load());
+}
+
+void test_async_transactions_complete_in_order_with_their_tags(void)
+{
+    addPzems();
+    addEs35();
+    static const char *purposes[] = {"pzem.measure", "es35.update", "pzem.energy"};
+    static const uint8_t addrs[] = {0x01, ES35_ADDR, 0x06};
+    static uint8_t requests[3][MODBUS_RTU_READ_REQUEST_LEN];
+    static uint8_t responses[3][RS485_MAX_FRAME];
+    static Rs485Transaction txns[3];
+    completionCount = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        txns[i] = {};
+        txns[i].slave = addrs[i];
+        txns[i].purpose = purposes[i];
+        txns[i].request = requests[i];
+        txns[i].requestLen = (uint16_t)ModbusRtu_buildReadRequest(requests[i], sizeof(requests[i]), addrs[i],
+                                                                  MODBUS_FC_READ_HOLDING, 0, 2);
+        txns[i].response = responses[i];
+        txns[i].responseCap = RS485_MAX_FRAME;
+        txns[i].expectedLen = ModbusRtu_readResponseLen(2);
+        txns[i].onComplete = recordCompletion;
+        TEST_ASSERT_TRUE(RS485Bus_submit(bus, &txns[i]));
+    }
+    waitCompletions(3);
+    for (int i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT8(addrs[i], completions[i].slave);
+        TEST_ASSERT_EQUAL_STRING(purposes[i], completions[i].purpose);
+        TEST_ASSERT_EQUAL_INT(RS485_OK, completions[i].status);
+    }
+}
+
+void test_full_queue_reports_busy(void)
+{
+    // The first transaction waits for a silent slave, the rest pile up behind it
+    static uint8_t request[MODBUS_RTU_READ_REQUEST_LEN];
+    static uint8_t response[RS485_MAX_FRAME];
+    static Rs485Transaction txns[RS485_QUEUE_DEPTH + 2];
+    completionCount = 0;
+    ModbusRtu_buildReadRequest(request, sizeof(request), EMPTY_ADDR, MODBUS_FC_READ_INPUT, 0, 1);
+
+    int accepted = 0;
+    for (int i = 0; i < RS485_QUEUE_DEPTH + 2; i++)
+    {
+        txns[i] = {};
+        txns[i].slave = EMPTY_ADDR;
+        txns[i].purpose = "probe";
+        txns[i].request = request;
+        txns[i].requestLen = sizeof(request);
+        txns[i].response = response;
+        txns[i].responseCap = sizeof(response);
+        txns[i].expectedLen = ModbusRtu_readResponseLen(1);
+        txns[i].timeoutMs = 30;
+        txns[i].quietTimeout = true;
+        txns[i].onComplete = recordCompletion;
+        if (RS485Bus_submit(bus, &txns[i]))
+        {
+            accepted++;
+        }
+        else
+        {
+            TEST_ASSERT_EQUAL_INT(RS485_BUSY, txns[i].status);
+        }
+        if (i == 0)
+        {
+            delay(5); // Let the worker take the first one onto the wire
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(RS485_QUEUE_DEPTH + 1, accepted); // Queue depth + the one on the wire
+    TEST_ASSERT_EQUAL_UINT32(RS485_QUEUE_DEPTH, bus->stats.queueHighWater);
+
+    waitCompletions(accepted);
+    TEST_ASSERT_EQUAL_UINT32(0, RS485Bus_queueDepth(bus));
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)accepted, bus->stats.timeouts);
+}
+
+void test_failures_are_classified_and_counted_per_slave(void)
+{
+    addPzems();
+    uint8_t data[2 * PZEM_REGS];
+
+    slaves->device(0x01).corruptNext = 1;
+    TEST_ASSERT_EQUAL_INT(RS485_CRC_ERROR, RS485Bus_readRegisters(bus, 0x01, MODBUS_FC_READ_INPUT, 0, PZEM_REGS, "pzem.measure", data));
+
+    slaves->device(0x02).exception = 0x04; // Slave device failure
+    TEST_ASSERT_EQUAL_INT(RS485_EXCEPTION, RS485Bus_readRegisters(bus, 0x02, MODBUS_FC_READ_INPUT, 0, PZEM_REGS, "pzem.measure", data));
+
+    slaves->device(0x04).shortNext = 1; // Valid frame, one register short: ends early at t3.5
+    TEST_ASSERT_EQUAL_INT(RS485_FRAME_ERROR, RS485Bus_readRegisters(bus, 0x04, MODBUS_FC_READ_INPUT, 0, PZEM_REGS, "pzem.measure", data));
+
+    const uint32_t start = millis();
+    TEST_ASSERT_EQUAL_INT(RS485_TIMEOUT, RS485Bus_readRegisters(bus, EMPTY_ADDR + 4, MODBUS_FC_READ_INPUT, 0, PZEM_REGS, "pzem.measure", data));
+    const uint32_t waited = millis() - start;
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(RS485_DEFAULT_TIMEOUT_MS, waited);
+    TEST_ASSERT_LESS_THAN_UINT32(RS485_DEFAULT_TIMEOUT_MS + 50, waited);
+
+    TEST_ASSERT_EQUAL_UINT32(4, bus->stats.transactions);
+    TEST_ASSERT_EQUAL_UINT32(4, bus->stats.failures);
+    TEST_ASSERT_EQUAL_UINT32(1, bus->stats.timeouts);
+    TEST_ASSERT_EQUAL_UINT32(1, bus->telemetry[0x01].crcErrors);
+    TEST_ASSERT_EQUAL_UINT32(1, bus->telemetry[0x02].exceptions);
+    TEST_ASSERT_EQUAL_UINT32(1, bus->telemetry[0x02].exceptionCodes[0x04]);
+    TEST_ASSERT_EQUAL_UINT32(1, bus->telemetry[0x04].frameErrors);
+    TEST_ASSERT_EQUAL_UINT32(1, bus->telemetry[EMPTY_ADDR + 4].timeouts);
+}
+
+void test_bus_time_counters(void)
+{
+    addPzems();
+    uint8_t data[2 * PZEM_REGS];
+    for (uint8_t addr = PZEM_FIRST_ADDR; addr < PZEM_FIRST_ADDR + PZEM_COUNT; addr++)
+    {
+        TEST_ASSERT_EQUAL_INT(RS485_OK, RS485Bus_readRegisters(bus, addr, MODBUS_FC_READ_INPUT, 0, PZEM_REGS, "pzem.measure", data));
+    }
+
+    // Request + response of a 10-register read: (8 + 25) characters on the wire, plus the slave latency
+    const uint32_t wireUs = (MODBUS_RTU_READ_REQUEST_LEN + ModbusRtu_readResponseLen(PZEM_REGS)) * bus->charTimeUs;
+    TEST_ASSERT_EQUAL_UINT32(PZEM_COUNT, bus->stats.transactions);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(PZEM_COUNT * wireUs, bus->stats.busTimeUs);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(wireUs, bus->stats.maxBusTimeUs);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(bus->stats.maxBusTimeUs * PZEM_COUNT, bus->stats.busTimeUs);
+    TEST_ASSERT_TRUE(bus->stats.gapWaitUs > 0); // Back-to-back reads waited for t3.5
+}
+
+/**
+ * @brief One acquisition cycle (6 PZEM reads + 1 ES35-SW read) through the bus owner, compared
+ *        with the guard delays it replaced.
+ */
+void test_benchmark_poll_cycle(void)
+{
+    addPzems();
+    addEs35();
+    uint8_t data[2 * PZEM_REGS];
+    const int cycles = 5;
+    const uint32_t start = micros();
+    for (int c = 0; c < cycles; c++)
+    {
+        for (uint8_t addr = PZEM_FIRST_ADDR; addr < PZEM_FIRST_ADDR + PZEM_COUNT; addr++)
+        {
+            TEST_ASSERT_EQUAL_INT(RS485_OK, RS485Bus_readRegisters(bus, addr, MODBUS_FC_READ_INPUT, 0, PZEM_REGS, "pzem.measure", data));
+        }
+        TEST_ASSERT_EQUAL_INT(RS485_OK, RS485Bus_readRegisters(bus, ES35_ADDR, MODBUS_FC_READ_HOLDING, 0, ES35_REGS, "es35.update", data));
+    }
+    const uint32_t cycleUs = (micros() - start) / cycles;
+
+    // Old code: delay(100) after each PZEM read and delay(150) around the ES35-SW, on top of the frames
+    const uint32_t oldGuardUs = PZEM_COUNT * 100000 + 150000;
+    char line[128];
+    snprintf(line, sizeof(line), "poll cycle: %lu us (%.1f cycles/s), guard delays alone were %lu us",
+             (unsigned long)cycleUs, 1e6 / cycleUs, (unsigned long)oldGuardUs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_LESS_THAN_UINT32(oldGuardUs, cycleUs);
+}
+
+/**
+ * @brief PZEM measurement reads per second at each rate from 9600 baud the ES35-SW offers, on the
+ *        simulated wire: what a faster bus would buy if every slave on it could follow (the PZEM016T
+ *        cannot).
+ */
+void test_benchmark_sockets_per_second_per_baud(void)
+{
+    addPzems();
+    static const uint32_t rates[] = {9600, 19200, 38400};
+    const int reads = 24;
+    double perSecond[sizeof(rates) / sizeof(rates[0])];
+    uint8_t data[2 * PZEM_REGS];
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+    {
+        RS485Bus_setBaud(bus, rates[r]);
+        slaves->setBaud(rates[r]);
+        const uint32_t start = micros();
+        for (int i = 0; i < reads; i++)
+        {
+            const Rs485Status status = RS485Bus_readRegisters(bus, (uint8_t)(PZEM_FIRST_ADDR + i % PZEM_COUNT),
+                                                              MODBUS_FC_READ_INPUT, 0, PZEM_REGS, "pzem.measure", data);
+            TEST_ASSERT_EQUAL_INT(RS485_OK, status);
+        }
+        const uint32_t elapsedUs = micros() - start;
+        perSecond[r] = reads * 1e6 / elapsedUs;
+
+        // Request + response + t3.5 on the wire, without the slave latency
+        const uint32_t wireUs = (MODBUS_RTU_READ_REQUEST_LEN + ModbusRtu_readResponseLen(PZEM_REGS)) * bus->charTimeUs +
+                                bus->interFrameGapUs;
+        char line[128];
+        snprintf(line, sizeof(line), "%6lu baud: %5.1f sockets/s (%lu us per read, %lu us of it on the wire)",
+                 (unsigned long)rates[r], perSecond[r], (unsigned long)(elapsedUs / reads), (unsigned long)wireUs);
+        TEST_MESSAGE(line);
+    }
+    for (size_t r = 1; r < sizeof(rates) / sizeof(rates[0]); r++)
+    {
+        TEST_ASSERT_TRUE(perSecond[r] > perSecond[r - 1]);
+    }
+    TEST_ASSERT_TRUE(perSecond[2] > 2 * perSecond[0]); // Not 4x: the 2 ms slave latency does not scale
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_inter_frame_gap_is_three_and_a_half_characters);
+    RUN_TEST(test_read_round_trip);
+    RUN_TEST(test_write_single_register_checks_the_echo);
+    RUN_TEST(test_mismatched_echo_does_not_switch_the_baud_rate);
+    RUN_TEST(test_concurrent_drivers_are_serialized_with_the_minimum_gap);
+    RUN_TEST(test_async_transactions_complete_in_order_with_their_tags);
+    RUN_TEST(test_full_queue_reports_busy);
+    RUN_TEST(test_failures_are_classified_and_counted_per_slave);
+    RUN_TEST(test_bus_time_counters);
+    RUN_TEST(test_benchmark_poll_cycle);
+    RUN_TEST(test_benchmark_sockets_per_second_per_baud);
+    return UNITY_END();
+}
@@ -0,0 +1,189 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the per-slave response timeout estimator, replaying latency traces of the
+ *        PZEM016T, ES35-SW and leak sensor (pio test -e native -f test_rto).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include "RtoEstimator.h"
+#include "traces.h"
+
+#define FIXED_TIMEOUT_MS 100 // RS485_DEFAULT_TIMEOUT_MS: timeout before a slave has been measured
+
+#define TRACE_LEN(trace) (sizeof(trace) / sizeof((trace)[0]))
+
+/**
+ * @brief Result of replaying one trace through an estimator, the way RS485_Bus uses it.
+ */
+typedef struct
+{
+    uint32_t falseTimeouts;     ///< Answers that came after the timeout in effect
+    uint32_t lastFalseTimeout;  ///< Index of the last false timeout
+    uint32_t deadTimeouts;      ///< Requests the slave never answered
+    uint32_t firstDetectMs;     ///< Wait before the first unanswered request was declared lost
+    uint32_t busMs;             ///< Bus time spent waiting for answers and timeouts
+    uint32_t fixedBusMs;        ///< Same trace with the fixed timeout
+    uint16_t minRtoMs;          ///< Smallest timeout used
+    uint16_t maxRtoMs;          ///< Largest timeout used
+} ReplayResult;
+
+static RtoEstimator est;
+
+/**
+ * @brief Wait for each transaction with the current timeout. An answer later than the timeout is a
+ *        (false) timeout and gives no sample, as in RS485_Bus (Karn).
+ */
+static ReplayResult replay(const uint32_t *trace, size_t len)
+{
+    ReplayResult r = {};
+    r.minRtoMs = 0xFFFF;
+    for (size_t i = 0; i < len; i++)
+    {
+        const uint16_t rtoMs = Rto_timeoutMs(&est);
+        r.minRtoMs = rtoMs < r.minRtoMs ? rtoMs : r.minRtoMs;
+        r.maxRtoMs = rtoMs > r.maxRtoMs ? rtoMs : r.maxRtoMs;
+        if (trace[i] == TRACE_NO_ANSWER)
+        {
+            if (r.deadTimeouts++ == 0)
+            {
+                r.firstDetectMs = rtoMs;
+            }
+            r.busMs += rtoMs;
+            r.fixedBusMs += FIXED_TIMEOUT_MS;
+            Rto_onTimeout(&est);
+            continue;
+        }
+        r.fixedBusMs += trace[i] / 1000;
+        if (trace[i] > rtoMs * 1000u)
+        {
+            r.falseTimeouts++;
+            r.lastFalseTimeout = (uint32_t)i;
+            r.busMs += rtoMs;
+            Rto_onTimeout(&est);
+            continue;
+        }
+        r.busMs += trace[i] / 1000;
+        Rto_addSample(&est, trace[i]);
+    }
+    return r;
+}
+
+static void report(const char *name, const ReplayResult &r)
+{
+    char line[192];
+    snprintf(line, sizeof(line), "%s: RTO %u..%u ms, false timeouts %lu, lost %lu (first after %lu ms), bus wait %lu ms (fixed %d ms: %lu ms)",
+             name, r.minRtoMs, r.maxRtoMs, (unsigned long)r.falseTimeouts, (unsigned long)r.deadTimeouts,
+             (unsigned long)r.firstDetectMs, (unsigned long)r.busMs, FIXED_TIMEOUT_MS, (unsigned long)r.fixedBusMs);
+    TEST_MESSAGE(line);
+}
+
+void setUp(void)
+{
+    Rto_init(&est, FIXED_TIMEOUT_MS);
+}
+
+void tearDown(void) {}
+
+void test_first_sample_sets_srtt_and_half_deviation(void)
+{
+    TEST_ASSERT_EQUAL_UINT16(FIXED_TIMEOUT_MS, Rto_timeoutMs(&est));
+    Rto_addSample(&est, 10000);
+    TEST_ASSERT_EQUAL_UINT32(10000, est.srttUs);
+    TEST_ASSERT_EQUAL_UINT32(5000, est.rttvarUs);
+    TEST_ASSERT_EQUAL_UINT16(30, Rto_timeoutMs(&est)); // 10 ms + 4 * 5 ms
+    TEST_ASSERT_EQUAL_UINT32(1, est.samples);
+}
+
+void test_timeout_is_clamped_to_its_bounds(void)
+{
+    for (int i = 0; i < 50; i++)
+    {
+        Rto_addSample(&est, 500); // Far below RTO_MIN_MS
+    }
+    TEST_ASSERT_EQUAL_UINT16(RTO_MIN_MS, Rto_timeoutMs(&est));
+
+    Rto_init(&est, FIXED_TIMEOUT_MS);
+    Rto_addSample(&est, 90000);
+    TEST_ASSERT_EQUAL_UINT16(RTO_MAX_MS, Rto_timeoutMs(&est));
+}
+
+void test_timeouts_double_up_to_the_cap(void)
+{
+    Rto_addSample(&est, 4000);
+    Rto_addSample(&est, 4000);
+    uint16_t expected = Rto_timeoutMs(&est);
+    for (int i = 0; i < 6; i++)
+    {
+        Rto_onTimeout(&est);
+        expected = (uint16_t)(2 * expected > RTO_MAX_MS ? RTO_MAX_MS : 2 * expected);
+        TEST_ASSERT_EQUAL_UINT16(expected, Rto_timeoutMs(&est));
+    }
+    TEST_ASSERT_EQUAL_UINT32(6, est.backoffs);
+    TEST_ASSERT_EQUAL_UINT32(2, est.samples); // Timeouts are not samples
+}
+
+void test_steady_pzem_trace_has_no_false_timeouts(void)
+{
+    const ReplayResult r = replay(TRACE_PZEM_STEADY, TRACE_LEN(TRACE_PZEM_STEADY));
+    report("pzem steady", r);
+    TEST_ASSERT_EQUAL_UINT32(0, r.falseTimeouts);
+    TEST_ASSERT_EQUAL_UINT16(RTO_MIN_MS, Rto_timeoutMs(&est)); // Settles on the floor, 5x below the fixed timeout
+    TEST_ASSERT_LESS_THAN_UINT32(RTO_MIN_MS * 1000u, est.srttUs + RTO_DEV_FACTOR * est.rttvarUs); // The floor binds
+}
+
+void test_jittery_es35_trace_keeps_a_margin(void)
+{
+    const ReplayResult r = replay(TRACE_ES35_JITTERY, TRACE_LEN(TRACE_ES35_JITTERY));
+    report("es35 jittery", r);
+    // Only the largest outlier (34.6 ms after a run of quick answers) outlasts SRTT + 4 * RTTVAR
+    TEST_ASSERT_EQUAL_UINT32(1, r.falseTimeouts);
+    TEST_ASSERT_EQUAL_UINT32(22, r.lastFalseTimeout);
+    TEST_ASSERT_GREATER_THAN_UINT32(RTO_MIN_MS, Rto_timeoutMs(&est)); // Variance keeps the timeout above the floor
+    TEST_ASSERT_LESS_THAN_UINT32(FIXED_TIMEOUT_MS, Rto_timeoutMs(&est));
+}
+
+void test_outage_is_detected_fast_and_polling_recovers(void)
+{
+    const ReplayResult r = replay(TRACE_PZEM_OUTAGE, TRACE_LEN(TRACE_PZEM_OUTAGE));
+    report("pzem outage", r);
+    TEST_ASSERT_EQUAL_UINT32(8, r.deadTimeouts);
+    TEST_ASSERT_EQUAL_UINT32(0, r.falseTimeouts);
+    TEST_ASSERT_EQUAL_UINT32(RTO_MIN_MS, r.firstDetectMs); // 5x faster than the fixed timeout
+    TEST_ASSERT_LESS_THAN_UINT32(r.fixedBusMs, r.busMs);
+    TEST_ASSERT_EQUAL_UINT16(RTO_MIN_MS, Rto_timeoutMs(&est)); // Backoff forgotten once the slave answers again
+}
+
+void test_latency_step_costs_only_a_few_timeouts(void)
+{
+    const ReplayResult r = replay(TRACE_LEAK_STEP, TRACE_LEN(TRACE_LEAK_STEP));
+    report("leak step", r);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(3, r.falseTimeouts);
+    TEST_ASSERT_LESS_THAN_UINT32(12 + 6, r.lastFalseTimeout); // Adapted within a few transactions of the step
+    TEST_ASSERT_GREATER_THAN_UINT32(42, Rto_timeoutMs(&est));  // Above the new latency
+}
+
+void test_isolated_spike_does_not_disturb_the_estimate(void)
+{
+    const ReplayResult r = replay(TRACE_PZEM_SPIKE, TRACE_LEN(TRACE_PZEM_SPIKE));
+    report("pzem spike", r);
+    TEST_ASSERT_EQUAL_UINT32(1, r.falseTimeouts); // The spike itself
+    TEST_ASSERT_EQUAL_UINT32(16, r.lastFalseTimeout);
+    TEST_ASSERT_EQUAL_UINT16(RTO_MIN_MS, Rto_timeoutMs(&est)); // No sample from the late answer (Karn)
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_sample_sets_srtt_and_half_deviation);
+    RUN_TEST(test_timeout_is_clamped_to_its_bounds);
+    RUN_TEST(test_timeouts_double_up_to_the_cap);
+    RUN_TEST(test_steady_pzem_trace_has_no_false_timeouts);
+    RUN_TEST(test_jittery_es35_trace_keeps_a_margin);
+    RUN_TEST(test_outage_is_detected_fast_and_polling_recovers);
+    RUN_TEST(test_latency_step_costs_only_a_few_timeouts);
+    RUN_TEST(test_isolated_spike_does_not_disturb_the_estimate);
+    return UNITY_END();
+}
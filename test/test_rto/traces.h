@@ -0,0 +1,48 @@
+/**
+ * @file traces.h
+ * @brief Latency traces replayed by the RTO estimator tests: one value per transaction, in the form
+ *        RS485_Bus feeds Rto_addSample() (end of request to end of response, minus the response's
+ *        wire time, so including the 4.6 ms UART RX-idle detection at 9600 baud).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#ifndef RTO_TRACES_H
+#define RTO_TRACES_H
+
+#include <stdint.h>
+
+#define TRACE_NO_ANSWER 0xFFFFFFFFu // Slave did not answer at all (dead, unpowered)
+
+// PZEM016T on a healthy bus: 1-4 ms turnaround
+static const uint32_t TRACE_PZEM_STEADY[] = {
+    6120, 6480, 5910, 7020, 6350, 6890, 5870, 6610, 7340, 6050, 6230, 6980, 5960, 6440, 7810, 6170,
+    6530, 6020, 6700, 6260, 5890, 7150, 6390, 6820, 6110, 6570, 8420, 6040, 6310, 6760, 5980, 6650,
+    6200, 7090, 6470, 6130, 6880, 6290, 6010, 6540};
+
+// ES35-SW: slower and more variable, sensor conversion occasionally delays the answer
+static const uint32_t TRACE_ES35_JITTERY[] = {
+    18400, 21300, 16900, 24800, 19700, 17200, 28900, 20100, 18800, 22600, 16500, 31200, 19300, 17800,
+    23400, 20900, 18100, 26700, 17500, 21800, 19900, 16800, 34600, 18600, 20400, 22100, 17100, 25300,
+    19100, 18300, 27800, 20700, 17600, 23900, 19500, 18900};
+
+// PZEM whose socket loses power after 10 answers and comes back after 8 unanswered requests
+static const uint32_t TRACE_PZEM_OUTAGE[] = {
+    6200, 6450, 5980, 6700, 6310, 6090, 6580, 6240, 6870, 6150,
+    TRACE_NO_ANSWER, TRACE_NO_ANSWER, TRACE_NO_ANSWER, TRACE_NO_ANSWER,
+    TRACE_NO_ANSWER, TRACE_NO_ANSWER, TRACE_NO_ANSWER, TRACE_NO_ANSWER,
+    9800, 7200, 6400, 6150, 6520, 6080, 6690, 6230, 6370, 6010};
+
+// Leak sensor whose turnaround steps from ~8 ms to ~40 ms (e.g. internal averaging enabled)
+static const uint32_t TRACE_LEAK_STEP[] = {
+    8100, 7900, 8400, 8200, 7800, 8600, 8000, 8300, 7700, 8500, 8100, 8200,
+    39800, 41200, 40500, 38900, 42100, 40200, 39600, 41700, 40800, 39300, 40100, 41500,
+    40600, 39900, 41000, 40300, 39500, 40900};
+
+// Healthy PZEM with one isolated late answer (bus noise, retransmission inside the slave)
+static const uint32_t TRACE_PZEM_SPIKE[] = {
+    6300, 6100, 6550, 6220, 6410, 6080, 6690, 6330, 6150, 6480, 6270, 6040, 6590, 6210, 6380, 6120,
+    48000,
+    6260, 6430, 6070, 6520, 6190, 6340, 6110, 6470, 6230, 6050, 6610, 6290, 6160, 6400, 6250};
+
+#endif // RTO_TRACES_H
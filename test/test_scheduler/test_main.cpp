@@ -0,0 +1,326 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the deadline scheduler on a fake clock, and a cycle-timing benchmark of the
+ *        acquisition job set (pio test -e native -f test_scheduler).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "Scheduler.h"
+
+static uint32_t fakeNow = 0; // Fake millis(), only moved by the tests and by job costs
+
+static uint32_t fakeClock(void)
+{
+    return fakeNow;
+}
+
+/**
+ * @brief Job context: counts runs, records the order of execution and burns fake time.
+ */
+typedef struct
+{
+    char tag;         ///< Written to the run log when the job runs
+    uint32_t costMs;  ///< Fake time the job takes
+    uint32_t runs;    ///< Executions so far
+    uint32_t lastRun; ///< Fake time of the last start
+} FakeJob;
+
+static char runLog[64];
+static size_t runLogLen = 0;
+
+static void fakeJobFn(void *ctx)
+{
+    FakeJob *job = (FakeJob *)ctx;
+    job->runs++;
+    job->lastRun = fakeNow;
+    if (runLogLen + 1 < sizeof(runLog))
+    {
+        runLog[runLogLen++] = job->tag;
+        runLog[runLogLen] = '\0';
+    }
+    fakeNow += job->costMs;
+}
+
+/**
+ * @brief Drive the scheduler like the acquisition task: run due jobs, then "sleep" the returned time.
+ */
+static void runUntil(Scheduler *sched, uint32_t endMs)
+{
+    while ((int32_t)(fakeNow - endMs) < 0)
+    {
+        const uint32_t waitMs = Scheduler_runDue(sched);
+        const uint32_t left = endMs - fakeNow;
+        fakeNow += (waitMs < left) ? waitMs : left;
+    }
+}
+
+void setUp(void)
+{
+    fakeNow = 1000;
+    runLogLen = 0;
+    runLog[0] = '\0';
+}
+
+void tearDown(void) {}
+
+void test_first_release_after_offset_then_periodic(void)
+{
+    Scheduler sched;
+    FakeJob job = {'a', 0, 0, 0};
+    Scheduler_init(&sched, fakeClock);
+    TEST_ASSERT_EQUAL_INT(0, Scheduler_addJob(&sched, "a", 100, 30, 0, fakeJobFn, &job));
+
+    TEST_ASSERT_EQUAL_UINT32(30, Scheduler_runDue(&sched));
+    TEST_ASSERT_EQUAL_UINT32(0, job.runs);
+
+    runUntil(&sched, 1000 + 30 + 100 * 9 + 1);
+    TEST_ASSERT_EQUAL_UINT32(10, job.runs);
+    TEST_ASSERT_EQUAL_UINT32(1930, job.lastRun);
+    TEST_ASSERT_EQUAL_UINT32(0, sched.jobs[0].missCount);
+    TEST_ASSERT_EQUAL_UINT32(0, sched.jobs[0].maxJitterMs);
+}
+
+void test_idle_wait_is_time_to_next_release(void)
+{
+    Scheduler sched;
+    FakeJob fast = {'f', 0, 0, 0};
+    FakeJob slow = {'s', 0, 0, 0};
+    Scheduler_init(&sched, fakeClock);
+    TEST_ASSERT_EQUAL_UINT32(SCHEDULER_IDLE_MAX_MS, Scheduler_runDue(&sched));
+
+    Scheduler_addJob(&sched, "fast", 250, 0, 0, fakeJobFn, &fast);
+    Scheduler_addJob(&sched, "slow", 1000, 400, 0, fakeJobFn, &slow);
+    TEST_ASSERT_EQUAL_UINT32(250, Scheduler_runDue(&sched)); // fast ran, released again at +250
+    fakeNow += 250;
+    TEST_ASSERT_EQUAL_UINT32(150, Scheduler_runDue(&sched)); // fast ran, slow is due at +400
+    TEST_ASSERT_EQUAL_STRING("ff", runLog);
+}
+
+void test_earliest_deadline_runs_first(void)
+{
+    Scheduler sched;
+    FakeJob lax = {'l', 0, 0, 0};
+    FakeJob urgent = {'u', 0, 0, 0};
+    FakeJob medium = {'m', 0, 0, 0};
+    Scheduler_init(&sched, fakeClock);
+    // Registration order is not execution order when all three are due together
+    Scheduler_addJob(&sched, "lax", 1000, 0, 900, fakeJobFn, &lax);
+    Scheduler_addJob(&sched, "urgent", 1000, 0, 50, fakeJobFn, &urgent);
+    Scheduler_addJob(&sched, "medium", 1000, 0, 300, fakeJobFn, &medium);
+
+    Scheduler_runDue(&sched);
+    TEST_ASSERT_EQUAL_STRING("uml", runLog);
+}
+
+void test_late_start_is_recorded_as_jitter(void)
+{
+    Scheduler sched;
+    FakeJob blocker = {'b', 70, 0, 0};
+    FakeJob victim = {'v', 0, 0, 0};
+    Scheduler_init(&sched, fakeClock);
+    Scheduler_addJob(&sched, "blocker", 1000, 0, 100, fakeJobFn, &blocker);
+    Scheduler_addJob(&sched, "victim", 1000, 0, 500, fakeJobFn, &victim);
+
+    Scheduler_runDue(&sched);
+    TEST_ASSERT_EQUAL_STRING("bv", runLog);
+    TEST_ASSERT_EQUAL_UINT32(70, sched.jobs[1].lastJitterMs);
+    TEST_ASSERT_EQUAL_UINT32(70, sched.jobs[1].maxJitterMs);
+    TEST_ASSERT_EQUAL_UINT32(70, sched.jobs[0].lastDurationMs);
+    TEST_ASSERT_EQUAL_UINT32(0, sched.jobs[0].missCount);
+    TEST_ASSERT_EQUAL_UINT32(0, sched.jobs[1].missCount);
+}
+
+void test_overrun_counts_a_deadline_miss(void)
+{
+    Scheduler sched;
+    FakeJob job = {'a', 120, 0, 0};
+    Scheduler_init(&sched, fakeClock);
+    Scheduler_addJob(&sched, "a", 1000, 0, 100, fakeJobFn, &job);
+
+    Scheduler_runDue(&sched);
+    TEST_ASSERT_EQUAL_UINT32(1, sched.jobs[0].missCount);
+    // The next release keeps the original grid, not end of run + period
+    TEST_ASSERT_EQUAL_UINT32(2000, sched.jobs[0].nextRunMs);
+}
+
+void test_skipped_releases_count_as_misses(void)
+{
+    Scheduler sched;
+    FakeJob job = {'a', 0, 0, 0};
+    Scheduler_init(&sched, fakeClock);
+    Scheduler_addJob(&sched, "a", 100, 0, 0, fakeJobFn, &job);
+    Scheduler_runDue(&sched);
+
+    fakeNow += 350; // Dispatcher blocked for 3.5 periods
+    Scheduler_runDue(&sched);
+    // The 1100 release runs late (a miss), 1200 is skipped (a miss), 1300 still runs, 1400 is next
+    TEST_ASSERT_EQUAL_UINT32(3, job.runs);
+    TEST_ASSERT_EQUAL_UINT32(250, sched.jobs[0].maxJitterMs);
+    TEST_ASSERT_EQUAL_UINT32(50, sched.jobs[0].lastJitterMs);
+    TEST_ASSERT_EQUAL_UINT32(2, sched.jobs[0].missCount);
+    TEST_ASSERT_EQUAL_UINT32(1400, sched.jobs[0].nextRunMs);
+}
+
+void test_shorter_period_pulls_next_release_in(void)
+{
+    Scheduler sched;
+    FakeJob job = {'a', 0, 0, 0};
+    FakeJob other = {'b', 0, 0, 0};
+    Scheduler_init(&sched, fakeClock);
+    const int idx = Scheduler_addJob(&sched, "a", 5000, 0, 0, fakeJobFn, &job);
+    const int late = Scheduler_addJob(&sched, "b", 5000, 0, 0, fakeJobFn, &other);
+    Scheduler_runDue(&sched);
+    TEST_ASSERT_EQUAL_UINT32(6000, sched.jobs[idx].nextRunMs);
+
+    fakeNow = 1300;
+    Scheduler_setPeriod(&sched, idx, 1000);
+    TEST_ASSERT_EQUAL_UINT32(2000, sched.jobs[idx].nextRunMs); // Last release 1000 + new period
+    TEST_ASSERT_EQUAL_UINT32(1000, sched.jobs[idx].deadlineMs); // Default deadline follows the period
+
+    Scheduler_setPeriod(&sched, idx, 10000); // A longer period never delays the pending release
+    TEST_ASSERT_EQUAL_UINT32(2000, sched.jobs[idx].nextRunMs);
+
+    fakeNow = 2500;
+    Scheduler_setPeriod(&sched, late, 1000); // 1000 + 1000 already passed: due now, not a miss
+    TEST_ASSERT_EQUAL_UINT32(2500, sched.jobs[late].nextRunMs);
+    Scheduler_runDue(&sched);
+    TEST_ASSERT_EQUAL_UINT32(2, other.runs);
+    TEST_ASSERT_EQUAL_UINT32(0, sched.jobs[late].lastJitterMs);
+    TEST_ASSERT_EQUAL_UINT32(0, sched.jobs[late].missCount);
+}
+
+void test_disable_enable_and_trigger(void)
+{
+    Scheduler sched;
+    FakeJob job = {'a', 0, 0, 0};
+    Scheduler_init(&sched, fakeClock);
+    const int idx = Scheduler_addJob(&sched, "a", 100, 0, 0, fakeJobFn, &job);
+    Scheduler_setEnabled(&sched, idx, false);
+    runUntil(&sched, fakeNow + 1000);
+    TEST_ASSERT_EQUAL_UINT32(0, job.runs);
+
+    Scheduler_setEnabled(&sched, idx, true); // Runs at once, the releases missed while disabled are not misses
+    Scheduler_runDue(&sched);
+    TEST_ASSERT_EQUAL_UINT32(1, job.runs);
+    TEST_ASSERT_EQUAL_UINT32(0, sched.jobs[idx].missCount);
+
+    fakeNow += 10;
+    Scheduler_trigger(&sched, idx);
+    Scheduler_runDue(&sched);
+    TEST_ASSERT_EQUAL_UINT32(2, job.runs);
+
+    TEST_ASSERT_EQUAL_INT(-1, Scheduler_addJob(&sched, "bad", 0, 0, 0, fakeJobFn, &job));
+    Scheduler_setPeriod(&sched, 7, 100); // Out of range indexes are ignored
+    Scheduler_trigger(&sched, -1);
+}
+
+void test_millis_wraparound(void)
+{
+    Scheduler sched;
+    FakeJob job = {'a', 0, 0, 0};
+    fakeNow = 0xFFFFFF00u;
+    Scheduler_init(&sched, fakeClock);
+    Scheduler_addJob(&sched, "a", 100, 0, 0, fakeJobFn, &job);
+
+    runUntil(&sched, 0xFFFFFF00u + 1001); // Crosses 2^32 after 256 ms
+    TEST_ASSERT_EQUAL_UINT32(11, job.runs);
+    TEST_ASSERT_EQUAL_UINT32(0, sched.jobs[0].missCount);
+    TEST_ASSERT_EQUAL_UINT32(0, sched.jobs[0].maxJitterMs);
+}
+
+void test_job_table_full(void)
+{
+    Scheduler sched;
+    FakeJob job = {'a', 0, 0, 0};
+    Scheduler_init(&sched, fakeClock);
+    for (int i = 0; i < SCHEDULER_MAX_JOBS; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(i, Scheduler_addJob(&sched, "a", 100, 0, 0, fakeJobFn, &job));
+    }
+    TEST_ASSERT_EQUAL_INT(-1, Scheduler_addJob(&sched, "a", 100, 0, 0, fakeJobFn, &job));
+}
+
+/**
+ * @brief One simulated hour of the acquisition task's job set (periods and offsets of main.cpp), with
+ *        each job costing its 9600-baud Modbus round trip in fake time.
+ *
+ * Reports jitter and misses per job, the time the sensor bus is busy per 5 s cycle (the old loop
+ * slept 1.2 s of fixed delays on top of the same reads), and the host cost of one dispatch.
+ */
+void test_benchmark_acquisition_cycle(void)
+{
+    enum
+    {
+        PERIOD = 5000,
+        SOCKETS = 6,
+        HOUR_MS = 3600000
+    };
+    Scheduler sched;
+    FakeJob env = {'e', 20, 0, 0};     // FC 0x03, 2 registers: 8 + 9 bytes
+    FakeJob pzem[SOCKETS];
+    FakeJob publish = {'p', 15, 0, 0}; // Change detection and snapshot capture
+    FakeJob beeper = {'b', 0, 0, 0};
+    Scheduler_init(&sched, fakeClock);
+    Scheduler_addJob(&sched, "es35sw", PERIOD, 100, 500, fakeJobFn, &env);
+    for (int id = 0; id < SOCKETS; id++)
+    {
+        pzem[id] = {(char)('1' + id), 40, 0, 0}; // FC 0x04, 10 registers: 8 + 25 bytes
+        Scheduler_addJob(&sched, "pzem", PERIOD, 200, 500, fakeJobFn, &pzem[id]);
+    }
+    Scheduler_addJob(&sched, "publish", PERIOD, 2000, 1000, fakeJobFn, &publish);
+    Scheduler_addJob(&sched, "beeper", 1000, 2000, 0, fakeJobFn, &beeper);
+
+    uint32_t dispatches = 0;
+    const uint32_t endMs = fakeNow + HOUR_MS;
+    const auto start = std::chrono::steady_clock::now();
+    while ((int32_t)(fakeNow - endMs) < 0)
+    {
+        fakeNow += Scheduler_runDue(&sched);
+        dispatches++;
+    }
+    const double hostNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    char line[160];
+    uint32_t misses = 0;
+    for (int i = 0; i < sched.jobCount; i++)
+    {
+        const SchedulerJob *job = &sched.jobs[i];
+        snprintf(line, sizeof(line), "%-8s runs %5lu misses %lu jitter avg/max %lu/%lu ms", job->name,
+                 (unsigned long)job->runCount, (unsigned long)job->missCount,
+                 (unsigned long)(job->runCount ? job->sumJitterMs / job->runCount : 0),
+                 (unsigned long)job->maxJitterMs);
+        TEST_MESSAGE(line);
+        misses += job->missCount;
+    }
+    const uint32_t busyMs = env.costMs + SOCKETS * pzem[0].costMs + publish.costMs;
+    snprintf(line, sizeof(line), "busy per %u ms cycle: %lu ms (fixed-delay loop: %lu ms), %.0f ns per dispatch",
+             PERIOD, (unsigned long)busyMs, (unsigned long)(busyMs + 3 * 100 + SOCKETS * 150), hostNs / dispatches);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL_UINT32(0, misses);
+    TEST_ASSERT_EQUAL_UINT32(HOUR_MS / PERIOD, publish.runs);
+    TEST_ASSERT_EQUAL_UINT32(HOUR_MS / PERIOD, pzem[SOCKETS - 1].runs);
+    // The last socket waits behind the other five reads: its start delay stays under its deadline
+    TEST_ASSERT_LESS_THAN_UINT32(500, sched.jobs[SOCKETS].maxJitterMs);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_release_after_offset_then_periodic);
+    RUN_TEST(test_idle_wait_is_time_to_next_release);
+    RUN_TEST(test_earliest_deadline_runs_first);
+    RUN_TEST(test_late_start_is_recorded_as_jitter);
+    RUN_TEST(test_overrun_counts_a_deadline_miss);
+    RUN_TEST(test_skipped_releases_count_as_misses);
+    RUN_TEST(test_shorter_period_pulls_next_release_in);
+    RUN_TEST(test_disable_enable_and_trigger);
+    RUN_TEST(test_millis_wraparound);
+    RUN_TEST(test_job_table_full);
+    RUN_TEST(test_benchmark_acquisition_cycle);
+    return UNITY_END();
+}
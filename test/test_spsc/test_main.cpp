@@ -0,0 +1,229 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests and throughput benchmark of the SPSC snapshot queue (pio test -e native -f test_spsc).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include "SpscQueue.h"
+
+#define HANDOFF_ITEMS 200000u  // Items pushed through the queue by the two-thread tests
+#define SNAPSHOT_PAYLOAD 436   // sizeof(SensorSnapshot) in a host build
+
+/**
+ * @brief Element whose every byte is derived from its sequence number, so a torn copy is detected.
+ */
+typedef struct
+{
+    uint32_t sequence;
+    uint8_t payload[SNAPSHOT_PAYLOAD - sizeof(uint32_t)];
+} FakeSnapshot;
+
+static void fillSnapshot(FakeSnapshot *snap, uint32_t sequence)
+{
+    snap->sequence = sequence;
+    memset(snap->payload, (int)(sequence & 0xFF), sizeof(snap->payload));
+}
+
+static bool snapshotIntact(const FakeSnapshot *snap)
+{
+    for (size_t i = 0; i < sizeof(snap->payload); i++)
+    {
+        if (snap->payload[i] != (uint8_t)(snap->sequence & 0xFF))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_starts_empty(void)
+{
+    SpscQueue<int, 4> queue;
+    int item = -1;
+    TEST_ASSERT_TRUE(queue.empty());
+    TEST_ASSERT_EQUAL_UINT32(0, queue.size());
+    TEST_ASSERT_FALSE(queue.pop(item));
+    TEST_ASSERT_EQUAL_INT(-1, item);
+    TEST_ASSERT_EQUAL_UINT32(4, queue.capacity());
+}
+
+void test_fifo_order(void)
+{
+    SpscQueue<int, 8> queue;
+    for (int i = 0; i < 5; i++)
+    {
+        TEST_ASSERT_TRUE(queue.push(i));
+    }
+    TEST_ASSERT_EQUAL_UINT32(5, queue.size());
+    for (int i = 0; i < 5; i++)
+    {
+        int item = -1;
+        TEST_ASSERT_TRUE(queue.pop(item));
+        TEST_ASSERT_EQUAL_INT(i, item);
+    }
+    TEST_ASSERT_TRUE(queue.empty());
+}
+
+void test_full_queue_rejects_push(void)
+{
+    SpscQueue<int, 4> queue;
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_TRUE(queue.push(i));
+    }
+    TEST_ASSERT_FALSE(queue.push(99));
+    TEST_ASSERT_EQUAL_UINT32(4, queue.size());
+
+    // The rejected item was not stored and the queued ones are untouched
+    int item = -1;
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL_INT(0, item);
+    TEST_ASSERT_TRUE(queue.push(4));
+    for (int expected = 1; expected <= 4; expected++)
+    {
+        TEST_ASSERT_TRUE(queue.pop(item));
+        TEST_ASSERT_EQUAL_INT(expected, item);
+    }
+    TEST_ASSERT_FALSE(queue.pop(item));
+}
+
+void test_wraps_around_many_times(void)
+{
+    SpscQueue<uint32_t, 4> queue;
+    uint32_t next = 0;
+    uint32_t expected = 0;
+    // Alternate fill levels so every slot is written and read at every offset
+    for (uint32_t round = 0; round < 10000; round++)
+    {
+        const uint32_t burst = 1 + round % 4;
+        for (uint32_t i = 0; i < burst; i++)
+        {
+            TEST_ASSERT_TRUE(queue.push(next++));
+        }
+        for (uint32_t i = 0; i < burst; i++)
+        {
+            uint32_t item = 0;
+            TEST_ASSERT_TRUE(queue.pop(item));
+            TEST_ASSERT_EQUAL_UINT32(expected++, item);
+        }
+    }
+    TEST_ASSERT_TRUE(queue.empty());
+}
+
+/**
+ * @brief Producer and consumer on two threads: every item arrives once, in order and not torn.
+ */
+void test_two_threads_handoff_in_order(void)
+{
+    static SpscQueue<FakeSnapshot, 4> queue;
+    std::thread producer([]()
+                         {
+                             FakeSnapshot snap;
+                             for (uint32_t seq = 0; seq < HANDOFF_ITEMS; seq++)
+                             {
+                                 fillSnapshot(&snap, seq);
+                                 while (!queue.push(snap))
+                                 {
+                                     std::this_thread::yield();
+                                 }
+                             } });
+
+    uint32_t expected = 0;
+    uint32_t torn = 0;
+    FakeSnapshot snap;
+    while (expected < HANDOFF_ITEMS)
+    {
+        if (!queue.pop(snap))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        if (snap.sequence != expected)
+        {
+            break;
+        }
+        if (!snapshotIntact(&snap))
+        {
+            torn++;
+        }
+        expected++;
+    }
+    producer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(HANDOFF_ITEMS, expected);
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_TRUE(queue.empty());
+}
+
+/**
+ * @brief Items per second through a queue of @p T with one producer and one consumer thread.
+ */
+template <typename T, size_t N>
+static double measureThroughput(uint32_t items)
+{
+    static SpscQueue<T, N> queue;
+    const auto start = std::chrono::steady_clock::now();
+    std::thread producer([items]()
+                         {
+                             T item = {};
+                             for (uint32_t i = 0; i < items; i++)
+                             {
+                                 while (!queue.push(item))
+                                 {
+                                     std::this_thread::yield();
+                                 }
+                             } });
+    T item;
+    for (uint32_t received = 0; received < items;)
+    {
+        if (queue.pop(item))
+        {
+            received++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return items / seconds;
+}
+
+void test_benchmark_throughput(void)
+{
+    char line[128];
+    const double words = measureThroughput<uint32_t, 64>(2000000);
+    snprintf(line, sizeof(line), "uint32_t, depth 64: %.1f M items/s (%.0f ns/item)", words / 1e6, 1e9 / words);
+    TEST_MESSAGE(line);
+
+    const double snapshots = measureThroughput<FakeSnapshot, 4>(HANDOFF_ITEMS);
+    snprintf(line, sizeof(line), "%u-byte snapshot, depth 4: %.2f M snapshots/s (%.0f ns/snapshot)",
+             (unsigned)sizeof(FakeSnapshot), snapshots / 1e6, 1e9 / snapshots);
+    TEST_MESSAGE(line);
+
+    // The firmware hands over one snapshot per publish period (seconds): any positive rate is ample,
+    // the numbers above are for comparison between builds, not a pass criterion
+    TEST_ASSERT_TRUE(snapshots > 0);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_starts_empty);
+    RUN_TEST(test_fifo_order);
+    RUN_TEST(test_full_queue_rejects_push);
+    RUN_TEST(test_wraps_around_many_times);
+    RUN_TEST(test_two_threads_handoff_in_order);
+    RUN_TEST(test_benchmark_throughput);
+    return UNITY_END();
+}
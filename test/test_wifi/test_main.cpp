@@ -0,0 +1,339 @@
+/**
+ * @file test_main.cpp
+ * @brief Host tests of the WiFi connection state machine, driven by a fake WiFi event source and a
+ *        fake clock (pio test -e native -f test_wifi).
+ * @date 2026-10-17
+ * @license MIT
+ */
+
+#include <unity.h>
+#include <string.h>
+#include "WifiStateMachine.h"
+
+#define BEGIN_LOG_MAX 64 // WiFi.begin() calls recorded per test
+
+/**
+ * @brief One call of the driver's begin(): which network, and whether the scan was skipped.
+ */
+typedef struct
+{
+    const char *ssid;
+    int32_t channel;
+    bool hasBssid;
+    uint8_t bssid[6];
+    uint32_t atMs;
+} BeginCall;
+
+static const WifiCredential credentials[] = {
+    {"primary", "pw-primary"},
+    {"backup", "pw-backup"}};
+
+static const uint8_t AP_PRIMARY[6] = {0x24, 0x0A, 0xC4, 0x11, 0x22, 0x33};
+static const uint8_t AP_PRIMARY_OTHER[6] = {0x24, 0x0A, 0xC4, 0x44, 0x55, 0x66};
+static const uint8_t AP_BACKUP[6] = {0xB8, 0x27, 0xEB, 0x01, 0x02, 0x03};
+
+static WifiStateMachine sm;
+static uint32_t fakeNowMs;
+static BeginCall beginLog[BEGIN_LOG_MAX];
+static size_t beginCount;
+static uint32_t disconnectCount;
+static WifiApCache savedCache;
+static uint32_t saveCount;
+
+static void fakeBegin(const char *ssid, const char *password, int32_t channel, const uint8_t *bssid)
+{
+    (void)password;
+    if (beginCount < BEGIN_LOG_MAX)
+    {
+        BeginCall *call = &beginLog[beginCount];
+        call->ssid = ssid;
+        call->channel = channel;
+        call->hasBssid = bssid != NULL;
+        if (bssid != NULL)
+        {
+            memcpy(call->bssid, bssid, sizeof(call->bssid));
+        }
+        call->atMs = fakeNowMs;
+    }
+    beginCount++;
+}
+
+static void fakeDisconnect(void)
+{
+    disconnectCount++;
+}
+
+static void fakeSaveCache(const WifiApCache *cache)
+{
+    savedCache = *cache;
+    saveCount++;
+}
+
+static const WifiSmDriver driver = {fakeBegin, fakeDisconnect, fakeSaveCache};
+
+// Fake event source: what the ESP32 WiFi driver reports through WiFi.onEvent()
+static void associated(const uint8_t bssid[6], uint8_t channel)
+{
+    WifiSmEvent event = {};
+    event.type = WIFI_SM_EVT_ASSOCIATED;
+    memcpy(event.bssid, bssid, sizeof(event.bssid));
+    event.channel = channel;
+    WifiSM_handleEvent(&sm, &event, fakeNowMs);
+}
+
+static void gotIp(void)
+{
+    WifiSmEvent event = {};
+    event.type = WIFI_SM_EVT_GOT_IP;
+    WifiSM_handleEvent(&sm, &event, fakeNowMs);
+}
+
+static void disconnected(void)
+{
+    WifiSmEvent event = {};
+    event.type = WIFI_SM_EVT_DISCONNECTED;
+    WifiSM_handleEvent(&sm, &event, fakeNowMs);
+}
+
+/**
+ * @brief Advance the fake clock to @p endMs, ticking every 100 ms like the network task does.
+ */
+static void tickUntil(uint32_t endMs)
+{
+    while (fakeNowMs < endMs)
+    {
+        WifiSM_tick(&sm, fakeNowMs);
+        fakeNowMs += 100;
+    }
+    WifiSM_tick(&sm, fakeNowMs);
+}
+
+static const BeginCall *lastBegin(void)
+{
+    TEST_ASSERT_TRUE(beginCount > 0 && beginCount <= BEGIN_LOG_MAX);
+    return &beginLog[beginCount - 1];
+}
+
+/**
+ * @brief Bring the link up on the primary AP through a full scan, starting from @p startMs.
+ */
+static void connectPrimary(uint32_t startMs)
+{
+    fakeNowMs = startMs;
+    WifiSM_tick(&sm, fakeNowMs);
+    fakeNowMs += 1800;
+    associated(AP_PRIMARY, 6);
+    fakeNowMs += 400;
+    gotIp();
+}
+
+void setUp(void)
+{
+    fakeNowMs = 0;
+    beginCount = 0;
+    disconnectCount = 0;
+    saveCount = 0;
+    memset(&savedCache, 0, sizeof(savedCache));
+    WifiSM_init(&sm, credentials, 2, &driver, NULL);
+}
+
+void tearDown(void) {}
+
+void test_idle_until_first_tick(void)
+{
+    TEST_ASSERT_EQUAL_INT(WIFI_SM_IDLE, sm.state);
+    TEST_ASSERT_EQUAL_UINT32(0, beginCount);
+
+    WifiSM_tick(&sm, 0);
+    TEST_ASSERT_EQUAL_INT(WIFI_SM_CONNECTING, sm.state);
+    TEST_ASSERT_EQUAL_UINT32(1, beginCount);
+    TEST_ASSERT_EQUAL_STRING("primary", lastBegin()->ssid);
+    TEST_ASSERT_FALSE(lastBegin()->hasBssid); // Nothing cached: full scan
+    TEST_ASSERT_EQUAL_INT32(0, lastBegin()->channel);
+}
+
+void test_first_connection_fills_the_cache(void)
+{
+    connectPrimary(1000);
+
+    TEST_ASSERT_TRUE(WifiSM_isConnected(&sm));
+    TEST_ASSERT_EQUAL_UINT32(1, sm.connectCount);
+    TEST_ASSERT_EQUAL_UINT32(0, sm.cacheHits);
+    TEST_ASSERT_EQUAL_UINT32(2200, sm.lastReconnectMs);
+    TEST_ASSERT_EQUAL_UINT32(1, saveCount);
+    TEST_ASSERT_TRUE(savedCache.valid);
+    TEST_ASSERT_EQUAL_UINT8(6, savedCache.channel);
+    TEST_ASSERT_EQUAL_UINT8(0, savedCache.credentialIndex);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(AP_PRIMARY, savedCache.bssid, 6);
+}
+
+void test_reconnect_skips_the_scan_and_is_measured(void)
+{
+    connectPrimary(0);
+    tickUntil(60000); // Connected: ticks start nothing
+    const size_t before = beginCount;
+
+    disconnected();
+    TEST_ASSERT_EQUAL_INT(WIFI_SM_CONNECTING, sm.state);
+    TEST_ASSERT_EQUAL_UINT32(before + 1, beginCount);
+    TEST_ASSERT_EQUAL_STRING("primary", lastBegin()->ssid);
+    TEST_ASSERT_TRUE(lastBegin()->hasBssid);
+    TEST_ASSERT_EQUAL_INT32(6, lastBegin()->channel);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(AP_PRIMARY, lastBegin()->bssid, 6);
+
+    fakeNowMs += 100;
+    disconnected(); // Echo of our own disconnect(): inside the grace period, ignored
+    TEST_ASSERT_EQUAL_UINT32(before + 1, beginCount);
+
+    fakeNowMs += 250;
+    associated(AP_PRIMARY, 6);
+    fakeNowMs += 150;
+    gotIp();
+    TEST_ASSERT_TRUE(WifiSM_isConnected(&sm));
+    TEST_ASSERT_EQUAL_UINT32(1, sm.cacheHits);
+    TEST_ASSERT_EQUAL_UINT32(500, sm.lastReconnectMs);
+    TEST_ASSERT_EQUAL_UINT32(2200, sm.maxReconnectMs);
+    TEST_ASSERT_EQUAL_UINT32(1, saveCount); // Same AP: the cache is not rewritten
+}
+
+void test_stale_cache_falls_back_to_a_scan_of_the_same_ssid(void)
+{
+    connectPrimary(0);
+    disconnected();
+    const uint32_t lostMs = fakeNowMs;
+
+    tickUntil(lostMs + WIFI_SM_CACHED_TIMEOUT_MS);
+    TEST_ASSERT_EQUAL_INT(WIFI_SM_CONNECTING, sm.state);
+    TEST_ASSERT_EQUAL_STRING("primary", lastBegin()->ssid);
+    TEST_ASSERT_FALSE(lastBegin()->hasBssid);
+    TEST_ASSERT_EQUAL_UINT32(lostMs + WIFI_SM_CACHED_TIMEOUT_MS, lastBegin()->atMs);
+    TEST_ASSERT_FALSE(sm.cache.valid);
+
+    // The AP was replaced: the scan finds another BSSID, which becomes the new cache
+    associated(AP_PRIMARY_OTHER, 11);
+    gotIp();
+    TEST_ASSERT_EQUAL_UINT32(0, sm.cacheHits);
+    TEST_ASSERT_EQUAL_UINT32(2, saveCount);
+    TEST_ASSERT_EQUAL_UINT8(11, savedCache.channel);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(AP_PRIMARY_OTHER, savedCache.bssid, 6);
+}
+
+void test_scan_timeout_rotates_to_the_backup_ssid(void)
+{
+    tickUntil(WIFI_SM_SCAN_TIMEOUT_MS - 100);
+    TEST_ASSERT_EQUAL_UINT32(1, beginCount);
+
+    tickUntil(WIFI_SM_SCAN_TIMEOUT_MS);
+    TEST_ASSERT_EQUAL_UINT32(2, beginCount);
+    TEST_ASSERT_EQUAL_STRING("backup", lastBegin()->ssid);
+    TEST_ASSERT_EQUAL_UINT32(1, sm.failedAttempts);
+
+    associated(AP_BACKUP, 1);
+    gotIp();
+    TEST_ASSERT_TRUE(WifiSM_isConnected(&sm));
+    TEST_ASSERT_EQUAL_UINT8(1, savedCache.credentialIndex);
+}
+
+void test_rejected_attempt_moves_on_without_waiting_for_the_timeout(void)
+{
+    WifiSM_tick(&sm, 0);
+    fakeNowMs = 2000;
+    disconnected(); // Wrong password / AP refused us
+    TEST_ASSERT_EQUAL_UINT32(2, beginCount);
+    TEST_ASSERT_EQUAL_STRING("backup", lastBegin()->ssid);
+    TEST_ASSERT_EQUAL_UINT32(2000, lastBegin()->atMs);
+}
+
+void test_all_ssids_failing_backs_off_exponentially(void)
+{
+    const uint32_t expectedBackoff[] = {1000, 2000, 4000, 8000, 16000, 32000, 60000, 60000};
+    WifiSM_tick(&sm, 0);
+
+    for (size_t round = 0; round < sizeof(expectedBackoff) / sizeof(expectedBackoff[0]); round++)
+    {
+        const size_t beginsBefore = beginCount;
+        const uint32_t roundStart = fakeNowMs;
+        tickUntil(roundStart + 2 * WIFI_SM_SCAN_TIMEOUT_MS);
+        TEST_ASSERT_EQUAL_INT(WIFI_SM_BACKOFF, sm.state);
+        TEST_ASSERT_EQUAL_UINT32(beginsBefore + 1, beginCount); // Only the backup was tried
+
+        const uint32_t backoffStart = fakeNowMs;
+        tickUntil(backoffStart + expectedBackoff[round] - 100);
+        TEST_ASSERT_EQUAL_INT(WIFI_SM_BACKOFF, sm.state);
+        tickUntil(backoffStart + expectedBackoff[round]);
+        TEST_ASSERT_EQUAL_INT(WIFI_SM_CONNECTING, sm.state);
+        TEST_ASSERT_EQUAL_STRING("primary", lastBegin()->ssid);
+    }
+
+    // A success resets the backoff
+    associated(AP_PRIMARY, 6);
+    gotIp();
+    TEST_ASSERT_EQUAL_UINT32(WIFI_SM_BACKOFF_MIN_MS, sm.backoffMs);
+    TEST_ASSERT_EQUAL_UINT32(fakeNowMs, sm.lastReconnectMs);
+}
+
+void test_saved_cache_is_used_from_the_first_attempt(void)
+{
+    WifiApCache cache = {};
+    memcpy(cache.bssid, AP_BACKUP, sizeof(cache.bssid));
+    cache.channel = 1;
+    cache.credentialIndex = 1;
+    cache.valid = true;
+    WifiSM_init(&sm, credentials, 2, &driver, &cache);
+
+    WifiSM_tick(&sm, 0);
+    TEST_ASSERT_EQUAL_STRING("backup", lastBegin()->ssid);
+    TEST_ASSERT_TRUE(lastBegin()->hasBssid);
+    TEST_ASSERT_EQUAL_INT32(1, lastBegin()->channel);
+
+    fakeNowMs = 300;
+    associated(AP_BACKUP, 1);
+    gotIp();
+    TEST_ASSERT_EQUAL_UINT32(1, sm.cacheHits);
+    TEST_ASSERT_EQUAL_UINT32(0, saveCount);
+}
+
+void test_invalid_saved_cache_is_ignored(void)
+{
+    WifiApCache cache = {};
+    cache.channel = 1;
+    cache.credentialIndex = 5; // Credential table shrank since the cache was written
+    cache.valid = true;
+    WifiSM_init(&sm, credentials, 2, &driver, &cache);
+
+    WifiSM_tick(&sm, 0);
+    TEST_ASSERT_EQUAL_STRING("primary", lastBegin()->ssid);
+    TEST_ASSERT_FALSE(lastBegin()->hasBssid);
+}
+
+void test_stray_events_are_ignored(void)
+{
+    gotIp(); // Before the first attempt
+    TEST_ASSERT_EQUAL_INT(WIFI_SM_IDLE, sm.state);
+
+    WifiSM_tick(&sm, 0);
+    tickUntil(2 * WIFI_SM_SCAN_TIMEOUT_MS);
+    TEST_ASSERT_EQUAL_INT(WIFI_SM_BACKOFF, sm.state);
+    const size_t before = beginCount;
+    gotIp();
+    disconnected();
+    TEST_ASSERT_EQUAL_INT(WIFI_SM_BACKOFF, sm.state);
+    TEST_ASSERT_EQUAL_UINT32(before, beginCount);
+    TEST_ASSERT_EQUAL_UINT32(0, sm.connectCount);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_until_first_tick);
+    RUN_TEST(test_first_connection_fills_the_cache);
+    RUN_TEST(test_reconnect_skips_the_scan_and_is_measured);
+    RUN_TEST(test_stale_cache_falls_back_to_a_scan_of_the_same_ssid);
+    RUN_TEST(test_scan_timeout_rotates_to_the_backup_ssid);
+    RUN_TEST(test_rejected_attempt_moves_on_without_waiting_for_the_timeout);
+    RUN_TEST(test_all_ssids_failing_backs_off_exponentially);
+    RUN_TEST(test_saved_cache_is_used_from_the_first_attempt);
+    RUN_TEST(test_invalid_saved_cache_is_ignored);
+    RUN_TEST(test_stray_events_are_ignored);
+    return UNITY_END();
+}